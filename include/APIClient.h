@@ -6,21 +6,41 @@
 #include <ArduinoJson.h>
 #include "DataCollector.h"
 #include "EventDetector.h"
+#include "JsonWriter.h"
+#include "CborWriter.h"
+#include "Deflater.h"
+#include "FlashOutbox.h"
+#include "SequenceCounter.h"
+#include "SecureTransport.h"
+#include "CircuitBreaker.h"
+#include "TokenBucket.h"
+#include "TelemetrySink.h"
+#include "SensorRecord.h"
 
 struct APIConfig {
     String baseURL;
     String apiKey;
     bool useHttps;
     bool verifyCertificate;
+    String caCert;              // PEM; pins the CA when verifying
+    String certFingerprint;     // SHA-256 hex; pins the server certificate instead
+    bool useCbor;
+    bool compressBatches;
 };
 
-struct DataBuffer {
-    AggregatedData data;
-    unsigned long timestamp;
-    bool valid;
+// One outgoing POST body and the headers that describe it
+struct RequestBody {
+    const char* data;
+    size_t length;
+    bool cbor;
+    bool gzip;
+    const char* idempotencyKey;   // nullptr omits the Idempotency-Key header
+    bool critical;                // Critical event; see admitRequest()
 };
 
-class WellPumpAPIClient {
+// Also a TelemetrySink: the pipeline hands it each record already encoded
+// in its current payload encoding.
+class WellPumpAPIClient : public TelemetrySink {
 private:
     String baseURL;
     String apiKey;
@@ -28,9 +48,56 @@ private:
     String location;
     bool useHttps;
     bool verifyCertificate;
+    String caCert;
+    String certFingerprint;
+    
+    // Binary payloads when configured; a 415 from the server switches back to JSON
+    bool useCbor;
+    bool cborAccepted;
+    
+    // Gzip for batch bodies large enough to benefit; a 415 on a compressed
+    // request switches back to identity encoding
+    bool compressBatches;
+    bool gzipAccepted;
+    Deflater* deflater;
+    uint8_t* compressBuffer;
+    uint32_t compressedBatchCount;
+    uint32_t compressedBytesIn;
+    uint32_t compressedBytesOut;
+    
+    // Request strings built once per configuration instead of per request
+    String sensorsURL;
+    String batchURL;
+    String eventsURL;
+    String healthURL;
+    String authHeader;
+    
+    // Every outgoing body is serialized in place here; no per-request heap
+    char* payloadBuffer;
     
     HTTPClient* httpClient;
-    WiFiClientSecure* secureClient;
+    SecureTransport* secureClient;      // Caches the TLS session for resumption
+    WiFiClient* plainClient;
+    
+    // Keep-alive: one socket reused across requests until the server closes
+    // it or it sits idle past KEEPALIVE_IDLE_TIMEOUT
+    unsigned long lastRequestTime;
+    uint32_t requestCount;
+    uint32_t connectionCount;
+    uint32_t reusedCount;
+    uint32_t reconnectRetryCount;
+    unsigned long lastRequestDuration;
+    unsigned long totalRequestDuration;
+    uint32_t lastDrainCount;
+    unsigned long lastDrainDuration;
+    
+    // Batched drain of the buffer to /api/sensors/batch. The batch size
+    // grows while requests stay under BATCH_TARGET_LATENCY and halves when
+    // they don't; a 404/405 falls back to one POST per record.
+    bool batchSupported;
+    uint8_t batchSize;
+    uint32_t batchRequestCount;
+    uint32_t rejectedCount;
     
     bool connected;
     bool initialized;
@@ -38,26 +105,58 @@ private:
     unsigned long lastRetryTime;
     uint16_t retryCount;
     uint16_t maxRetries;
+    unsigned long retryDelay;           // Drawn once per failed attempt; see getRetryDelay()
     int lastHttpStatusCode;
     
-    static const uint16_t BUFFER_SIZE = 20;
+    // Overload protection for every request, drains and health checks
+    // included: the breaker stops traffic to a failing or slow server, the
+    // bucket caps requests per minute. Critical events have their own lane:
+    // a reserved token and no breaker hold-off.
+    CircuitBreaker* breaker;
+    TokenBucket* rateLimiter;
+    uint32_t deferredCount;
+    bool lastRequestDeferred;
+    
+    // Between drain posts, so critical events don't wait behind a backlog
+    SinkYieldCallback yieldCallback;
+    void* yieldContext;
+    
+    static const size_t PAYLOAD_BUFFER_SIZE = 8192;
     static const unsigned long CONNECTION_TEST_INTERVAL = 30000;
     static const unsigned long RETRY_DELAY = 5000;
     static const unsigned long MAX_RETRY_DELAY = 300000;
+    static const unsigned long KEEPALIVE_IDLE_TIMEOUT = 4000;   // Under Node's 5s keepAliveTimeout
+    static const uint16_t REQUEST_TIMEOUT = 10000;
+    static const uint8_t MIN_BATCH_SIZE = 2;
+    static const uint8_t MAX_BATCH_SIZE = 20;
+    static const uint8_t INITIAL_BATCH_SIZE = 5;
+    static const unsigned long BATCH_TARGET_LATENCY = 3000;
+    static const size_t COMPRESS_MIN_BYTES = 1024;               // About two records
+    static const size_t IDEMPOTENCY_KEY_SIZE = 64;
+    static const unsigned long SLOW_REQUEST_TIME = 6000;        // Counts against the server in the breaker
+    static const uint16_t RATE_LIMIT_PER_MINUTE = 12;           // With batching, about 240 records a minute
+    static const uint16_t RATE_LIMIT_BURST = 6;
+    static const uint16_t CRITICAL_TOKEN_RESERVE = 1;           // Only critical events spend the last token
+    static const long MAX_RETRY_AFTER = 3600;                   // Seconds
+    
+    // Unsent aggregates, on flash so they survive resets; drained oldest first
+    FlashOutbox* outbox;
+    AggregatedData* batchRecords;
+    unsigned long lastDrainFailure;
     
-    DataBuffer* buffer;
-    uint8_t bufferIndex;
-    uint8_t bufferedCount;
-    uint8_t bufferSize;
+    // The pipeline's device-wide numbering, not owned; only records sent
+    // directly through sendSensorData() are numbered here
+    SequenceCounter* sequenceCounter;
+    uint32_t lastAckedSequence;
     
-    void resetRetryCount() { retryCount = 0; }
+    void resetRetryCount() { retryCount = 0; retryDelay = RETRY_DELAY; }
     unsigned long getRetryDelay() const;
     
 public:
-    WellPumpAPIClient(const APIConfig& config, const String& device, const String& loc);
+    WellPumpAPIClient(const APIConfig& config, const String& device, const String& loc, SequenceCounter* sequences);
     ~WellPumpAPIClient();
     
-    bool begin();
+    bool begin() override;
     bool testConnection();
     bool connect();
     void disconnect();
@@ -66,11 +165,22 @@ public:
     bool validateConfiguration() const;
     
     // Data sending methods
-    bool sendSensorData(const AggregatedData& data);
-    bool sendEvent(const Event& event);
+    bool sendSensorData(const AggregatedData& aggregate);
+    bool sendEvent(const Event& event, bool heartbeat = false);
+    
+    // TelemetrySink
+    const char* getName() const override { return "api"; }
+    SinkEncoding getEncoding() const override { return cborEnabled() ? ENCODING_API_CBOR : ENCODING_API_JSON; }
+    size_t encode(const AggregatedData& data, uint8_t* out, size_t size) override;
+    SinkResult deliver(const AggregatedData& data, const uint8_t* payload, size_t length) override;
+    bool acceptsEvents() const override { return true; }
+    uint8_t deliverEvents(const OutboxEntry* entries, uint8_t count) override;
+    void update(bool online) override { if (online) update(); }
+    void setYieldCallback(SinkYieldCallback callback, void* context) override;
+    int getLastStatusCode() const override { return lastHttpStatusCode; }
     
     // Buffer management
-    void addToBuffer(const AggregatedData& data);
+    bool addToBuffer(const AggregatedData& data);
     bool processBuffer();
     bool flushBuffer();
     
@@ -78,23 +188,72 @@ public:
     void update();
     String getConnectionStatus() const;
     String getLastError() const;
-    uint8_t getBufferedCount() const { return bufferedCount; }
+    uint32_t getBufferedCount() const { return outbox->pendingCount(); }
+    void getOutboxStats(OutboxStats& out) const { outbox->getStats(out); }
     bool isConnected() const { return connected; }
     bool isInitialized() const { return initialized; }
     int getLastHttpStatusCode() const { return lastHttpStatusCode; }
     
+    // Transport metrics; request duration is also a proxy for radio-on time per upload
+    uint32_t getRequestCount() const { return requestCount; }
+    uint32_t getConnectionCount() const { return connectionCount; }
+    uint32_t getReusedCount() const { return reusedCount; }
+    uint32_t getReconnectRetryCount() const { return reconnectRetryCount; }
+    unsigned long getLastRequestDuration() const { return lastRequestDuration; }
+    unsigned long getAverageRequestDuration() const { return requestCount ? totalRequestDuration / requestCount : 0; }
+    unsigned long getTotalRequestDuration() const { return totalRequestDuration; }
+    uint32_t getLastDrainCount() const { return lastDrainCount; }
+    unsigned long getLastDrainDuration() const { return lastDrainDuration; }
+    bool isBatchSupported() const { return batchSupported; }
+    uint8_t getBatchSize() const { return batchSize; }
+    uint32_t getBatchRequestCount() const { return batchRequestCount; }
+    uint32_t getRejectedCount() const { return rejectedCount; }
+    const char* getPayloadEncoding() const { return cborEnabled() ? "cbor" : "json"; }
+    bool isCompressionEnabled() const { return compressionEnabled(); }
+    uint32_t getCompressedBatchCount() const { return compressedBatchCount; }
+    uint32_t getLastAckedSequence() const { return lastAckedSequence; }
+    const char* getTLSMode() const;
+    bool getTLSStats(TLSStats& out) const;
+    float getCompressionRatio() const { return compressedBytesOut ? (float)compressedBytesIn / compressedBytesOut : 0.0f; }
+    const char* getBreakerState() const { return breaker->getStateName(); }
+    uint8_t getBreakerFailurePercent() const { return breaker->getFailurePercent(); }
+    unsigned long getBreakerRetryIn() const { return breaker->getRetryIn(); }
+    uint32_t getBreakerTrips() const { return breaker->getTripCount(); }
+    uint16_t getRateLimitTokens() const { return rateLimiter->getTokens(); }
+    uint32_t getDeferredCount() const { return deferredCount; }
+    
 private:
     // HTTP request methods
-    bool makeRequest(const String& endpoint, const String& method, const String& payload);
-    bool sendSensorDataToAPI(const AggregatedData& data);
-    bool sendEventToAPI(const Event& event);
+    bool makeRequest(const String& url, const RequestBody& body, String* response = nullptr);
+    int performRequest(const String& url, const RequestBody& body);
+    bool uplinkReady(bool critical = false);
+    bool admitRequest(bool critical = false);
+    void recordOutcome(int httpCode, unsigned long duration);
+    bool cborEnabled() const { return useCbor && cborAccepted; }
+    bool cborRejected();
+    bool compressionEnabled() const { return compressBatches && gzipAccepted && deflater; }
+    void beginRequest(const String& url, const RequestBody* body = nullptr);
+    SinkResult sendRecord(const AggregatedData& data, const uint8_t* payload, size_t length);
+    bool sendSensorDataToAPI(const AggregatedData& data, const uint8_t* payload = nullptr, size_t length = 0);
+    bool sendEventToAPI(const OutboxEntry& entry);
+    
+    // Buffer drain
+    int sendBufferBatch(const AggregatedData* records, uint8_t count);
+    bool postBatch(const RequestBody& body, String* response);
+    void adjustBatchSize(bool success);
     
-    // JSON formatting
-    String createSensorJSON(const AggregatedData& data);
-    String createEventJSON(const Event& event);
-    String formatTimestamp(unsigned long timestamp);
+    // Payload formatting; record layouts are shared by the JSON and CBOR
+    // encodings (sensor records in SensorRecord.h)
+    template <typename Writer> void writeEventRecord(Writer& writer, const OutboxEntry& entry);
+    template <typename Writer> uint8_t writeBatch(Writer& writer, const AggregatedData* records, uint8_t count);
     
     // Connection management
+    void buildRequestStrings();
+    void setupCompressor();
     bool setupHTTPClient();
+    bool setupVerification();
     void cleanupHTTPClient();
+    WiFiClient* transport() const;
+    void closeIdleConnection();
+    static bool isStaleConnectionError(int httpCode);
 };
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+
+// The one list of AggregatedData fields. The struct and every encoder are
+// generated from it: the uplink record (JSON and CBOR), the MongoDB
+// document, /api/aggregated, CSV and the packed binary form. Host tools
+// read this file too (tools/aggregate_decode.py), so a field added here
+// shows up everywhere without further code.
+//
+//   type    C type of the member
+//   member  Member name, also the field name in flat layouts
+//   kind    TIME (epoch seconds), COUNT, ID or METRIC
+//   group   MongoDB sub-document for metrics, NONE for top level
+//   key     Name inside the group. Also how mergeAggregate() combines two
+//           windows: min, max, start (older), end (newer), rms; other
+//           metrics are averaged by sample count
+//   pack    Packed binary: 0 leaves it out; a metric's fixed-point scale
+//           as int16; 1 for integers, sent as is
+//   record  1 if uplink records carry it; 0 for local views only
+//
+// Members are stored in this order, so reordering or retyping them changes
+// the flash outbox record; bump FlashOutbox::RECORD_MAGIC with it.
+#define AGGREGATE_FIELDS(X) \
+    X(float,         tempMin,             METRIC, TEMPERATURE, "min",       0,   1) \
+    X(float,         tempMax,             METRIC, TEMPERATURE, "max",       0,   1) \
+    X(float,         tempAvg,             METRIC, TEMPERATURE, "avg",       100, 1) \
+    X(float,         humMin,              METRIC, HUMIDITY,    "min",       0,   1) \
+    X(float,         humMax,              METRIC, HUMIDITY,    "max",       0,   1) \
+    X(float,         humAvg,              METRIC, HUMIDITY,    "avg",       100, 1) \
+    X(float,         pressMin,            METRIC, PRESSURE,    "min",       100, 1) \
+    X(float,         pressMax,            METRIC, PRESSURE,    "max",       100, 1) \
+    X(float,         pressAvg,            METRIC, PRESSURE,    "avg",       0,   1) \
+    X(float,         current1Min,         METRIC, CURRENT1,    "min",       0,   1) \
+    X(float,         current1Max,         METRIC, CURRENT1,    "max",       100, 1) \
+    X(float,         current1Avg,         METRIC, CURRENT1,    "avg",       0,   1) \
+    X(float,         current1RMS,         METRIC, CURRENT1,    "rms",       100, 1) \
+    X(float,         current2Min,         METRIC, CURRENT2,    "min",       0,   1) \
+    X(float,         current2Max,         METRIC, CURRENT2,    "max",       100, 1) \
+    X(float,         current2Avg,         METRIC, CURRENT2,    "avg",       0,   1) \
+    X(float,         current2RMS,         METRIC, CURRENT2,    "rms",       100, 1) \
+    X(float,         dutyCycle1,          METRIC, CURRENT1,    "dutyCycle", 100, 1) \
+    X(float,         dutyCycle2,          METRIC, CURRENT2,    "dutyCycle", 100, 1) \
+    X(unsigned long, startTime,           TIME,   NONE,        "start",     0,   1) \
+    X(unsigned long, endTime,             TIME,   NONE,        "end",       1,   1) \
+    X(uint16_t,      tempSampleCount,     COUNT,  NONE,        "",          0,   0) \
+    X(uint16_t,      humSampleCount,      COUNT,  NONE,        "",          0,   0) \
+    X(uint16_t,      pressSampleCount,    COUNT,  NONE,        "",          0,   0) \
+    X(uint16_t,      current1SampleCount, COUNT,  NONE,        "",          0,   0) \
+    X(uint16_t,      current2SampleCount, COUNT,  NONE,        "",          0,   0) \
+    X(uint16_t,      sampleCount,         COUNT,  NONE,        "",          0,   1) \
+    X(uint32_t,      sequence,            ID,     NONE,        "",          1,   1)
+
+// MongoDB sub-documents, in the order they are written
+#define AGGREGATE_GROUPS(G) \
+    G(TEMPERATURE, "temperature") \
+    G(HUMIDITY,    "humidity") \
+    G(PRESSURE,    "pressure") \
+    G(CURRENT1,    "current1") \
+    G(CURRENT2,    "current2")
+
+enum AggregateFieldKind {
+    FIELD_TIME,
+    FIELD_COUNT,
+    FIELD_ID,
+    FIELD_METRIC
+};
+
+enum AggregateGroup {
+    GROUP_NONE,
+#define AGGREGATE_GROUP_ENUM(id, name) GROUP_##id,
+    AGGREGATE_GROUPS(AGGREGATE_GROUP_ENUM)
+#undef AGGREGATE_GROUP_ENUM
+    GROUP_COUNT
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Streaming CBOR (RFC 8949) writer with the same interface as JsonWriter, so
+// one record layout can be emitted in either encoding. Maps and arrays use
+// indefinite length, floats are single precision. Never allocates.
+class CborWriter {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    bool overflow;
+    
+public:
+    CborWriter(char* buf, size_t size);
+    
+    void reset();
+    
+    // Drop everything written since mark(), e.g. an array element that
+    // didn't fit
+    size_t mark() const { return length; }
+    void rewind(size_t position);
+    
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    
+    void key(const char* name);
+    
+    void value(const char* str);
+    void value(float number, uint8_t decimals = 3);
+    void value(double number, uint8_t decimals = 3);
+    void value(int number);
+    void value(unsigned int number);
+    void value(long number);
+    void value(unsigned long number);
+    void value(unsigned long long number);
+    void value(bool flag);
+    void nullValue();
+    
+    template <typename T>
+    void field(const char* name, T fieldValue) {
+        key(name);
+        value(fieldValue);
+    }
+    
+    const char* data() const { return buffer; }
+    size_t size() const { return length; }
+    bool overflowed() const { return overflow; }
+    
+private:
+    void put(uint8_t byte);
+    void putHead(uint8_t majorType, unsigned long long argument);
+    void putSigned(long long number);
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+
+enum BreakerState {
+    BREAKER_CLOSED,         // Requests flow; outcomes are tracked
+    BREAKER_OPEN,           // Requests are held until the open time runs out
+    BREAKER_HALF_OPEN       // One probe request decides between closed and open
+};
+
+// Circuit breaker over the outcomes of the last WINDOW_SIZE requests. A
+// request counts against the server when it fails (transport error, 5xx,
+// 429) or takes longer than the slow-call threshold. When at least
+// MIN_SAMPLES are known and FAILURE_PERCENT of them are bad, the breaker
+// opens and no requests go out until the open time has passed; then a
+// single probe is let through.
+//
+// The open time doubles with each failed probe and is drawn at random from
+// the upper half of its range, so devices that tripped together come back
+// spread out instead of all at once.
+class CircuitBreaker {
+private:
+    BreakerState state;
+    uint32_t outcomes;          // One bit per request, newest in bit 0; set = bad
+    uint8_t samples;
+    uint8_t reopenCount;        // Failed probes since the breaker last closed
+    
+    unsigned long slowCallMs;
+    unsigned long openedAt;
+    unsigned long openDuration;
+    bool probeInFlight;
+    
+    uint32_t tripCount;
+    uint32_t heldCount;
+    
+    static const uint8_t WINDOW_SIZE = 20;
+    static const uint8_t MIN_SAMPLES = 5;
+    static const uint8_t FAILURE_PERCENT = 50;
+    static const unsigned long BASE_OPEN_TIME = 30000;
+    static const unsigned long MAX_OPEN_TIME = 300000;      // Same cap as the reconnect backoff
+    
+public:
+    CircuitBreaker(unsigned long slowCall);
+    
+    // Whether a request may go out now. In the open state this moves to
+    // half-open once the open time is over, and the caller's request is
+    // the probe; every admitted request must be followed by record().
+    bool allowRequest();
+    bool wouldAllow() const;
+    void record(bool failed, unsigned long durationMs);
+    
+    // Server asked for a pause (Retry-After); opens for at least that long
+    void holdOff(unsigned long ms);
+    void reset();
+    
+    BreakerState getState() const { return state; }
+    const char* getStateName() const;
+    uint8_t getFailurePercent() const;
+    unsigned long getRetryIn() const;       // ms until the next probe, 0 unless open
+    uint32_t getTripCount() const { return tripCount; }
+    uint32_t getHeldCount() const { return heldCount; }
+    
+private:
+    void open(unsigned long duration);
+    void close();
+    unsigned long jitteredOpenTime() const;
+    uint8_t badCount() const;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+// CSV with the same interface as JsonWriter, so a flat record layout can
+// be written as a header line (header = true: keys only) or a data line
+// (values only) from the same template. Objects and arrays don't nest in
+// CSV and only delimit the line. Never allocates.
+class CsvWriter {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    bool overflow;
+    bool header;
+    bool hasItems;
+    
+public:
+    CsvWriter(char* buf, size_t size, bool headerLine);
+    
+    void reset();
+    
+    void beginObject() {}
+    void endObject() {}
+    void beginArray() {}
+    void endArray() {}
+    
+    void key(const char* name);
+    
+    void value(const char* str);
+    void value(float number, uint8_t decimals = 3);
+    void value(double number, uint8_t decimals = 3);
+    void value(int number);
+    void value(unsigned int number);
+    void value(long number);
+    void value(unsigned long number);
+    void value(unsigned long long number);
+    void value(bool flag);
+    void nullValue();
+    
+    template <typename T>
+    void field(const char* name, T fieldValue) {
+        key(name);
+        value(fieldValue);
+    }
+    
+    const char* c_str() const { return buffer; }
+    size_t size() const { return length; }
+    bool overflowed() const { return overflow; }
+    
+private:
+    void numberCell(const char* text);
+    void cell(const char* text, bool quoteIfNeeded);
+    void put(char c);
+};
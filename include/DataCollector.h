@@ -7,6 +7,7 @@
 #include <freertos/semphr.h>
 #include "SensorManager.h"
 #include "NoiseFilter.h"
+#include "AggregateSchema.h"
 
 struct SensorData {
     float temperature;
@@ -15,24 +16,26 @@ struct SensorData {
     float current1;
     float current2;
     unsigned long timestamp;
+    unsigned long sampleTime;   // millis() when the sample was taken
+    unsigned long sampleMicros; // micros() when the sample was taken, for latency tracking
     bool valid;
 };
 
+// Called from the collection task exactly once per sample, outside the data mutex
+typedef void (*SampleCallback)(const SensorData& data, void* context);
+
+struct SampleSubscriber {
+    SampleCallback callback;
+    void* context;
+};
+
+// Members come from AggregateSchema.h. sampleCount is the smallest of the
+// per-sensor counts; sequence is assigned by the uplink before the first
+// send attempt and is 0 until then.
 struct AggregatedData {
-    float tempMin, tempMax, tempAvg;
-    float humMin, humMax, humAvg;
-    float pressMin, pressMax, pressAvg;
-    float current1Min, current1Max, current1Avg, current1RMS;
-    float current2Min, current2Max, current2Avg, current2RMS;
-    float dutyCycle1, dutyCycle2;
-    unsigned long startTime;
-    unsigned long endTime;
-    uint16_t tempSampleCount;
-    uint16_t humSampleCount;
-    uint16_t pressSampleCount;
-    uint16_t current1SampleCount;
-    uint16_t current2SampleCount;
-    uint16_t sampleCount; // Keep for backward compatibility - will be the minimum count
+#define AGGREGATE_MEMBER(type, member, ...) type member;
+    AGGREGATE_FIELDS(AGGREGATE_MEMBER)
+#undef AGGREGATE_MEMBER
 };
 
 class DataCollector {
@@ -66,6 +69,10 @@ private:
     float currentThreshold1;
     float currentThreshold2;
     
+    static const uint8_t MAX_SAMPLE_SUBSCRIBERS = 4;
+    SampleSubscriber sampleSubscribers[MAX_SAMPLE_SUBSCRIBERS];
+    uint8_t sampleSubscriberCount;
+    
 public:
     DataCollector(SensorManager* sensorMgr);
     ~DataCollector();
@@ -75,10 +82,14 @@ public:
     
     bool getCurrentData(SensorData& data);
     bool getAggregatedData(AggregatedData& data);
-    void clearAggregatedData();
+    // Copies and clears in one step, so an aggregate is handed out once
+    bool takeAggregatedData(AggregatedData& data);
     
     void setCurrentThresholds(float threshold1, float threshold2);
     
+    // Register before begin(); subscribers run on the collection task
+    bool addSampleSubscriber(SampleCallback callback, void* context);
+    
     bool isRunning() const { return running; }
     uint16_t getQueueSize() const;
     
@@ -90,6 +101,7 @@ private:
     void aggregationTaskFunction();
     
     void collectSensorData();
+    void publishSample(const SensorData& data);
     void processQueueData();
     void aggregateData();
     
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Gzip (RFC 1952 / RFC 1951) compressor for upload bodies. LZ77 with hash
+// chains over a bounded window, emitted as a single fixed-Huffman block.
+// The match tables are allocated once; gzip() itself never allocates.
+class Deflater {
+private:
+    uint16_t* head;
+    uint16_t* prev;
+    
+    uint8_t* output;
+    size_t capacity;
+    size_t length;
+    bool overflow;
+    
+    uint32_t bitBuffer;
+    uint8_t bitCount;
+    
+    static const uint16_t WINDOW_SIZE = 4096;     // Max match distance; deflate allows 32K
+    static const uint16_t WINDOW_MASK = WINDOW_SIZE - 1;
+    static const uint8_t HASH_BITS = 10;
+    static const uint16_t HASH_SIZE = 1 << HASH_BITS;
+    static const uint8_t MAX_CHAIN = 32;           // Candidates checked per position
+    static const uint16_t MIN_MATCH = 3;
+    static const uint16_t MAX_MATCH = 258;
+    static const uint16_t NO_POSITION = 0xFFFF;
+    
+public:
+    static const size_t MAX_INPUT = 0xFFFE;        // Positions are 16-bit
+    
+    Deflater();
+    ~Deflater();
+    
+    // Returns the gzip stream size, or 0 if it didn't fit in outSize
+    size_t gzip(const uint8_t* input, size_t inputLength, uint8_t* out, size_t outSize);
+    
+private:
+    void deflate(const uint8_t* input, size_t inputLength);
+    uint16_t longestMatch(const uint8_t* input, size_t inputLength, size_t position, uint16_t& distance);
+    void insertPosition(const uint8_t* input, size_t inputLength, size_t position);
+    
+    void putLiteral(uint8_t byte);
+    void putMatch(uint16_t matchLength, uint16_t distance);
+    void putCode(uint16_t code, uint8_t bits);
+    void putBits(uint32_t value, uint8_t bits);
+    void flushBits();
+    void putByte(uint8_t byte);
+    void putLE32(uint32_t value);
+};
@@ -2,6 +2,8 @@
 
 #include <Arduino.h>
 #include "DataCollector.h"
+#include "SlopeEstimator.h"
+#include "PumpCycleAnalyzer.h"
 
 enum EventType {
     EVENT_NONE = 0,
@@ -9,20 +11,48 @@ enum EventType {
     EVENT_LOW_PRESSURE = 2,
     EVENT_LOW_TEMPERATURE = 3,
     EVENT_SENSOR_ERROR = 4,
-    EVENT_SYSTEM_ERROR = 5
+    EVENT_SYSTEM_ERROR = 5,
+    EVENT_PRESSURE_DECAY = 6,
+    EVENT_CYCLE_ANOMALY = 7,
+    EVENT_DRY_RUN = 8,
+    EVENT_LOCKED_ROTOR = 9,
+    EVENT_TYPE_COUNT
 };
 
+enum EventState {
+    EVENT_STATE_RAISED = 0,
+    EVENT_STATE_UPDATED = 1,
+    EVENT_STATE_CLEARED = 2
+};
+
+// Trivially copyable: no heap, safe to memset and copy between tasks
 struct Event {
+    uint32_t sequence;          // Monotonic per device, bumped on every logged transition
     EventType type;
+    EventState state;
     float value;
     float threshold;
     unsigned long startTime;
     unsigned long duration;
+    unsigned long loggedMillis; // millis() when this transition was logged, for delivery latency
     bool active;
-    String description;
 };
 
+// Static per-type text, indexed by EventType
+const char* eventDescription(EventType type);
+const char* eventTypeName(EventType type);
+const char* eventStateName(EventState state);
+
+// Critical types bypass the periodic upload and go out as soon as they're logged
+bool isCriticalEvent(EventType type);
+
+typedef void (*EventVisitor)(const Event& event, void* context);
+
 class EventDetector {
+public:
+    // Ring of raised/cleared transitions, oldest overwritten first
+    static const uint8_t EVENT_LOG_SIZE = 32;
+    
 private:
     DataCollector* dataCollector;
     
@@ -34,67 +64,163 @@ private:
     float currentHysteresis;
     float temperatureHysteresis;
     
+    // Leak detection: pressure decay rate (PSI/min) while the pump is idle
+    float pressureDecayThreshold;
+    float pressureDecayHysteresis;
+    SlopeEstimator* pressureSlope;
+    
+    // Current above which the pump is considered running
+    float pumpRunningCurrent;
+    
+    // Learned per-site pump cycle signature
+    PumpCycleAnalyzer* cycleAnalyzer;
+    
+    // Run response: current vs. pressure rise at the start of each run.
+    // Absolute limits apply until the cycle baseline is learned.
+    float dryRunCurrent;
+    float lockedRotorCurrent;
+    float minPressureRise;
+    unsigned long lockedRotorEventTime;
+    
     unsigned long currentEventTime;
     unsigned long pressureEventTime;
     unsigned long temperatureEventTime;
+    unsigned long pressureDecayEventTime;
     
     unsigned long currentEventDuration;
     unsigned long pressureEventDuration;
     unsigned long temperatureEventDuration;
     
-    Event currentEvents[10];
+    // One slot per event type; active slots are the current incidents
+    Event activeEvents[EVENT_TYPE_COUNT];
     uint8_t eventCount;
-
-    Event resolvedEvents[10];
-    uint8_t resolvedEventCount;
+    
+    Event eventLog[EVENT_LOG_SIZE];
+    uint8_t eventLogHead;
+    uint8_t eventLogCount;
+    uint32_t nextSequence;
+    uint32_t firstSequence;     // First sequence logged this boot
+    uint32_t deliveredSequence; // Everything up to here reached a sink; later entries are checkpointed
+    
+    // Value at the last logged transition; moving further past the
+    // threshold by ESCALATION_STEP_RATIO logs an escalation (UPDATED)
+    float loggedValue[EVENT_TYPE_COUNT];
+    static constexpr float ESCALATION_STEP_RATIO = 0.1;
     
     bool highCurrentActive;
     bool lowPressureActive;
     bool lowTemperatureActive;
     bool sensorErrorActive;
+    bool pressureDecayActive;
+    bool cycleAnomalyActive;
+    bool dryRunActive;
+    bool lockedRotorActive;
+    
+    SemaphoreHandle_t eventMutex;
+    
+    // Detection latency: sample capture to end of evaluation
+    uint32_t samplesEvaluated;
+    uint32_t samplesSkipped;            // Lock timed out; the sample was never evaluated
+    unsigned long lastEvaluationLatencyUs;
+    unsigned long maxEvaluationLatencyUs;
+    unsigned long lastDetectionDelayMs;
     
     static const unsigned long CURRENT_EVENT_DELAY = 3000;
     static const unsigned long PRESSURE_EVENT_DELAY = 10000;
     static const unsigned long TEMPERATURE_EVENT_DELAY = 10000;
+    static const unsigned long PRESSURE_DECAY_EVENT_DELAY = 30000;
+    
+    static const unsigned long DRY_RUN_WINDOW = 10000;          // Pressure must rise within 10s of start
+    static const unsigned long LOCKED_ROTOR_DELAY = 2000;       // Sustained past the inrush window
+    static constexpr float DRY_RUN_BASELINE_RATIO = 0.75;
+    static constexpr float LOCKED_ROTOR_BASELINE_RATIO = 2.5;
+    
+    static const uint32_t CHECKPOINT_MAGIC = 0x45564332;             // "EVC2"
+    
+    static const uint16_t PRESSURE_SLOPE_SIZE = 160;                 // 2s samples over the window
+    static const unsigned long PRESSURE_SLOPE_WINDOW = 300000;       // 5-minute regression window
+    static const unsigned long PRESSURE_SLOPE_MIN_SPAN = 180000;     // Need 3 minutes of idle data
     
 public:
     EventDetector(DataCollector* collector);
+    ~EventDetector();
     
     void begin();
-    void update();
+    void processSample(const SensorData& data);
     
     void setThresholds(float highCurrent, float lowPressure, float lowTemp);
     void setHysteresis(float pressureHyst, float currentHyst, float tempHyst);
+    void setLeakDetection(float decayRate, float decayHyst);
+    void setPumpRunningCurrent(float current);
+    void setCycleAnomalyThreshold(float score);
+    // dryRunAmps 0 leaves dry run off until the cycle baseline supplies a
+    // bound; the learned baseline replaces both currents once ready
+    void setRunResponse(float dryRunAmps, float lockedRotorAmps, float pressureRise);
     
     bool hasActiveEvents() const;
     uint8_t getEventCount() const { return eventCount; }
-    Event getEvent(uint8_t index) const;
-
-    bool hasResolvedEvents() const { return resolvedEventCount > 0; }
-    uint8_t getResolvedEventCount() const { return resolvedEventCount; }
-    Event getResolvedEvent(uint8_t index) const;
-    void clearResolvedEvents();
+    
+    // Visitors run under the event mutex, which every sample needs; they
+    // must not block or allocate. Readers doing more use the copy methods.
+    uint8_t forEachActiveEvent(EventVisitor visitor, void* context) const;
+    // lost, if given, is set to the transitions after afterSequence that the
+    // ring overwrote before they were read
+    uint32_t forEachEventSince(uint32_t afterSequence, EventVisitor visitor, void* context,
+                               uint32_t* lost = nullptr) const;
+    
+    // Copy out for callers that need to do slow work (e.g. network) per event
+    uint8_t copyActiveEvents(Event* out, uint8_t maxEvents) const;
+    uint8_t copyEventsSince(uint32_t afterSequence, Event* out, uint8_t maxEvents) const;
+    uint32_t getLastSequence() const { return nextSequence - 1; }
+    
+    // The outbox reports how far delivery got, so transitions logged but not
+    // yet sent survive a warm reset and are collected again after it
+    void setDeliveredSequence(uint32_t sequence);
     
     bool isHighCurrentActive() const { return highCurrentActive; }
     bool isLowPressureActive() const { return lowPressureActive; }
     bool isLowTemperatureActive() const { return lowTemperatureActive; }
     bool isSensorErrorActive() const { return sensorErrorActive; }
+    bool isPressureDecayActive() const { return pressureDecayActive; }
+    float getPressureDecayRate() const;
+    bool isCycleAnomalyActive() const { return cycleAnomalyActive; }
+    bool getCycleStats(CycleStats& stats) const;
+    bool isDryRunActive() const { return dryRunActive; }
+    bool isLockedRotorActive() const { return lockedRotorActive; }
     
     String getStatusString() const;
     String getEventSummary() const;
     
+    uint32_t getSamplesEvaluated() const { return samplesEvaluated; }
+    uint32_t getSamplesSkipped() const { return samplesSkipped; }
+    unsigned long getLastEvaluationLatencyUs() const { return lastEvaluationLatencyUs; }
+    unsigned long getMaxEvaluationLatencyUs() const { return maxEvaluationLatencyUs; }
+    unsigned long getLastDetectionDelayMs() const { return lastDetectionDelayMs; }
+    
 private:
+    static void sampleCallback(const SensorData& data, void* context);
+    
+    bool lock() const;
+    void unlock() const;
+    
     void checkHighCurrent(const SensorData& data);
     void checkLowPressure(const SensorData& data);
     void checkLowTemperature(const SensorData& data);
     void checkSensorHealth(const SensorData& data);
+    void checkPressureDecay(const SensorData& data);
+    void checkPumpCycle(const SensorData& data);
+    void checkRunResponse(const SensorData& data);
     
-    void addEvent(EventType type, float value, float threshold, const String& description);
+    // startTime is the sample's wall-clock time, taken by the collector
+    // outside the lock (NTP epoch, or millis() until NTP syncs)
+    void addEvent(EventType type, float value, float threshold, unsigned long startTime);
     void clearEvent(EventType type);
     void updateEvent(EventType type, float value, unsigned long duration);
     
-    int findEventIndex(EventType type) const;
-    void removeEvent(uint8_t index);
+    void logTransition(Event& event, EventState state);
     
-    String eventTypeToString(EventType type) const;
+    // Active events, sequence and debounce timers survive warm resets in RTC memory
+    bool restoreCheckpoint();
+    void saveCheckpoint(unsigned long now);
+    uint8_t firstLogIndexAfter(uint32_t afterSequence, uint8_t& available, uint32_t& lost) const;
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+#include "EventDetector.h"
+
+struct OutboxEntry {
+    Event event;
+    bool heartbeat;     // Periodic re-send of a still-active event
+    uint32_t lostBefore;    // Transitions the detector's log overwrote before this one was collected
+    uint32_t firstSequence; // Oldest transition coalesced into this entry
+    bool relayed;           // Sent over the relay link; still waiting for the event sink
+};
+
+// Edge-triggered event delivery: queues raised/escalated/cleared transitions
+// from the detector's log, coalesces transitions of the same incident that
+// haven't been sent yet, and adds a heartbeat for long-running events.
+// Critical transitions are queued ahead of everything else so the fast lane
+// in the main loop can send them without waiting for the upload interval.
+class EventOutbox {
+public:
+    static const unsigned long PRIORITY_TARGET_MS = 2000;
+    
+private:
+    EventDetector* detector;
+    
+    static const uint8_t OUTBOX_SIZE = 16;
+    OutboxEntry entries[OUTBOX_SIZE];
+    uint8_t head;
+    uint8_t count;
+    
+    uint32_t cursor;
+    uint32_t lostPending;   // Overrun found by the current collect(), for its first transition
+    
+    unsigned long heartbeatInterval;
+    unsigned long lastHeartbeat;
+    
+    uint32_t sentCount;
+    uint32_t coalescedCount;
+    uint32_t droppedCount;
+    uint32_t heartbeatCount;
+    uint32_t lostCount;
+    
+    // Detection-to-acknowledged latency of critical transitions
+    unsigned long lastPriorityLatency;
+    unsigned long maxPriorityLatency;
+    uint32_t priorityDelivered;
+    uint32_t priorityLate;
+    
+public:
+    EventOutbox(EventDetector* eventDetector, unsigned long heartbeatMs = 900000);
+    
+    // Pull new transitions from the detector and queue heartbeats when due
+    void collect();
+    
+    bool peek(OutboxEntry& entry) const;
+    bool peekCritical(OutboxEntry& entry) const;
+    
+    // Copies up to maxCount entries, starting offset entries from the front,
+    // for a batched send; pop() once per entry the sink acknowledged
+    uint8_t peekMany(OutboxEntry* out, uint8_t maxCount, bool criticalOnly, uint8_t offset = 0) const;
+    void pop();
+    
+    // Flags count entries from offset as relayed. A transition coalesced
+    // into one of them later clears the flag, so the update goes out too.
+    void markRelayed(uint8_t offset, uint8_t count);
+    
+    void setHeartbeatInterval(unsigned long heartbeatMs) { heartbeatInterval = heartbeatMs; }
+    unsigned long getHeartbeatInterval() const { return heartbeatInterval; }
+    
+    uint8_t getPendingCount() const { return count; }
+    uint32_t getCursor() const { return cursor; }
+    uint32_t getSentCount() const { return sentCount; }
+    uint32_t getCoalescedCount() const { return coalescedCount; }
+    uint32_t getDroppedCount() const { return droppedCount; }
+    uint32_t getHeartbeatCount() const { return heartbeatCount; }
+    uint32_t getLostCount() const { return lostCount; }
+    
+    unsigned long getLastPriorityLatency() const { return lastPriorityLatency; }
+    unsigned long getMaxPriorityLatency() const { return maxPriorityLatency; }
+    uint32_t getPriorityDeliveredCount() const { return priorityDelivered; }
+    uint32_t getPriorityLateCount() const { return priorityLate; }
+    
+private:
+    static void transitionVisitor(const Event& event, void* context);
+    static void heartbeatVisitor(const Event& event, void* context);
+    
+    void enqueue(const Event& event, bool heartbeat);
+    void reportDelivered();
+    int findPending(const Event& event) const;
+    void makeRoom();
+    void removeAt(uint8_t offset);
+    void insertAt(uint8_t offset, const OutboxEntry& entry);
+    static bool isPriority(const OutboxEntry& entry) { return !entry.heartbeat && isCriticalEvent(entry.event.type); }
+    OutboxEntry& entryAt(uint8_t offset) { return entries[(head + offset) % OUTBOX_SIZE]; }
+    const OutboxEntry& entryAt(uint8_t offset) const { return entries[(head + offset) % OUTBOX_SIZE]; }
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include "TelemetrySink.h"
+
+// Appends each aggregate as a JSON line (POST /api/sensors layout) to a
+// log on SPIFFS, for retrieval over USB or the web server when there is no
+// uplink at all. The log rotates once at MAX_LOG_SIZE, so at most two
+// files' worth is kept; unlike the outboxes nothing is ever acknowledged.
+class FlashLogSink : public TelemetrySink {
+private:
+    String deviceName;
+    String location;
+    char* lineBuffer;               // Only when the pipeline had no room for the record
+    size_t logSize;
+    bool ready;
+    
+    uint32_t writeErrors;
+    uint32_t rotations;
+    
+    static const char* LOG_PATH;
+    static const char* OLD_LOG_PATH;
+    static const size_t MAX_LOG_SIZE = 65536;
+    static const size_t LINE_BUFFER_SIZE = 1024;
+    
+public:
+    FlashLogSink(const String& device, const String& loc);
+    ~FlashLogSink();
+    
+    // SPIFFS must already be mounted
+    bool begin() override;
+    
+    const char* getName() const override { return "flash"; }
+    SinkEncoding getEncoding() const override { return ENCODING_API_JSON; }
+    SinkPolicy getPolicy() const override { return { 3, 1000, 4000 }; }
+    
+    size_t encode(const AggregatedData& data, uint8_t* out, size_t size) override;
+    SinkResult deliver(const AggregatedData& data, const uint8_t* payload, size_t length) override;
+    
+    size_t getLogSize() const { return logSize; }
+    uint32_t getWriteErrors() const { return writeErrors; }
+    uint32_t getRotations() const { return rotations; }
+    
+private:
+    void rotate();
+};
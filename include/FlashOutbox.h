@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include "DataCollector.h"
+
+// One record as stored on flash. The commit marker is written after the
+// rest has been flushed, so a record torn by a reset is never mistaken for
+// a complete one.
+struct OutboxRecord {
+    uint32_t magic;
+    AggregatedData data;
+    uint32_t crc;
+    uint32_t commit;
+};
+
+struct OutboxStats {
+    uint32_t pending;
+    uint32_t capacity;
+    uint32_t appended;
+    uint32_t acknowledged;
+    uint32_t dropped;       // Evicted unsent when the outbox was full
+    uint32_t corrupt;       // Failed CRC or commit check on read
+    uint32_t segments;
+};
+
+// Flash-backed FIFO for aggregates awaiting upload. Records are appended to
+// fixed-size segment files on SPIFFS and read back oldest first; the read
+// cursor is kept in NVS and only advances on acknowledge(), so unsent data
+// survives resets and outages of several days. When the space budget is
+// used up the oldest segment is evicted and counted as dropped.
+//
+// Not thread-safe: owned by the uplink task.
+class FlashOutbox {
+private:
+    Preferences cursorStore;
+    const char* name;           // Segment directory and NVS namespace
+    bool ready;
+    
+    uint32_t firstSegment;      // Oldest segment file on flash
+    uint32_t writeSegment;
+    uint16_t writeCount;        // Records in writeSegment
+    uint32_t readSegment;
+    uint16_t readPosition;      // Next unacknowledged record in readSegment
+    uint32_t maxSegments;
+    
+    OutboxStats stats;
+    
+    static const uint32_t RECORD_MAGIC = 0x4F425832;          // "OBX2"; change with the AggregatedData layout
+    static const uint32_t COMMIT_MARKER = 0xC0FFEE01;
+    static const uint16_t RECORDS_PER_SEGMENT = 240;          // 4 hours of 1-minute records
+    static const uint8_t MIN_SEGMENTS = 2;
+    static const uint8_t FLASH_BUDGET_PERCENT = 75;           // SPIFFS needs free pages for GC
+    
+public:
+    // Up to 8 characters, so segment paths stay within SPIFFS limits.
+    // Each uplink sink that buffers needs its own.
+    FlashOutbox(const char* storeName = "outbox");
+    ~FlashOutbox();
+    
+    // SPIFFS must already be mounted
+    bool begin();
+    bool isReady() const { return ready; }
+    
+    bool append(const AggregatedData& data);
+    
+    // Copies up to maxCount records from the read cursor, oldest first.
+    // Records that fail validation are skipped and counted as corrupt.
+    uint8_t peek(AggregatedData* out, uint8_t maxCount);
+    
+    // Advances the cursor past the first count records returned by peek()
+    void acknowledge(uint8_t count);
+    
+    uint32_t pendingCount() const { return stats.pending; }
+    void getStats(OutboxStats& out) const { out = stats; }
+    
+private:
+    void scanSegments();
+    void recoverWriteSegment();
+    void evictOldest();
+    void saveCursor();
+    uint16_t segmentRecordCount(uint32_t segment);
+    bool readRecord(File& file, uint16_t position, OutboxRecord& record);
+    void advanceCursor(uint16_t count);
+    void removeSegment(uint32_t segment);
+    
+    void segmentPath(uint32_t segment, char* out, size_t size) const;
+    static uint32_t recordCRC(const OutboxRecord& record);
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+
+struct JsonMark {
+    size_t length;
+    uint8_t depth;
+    bool hasItems;
+};
+
+// Streaming JSON writer over a caller-owned buffer. Never allocates: output
+// that doesn't fit sets the overflow flag and is truncated, so callers check
+// overflowed() before sending.
+class JsonWriter {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    bool overflow;
+    
+    static const uint8_t MAX_DEPTH = 8;
+    uint8_t depth;
+    bool hasItems[MAX_DEPTH];
+    bool afterKey;
+    
+public:
+    JsonWriter(char* buf, size_t size);
+    
+    void reset();
+    
+    // Drop everything written since mark(), e.g. an array element that
+    // didn't fit
+    JsonMark mark() const;
+    void rewind(const JsonMark& position);
+    
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    
+    void key(const char* name);
+    
+    void value(const char* str);
+    void value(float number, uint8_t decimals = 3);
+    void value(double number, uint8_t decimals = 3);
+    void value(int number);
+    void value(unsigned int number);
+    void value(long number);
+    void value(unsigned long number);
+    void value(unsigned long long number);
+    void value(bool flag);
+    void nullValue();
+    
+    // Splice in a value that is already serialized JSON, e.g. a document
+    // encoded once and shared between requests
+    void raw(const char* json, size_t size);
+    
+    template <typename T>
+    void field(const char* name, T fieldValue) {
+        key(name);
+        value(fieldValue);
+    }
+    
+    const char* c_str() const { return buffer; }
+    size_t size() const { return length; }
+    bool overflowed() const { return overflow; }
+    
+private:
+    void separator();
+    void put(char c);
+    void put(const char* str);
+    void putString(const char* str);
+    void putUnsigned(unsigned long long number);
+};
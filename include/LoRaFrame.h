@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+#include "SensorRecord.h"
+#include "EventDetector.h"
+
+// Radio frames for the LoRa uplink. Every frame starts with a header byte
+// (version in the high nibble, frame type in the low nibble) and the
+// sender's node id, and ends with a CRC-16/CCITT-FALSE over everything
+// before it, little endian. The radio's own CRC only covers the air; this
+// one also rejects frames from other LoRa gear on the channel and anything
+// a gateway mangles on the way to the decoder (tools/aggregate_decode.py
+// --frame).
+//
+// Aggregate, 32 bytes:
+//   0      header      0x11: version 1, aggregate
+//   1      node id
+//   2..29  packAggregate() body, AGGREGATE_PACKED_SIZE bytes
+//   30..31 CRC
+//
+// Event transition, 18 bytes:
+//   0      header      0x12: version 1, event
+//   1      node id
+//   2..5   event sequence
+//   6      EventType
+//   7      EventState
+//   8..11  start time, epoch seconds
+//   12..13 value, int16 hundredths (-32768 if NaN)
+//   14..15 threshold, likewise
+//   16..17 CRC
+//
+// Acknowledgement, 8 bytes, receiver to node, only with adaptive data rate:
+//   0      header      0x13: version 1, ack
+//   1      node id of the node acknowledged
+//   2..3   CRC of the frame acknowledged
+//   4      SNR the receiver measured, int8 quarter dB
+//   5      RSSI the receiver measured, int8 dBm
+//   6..7   CRC
+
+static const uint8_t LORA_FRAME_VERSION = 1;
+
+enum LoRaFrameType {
+    LORA_FRAME_AGGREGATE = 1,
+    LORA_FRAME_EVENT = 2,
+    LORA_FRAME_ACK = 3
+};
+
+static const size_t LORA_FRAME_HEADER_SIZE = 2;
+static const size_t LORA_FRAME_CRC_SIZE = 2;
+static const size_t LORA_AGGREGATE_FRAME_SIZE = LORA_FRAME_HEADER_SIZE + AGGREGATE_PACKED_SIZE + LORA_FRAME_CRC_SIZE;
+static const size_t LORA_EVENT_FRAME_SIZE = LORA_FRAME_HEADER_SIZE + 14 + LORA_FRAME_CRC_SIZE;
+static const size_t LORA_ACK_FRAME_SIZE = LORA_FRAME_HEADER_SIZE + 4 + LORA_FRAME_CRC_SIZE;
+static const size_t LORA_MAX_FRAME_SIZE = LORA_AGGREGATE_FRAME_SIZE;
+
+uint16_t loraFrameCRC(const uint8_t* data, size_t length);
+
+// Returns the frame size, 0 if it doesn't fit
+size_t encodeLoRaAggregate(const AggregatedData& data, uint8_t nodeId, uint8_t* out, size_t size);
+
+// False on a short frame, bad CRC, unknown version or another frame type
+bool decodeLoRaAggregate(const uint8_t* in, size_t length, uint8_t& nodeId, AggregatedData& data);
+
+size_t encodeLoRaEvent(const Event& event, uint8_t nodeId, uint8_t* out, size_t size);
+
+// Fills sequence, type, state, startTime, value and threshold; the rest is zeroed
+bool decodeLoRaEvent(const uint8_t* in, size_t length, uint8_t& nodeId, Event& event);
+
+// ackedCRC is the CRC at the end of the frame acknowledged
+size_t encodeLoRaAck(uint8_t nodeId, uint16_t ackedCRC, float snr, int16_t rssi, uint8_t* out, size_t size);
+bool decodeLoRaAck(const uint8_t* in, size_t length, uint8_t& nodeId, uint16_t& ackedCRC, float& snr, int16_t& rssi);
+
+// LoRaFrameType of a frame with a valid header and CRC, 0 otherwise
+uint8_t loraFrameType(const uint8_t* in, size_t length);
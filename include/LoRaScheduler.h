@@ -0,0 +1,118 @@
+#pragma once
+
+#include <Arduino.h>
+
+enum LoRaTraffic {
+    LORA_TRAFFIC_EVENT,
+    LORA_TRAFFIC_TELEMETRY
+};
+
+struct LoRaSchedulerConfig {
+    uint8_t spreadingFactor;        // Starting point when adaptive
+    int8_t txPower;                 // dBm
+    uint16_t dutyCyclePermille;     // Budget per hour of airtime; 0 for no budget
+    unsigned long maxFrameAirtime;  // Dwell limit per frame in ms (US915: 400); 0 for none
+    bool adaptive;                  // The receiver acknowledges frames, so SF and power follow the link
+};
+
+// Decides what the LoRa sink may send and how. Each frame's airtime is
+// computed from the radio settings (Semtech AN1200.13), and the airtime of
+// the last hour is kept in one-minute buckets against a duty-cycle
+// budget. A bucket only drops out once all of it is over an hour old, so
+// no sliding hour ever holds more than the budget.
+//
+// Telemetry may only use TELEMETRY_SHARE of the budget, and is paced so
+// that share lasts the hour: after each telemetry frame the next one waits
+// its airtime divided by the share of the duty cycle. Events aren't paced
+// and may use the whole budget.
+//
+// With acknowledgements the spreading factor and power adapt like LoRaWAN
+// ADR: the SNR the receiver reports, less what the spreading factor needs
+// and a safety margin, buys a faster spreading factor or lower power in
+// 3 dB steps. MISSED_ACK_LIMIT missed acknowledgements in a row raise the
+// power to the maximum, then the spreading factor one step at a time. The
+// spreading factor never goes above what fits the dwell limit.
+class LoRaScheduler {
+public:
+    static const long BANDWIDTH = 125000;
+    static const uint8_t CODING_RATE = 5;               // 4/5
+    static const uint8_t PREAMBLE_LENGTH = 8;
+    static const uint8_t MIN_SPREADING_FACTOR = 7;
+    static const uint8_t MAX_SPREADING_FACTOR = 12;
+    static const int8_t MIN_TX_POWER = 2;
+    static const int8_t MAX_TX_POWER = 20;
+    static const uint8_t TELEMETRY_SHARE = 80;          // Percent of the budget
+    static const size_t LARGEST_FRAME = 32;             // Sizes the dwell limit check
+    
+private:
+    static const uint8_t BUCKET_COUNT = 61;             // The last hour's minutes and the current one
+    static const unsigned long BUCKET_LENGTH = 60000;
+    static const uint8_t SNR_HISTORY = 5;
+    static const uint8_t MISSED_ACK_LIMIT = 3;
+    static const int8_t MARGIN_DB = 10;
+    
+    LoRaSchedulerConfig config;
+    uint8_t spreadingFactor;
+    int8_t txPower;
+    uint8_t maxSpreadingFactor;
+    bool settingsChanged;
+    
+    uint32_t eventBuckets[BUCKET_COUNT];        // ms of airtime per minute
+    uint32_t telemetryBuckets[BUCKET_COUNT];
+    uint8_t currentBucket;
+    unsigned long bucketStart;
+    unsigned long nextTelemetry;
+    
+    float snrHistory[SNR_HISTORY];
+    uint8_t snrCount;
+    uint8_t missedAcks;
+    
+    uint32_t eventAirtime;
+    uint32_t telemetryAirtime;
+    uint32_t eventsDeferred;
+    uint32_t telemetryDeferred;
+    uint32_t acksReceived;
+    uint32_t acksMissed;
+    uint32_t adaptations;
+    float lastSnr;
+    int16_t lastRssi;
+    
+public:
+    LoRaScheduler(const LoRaSchedulerConfig& schedulerConfig);
+    
+    // Time on air of one frame at the given spreading factor, in ms
+    static unsigned long frameAirtime(size_t length, uint8_t spreadingFactor);
+    unsigned long frameAirtime(size_t length) const { return frameAirtime(length, spreadingFactor); }
+    
+    // Whether a frame of this size fits the budget now; counts a deferral if not
+    bool allow(LoRaTraffic traffic, size_t length);
+    void recordTransmit(LoRaTraffic traffic, size_t length);
+    
+    // Link feedback: the receiver's SNR and RSSI for the frame it acknowledged
+    void recordAck(float snr, int16_t rssi);
+    void recordMissedAck();
+    
+    // True once after the spreading factor or power changed
+    bool takeSettingsChange();
+    
+    uint8_t getSpreadingFactor() const { return spreadingFactor; }
+    int8_t getTxPower() const { return txPower; }
+    bool isAdaptive() const { return config.adaptive; }
+    uint32_t getBudget() const;                 // ms per hour, 0 for none
+    uint32_t getBudgetUsed() const;             // ms in the last hour
+    uint32_t getEventAirtime() const { return eventAirtime; }
+    uint32_t getTelemetryAirtime() const { return telemetryAirtime; }
+    uint32_t getEventsDeferred() const { return eventsDeferred; }
+    uint32_t getTelemetryDeferred() const { return telemetryDeferred; }
+    uint32_t getAcksReceived() const { return acksReceived; }
+    uint32_t getAcksMissed() const { return acksMissed; }
+    uint32_t getAdaptations() const { return adaptations; }
+    float getLastSnr() const { return lastSnr; }
+    int16_t getLastRssi() const { return lastRssi; }
+    
+private:
+    void advanceBuckets();
+    uint32_t sumBuckets(const uint32_t* buckets) const;
+    void adapt(int steps);
+    static float requiredSnr(uint8_t spreadingFactor);
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TelemetrySink.h"
+#include "LoRaFrame.h"
+#include "LoRaScheduler.h"
+
+// Sends aggregates as 32-byte LoRa frames (LoRaFrame.h) to a receiver
+// within radio range. The radio is set up by setupLoRa() before the sink
+// is added.
+//
+// Without a WiFi sink every aggregate goes out. In failover mode, used
+// alongside one, the radio stays quiet while WiFi is up; while it's down
+// aggregates are merged FAILOVER_MERGE at a time into one frame, and the
+// WiFi sinks backfill them at full resolution from their flash outbox
+// later. Critical events are relayed as soon as the event sink can't
+// deliver them, and stay in the outbox for it; the rest wait there for
+// WiFi. Without a WiFi sink every event but heartbeats goes out and leaves
+// the outbox. The server keeps one record per sequence number and lets the
+// full one replace the LoRa one.
+//
+// Every frame goes through a LoRaScheduler first. A telemetry frame the
+// duty-cycle budget has no room for stays in the window and goes out
+// merged with the next aggregate; an event waits in the outbox for the
+// next pass. With adaptive data rate the receiver acknowledges each frame
+// (LoRaFrame.h) and the sink listens for it right after sending; the
+// scheduler picks spreading factor and power from what comes back.
+//
+// Best effort: nothing is sent again, so a frame lost on the air is gone.
+class LoRaSink : public TelemetrySink {
+public:
+    static const uint8_t FAILOVER_MERGE = 5;         // Aggregates per frame while WiFi is down
+    static const unsigned long ACK_TURNAROUND = 150; // ms for the receiver to answer, on top of the ack's airtime
+    
+private:
+    uint8_t nodeId;
+    bool failover;
+    bool wifiOnline;
+    uint8_t frameBuffer[LORA_MAX_FRAME_SIZE];
+    
+    AggregatedData window;                          // Aggregates merged since the last failover frame
+    uint16_t windowCount;
+    
+    LoRaScheduler* scheduler;
+    
+    uint32_t framesSent;
+    uint32_t eventsRelayed;
+    uint32_t airtimeTotal;          // ms spent transmitting
+    unsigned long lastAirtime;
+    
+public:
+    LoRaSink(uint8_t node, bool failoverOnly, const LoRaSchedulerConfig& schedule);
+    ~LoRaSink();
+    
+    const char* getName() const override { return "lora"; }
+    SinkEncoding getEncoding() const override { return ENCODING_LORA_FRAME; }
+    SinkPolicy getPolicy() const override { return { 1, 0, 0 }; }
+    
+    size_t encode(const AggregatedData& data, uint8_t* out, size_t size) override;
+    SinkResult deliver(const AggregatedData& data, const uint8_t* payload, size_t length) override;
+    
+    bool relaysEvents() const override { return true; }
+    uint8_t relayEvents(const OutboxEntry* entries, uint8_t count) override;
+    
+    void update(bool online) override;
+    
+    uint8_t getNodeId() const { return nodeId; }
+    bool isFailover() const { return failover; }
+    bool isTransmitting() const { return !failover || !wifiOnline; }
+    uint32_t getFramesSent() const { return framesSent; }
+    uint32_t getEventsRelayed() const { return eventsRelayed; }
+    uint32_t getAirtimeTotal() const { return airtimeTotal; }
+    unsigned long getLastAirtime() const { return lastAirtime; }
+    uint16_t getWindowCount() const { return windowCount; }
+    const LoRaScheduler* getScheduler() const { return scheduler; }
+    
+private:
+    bool transmit(const uint8_t* frame, size_t length, LoRaTraffic traffic);
+    void awaitAck(const uint8_t* frame, size_t length);
+    void applySettings();
+};
@@ -1,15 +1,36 @@
 #pragma once
 
 #include <Arduino.h>
-#include <WiFi.h>
+#include <WiFiClient.h>
 #include <HTTPClient.h>
-#include <ArduinoJson.h>
 #include "DataCollector.h"
 #include "EventDetector.h"
+#include "EventOutbox.h"
+#include "JsonWriter.h"
+#include "SensorRecord.h"
+#include "FlashOutbox.h"
+#include "SequenceCounter.h"
+#include "CircuitBreaker.h"
+#include "TokenBucket.h"
+#include "SecureTransport.h"
+#include "TelemetrySink.h"
 
-class WellPumpMongoClient {
+// Writes aggregates and events to MongoDB through the Atlas Data API (or
+// anything speaking its /action/* protocol). Unsent aggregates go to a
+// flash outbox of its own, so it can run alongside the HTTP API sink, and
+// are drained oldest first with /action/insertMany, up to MAX_BATCH_SIZE
+// documents per request, over one kept-alive connection.
+//
+// Documents carry a deterministic _id (device plus sequence), so a batch
+// resent after a lost response fails with a duplicate key instead of
+// storing twice. The client then looks up which of the batch already
+// exist (/action/find) and counts those as written; events, at most a few
+// per batch, are retried one document at a time instead.
+class WellPumpMongoClient : public TelemetrySink {
 private:
     HTTPClient* httpClient;
+    SecureTransport* secureClient;
+    WiFiClient* plainClient;
     
     String mongoURL;
     String apiKey;
@@ -20,75 +41,158 @@ private:
     String deviceName;
     String location;
     
+    // Built once per configuration
+    String insertOneURL;
+    String insertManyURL;
+    String findOneURL;
+    String findURL;
+    String authHeader;
+    
+    char* payloadBuffer;
+    
     bool connected;
     bool initialized;
     
     unsigned long lastConnectionTest;
     unsigned long lastRetryTime;
+    unsigned long retryDelay;
+    unsigned long lastRequestTime;
+    unsigned long lastDrainFailure;
     
     uint16_t retryCount;
     uint16_t maxRetries;
+    int lastHttpStatusCode;
+    
+    // Transport and batching metrics
+    uint32_t requestCount;
+    uint32_t connectionCount;
+    uint32_t reusedCount;
+    uint32_t insertManyCount;
+    uint32_t documentsWritten;
+    uint32_t duplicateCount;
+    unsigned long lastRequestDuration;
+    
+    // Same admission as the HTTP API sink: every request takes a token and
+    // passes the breaker, and Retry-After holds the breaker open. Critical
+    // events skip the breaker and may spend the reserved token.
+    CircuitBreaker* breaker;
+    TokenBucket* rateLimiter;
+    uint32_t deferredCount;
+    bool lastRequestDeferred;
+    
+    SinkYieldCallback yieldCallback;
+    void* yieldContext;
+    
+    FlashOutbox* outbox;
+    SequenceCounter* sequenceCounter;   // The pipeline's, not owned
+    AggregatedData* batchRecords;
+    uint32_t lastAckedSequence;
     
     static const unsigned long CONNECTION_TEST_INTERVAL = 300000;
     static const unsigned long RETRY_DELAY = 30000;
     static const unsigned long MAX_RETRY_DELAY = 300000;
-    
-    struct DataBuffer {
-        AggregatedData data;
-        unsigned long timestamp;
-        bool valid;
-    };
-    
-    DataBuffer* buffer;
-    uint8_t bufferSize;
-    uint8_t bufferIndex;
-    uint8_t bufferedCount;
-    
-    static const uint8_t BUFFER_SIZE = 10;
+    static const unsigned long KEEPALIVE_IDLE_TIMEOUT = 4000;
+    static const uint16_t REQUEST_TIMEOUT = 10000;
+    static const size_t PAYLOAD_BUFFER_SIZE = 8192;
+    static const uint8_t MAX_BATCH_SIZE = 20;       // About 9 KB of documents; the buffer caps it first
+    static const unsigned long SLOW_REQUEST_TIME = 6000;
+    static const uint16_t RATE_LIMIT_PER_MINUTE = 12;
+    static const uint16_t RATE_LIMIT_BURST = 6;
+    static const uint16_t CRITICAL_TOKEN_RESERVE = 1;
+    static const long MAX_RETRY_AFTER = 3600;       // Seconds
+    static const size_t ID_SIZE = 64;
     
 public:
-    WellPumpMongoClient(const String& url, const String& key, 
+    WellPumpMongoClient(const String& url, const String& key,
                        const String& dataSource, const String& db,
-                       const String& device, const String& loc);
+                       const String& device, const String& loc, SequenceCounter* sequences);
     ~WellPumpMongoClient();
     
-    bool begin();
+    bool begin() override;
     bool isConnected() const { return connected; }
     bool isInitialized() const { return initialized; }
     
-    void setCredentials(const String& url, const String& key, 
+    void setCredentials(const String& url, const String& key,
                        const String& dataSource, const String& db);
     
     bool testConnection();
     bool writeAggregatedData(const AggregatedData& data);
-    bool writeEvent(const Event& event);
+    bool writeEvent(const Event& event, bool heartbeat = false);
+    
+    // One insertMany for several events; returns how many from the front
+    // were stored (fewer than count if the rest didn't fit or a send
+    // failed), so the caller pops exactly those
+    uint8_t writeEvents(const OutboxEntry* entries, uint8_t count);
+    
+    // TelemetrySink; the pipeline's payload is the document, wrapped here
+    // in the insertOne command
+    const char* getName() const override { return "mongodb"; }
+    SinkEncoding getEncoding() const override { return ENCODING_MONGO_DOCUMENT; }
+    size_t encode(const AggregatedData& data, uint8_t* out, size_t size) override;
+    SinkResult deliver(const AggregatedData& data, const uint8_t* payload, size_t length) override;
+    bool acceptsEvents() const override { return true; }
+    uint8_t deliverEvents(const OutboxEntry* entries, uint8_t count) override { return writeEvents(entries, count); }
+    void update(bool online) override { if (online) update(); }
+    void setYieldCallback(SinkYieldCallback callback, void* context) override;
+    int getLastStatusCode() const override { return lastHttpStatusCode; }
     
     bool flushBuffer();
-    uint8_t getBufferedCount() const { return bufferedCount; }
+    uint32_t getBufferedCount() const { return outbox->pendingCount(); }
+    void getOutboxStats(OutboxStats& out) const { outbox->getStats(out); }
     
     void update();
     
     String getConnectionStatus() const;
     String getLastError() const;
+    int getLastHttpStatusCode() const { return lastHttpStatusCode; }
+    
+    uint32_t getRequestCount() const { return requestCount; }
+    uint32_t getConnectionCount() const { return connectionCount; }
+    uint32_t getReusedCount() const { return reusedCount; }
+    uint32_t getInsertManyCount() const { return insertManyCount; }
+    uint32_t getDocumentsWritten() const { return documentsWritten; }
+    uint32_t getDuplicateCount() const { return duplicateCount; }
+    unsigned long getLastRequestDuration() const { return lastRequestDuration; }
+    uint32_t getLastAckedSequence() const { return lastAckedSequence; }
+    
+    const char* getBreakerState() const { return breaker->getStateName(); }
+    uint32_t getBreakerTrips() const { return breaker->getTripCount(); }
+    uint16_t getRateLimitTokens() const { return rateLimiter->getTokens(); }
+    uint32_t getDeferredCount() const { return deferredCount; }
     
 private:
     bool connect();
     void disconnect();
-    
-    bool writeDataDocument(const AggregatedData& data);
-    bool writeEventDocument(const Event& event);
-    
-    void addToBuffer(const AggregatedData& data);
+    bool setupHTTPClient();
+    void cleanupHTTPClient();
+    WiFiClient* transport() const;
+    void closeIdleConnection();
+    void buildRequestStrings();
+    
+    SinkResult sendRecord(const AggregatedData& data, const uint8_t* payload, size_t length);
+    bool addToBuffer(const AggregatedData& data);
     bool processBuffer();
+    // Sends as many records from the front as fit in one request; written
+    // is how many are stored, also when the call fails part way
+    bool insertSensorBatch(const AggregatedData* records, uint8_t count, uint8_t& written);
+    bool countStoredPrefix(const AggregatedData* records, uint8_t count, uint8_t& stored);
     
     unsigned long getRetryDelay() const;
-    void resetRetryCount() { retryCount = 0; }
+    void resetRetryCount() { retryCount = 0; retryDelay = RETRY_DELAY; }
     
     bool validateConfiguration() const;
     
+    bool uplinkReady(bool critical = false);
+    bool admitRequest(bool critical = false);
+    void recordOutcome(int httpCode, unsigned long duration);
+    
     // MongoDB Data API helper methods
-    bool insertDocument(const String& collection, const String& document);
-    String createSensorDocument(const AggregatedData& data);
-    String createEventDocument(const Event& event);
-    String formatTimestamp(unsigned long timestamp);
-};
\ No newline at end of file
+    bool postAction(const String& url, const char* body, size_t length, String* response = nullptr,
+                    bool critical = false);
+    static bool isDuplicateKey(const String& response);
+    void beginCommand(JsonWriter& writer, const String& collection);
+    void writeSensorDocument(JsonWriter& writer, const AggregatedData& data);
+    void writeEventDocument(JsonWriter& writer, const OutboxEntry& entry);
+    void formatSensorId(const AggregatedData& data, char* out, size_t size);
+    void formatTimestamp(unsigned long timestamp, char* out, size_t size);
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+#include "DataCollector.h"
+
+// Features extracted from one pump run (current on -> current off)
+struct CycleSignature {
+    float inrushPeak;        // A, highest current during the inrush window
+    float steadyCurrent;     // A, mean current after the inrush window
+    float runTime;           // seconds
+    float pressureRiseRate;  // PSI/min over the run
+};
+
+// EWMA mean and variance of each signature feature
+struct CycleBaseline {
+    CycleSignature mean;
+    CycleSignature variance;
+    uint16_t cycleCount;
+};
+
+struct CycleStats {
+    CycleBaseline baseline;
+    CycleSignature lastCycle;
+    float lastScore;
+    uint32_t totalCycles;
+    bool running;
+};
+
+class PumpCycleAnalyzer {
+private:
+    float runningCurrent;
+    float alpha;
+    float scoreThreshold;
+    
+    bool running;
+    bool idleSeen;                  // Since reset(); a run before that started unobserved
+    bool runStartObserved;
+    unsigned long runStartTime;
+    unsigned long lastRunSampleTime;
+    float runStartPressure;
+    float lastRunPressure;
+    float peakCurrent;
+    float steadySum;
+    uint16_t steadyCount;
+    
+    CycleBaseline baseline;
+    CycleSignature lastCycle;
+    float lastScore;
+    uint32_t totalCycles;
+    
+    static const unsigned long MIN_RUN_TIME = 4000;     // Shorter runs are treated as noise
+    static const uint16_t WARMUP_CYCLES = 5;
+    static constexpr float SIGMA_FLOOR_RATIO = 0.05;    // Minimum sigma as a fraction of the mean
+    static constexpr float SIGMA_FLOOR_ABS = 0.1;
+    
+public:
+    static const unsigned long INRUSH_WINDOW = 4000;
+    
+    PumpCycleAnalyzer(float runCurrent = 0.5, float ewmaAlpha = 0.1, float anomalyScore = 4.0);
+    
+    void reset();
+    
+    // Returns true when the sample completed a pump cycle
+    bool processSample(const SensorData& data);
+    
+    void setRunningCurrent(float current) { runningCurrent = current; }
+    void setAlpha(float ewmaAlpha) { alpha = constrain(ewmaAlpha, 0.01, 1.0); }
+    void setScoreThreshold(float anomalyScore) { scoreThreshold = anomalyScore; }
+    
+    bool isRunning() const { return running; }
+    unsigned long getRunStartTime() const { return runStartTime; }
+    float getRunStartPressure() const { return runStartPressure; }
+    
+    // False for a run already under way at the first sample (e.g. after a
+    // reboot): its start time and pressure are just when sampling began
+    bool isRunStartObserved() const { return runStartObserved; }
+    
+    bool isBaselineReady() const { return baseline.cycleCount >= WARMUP_CYCLES; }
+    float getBaselineSteadyCurrent() const { return baseline.mean.steadyCurrent; }
+    float getLastScore() const { return lastScore; }
+    float getScoreThreshold() const { return scoreThreshold; }
+    bool isLastCycleAnomalous() const { return isBaselineReady() && lastScore >= scoreThreshold; }
+    const CycleSignature& getLastCycle() const { return lastCycle; }
+    void getStats(CycleStats& stats) const;
+    
+private:
+    void completeCycle(unsigned long endTime);
+    float scoreCycle(const CycleSignature& cycle) const;
+    void updateBaseline(const CycleSignature& cycle, float weight);
+    
+    static float featureScore(float value, float mean, float variance);
+    static void updateFeature(float value, float& mean, float& variance, float weight);
+};
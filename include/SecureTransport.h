@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+
+enum TLSVerifyMode {
+    TLS_VERIFY_NONE,            // Encrypted, server not authenticated
+    TLS_VERIFY_CA,              // Chain must lead to the pinned CA certificate
+    TLS_VERIFY_FINGERPRINT      // SHA-256 of the server certificate must match
+};
+
+struct TLSStats {
+    uint32_t fullHandshakes;
+    uint32_t resumedHandshakes;     // Abbreviated, from the cached session
+    uint32_t failures;
+    unsigned long lastHandshakeMs;
+    unsigned long totalFullMs;
+    unsigned long totalResumedMs;
+    uint32_t connectionHeap;        // Heap held by the open connection
+    uint32_t minFreeHeap;           // Device-wide low-water mark after the last handshake
+    int lastError;                  // mbedTLS error code, 0 if none
+};
+
+// WiFiClientSecure with a handshake that offers the previous TLS session
+// (session ticket or session ID) on reconnect. A resumed handshake skips the
+// key exchange and certificate checks, so the socket closed between uploads
+// costs one round trip of symmetric crypto instead of a full handshake.
+//
+// The pinned CA is parsed once rather than on every connect, and fingerprint
+// mode avoids chain verification altogether.
+//
+// Replaces the base connect() and fills the base's sslclient context, so the
+// base read/write/stop paths are unchanged. Written against the
+// arduino-esp32 2.0.x ssl_client layout.
+class SecureTransport : public WiFiClientSecure {
+private:
+    TLSVerifyMode verifyMode;
+    mbedtls_x509_crt pinnedCA;
+    bool pinReady;              // False after a pin failed to parse
+    uint8_t fingerprint[32];
+    
+    mbedtls_ssl_session session;
+    bool sessionValid;
+    String sessionHost;
+    uint16_t sessionPort;
+    
+    TLSStats stats;
+    
+    static const int32_t CONNECT_TIMEOUT = 5000;
+    static const unsigned long HANDSHAKE_TIMEOUT = 10000;
+    
+public:
+    SecureTransport();
+    ~SecureTransport();
+    
+    // pin is a PEM certificate for TLS_VERIFY_CA or a hex SHA-256
+    // fingerprint (colons and spaces allowed) for TLS_VERIFY_FINGERPRINT
+    bool setVerification(TLSVerifyMode mode, const String& pin);
+    TLSVerifyMode getVerifyMode() const { return verifyMode; }
+    
+    int connect(IPAddress ip, uint16_t port);
+    int connect(IPAddress ip, uint16_t port, int32_t timeout);
+    int connect(const char* host, uint16_t port);
+    int connect(const char* host, uint16_t port, int32_t timeout);
+    
+    void clearSession();
+    bool hasSession() const { return sessionValid; }
+    void getStats(TLSStats& out) const { out = stats; }
+    
+private:
+    int openSocket(IPAddress address, uint16_t port, int32_t timeout);
+    int handshake(const char* host, bool offerSession);
+    bool checkFingerprint();
+    int fail(int error);
+    
+    static bool parseFingerprint(const String& text, uint8_t* out);
+};
@@ -32,7 +32,7 @@ private:
     float lastCurrent2;
     
     static const unsigned long TEMP_READ_INTERVAL = 5000;
-    static const unsigned long PRESSURE_READ_INTERVAL = 3000;
+    static const unsigned long PRESSURE_READ_INTERVAL = 1000;  // Fresh pressure on every sample for run-response checks
     static const unsigned long CURRENT_READ_INTERVAL = 1000;
     
 public:
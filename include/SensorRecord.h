@@ -0,0 +1,124 @@
+#pragma once
+
+#include <Arduino.h>
+#include <type_traits>
+#include "DataCollector.h"
+
+// Encoders for AggregatedData, all generated from AggregateSchema.h. The
+// templates take JsonWriter, CborWriter or CsvWriter alike; with every
+// argument but the data fixed at the call site, the schema expansion folds
+// down to one straight run of writer calls.
+
+enum RecordLayout {
+    LAYOUT_FLAT,                // Metrics by member name: tempMin, current1RMS, ...
+    LAYOUT_GROUPED              // Metrics in one sub-document per sensor: temperature.min, ...
+};
+
+enum RecordTimeFormat {
+    TIME_MILLIS_STRING,         // Decimal string of epoch milliseconds; "0" before NTP sync
+    TIME_SECONDS_STRING,        // Decimal string of epoch seconds
+    TIME_MILLIS,                // Number, epoch milliseconds
+    TIME_SECONDS                // Number, epoch seconds
+};
+
+// Timestamps go out as a decimal string of epoch milliseconds, as the API
+// contract has them; "0" when the clock wasn't synced yet
+const char* formatRecordTimestamp(unsigned long timestamp, char* out, size_t size);
+
+template <typename Writer>
+void writeRecordTime(Writer& writer, const char* name, unsigned long timestamp, RecordTimeFormat format) {
+    char text[21];
+    switch (format) {
+        case TIME_MILLIS_STRING:
+            writer.field(name, formatRecordTimestamp(timestamp, text, sizeof(text)));
+            break;
+        case TIME_SECONDS_STRING:
+            snprintf(text, sizeof(text), "%lu", timestamp);
+            writer.field(name, (const char*)text);
+            break;
+        case TIME_MILLIS:
+            writer.field(name, (unsigned long long)timestamp * 1000ULL);
+            break;
+        case TIME_SECONDS:
+            writer.field(name, timestamp);
+            break;
+    }
+}
+
+// Every field of the record in the current object: times and counts
+// first, then the metrics sensor by sensor. recordOnly leaves out the
+// fields the schema keeps to local views.
+template <typename Writer>
+void writeAggregateFields(Writer& writer, const AggregatedData& data, RecordLayout layout,
+                          RecordTimeFormat timeFormat, bool recordOnly) {
+#define AGGREGATE_WRITE_HEADER(type, member, kind, group, key, pack, record) \
+    if (FIELD_##kind != FIELD_METRIC && (record || !recordOnly)) { \
+        if (FIELD_##kind == FIELD_TIME) { \
+            writeRecordTime(writer, #member, (unsigned long)data.member, timeFormat); \
+        } else { \
+            writer.field(#member, data.member); \
+        } \
+    }
+    AGGREGATE_FIELDS(AGGREGATE_WRITE_HEADER)
+#undef AGGREGATE_WRITE_HEADER
+    
+#define AGGREGATE_WRITE_METRIC(type, member, kind, group, key, pack, record) \
+    if (FIELD_##kind == FIELD_METRIC && GROUP_##group == current && (record || !recordOnly)) { \
+        writer.field(layout == LAYOUT_GROUPED ? key : #member, data.member); \
+    }
+#define AGGREGATE_WRITE_GROUP(id, name) \
+    { \
+        const AggregateGroup current = GROUP_##id; \
+        if (layout == LAYOUT_GROUPED) { \
+            writer.key(name); \
+            writer.beginObject(); \
+        } \
+        AGGREGATE_FIELDS(AGGREGATE_WRITE_METRIC) \
+        if (layout == LAYOUT_GROUPED) { \
+            writer.endObject(); \
+        } \
+    }
+    AGGREGATE_GROUPS(AGGREGATE_WRITE_GROUP)
+#undef AGGREGATE_WRITE_GROUP
+#undef AGGREGATE_WRITE_METRIC
+}
+
+// One aggregate in the layout of POST /api/sensors. Every sink that sends
+// or stores this record uses it, with JsonWriter or CborWriter, so sinks
+// sharing an encoding produce the same bytes.
+template <typename Writer>
+void writeSensorRecord(Writer& writer, const AggregatedData& data, const char* device, const char* location) {
+    char timestamp[21];
+    formatRecordTimestamp(data.endTime, timestamp, sizeof(timestamp));
+    
+    writer.beginObject();
+    writer.field("device", device);
+    writer.field("location", location);
+    writer.field("timestamp", (const char*)timestamp);
+    writeAggregateFields(writer, data, LAYOUT_FLAT, TIME_MILLIS_STRING, true);
+    writer.endObject();
+}
+
+// Packed binary: the fields with a pack scale, in schema order, little
+// endian. Metrics are int16 fixed point (value times scale, rounded and
+// clamped; NaN as -32768), integers keep up to 32 bits. Small enough for
+// a radio frame.
+template <typename T>
+constexpr size_t packedWidth() {
+    return std::is_floating_point<T>::value ? 2 : (sizeof(T) > 4 ? 4 : sizeof(T));
+}
+
+#define AGGREGATE_PACKED_WIDTH(type, member, kind, group, key, pack, record) + (pack ? packedWidth<type>() : 0)
+static const size_t AGGREGATE_PACKED_SIZE = 0 AGGREGATE_FIELDS(AGGREGATE_PACKED_WIDTH);
+#undef AGGREGATE_PACKED_WIDTH
+
+// Returns the size written, 0 if it doesn't fit
+size_t packAggregate(const AggregatedData& data, uint8_t* out, size_t size);
+
+// Fields not in the packed form come back zeroed
+bool unpackAggregate(const uint8_t* in, size_t length, AggregatedData& data);
+
+// Folds a newer aggregate into an older one, as if one window had covered
+// both; each field combines as its schema key says. Metrics missing (NaN)
+// on one side take the other side's value.
+void mergeAggregate(AggregatedData& into, const AggregatedData& next);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// Monotonic counter persisted in NVS. Values are reserved in blocks, so
+// flash is written once per RESERVE_BLOCK values; after a reset the rest of
+// the block is skipped. Values never repeat but may have gaps. 0 is never
+// handed out.
+class SequenceCounter {
+private:
+    Preferences store;
+    const char* name;
+    bool ready;
+    
+    uint32_t nextValue;
+    uint32_t reservedUntil;
+    
+    static const uint32_t RESERVE_BLOCK = 64;
+    
+public:
+    SequenceCounter(const char* storeName);
+    ~SequenceCounter();
+    
+    bool begin();
+    
+    uint32_t allocate();
+    uint32_t peek() const { return nextValue; }
+};
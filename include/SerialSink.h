@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TelemetrySink.h"
+
+// Prints each aggregate as one "TELEMETRY <json>" line on the console, in
+// the POST /api/sensors layout, for a logger or gateway on the USB port.
+// Best effort: nothing is buffered or retried.
+class SerialSink : public TelemetrySink {
+private:
+    String deviceName;
+    String location;
+    char* lineBuffer;               // Only when the pipeline had no room for the record
+    
+    static const size_t LINE_BUFFER_SIZE = 1024;
+    
+public:
+    SerialSink(const String& device, const String& loc);
+    ~SerialSink();
+    
+    const char* getName() const override { return "serial"; }
+    SinkEncoding getEncoding() const override { return ENCODING_API_JSON; }
+    SinkPolicy getPolicy() const override { return { 1, 0, 0 }; }
+    
+    size_t encode(const AggregatedData& data, uint8_t* out, size_t size) override;
+    SinkResult deliver(const AggregatedData& data, const uint8_t* payload, size_t length) override;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Least-squares slope over a sliding time window.
+// Keeps running sums (Σt, Σv, Σt², Σtv) so each sample costs O(1).
+class SlopeEstimator {
+private:
+    unsigned long* times;
+    float* values;
+    uint16_t capacity;
+    uint16_t head;
+    uint16_t count;
+    
+    unsigned long windowMs;
+    unsigned long originMs;
+    
+    double sumT;
+    double sumV;
+    double sumTT;
+    double sumTV;
+    
+    // Re-anchor the time origin so t stays small and float error doesn't accumulate
+    static const unsigned long REBASE_INTERVAL = 3600000;
+    
+public:
+    SlopeEstimator(uint16_t size, unsigned long window);
+    ~SlopeEstimator();
+    
+    void reset();
+    void addSample(unsigned long timeMs, float value);
+    
+    bool hasSlope() const;
+    float getSlope() const;          // Units per second
+    float getSlopePerMinute() const;
+    
+    uint16_t getSampleCount() const { return count; }
+    unsigned long getSpan() const;    // ms between oldest and newest sample
+    unsigned long getWindow() const { return windowMs; }
+    
+private:
+    void accumulate(unsigned long timeMs, float value, double sign);
+    void evictOldest();
+    void rebase(unsigned long newOriginMs);
+};
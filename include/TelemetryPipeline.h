@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "TelemetrySink.h"
+#include "SequenceCounter.h"
+
+// Fans each aggregate out to every configured sink. A published record is
+// numbered, then encoded once per encoding the sinks ask for; sinks sharing
+// an encoding get the same bytes. Records sit in a shared ring with a
+// pending bit per sink, so each sink works through its own queue at its
+// own pace, under its own retry policy, without copying the record.
+//
+// When the ring is full the oldest record is pushed out and counted as
+// dropped for every sink still holding it. Durable sinks (HTTP API,
+// MongoDB) take records into their flash outbox on the first attempt, so in
+// practice only best-effort sinks ever hold a slot for long.
+//
+// Everything except getSinkStats() runs on the uplink task.
+class TelemetryPipeline {
+public:
+    static const uint8_t MAX_SINKS = 5;
+    
+private:
+    struct Slot {
+        AggregatedData data;
+        unsigned long enqueuedAt;
+        uint8_t pending;                        // Bit per sink index
+        uint16_t offset[ENCODING_COUNT];        // Into this slot's payload area
+        uint16_t length[ENCODING_COUNT];        // 0 = not encoded
+    };
+    
+    struct SinkState {
+        TelemetrySink* sink;
+        SinkPolicy policy;
+        uint8_t attempts;                       // On the record at the front of its queue
+        unsigned long retryDelay;
+        unsigned long nextAttempt;
+        SinkStats stats;
+    };
+    
+    static const uint8_t QUEUE_SIZE = 6;
+    static const size_t SLOT_PAYLOAD_SIZE = 1536;   // All encodings of one record, about 1.1 KB with every sink
+    
+    Slot slots[QUEUE_SIZE];
+    uint8_t* payloadArea;
+    uint8_t head;
+    uint8_t count;
+    
+    SinkState sinks[MAX_SINKS];
+    uint8_t sinkCount;
+    int8_t eventSink;                           // Index of the sink that gets events, -1 if none
+    int8_t relaySink;                           // Index of the sink that relays critical events, -1 if none
+    
+    SequenceCounter* sequenceCounter;
+    SemaphoreHandle_t statsMutex;
+    
+    SinkYieldCallback yieldCallback;
+    void* yieldContext;
+    
+    uint32_t publishedCount;
+    uint32_t encodeCount;                       // Encodings produced
+    uint32_t encodeShared;                      // Deliveries that reused another sink's encoding
+    uint32_t encodeOverflow;                    // Encodings that didn't fit in the slot
+    
+public:
+    TelemetryPipeline();
+    ~TelemetryPipeline();
+    
+    // Sinks are served in the order added. The first one that accepts
+    // events becomes the event sink, the first that relays them the relay.
+    bool addSink(TelemetrySink* sink);
+    bool begin();
+    
+    // Passed to every sink, including ones added later
+    void setYieldCallback(SinkYieldCallback callback, void* context);
+    
+    // Numbers and encodes the record and queues it for every sink
+    void publish(const AggregatedData& data, unsigned long enqueuedAt);
+    
+    // One delivery attempt per sink with a due record; returns true while
+    // any sink still has work queued
+    bool service();
+    void update(bool online);
+    
+    TelemetrySink* getEventSink() const { return eventSink >= 0 ? sinks[eventSink].sink : nullptr; }
+    TelemetrySink* getRelaySink() const { return relaySink >= 0 ? sinks[relaySink].sink : nullptr; }
+    uint8_t getSinkCount() const { return sinkCount; }
+    const char* getSinkName(uint8_t index) const;
+    bool getSinkStats(uint8_t index, SinkStats& out) const;
+    
+    uint32_t getPublishedCount() const { return publishedCount; }
+    uint32_t getEncodeCount() const { return encodeCount; }
+    uint32_t getEncodeShared() const { return encodeShared; }
+    uint32_t getEncodeOverflow() const { return encodeOverflow; }
+    uint32_t getNextSequence() const { return sequenceCounter->peek(); }
+    
+    // The one device-wide counter; sinks that take records directly as well
+    // number them from it, so no two records share a sequence
+    SequenceCounter* getSequenceCounter() const { return sequenceCounter; }
+    
+private:
+    Slot& slotAt(uint8_t offset) { return slots[(head + offset) % QUEUE_SIZE]; }
+    uint8_t* slotPayload(const Slot& slot) { return payloadArea + (&slot - slots) * SLOT_PAYLOAD_SIZE; }
+    void encodeSlot(Slot& slot);
+    void dropOldest();
+    void reclaim();
+    void deliverNext(uint8_t index);
+    void settle(uint8_t index, Slot& slot, SinkResult result);
+    void updateQueueDepths();
+    
+    // Only this task writes the stats, so it goes ahead even if the lock
+    // times out; it just mustn't give a mutex it doesn't hold
+    bool lockStats() const;
+    void unlockStats() const;
+};
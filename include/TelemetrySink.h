@@ -0,0 +1,100 @@
+#pragma once
+
+#include <Arduino.h>
+#include "DataCollector.h"
+#include "EventOutbox.h"
+
+// Wire formats a record can be encoded in. Sinks declaring the same
+// encoding must produce the same bytes for the same record, so the
+// pipeline encodes each record once per encoding and hands the bytes to
+// all of them.
+enum SinkEncoding {
+    ENCODING_API_JSON,          // Record object of POST /api/sensors (SensorRecord.h)
+    ENCODING_API_CBOR,          // The same record in CBOR
+    ENCODING_MONGO_DOCUMENT,    // MongoDB document with its deterministic _id
+    ENCODING_LORA_FRAME,        // 32-byte radio frame (LoRaFrame.h)
+    ENCODING_COUNT
+};
+
+enum SinkResult {
+    SINK_DELIVERED,             // Sent or stored
+    SINK_BUFFERED,              // Taken into the sink's own durable outbox; it retries from there
+    SINK_RETRY,                 // Not now; stays queued and the sink's retry policy applies
+    SINK_FAILED,                // Can't ever be delivered; dropped for this sink
+    SINK_SKIPPED                // Left out on purpose, e.g. merged into a later send; not an error
+};
+
+// How the pipeline retries a record that came back SINK_RETRY. The delay
+// doubles per attempt up to maxRetryDelay.
+struct SinkPolicy {
+    uint8_t maxAttempts;        // 0 retries until the record is pushed out of the queue
+    unsigned long retryDelay;
+    unsigned long maxRetryDelay;
+};
+
+struct SinkStats {
+    uint32_t delivered;
+    uint32_t buffered;
+    uint32_t retries;
+    uint32_t failed;            // SINK_FAILED or out of attempts
+    uint32_t dropped;           // Pushed out of the queue before delivery
+    uint32_t skipped;
+    uint16_t queueDepth;
+    uint16_t queueHighWater;
+    uint32_t bytes;             // Encoded bytes handed to the sink
+    unsigned long lastAttemptTime;
+    unsigned long lastDeliveredTime;
+    unsigned long lastLatency;  // Enqueue to delivered
+    unsigned long maxLatency;
+    SinkResult lastResult;
+    int lastStatusCode;
+};
+
+// Called by a sink between the requests of a long outbox drain, so the
+// uplink task can send critical events without waiting for the drain
+typedef void (*SinkYieldCallback)(void* context);
+
+// A destination for aggregates and, optionally, events. Sinks run on the
+// uplink task; deliver() may block on I/O but should bound it.
+class TelemetrySink {
+public:
+    virtual ~TelemetrySink() {}
+    
+    virtual const char* getName() const = 0;
+    virtual SinkEncoding getEncoding() const = 0;
+    virtual SinkPolicy getPolicy() const { return { 3, 5000, 60000 }; }
+    
+    virtual bool begin() { return true; }
+    
+    // Encodes the record in getEncoding(); returns the size, or 0 if it
+    // doesn't fit. Called for the first sink of each encoding only.
+    virtual size_t encode(const AggregatedData& data, uint8_t* out, size_t size) = 0;
+    
+    // payload is the record in getEncoding(), or nullptr if the pipeline
+    // had no room for it and the sink has to encode it itself
+    virtual SinkResult deliver(const AggregatedData& data, const uint8_t* payload, size_t length) = 0;
+    
+    // Events from the front of the outbox; returns how many were taken.
+    // Only the pipeline's event sink gets them.
+    virtual bool acceptsEvents() const { return false; }
+    virtual uint8_t deliverEvents(const OutboxEntry* entries, uint8_t count) { return 0; }
+    
+    // Events for the relay link: copies of critical events while the event
+    // sink can't reach its server, or every event when there is no event
+    // sink. Copies stay in the outbox for the event sink, so the same
+    // entries come back every pass until then, flagged once relayed; the
+    // sink skips those. Returns how many entries from the front it dealt
+    // with, relayed now, before or not at all, stopping at the first it
+    // couldn't send.
+    virtual bool relaysEvents() const { return false; }
+    virtual uint8_t relayEvents(const OutboxEntry* entries, uint8_t count) { return 0; }
+    
+    // Reconnects, outbox drains and other housekeeping; online is WiFi state
+    virtual void update(bool online) {}
+    
+    // Sinks whose drains send several requests in a row call this between
+    // them, with none of their own buffers in use
+    virtual void setYieldCallback(SinkYieldCallback callback, void* context) {}
+    
+    virtual int getLastStatusCode() const { return 0; }
+};
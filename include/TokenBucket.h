@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Request rate limit: up to `burst` requests back to back, refilled at
+// `perMinute` tokens per minute. Refill is computed from elapsed time on
+// each call, so there is no timer.
+class TokenBucket {
+private:
+    uint32_t capacity;          // Both in thousandths of a token
+    uint32_t tokens;
+    unsigned long refillInterval;   // ms per whole token
+    unsigned long lastRefill;
+    
+public:
+    TokenBucket(uint16_t burst, uint16_t perMinute);
+    
+    // reserve whole tokens are left for requests that pass 0, so a lower
+    // priority caller can't spend the last of them
+    bool available(uint16_t reserve = 0);
+    bool take(uint16_t reserve = 0);    // Consumes a token if one is available
+    
+    // Snapshots for status readers; they compute the refill but don't apply it
+    uint16_t getTokens() const;
+    unsigned long getWaitTime() const;  // ms until the next token, 0 if one is available
+    
+private:
+    void refill();
+    uint32_t refilledTokens(unsigned long now, unsigned long& converted) const;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "TelemetryPipeline.h"
+#include "EventOutbox.h"
+
+struct UplinkItem {
+    AggregatedData data;
+    unsigned long enqueuedAt;
+};
+
+// Send fields are those of the first sink; the pipeline has all of them
+struct UplinkStats {
+    unsigned long lastSendTime;
+    unsigned long lastAttemptTime;
+    bool lastSendSuccess;
+    uint32_t sendErrorCount;
+    int lastHttpStatusCode;
+    
+    uint16_t queueDepth;
+    uint16_t queueHighWater;
+    uint32_t enqueuedCount;
+    uint32_t droppedCount;
+    
+    // Enqueue to acknowledged, for aggregates
+    unsigned long lastSendLatency;
+    unsigned long maxSendLatency;
+};
+
+// Owns all network I/O: aggregates, event delivery and the sinks'
+// reconnect/buffer maintenance run on a task pinned to the WiFi core, so
+// loop() only ever enqueues and returns. Aggregates are published to the
+// telemetry pipeline, which fans them out; events go to its event sink.
+// While that sink is offline or failing, critical events also go out
+// straight away through the relay sink (LoRa), so alerts never wait for
+// WiFi; the event sink still gets them all once it's back, and the other
+// events wait for it in the outbox. With no event sink at all the relay
+// sink takes every event and each leaves the outbox once sent. Sinks
+// draining a backlog yield between requests so critical events don't queue
+// behind it.
+class UplinkTask {
+private:
+    TelemetryPipeline* pipeline;
+    EventOutbox* eventOutbox;
+    
+    QueueHandle_t uplinkQueue;
+    TaskHandle_t uplinkTask;
+    SemaphoreHandle_t statsMutex;
+    volatile bool running;
+    
+    UplinkStats stats;
+    
+    bool eventSendFailed;
+    unsigned long lastEventFailure;
+    
+    static const uint8_t QUEUE_SIZE = 4;                     // Aggregates are one per minute
+    static const uint32_t TASK_STACK_SIZE = 8192;
+    static const UBaseType_t TASK_PRIORITY = 1;
+    static const BaseType_t TASK_CORE = 0;                   // WiFi/lwIP run on core 0; loop() on core 1
+    static const unsigned long POLL_INTERVAL = 100;          // Critical event pickup latency
+    static const unsigned long EVENT_RETRY_INTERVAL = 5000;
+    static const uint8_t EVENT_BATCH_SIZE = 8;               // Events per deliverEvents(), one insertMany for MongoDB
+    
+public:
+    UplinkTask(TelemetryPipeline* telemetry, EventOutbox* outbox);
+    ~UplinkTask();
+    
+    bool begin();
+    void stop();
+    
+    // Never blocks. When full, the oldest queued aggregate is dropped
+    // in favour of the new one.
+    bool enqueueAggregate(const AggregatedData& data);
+    
+    void getStats(UplinkStats& out) const;
+    bool isRunning() const { return running; }
+    
+private:
+    static void uplinkTaskWrapper(void* parameter);
+    static void yieldToCriticalEvents(void* context);
+    void uplinkTaskFunction();
+    
+    bool sendEvents(bool criticalOnly);
+    void relayEvents();
+    void logSentEvent(const OutboxEntry& entry, bool critical);
+};
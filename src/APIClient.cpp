@@ -1,38 +1,102 @@
 #include "APIClient.h"
 
-WellPumpAPIClient::WellPumpAPIClient(const APIConfig& config, const String& device, const String& loc) {
+// Build with -DAPI_DEBUG_PAYLOADS to log full request bodies and timestamp conversions
+
+WellPumpAPIClient::WellPumpAPIClient(const APIConfig& config, const String& device, const String& loc,
+                                     SequenceCounter* sequences) {
     baseURL = config.baseURL;
     apiKey = config.apiKey;
     deviceName = device;
     location = loc;
     useHttps = config.useHttps;
     verifyCertificate = config.verifyCertificate;
+    caCert = config.caCert;
+    certFingerprint = config.certFingerprint;
+    useCbor = config.useCbor;
+    cborAccepted = true;
+    compressBatches = config.compressBatches;
+    gzipAccepted = true;
+    deflater = nullptr;
+    compressBuffer = nullptr;
+    compressedBatchCount = 0;
+    compressedBytesIn = 0;
+    compressedBytesOut = 0;
     
     httpClient = nullptr;
     secureClient = nullptr;
+    plainClient = nullptr;
     connected = false;
     initialized = false;
     lastConnectionTest = 0;
     lastRetryTime = 0;
     retryCount = 0;
     maxRetries = 3;
+    retryDelay = RETRY_DELAY;
     lastHttpStatusCode = -1;
     
-    bufferSize = BUFFER_SIZE;
-    buffer = new DataBuffer[bufferSize];
-    bufferIndex = 0;
-    bufferedCount = 0;
-    
-    for (uint8_t i = 0; i < bufferSize; i++) {
-        buffer[i].valid = false;
-    }
+    breaker = new CircuitBreaker(SLOW_REQUEST_TIME);
+    rateLimiter = new TokenBucket(RATE_LIMIT_BURST, RATE_LIMIT_PER_MINUTE);
+    deferredCount = 0;
+    lastRequestDeferred = false;
+    yieldCallback = nullptr;
+    yieldContext = nullptr;
+    
+    lastRequestTime = 0;
+    requestCount = 0;
+    connectionCount = 0;
+    reusedCount = 0;
+    reconnectRetryCount = 0;
+    lastRequestDuration = 0;
+    totalRequestDuration = 0;
+    lastDrainCount = 0;
+    lastDrainDuration = 0;
+    
+    batchSupported = true;
+    batchSize = INITIAL_BATCH_SIZE;
+    batchRequestCount = 0;
+    rejectedCount = 0;
+    
+    payloadBuffer = new char[PAYLOAD_BUFFER_SIZE];
+    payloadBuffer[0] = '\0';
+    buildRequestStrings();
+    setupCompressor();
+    
+    outbox = new FlashOutbox();
+    sequenceCounter = sequences;
+    lastAckedSequence = 0;
+    batchRecords = new AggregatedData[MAX_BATCH_SIZE];
+    lastDrainFailure = 0;
 }
 
 WellPumpAPIClient::~WellPumpAPIClient() {
     disconnect();
-    if (buffer) {
-        delete[] buffer;
-        buffer = nullptr;
+    if (outbox) {
+        delete outbox;
+        outbox = nullptr;
+    }
+    if (batchRecords) {
+        delete[] batchRecords;
+        batchRecords = nullptr;
+    }
+    if (payloadBuffer) {
+        delete[] payloadBuffer;
+        payloadBuffer = nullptr;
+    }
+    if (deflater) {
+        delete deflater;
+        deflater = nullptr;
+    }
+    if (compressBuffer) {
+        delete[] compressBuffer;
+        compressBuffer = nullptr;
+    }
+    if (breaker) {
+        delete breaker;
+        breaker = nullptr;
+    }
+    if (rateLimiter) {
+        delete rateLimiter;
+        rateLimiter = nullptr;
     }
 }
 
@@ -41,6 +105,11 @@ bool WellPumpAPIClient::begin() {
         return true;
     }
     
+    // Opened even without a usable configuration so nothing is lost meanwhile
+    if (!outbox->begin()) {
+        Serial.println("API Client: Flash outbox unavailable, unsent data will be lost");
+    }
+    
     if (!validateConfiguration()) {
         Serial.println("API Client: Invalid configuration");
         return false;
@@ -68,6 +137,18 @@ void WellPumpAPIClient::setCredentials(const APIConfig& config) {
     apiKey = config.apiKey;
     useHttps = config.useHttps;
     verifyCertificate = config.verifyCertificate;
+    caCert = config.caCert;
+    certFingerprint = config.certFingerprint;
+    useCbor = config.useCbor;
+    compressBatches = config.compressBatches;
+    
+    // A different server may support batching, CBOR or gzip even if the last one didn't
+    batchSupported = true;
+    cborAccepted = true;
+    gzipAccepted = true;
+    batchSize = INITIAL_BATCH_SIZE;
+    buildRequestStrings();
+    setupCompressor();
     
     if (initialized) {
         disconnect();
@@ -75,22 +156,75 @@ void WellPumpAPIClient::setCredentials(const APIConfig& config) {
     }
 }
 
+void WellPumpAPIClient::buildRequestStrings() {
+    sensorsURL = baseURL + "/api/sensors";
+    batchURL = baseURL + "/api/sensors/batch";
+    eventsURL = baseURL + "/api/events";
+    healthURL = baseURL + "/api/health";
+    authHeader = apiKey.length() > 0 ? "Bearer " + apiKey : "";
+}
+
+void WellPumpAPIClient::setupCompressor() {
+    // About 18 KB (match tables plus output buffer), only when enabled
+    if (!compressBatches || deflater) {
+        return;
+    }
+    deflater = new Deflater();
+    compressBuffer = new uint8_t[PAYLOAD_BUFFER_SIZE];
+}
+
 bool WellPumpAPIClient::setupHTTPClient() {
     cleanupHTTPClient();
     
+    // The transport client outlives individual requests so the socket (and
+    // for HTTPS the TLS session) can be reused
     if (useHttps) {
-        secureClient = new WiFiClientSecure();
-        if (!verifyCertificate) {
-            secureClient->setInsecure(); // Don't verify SSL certificates
+        secureClient = new SecureTransport();
+        if (!setupVerification()) {
+            return false;
         }
-        httpClient = new HTTPClient();
     } else {
-        httpClient = new HTTPClient();
+        plainClient = new WiFiClient();
     }
     
+    httpClient = new HTTPClient();
+    httpClient->setReuse(true);
+    
+    static const char* responseHeaders[] = { "Retry-After" };
+    httpClient->collectHeaders(responseHeaders, 1);
+    
     return (httpClient != nullptr);
 }
 
+bool WellPumpAPIClient::setupVerification() {
+    if (!verifyCertificate) {
+        return secureClient->setVerification(TLS_VERIFY_NONE, "");
+    }
+    
+    // A fingerprint skips chain validation entirely, so it wins when both are set
+    if (certFingerprint.length() > 0) {
+        return secureClient->setVerification(TLS_VERIFY_FINGERPRINT, certFingerprint);
+    }
+    if (caCert.length() > 0) {
+        return secureClient->setVerification(TLS_VERIFY_CA, caCert);
+    }
+    
+    Serial.println("API Client: Certificate verification needs a CA certificate or fingerprint");
+    return false;
+}
+
+const char* WellPumpAPIClient::getTLSMode() const {
+    if (!useHttps) return "off";
+    if (!verifyCertificate) return "unverified";
+    return certFingerprint.length() > 0 ? "fingerprint" : "ca";
+}
+
+bool WellPumpAPIClient::getTLSStats(TLSStats& out) const {
+    if (!secureClient) return false;
+    secureClient->getStats(out);
+    return true;
+}
+
 void WellPumpAPIClient::cleanupHTTPClient() {
     if (httpClient) {
         httpClient->end();
@@ -99,9 +233,64 @@ void WellPumpAPIClient::cleanupHTTPClient() {
     }
     
     if (secureClient) {
+        secureClient->stop();
         delete secureClient;
         secureClient = nullptr;
     }
+    
+    if (plainClient) {
+        plainClient->stop();
+        delete plainClient;
+        plainClient = nullptr;
+    }
+}
+
+WiFiClient* WellPumpAPIClient::transport() const {
+    if (secureClient) return secureClient;
+    return plainClient;
+}
+
+void WellPumpAPIClient::beginRequest(const String& url, const RequestBody* body) {
+    WiFiClient* client = transport();
+    if (client && client->connected()) {
+        reusedCount++;
+    } else {
+        connectionCount++;
+    }
+    
+    httpClient->begin(*client, url);
+    
+    httpClient->addHeader("Content-Type", body && body->cbor ? "application/cbor" : "application/json");
+    if (body && body->gzip) {
+        httpClient->addHeader("Content-Encoding", "gzip");
+    }
+    if (body && body->idempotencyKey) {
+        httpClient->addHeader("Idempotency-Key", body->idempotencyKey);
+    }
+    if (authHeader.length() > 0) {
+        httpClient->addHeader("Authorization", authHeader);
+    }
+    
+    // Enable redirect following and add timeout
+    httpClient->setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+    httpClient->setTimeout(REQUEST_TIMEOUT);
+}
+
+void WellPumpAPIClient::closeIdleConnection() {
+    // Close before the server does, so the next request never lands on a
+    // socket that is already half-closed on the other end
+    WiFiClient* client = transport();
+    if (client && client->connected() && millis() - lastRequestTime > KEEPALIVE_IDLE_TIMEOUT) {
+        client->stop();
+    }
+}
+
+bool WellPumpAPIClient::isStaleConnectionError(int httpCode) {
+    // Failures before the request reached the server; safe to resend
+    return httpCode == HTTPC_ERROR_SEND_HEADER_FAILED ||
+           httpCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+           httpCode == HTTPC_ERROR_NOT_CONNECTED ||
+           httpCode == HTTPC_ERROR_CONNECTION_LOST;
 }
 
 bool WellPumpAPIClient::testConnection() {
@@ -111,49 +300,41 @@ bool WellPumpAPIClient::testConnection() {
     if (now - lastConnectionTest < CONNECTION_TEST_INTERVAL) {
         return connected;
     }
+    if (!admitRequest()) {
+        return connected;
+    }
     
     // Test connection with health endpoint
-    String url = baseURL + "/api/health";
+    const String& url = healthURL;
     
     // Print connection test details
     Serial.println("=== CONNECTION TEST ===");
     Serial.println("URL: " + url);
     Serial.println("HTTPS: " + String(useHttps ? "Yes" : "No"));
-    Serial.println("Verify Cert: " + String(verifyCertificate ? "Yes" : "No"));
+    Serial.println("Verify Cert: " + String(verifyCertificate ? "Yes" : "No") + " (" + getTLSMode() + ")");
     Serial.println("=======================");
     
-    if (useHttps && secureClient) {
-        Serial.println("Attempting HTTPS connection...");
+    if (useHttps) {
         Serial.print("Free heap before connection: ");
         Serial.println(ESP.getFreeHeap());
-        
-        // Try to connect manually first to get better error info
-        if (!secureClient->connect("well.spidermo.net", 443)) {
-            Serial.println("SSL connection failed!");
-            httpClient->end();
-            return false;
-        }
-        Serial.println("SSL handshake successful");
-        secureClient->stop();
-        
-        httpClient->begin(*secureClient, url);
-    } else {
-        httpClient->begin(url);
-    }
-    
-    httpClient->addHeader("Content-Type", "application/json");
-    if (apiKey.length() > 0) {
-        httpClient->addHeader("Authorization", "Bearer " + apiKey);
     }
     
-    // Enable redirect following and add timeout
-    httpClient->setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    httpClient->setTimeout(10000); // 10 second timeout
+    closeIdleConnection();
+    beginRequest(url);
     
     Serial.println("Making GET request...");
+    unsigned long started = millis();
     int httpResponseCode = httpClient->GET();
+    recordOutcome(httpResponseCode, millis() - started);
     Serial.print("Received response code: ");
     Serial.println(httpResponseCode);
+    if (secureClient) {
+        TLSStats tls;
+        secureClient->getStats(tls);
+        Serial.printf("TLS: %lu ms handshake, %lu full / %lu resumed, %lu bytes heap per connection\n",
+                      tls.lastHandshakeMs, (unsigned long)tls.fullHandshakes,
+                      (unsigned long)tls.resumedHandshakes, (unsigned long)tls.connectionHeap);
+    }
     
     lastHttpStatusCode = httpResponseCode;
     connected = (httpResponseCode >= 200 && httpResponseCode < 300);
@@ -181,6 +362,7 @@ bool WellPumpAPIClient::testConnection() {
         }
     }
     
+    lastRequestTime = millis();
     httpClient->end();
     return connected;
 }
@@ -194,244 +376,536 @@ void WellPumpAPIClient::disconnect() {
     connected = false;
 }
 
-bool WellPumpAPIClient::sendSensorData(const AggregatedData& data) {
+bool WellPumpAPIClient::sendSensorData(const AggregatedData& aggregate) {
+    // Numbered once, before the first attempt; buffered copies keep it
+    AggregatedData data = aggregate;
+    if (data.sequence == 0 && sequenceCounter) {
+        data.sequence = sequenceCounter->allocate();
+    }
+    return sendRecord(data, nullptr, 0) == SINK_DELIVERED;
+}
+
+SinkResult WellPumpAPIClient::deliver(const AggregatedData& data, const uint8_t* payload, size_t length) {
+    return sendRecord(data, payload, length);
+}
+
+size_t WellPumpAPIClient::encode(const AggregatedData& data, uint8_t* out, size_t size) {
+    if (cborEnabled()) {
+        CborWriter writer((char*)out, size);
+        writeSensorRecord(writer, data, deviceName.c_str(), location.c_str());
+        return writer.overflowed() ? 0 : writer.size();
+    }
+    
+    JsonWriter writer((char*)out, size);
+    writeSensorRecord(writer, data, deviceName.c_str(), location.c_str());
+    return writer.overflowed() ? 0 : writer.size();
+}
+
+SinkResult WellPumpAPIClient::sendRecord(const AggregatedData& data, const uint8_t* payload, size_t length) {
+    // Until the record is on flash it stays with the caller
     if (!initialized || !connected) {
         Serial.println("API Client: Not connected, buffering data");
-        addToBuffer(data);
-        return false;
+        return addToBuffer(data) ? SINK_BUFFERED : SINK_RETRY;
+    }
+    if (!uplinkReady()) {
+        Serial.printf("API Client: Uplink held (breaker %s), buffering data\n", breaker->getStateName());
+        deferredCount++;
+        return addToBuffer(data) ? SINK_BUFFERED : SINK_RETRY;
+    }
+    
+    if (outbox->pendingCount() > 0) {
+        // Queue behind the backlog so the server receives records in order
+        if (!addToBuffer(data)) return SINK_RETRY;
+        processBuffer();
+        return outbox->pendingCount() == 0 ? SINK_DELIVERED : SINK_BUFFERED;
     }
     
-    if (sendSensorDataToAPI(data)) {
+    if (sendSensorDataToAPI(data, payload, length)) {
+        lastAckedSequence = data.sequence;
         resetRetryCount();
-        return true;
+        return SINK_DELIVERED;
     } else {
         Serial.println("API Client: Failed to send sensor data, buffering");
-        addToBuffer(data);
-        return false;
+        lastDrainFailure = millis();
+        return addToBuffer(data) ? SINK_BUFFERED : SINK_RETRY;
     }
 }
 
-bool WellPumpAPIClient::sendEvent(const Event& event) {
+bool WellPumpAPIClient::sendEvent(const Event& event, bool heartbeat) {
+    OutboxEntry entry;
+    entry.event = event;
+    entry.heartbeat = heartbeat;
+    entry.lostBefore = 0;
+    entry.firstSequence = event.sequence;
+    entry.relayed = false;
+    return deliverEvents(&entry, 1) == 1;
+}
+
+uint8_t WellPumpAPIClient::deliverEvents(const OutboxEntry* entries, uint8_t count) {
     if (!initialized || !connected) {
         Serial.println("API Client: Not connected, cannot send event");
+        return 0;
+    }
+    
+    uint8_t sent = 0;
+    while (sent < count) {
+        const OutboxEntry& entry = entries[sent];
+        if (!uplinkReady(!entry.heartbeat && isCriticalEvent(entry.event.type))) {
+            deferredCount++;
+            break; // Stays in the event outbox until the uplink is let through again
+        }
+        if (!sendEventToAPI(entry)) break;
+        sent++;
+    }
+    return sent;
+}
+
+template <typename Writer>
+void WellPumpAPIClient::writeEventRecord(Writer& writer, const OutboxEntry& entry) {
+    const Event& event = entry.event;
+    char startTime[21];
+    formatRecordTimestamp(event.startTime, startTime, sizeof(startTime));
+    
+    writer.beginObject();
+    writer.field("device", deviceName.c_str());
+    writer.field("location", location.c_str());
+    writer.field("timestamp", startTime);
+    writer.field("type", (int)event.type);
+    writer.field("value", event.value);
+    writer.field("threshold", event.threshold);
+    writer.field("startTime", startTime);
+    writer.field("duration", event.duration);
+    writer.field("active", event.active);
+    writer.field("description", eventDescription(event.type));
+    writer.field("sequence", event.sequence);
+    writer.field("state", eventStateName(event.state));
+    writer.field("heartbeat", entry.heartbeat);
+    if (entry.lostBefore > 0) {
+        writer.field("lostBefore", entry.lostBefore);
+    }
+    writer.endObject();
+}
+
+template <typename Writer>
+uint8_t WellPumpAPIClient::writeBatch(Writer& writer, const AggregatedData* records, uint8_t count) {
+    writer.beginArray();
+    for (uint8_t i = 0; i < count; i++) {
+        auto before = writer.mark();
+        writeSensorRecord(writer, records[i], deviceName.c_str(), location.c_str());
+        if (writer.overflowed()) {
+            // Send what fits; the rest stay buffered for the next batch
+            writer.rewind(before);
+            count = i;
+            break;
+        }
+    }
+    writer.endArray();
+    return writer.overflowed() ? 0 : count;
+}
+
+bool WellPumpAPIClient::sendSensorDataToAPI(const AggregatedData& data, const uint8_t* payload, size_t length) {
+    // Same key on every retry of this record, so the server can drop repeats
+    char key[IDEMPOTENCY_KEY_SIZE];
+    snprintf(key, sizeof(key), "%s-s%lu", deviceName.c_str(), (unsigned long)data.sequence);
+    
+    // The pipeline encodes ahead in the current encoding; anything else is
+    // encoded here
+    if (!payload) {
+        length = encode(data, (uint8_t*)payloadBuffer, PAYLOAD_BUFFER_SIZE);
+        payload = (const uint8_t*)payloadBuffer;
+    }
+    if (length == 0) {
+        Serial.println("API Client: Sensor payload exceeds buffer");
         return false;
     }
     
-    return sendEventToAPI(event);
+    bool cbor = cborEnabled();
+    RequestBody body = { (const char*)payload, length, cbor, false, key };
+    if (makeRequest(sensorsURL, body)) return true;
+    if (!cbor || !cborRejected()) return false;
+    
+    // The encoding just switched to JSON
+    length = encode(data, (uint8_t*)payloadBuffer, PAYLOAD_BUFFER_SIZE);
+    if (length == 0) {
+        Serial.println("API Client: Sensor payload exceeds buffer");
+        return false;
+    }
+    RequestBody json = { payloadBuffer, length, false, false, key };
+    return makeRequest(sensorsURL, json);
 }
 
-bool WellPumpAPIClient::sendSensorDataToAPI(const AggregatedData& data) {
-    String payload = createSensorJSON(data);
-    return makeRequest("/api/sensors", "POST", payload);
+bool WellPumpAPIClient::sendEventToAPI(const OutboxEntry& entry) {
+    const Event& event = entry.event;
+    // startTime tells apart events whose per-boot sequence restarted after a
+    // power cycle. Heartbeats are deliberate repeats and carry no key.
+    char key[IDEMPOTENCY_KEY_SIZE];
+    snprintf(key, sizeof(key), "%s-e%lu-%lu", deviceName.c_str(), (unsigned long)event.startTime,
+             (unsigned long)event.sequence);
+    const char* idempotencyKey = entry.heartbeat ? nullptr : key;
+    bool critical = !entry.heartbeat && isCriticalEvent(event.type);
+    
+    if (cborEnabled()) {
+        CborWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+        writeEventRecord(writer, entry);
+        if (writer.overflowed()) {
+            Serial.println("API Client: Event payload exceeds buffer");
+            return false;
+        }
+        RequestBody body = { writer.data(), writer.size(), true, false, idempotencyKey, critical };
+        if (makeRequest(eventsURL, body)) return true;
+        if (!cborRejected()) return false;
+    }
+    
+    JsonWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+    writeEventRecord(writer, entry);
+    if (writer.overflowed()) {
+        Serial.println("API Client: Event payload exceeds buffer");
+        return false;
+    }
+    RequestBody body = { writer.c_str(), writer.size(), false, false, idempotencyKey, critical };
+    return makeRequest(eventsURL, body);
 }
 
-bool WellPumpAPIClient::sendEventToAPI(const Event& event) {
-    String payload = createEventJSON(event);
-    return makeRequest("/api/events", "POST", payload);
+bool WellPumpAPIClient::cborRejected() {
+    // 415 Unsupported Media Type: the server only speaks JSON. Stay on JSON
+    // until the configuration changes.
+    if (lastHttpStatusCode != 415) {
+        return false;
+    }
+    Serial.println("API Client: Server does not accept CBOR, switching to JSON");
+    cborAccepted = false;
+    return true;
 }
 
-bool WellPumpAPIClient::makeRequest(const String& endpoint, const String& method, const String& payload) {
+bool WellPumpAPIClient::makeRequest(const String& url, const RequestBody& body, String* response) {
     if (!httpClient) return false;
     
-    String url = baseURL + endpoint;
+    lastRequestDeferred = !admitRequest(body.critical);
+    if (lastRequestDeferred) {
+        return false;
+    }
     
-    // Print request details
+#ifdef API_DEBUG_PAYLOADS
     Serial.println("=== API REQUEST ===");
-    Serial.println("Method: " + method);
-    Serial.println("URL: " + url);
-    Serial.println("HTTPS: " + String(useHttps ? "Yes" : "No"));
-    Serial.println("Verify Cert: " + String(verifyCertificate ? "Yes" : "No"));
-    if (apiKey.length() > 0) {
-        Serial.println("API Key: [PRESENT]");
+    Serial.printf("POST %s (%u bytes, HTTPS: %s, verify: %s, key: %s, idempotency: %s)\n", url.c_str(),
+                  (unsigned)body.length, useHttps ? "yes" : "no", verifyCertificate ? "yes" : "no",
+                  apiKey.length() > 0 ? "present" : "not set", body.idempotencyKey ? body.idempotencyKey : "none");
+    if (body.cbor || body.gzip) {
+        for (size_t i = 0; i < body.length; i++) {
+            Serial.printf("%02x", (uint8_t)body.data[i]);
+        }
+        Serial.println();
     } else {
-        Serial.println("API Key: [NOT SET]");
-    }
-    if (payload.length() > 0) {
-        Serial.println("Payload: " + payload);
+        Serial.println(body.data);
     }
     Serial.println("==================");
+#else
+    Serial.printf("API POST %s (%u bytes%s)\n", url.c_str(), (unsigned)body.length, body.gzip ? ", gzip" : "");
+#endif
     
-    if (useHttps && secureClient) {
-        httpClient->begin(*secureClient, url);
-    } else {
-        httpClient->begin(url);
-    }
+    closeIdleConnection();
     
-    httpClient->addHeader("Content-Type", "application/json");
-    if (apiKey.length() > 0) {
-        httpClient->addHeader("Authorization", "Bearer " + apiKey);
-    }
+    unsigned long started = millis();
+    bool reused = transport() && transport()->connected();
+    int httpResponseCode = performRequest(url, body);
     
-    // Enable redirect following and add timeout
-    httpClient->setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    httpClient->setTimeout(10000); // 10 second timeout
-    
-    int httpResponseCode;
-    if (method == "POST") {
-        Serial.println("Making POST request...");
-        httpResponseCode = httpClient->POST(payload);
-    } else if (method == "GET") {
-        Serial.println("Making GET request...");
-        httpResponseCode = httpClient->GET();
-    } else {
+    // A kept-alive socket the server has since closed fails before anything
+    // is sent; reconnect and try once more
+    if (reused && isStaleConnectionError(httpResponseCode)) {
+        Serial.println("API Client: Kept-alive connection was closed, reconnecting");
         httpClient->end();
-        return false;
+        transport()->stop();
+        reconnectRetryCount++;
+        httpResponseCode = performRequest(url, body);
     }
     
-    Serial.print("Received response code: ");
-    Serial.println(httpResponseCode);
+    lastRequestTime = millis();
+    lastRequestDuration = lastRequestTime - started;
+    totalRequestDuration += lastRequestDuration;
+    requestCount++;
+    recordOutcome(httpResponseCode, lastRequestDuration);
     
     lastHttpStatusCode = httpResponseCode;
-    bool success = (httpResponseCode == 200 || httpResponseCode == 201);
+    // 409 on a keyed request: the server already committed it on an earlier
+    // attempt whose response was lost
+    bool success = (httpResponseCode == 200 || httpResponseCode == 201 ||
+                    (httpResponseCode == 409 && body.idempotencyKey));
     
     if (!success) {
-        Serial.print("API Request failed. HTTP code: ");
-        Serial.println(httpResponseCode);
-        String response = httpClient->getString();
-        if (response.length() > 0) {
-            Serial.println("Response: " + response);
+        Serial.printf("API Request failed. HTTP code: %d\n", httpResponseCode);
+        if (httpResponseCode > 0) {
+            String body = httpClient->getString();
+            if (body.length() > 0 && body.length() < 500) {
+                Serial.println("Response: " + body);
+            }
         }
-    } else {
-        Serial.println("API Request successful: " + endpoint);
+    } else if (response) {
+        *response = httpClient->getString();
     }
     
+    // With reuse enabled this leaves the socket open for the next request
     httpClient->end();
     return success;
 }
 
-String WellPumpAPIClient::createSensorJSON(const AggregatedData& data) {
-    JsonDocument doc;
-    
-    doc["device"] = deviceName;
-    doc["location"] = location;
-    doc["timestamp"] = formatTimestamp(data.endTime);
-    doc["startTime"] = formatTimestamp(data.startTime);
-    doc["endTime"] = formatTimestamp(data.endTime);
-    doc["sampleCount"] = data.sampleCount; // Keep for backward compatibility
-    
-    // Individual sample counts for each metric - commented out to maintain API contract
-    // doc["tempSampleCount"] = data.tempSampleCount;
-    // doc["humSampleCount"] = data.humSampleCount;
-    // doc["pressSampleCount"] = data.pressSampleCount;
-    // doc["current1SampleCount"] = data.current1SampleCount;
-    // doc["current2SampleCount"] = data.current2SampleCount;
-    
-    // Temperature data (flattened to match API format)
-    doc["tempMin"] = data.tempMin;
-    doc["tempMax"] = data.tempMax;
-    doc["tempAvg"] = data.tempAvg;
-    
-    // Humidity data
-    doc["humMin"] = data.humMin;
-    doc["humMax"] = data.humMax;
-    doc["humAvg"] = data.humAvg;
-    
-    // Pressure data
-    doc["pressMin"] = data.pressMin;
-    doc["pressMax"] = data.pressMax;
-    doc["pressAvg"] = data.pressAvg;
-    
-    // Current 1 data
-    doc["current1Min"] = data.current1Min;
-    doc["current1Max"] = data.current1Max;
-    doc["current1Avg"] = data.current1Avg;
-    doc["current1RMS"] = data.current1RMS;
-    doc["dutyCycle1"] = data.dutyCycle1;
-    
-    // Current 2 data
-    doc["current2Min"] = data.current2Min;
-    doc["current2Max"] = data.current2Max;
-    doc["current2Avg"] = data.current2Avg;
-    doc["current2RMS"] = data.current2RMS;
-    doc["dutyCycle2"] = data.dutyCycle2;
-    
-    String result;
-    serializeJson(doc, result);
-    return result;
-}
-
-String WellPumpAPIClient::createEventJSON(const Event& event) {
-    JsonDocument doc;
-    
-    doc["device"] = deviceName;
-    doc["location"] = location;
-    doc["timestamp"] = formatTimestamp(event.startTime);
-    doc["type"] = (int)event.type;
-    doc["value"] = event.value;
-    doc["threshold"] = event.threshold;
-    doc["startTime"] = formatTimestamp(event.startTime);
-    doc["duration"] = event.duration;
-    doc["active"] = event.active;
-    doc["description"] = event.description;
-    
-    String result;
-    serializeJson(doc, result);
-    return result;
-}
-
-String WellPumpAPIClient::formatTimestamp(unsigned long timestamp) {
-    // Check if this looks like a unix timestamp or millis()
-    if (timestamp > 1600000000) {
-        // Looks like a unix timestamp (seconds since epoch) - convert to milliseconds
-        // Use proper 64-bit arithmetic to avoid overflow
-        uint64_t timestampMs = (uint64_t)timestamp * 1000ULL;
-        Serial.printf("API: Using unix timestamp %lu -> %llu ms\n", timestamp, timestampMs);
-        return String(timestampMs);
-    } else {
-        // Looks like millis() - this indicates NTP sync failed
-        Serial.printf("API: Warning - received millis timestamp %lu, NTP not synced!\n", timestamp);
-        return String(0); // Return 0 to indicate invalid timestamp
+int WellPumpAPIClient::performRequest(const String& url, const RequestBody& body) {
+    beginRequest(url, &body);
+    return httpClient->POST((uint8_t*)body.data, body.length);
+}
+
+bool WellPumpAPIClient::uplinkReady(bool critical) {
+    if (critical) {
+        return rateLimiter->available();
     }
+    return rateLimiter->available(CRITICAL_TOKEN_RESERVE) && breaker->wouldAllow();
 }
 
-void WellPumpAPIClient::addToBuffer(const AggregatedData& data) {
-    buffer[bufferIndex].data = data;
-    buffer[bufferIndex].timestamp = millis();
-    buffer[bufferIndex].valid = true;
-    
-    bufferIndex = (bufferIndex + 1) % bufferSize;
-    if (bufferedCount < bufferSize) {
-        bufferedCount++;
+bool WellPumpAPIClient::admitRequest(bool critical) {
+    // A critical event goes out even while the breaker is open or a
+    // Retry-After holds the rest back; the reserved token bounds it to the
+    // refill rate. Its outcome is still recorded, and counts as the probe
+    // if the breaker is half-open.
+    if (critical) {
+        if (!rateLimiter->take()) {
+            deferredCount++;
+            return false;
+        }
+        return true;
     }
     
-    Serial.println("API Client: Data added to buffer (" + String(bufferedCount) + "/" + String(bufferSize) + ")");
+    // Tokens first: a request the bucket holds back must not leave the
+    // breaker waiting for a half-open probe that was never sent
+    if (!rateLimiter->available(CRITICAL_TOKEN_RESERVE) || !breaker->allowRequest()) {
+        deferredCount++;
+        return false;
+    }
+    rateLimiter->take(CRITICAL_TOKEN_RESERVE);
+    return true;
+}
+
+void WellPumpAPIClient::recordOutcome(int httpCode, unsigned long duration) {
+    // Other 4xx are about the request, not the server's health
+    bool failed = httpCode <= 0 || httpCode >= 500 || httpCode == 429 || httpCode == 408;
+    breaker->record(failed, duration);
+    
+    if (httpCode == 429 || httpCode == 503) {
+        // Delta-seconds form only; an HTTP date reads as 0 and is ignored
+        long seconds = httpClient->header("Retry-After").toInt();
+        if (seconds > 0) {
+            breaker->holdOff(min(seconds, MAX_RETRY_AFTER) * 1000UL);
+        }
+    }
+}
+
+bool WellPumpAPIClient::addToBuffer(const AggregatedData& data) {
+    if (!outbox->append(data)) {
+        Serial.println("API Client: Failed to buffer data");
+        return false;
+    }
+    Serial.println("API Client: Data added to outbox (" + String(outbox->pendingCount()) + " pending)");
+    return true;
 }
 
 bool WellPumpAPIClient::processBuffer() {
-    if (bufferedCount == 0 || !connected) {
+    // Held by the rate limit or breaker isn't a failure; the drain resumes
+    // on a later update()
+    if (outbox->pendingCount() == 0 || !connected || !uplinkReady()) {
         return true;
     }
     
     bool allSuccess = true;
-    uint8_t processed = 0;
+    uint32_t processed = 0;
+    unsigned long started = millis();
     
-    Serial.println("API Client: Processing buffer (" + String(bufferedCount) + " items)");
+    Serial.println("API Client: Processing outbox (" + String(outbox->pendingCount()) + " items)");
     
-    for (uint8_t i = 0; i < bufferSize && processed < bufferedCount; i++) {
-        if (buffer[i].valid) {
-            if (sendSensorDataToAPI(buffer[i].data)) {
-                buffer[i].valid = false;
-                processed++;
-                Serial.println("API Client: Sent buffered data item " + String(processed));
-            } else {
+    while (outbox->pendingCount() > 0 && uplinkReady()) {
+        // Critical events logged since the last post go ahead of the next
+        // one; payloadBuffer is free here
+        if (processed > 0 && yieldCallback) {
+            yieldCallback(yieldContext);
+            if (!uplinkReady()) break;
+        }
+        
+        uint8_t count = outbox->peek(batchRecords, batchSupported ? batchSize : 1);
+        if (count == 0) break;
+        
+        if (count > 1) {
+            int released = sendBufferBatch(batchRecords, count);
+            if (released < 0) {
+                continue; // Endpoint unsupported; the rest go one at a time
+            }
+            processed += released;
+            if (released == 0 && lastRequestDeferred) {
+                break;
+            }
+            if (released < count) {
                 allSuccess = false;
-                Serial.println("API Client: Failed to send buffered data, stopping");
-                break; // Stop on first failure to avoid overwhelming the server
+                Serial.println("API Client: Batch not fully acknowledged, stopping");
+                break;
             }
-            delay(100); // Small delay between requests
+            continue;
+        }
+        
+        if (sendSensorDataToAPI(batchRecords[0])) {
+            lastAckedSequence = batchRecords[0].sequence;
+            outbox->acknowledge(1);
+            processed++;
+            Serial.println("API Client: Sent buffered data item " + String(processed));
+        } else if (lastRequestDeferred) {
+            break;
+        } else {
+            allSuccess = false;
+            Serial.println("API Client: Failed to send buffered data, stopping");
+            break; // Stop on first failure to avoid overwhelming the server
         }
     }
     
-    // Update buffered count
-    bufferedCount -= processed;
+    if (!allSuccess) {
+        lastDrainFailure = millis();
+    }
     
     if (processed > 0) {
-        Serial.println("API Client: Processed " + String(processed) + " buffered items, " + String(bufferedCount) + " remaining");
+        lastDrainCount = processed;
+        lastDrainDuration = millis() - started;
+        Serial.println("API Client: Processed " + String(processed) + " buffered items in " + String(lastDrainDuration) +
+                       "ms, " + String(outbox->pendingCount()) + " remaining");
     }
     
     return allSuccess;
 }
 
+int WellPumpAPIClient::sendBufferBatch(const AggregatedData* records, uint8_t count) {
+    // Per-record dedupe is by the sequence field; the key covers this exact batch
+    char key[IDEMPOTENCY_KEY_SIZE];
+    String response;
+    bool success = false;
+    bool sent = false;
+    
+    if (cborEnabled()) {
+        CborWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+        count = writeBatch(writer, records, count);
+        if (count == 0) {
+            return 0;
+        }
+        snprintf(key, sizeof(key), "%s-b%lu-%lu", deviceName.c_str(), (unsigned long)records[0].sequence,
+                 (unsigned long)records[count - 1].sequence);
+        RequestBody body = { writer.data(), writer.size(), true, false, key };
+        success = postBatch(body, &response);
+        sent = success || !cborRejected();
+    }
+    
+    if (!sent) {
+        JsonWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+        count = writeBatch(writer, records, count);
+        if (count == 0) {
+            return 0;
+        }
+        snprintf(key, sizeof(key), "%s-b%lu-%lu", deviceName.c_str(), (unsigned long)records[0].sequence,
+                 (unsigned long)records[count - 1].sequence);
+        RequestBody body = { writer.c_str(), writer.size(), false, false, key };
+        success = postBatch(body, &response);
+    }
+    if (!success && lastRequestDeferred) {
+        return 0;
+    }
+    if (!success && (lastHttpStatusCode == 404 || lastHttpStatusCode == 405)) {
+        Serial.println("API Client: Batch endpoint not available, falling back to single uploads");
+        batchSupported = false;
+        return -1;
+    }
+    
+    batchRequestCount++;
+    adjustBatchSize(success);
+    if (!success) {
+        return 0;
+    }
+    
+    // Per-record results in request order: {"results":[{"status":201},...]}.
+    // The acknowledgement is JSON whichever encoding the request used.
+    // Without a results array the HTTP status covers the whole batch.
+    JsonDocument ack;
+    JsonArray results;
+    if (response.length() > 0 && deserializeJson(ack, response) == DeserializationError::Ok) {
+        results = ack["results"].as<JsonArray>();
+    }
+    
+    // The outbox is a FIFO, so only the leading run of settled records is
+    // released; anything after a retryable failure is resent with it
+    uint8_t released = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        int status = results.isNull() ? lastHttpStatusCode : (results[i]["status"] | 0);
+        
+        if ((status >= 200 && status < 300) || status == 409) {
+            // 409: the server already has this record
+        } else if (status >= 400 && status < 500) {
+            // Resending a record the server rejected won't change the answer
+            Serial.printf("API Client: Batch record %d rejected (HTTP %d), dropping\n", i, status);
+            rejectedCount++;
+        } else {
+            break;
+        }
+        released++;
+    }
+    if (released > 0) {
+        lastAckedSequence = records[released - 1].sequence;
+    }
+    outbox->acknowledge(released);
+    
+    Serial.printf("API Client: Batch of %d acknowledged %d in %lums, next batch size %d\n",
+                  count, released, lastRequestDuration, batchSize);
+    return released;
+}
+
+bool WellPumpAPIClient::postBatch(const RequestBody& body, String* response) {
+    if (compressionEnabled() && body.length >= COMPRESS_MIN_BYTES) {
+        // Output capped at the input size: a body that doesn't shrink goes uncompressed
+        size_t compressed = deflater->gzip((const uint8_t*)body.data, body.length, compressBuffer, body.length);
+        if (compressed > 0) {
+            RequestBody gzipBody = body;
+            gzipBody.data = (const char*)compressBuffer;
+            gzipBody.length = compressed;
+            gzipBody.gzip = true;
+            if (makeRequest(batchURL, gzipBody, response)) {
+                compressedBatchCount++;
+                compressedBytesIn += body.length;
+                compressedBytesOut += compressed;
+                return true;
+            }
+            if (lastHttpStatusCode != 415) {
+                return false;
+            }
+            
+            // 415 covers both the encoding and the media type; retry
+            // uncompressed to find out which one the server refused
+            bool success = makeRequest(batchURL, body, response);
+            if (success || lastHttpStatusCode != 415 || !body.cbor) {
+                Serial.println("API Client: Server does not accept gzip bodies, sending uncompressed");
+                gzipAccepted = false;
+            }
+            return success;
+        }
+    }
+    
+    return makeRequest(batchURL, body, response);
+}
+
+void WellPumpAPIClient::adjustBatchSize(bool success) {
+    // Additive increase, multiplicative decrease
+    if (success && lastRequestDuration <= BATCH_TARGET_LATENCY) {
+        if (batchSize < MAX_BATCH_SIZE) {
+            batchSize++;
+        }
+    } else {
+        batchSize = max((uint8_t)(batchSize / 2), MIN_BATCH_SIZE);
+    }
+}
+
+void WellPumpAPIClient::setYieldCallback(SinkYieldCallback callback, void* context) {
+    yieldCallback = callback;
+    yieldContext = context;
+}
+
 bool WellPumpAPIClient::flushBuffer() {
     return processBuffer();
 }
@@ -444,7 +918,7 @@ void WellPumpAPIClient::update() {
     unsigned long now = millis();
     
     // Handle retry logic
-    if (!connected && (now - lastRetryTime > getRetryDelay())) {
+    if (!connected && now - lastRetryTime > retryDelay && uplinkReady()) {
         Serial.println("API Client: Attempting reconnection (attempt " + String(retryCount + 1) + ")");
         if (testConnection()) {
             Serial.println("API Client: Reconnected successfully");
@@ -452,21 +926,27 @@ void WellPumpAPIClient::update() {
         } else {
             retryCount++;
             lastRetryTime = now;
+            retryDelay = getRetryDelay();
             if (retryCount <= maxRetries) {
-                Serial.println("API Client: Reconnection failed, will retry in " + String(getRetryDelay()/1000) + " seconds");
+                Serial.println("API Client: Reconnection failed, will retry in " + String(retryDelay/1000) + " seconds");
             }
         }
     }
     
-    // Process buffer periodically even when connected
-    if (connected && bufferedCount > 0) {
+    // Drain the outbox while connected, holding off after a failed drain
+    if (connected && outbox->pendingCount() > 0 && now - lastDrainFailure > RETRY_DELAY) {
         processBuffer();
     }
+    
+    closeIdleConnection();
 }
 
 unsigned long WellPumpAPIClient::getRetryDelay() const {
     unsigned long delay = RETRY_DELAY * (1UL << min(retryCount, (uint16_t)4)); // Exponential backoff
-    return min(delay, MAX_RETRY_DELAY);
+    delay = min(delay, MAX_RETRY_DELAY);
+    // Random point in the upper half, so devices that lost the server at the
+    // same moment don't all come back on the same schedule
+    return delay / 2 + random(delay / 2 + 1);
 }
 
 String WellPumpAPIClient::getConnectionStatus() const {
@@ -474,8 +954,8 @@ String WellPumpAPIClient::getConnectionStatus() const {
         return "Not initialized";
     }
     if (connected) {
-        if (bufferedCount > 0) {
-            return "Connected (buffer: " + String(bufferedCount) + ")";
+        if (outbox->pendingCount() > 0) {
+            return "Connected (buffer: " + String(outbox->pendingCount()) + ")";
         }
         return "Connected";
     }
@@ -0,0 +1,153 @@
+#include "CborWriter.h"
+#include <math.h>
+
+static const uint8_t CBOR_UNSIGNED = 0;
+static const uint8_t CBOR_NEGATIVE = 1;
+static const uint8_t CBOR_TEXT = 3;
+static const uint8_t CBOR_ARRAY_INDEFINITE = 0x9F;
+static const uint8_t CBOR_MAP_INDEFINITE = 0xBF;
+static const uint8_t CBOR_BREAK = 0xFF;
+static const uint8_t CBOR_FALSE = 0xF4;
+static const uint8_t CBOR_TRUE = 0xF5;
+static const uint8_t CBOR_NULL = 0xF6;
+static const uint8_t CBOR_FLOAT32 = 0xFA;
+
+CborWriter::CborWriter(char* buf, size_t size) {
+    buffer = buf;
+    capacity = size;
+    reset();
+}
+
+void CborWriter::reset() {
+    length = 0;
+    overflow = false;
+}
+
+void CborWriter::rewind(size_t position) {
+    if (position > length) return;
+    length = position;
+    overflow = false;
+}
+
+void CborWriter::beginObject() {
+    put(CBOR_MAP_INDEFINITE);
+}
+
+void CborWriter::endObject() {
+    put(CBOR_BREAK);
+}
+
+void CborWriter::beginArray() {
+    put(CBOR_ARRAY_INDEFINITE);
+}
+
+void CborWriter::endArray() {
+    put(CBOR_BREAK);
+}
+
+void CborWriter::key(const char* name) {
+    value(name);
+}
+
+void CborWriter::value(const char* str) {
+    if (!str) {
+        put(CBOR_NULL);
+        return;
+    }
+    
+    size_t textLength = strlen(str);
+    putHead(CBOR_TEXT, textLength);
+    for (size_t i = 0; i < textLength; i++) {
+        put((uint8_t)str[i]);
+    }
+}
+
+void CborWriter::value(float number, uint8_t decimals) {
+    // Same NaN/inf handling as the JSON encoding
+    if (isnan(number) || isinf(number)) {
+        put(CBOR_NULL);
+        return;
+    }
+    
+    uint32_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    put(CBOR_FLOAT32);
+    put((bits >> 24) & 0xFF);
+    put((bits >> 16) & 0xFF);
+    put((bits >> 8) & 0xFF);
+    put(bits & 0xFF);
+}
+
+void CborWriter::value(double number, uint8_t decimals) {
+    value((float)number, decimals);
+}
+
+void CborWriter::value(int number) {
+    putSigned(number);
+}
+
+void CborWriter::value(unsigned int number) {
+    putHead(CBOR_UNSIGNED, number);
+}
+
+void CborWriter::value(long number) {
+    putSigned(number);
+}
+
+void CborWriter::value(unsigned long number) {
+    putHead(CBOR_UNSIGNED, number);
+}
+
+void CborWriter::value(unsigned long long number) {
+    putHead(CBOR_UNSIGNED, number);
+}
+
+void CborWriter::value(bool flag) {
+    put(flag ? CBOR_TRUE : CBOR_FALSE);
+}
+
+void CborWriter::nullValue() {
+    put(CBOR_NULL);
+}
+
+void CborWriter::put(uint8_t byte) {
+    if (length >= capacity) {
+        overflow = true;
+        return;
+    }
+    buffer[length++] = (char)byte;
+}
+
+void CborWriter::putHead(uint8_t majorType, unsigned long long argument) {
+    // Shortest form: inline below 24, then 1, 2, 4 or 8 argument bytes
+    uint8_t major = majorType << 5;
+    if (argument < 24) {
+        put(major | (uint8_t)argument);
+    } else if (argument <= 0xFF) {
+        put(major | 24);
+        put((uint8_t)argument);
+    } else if (argument <= 0xFFFF) {
+        put(major | 25);
+        put((argument >> 8) & 0xFF);
+        put(argument & 0xFF);
+    } else if (argument <= 0xFFFFFFFFULL) {
+        put(major | 26);
+        for (int8_t shift = 24; shift >= 0; shift -= 8) {
+            put((argument >> shift) & 0xFF);
+        }
+    } else {
+        put(major | 27);
+        for (int8_t shift = 56; shift >= 0; shift -= 8) {
+            put((argument >> shift) & 0xFF);
+        }
+    }
+}
+
+void CborWriter::putSigned(long long number) {
+    if (number < 0) {
+        // Negative integers encode -1 - n
+        putHead(CBOR_NEGATIVE, (unsigned long long)(-1 - number));
+    } else {
+        putHead(CBOR_UNSIGNED, (unsigned long long)number);
+    }
+}
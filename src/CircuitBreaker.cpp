@@ -0,0 +1,134 @@
+#include "CircuitBreaker.h"
+
+CircuitBreaker::CircuitBreaker(unsigned long slowCall) {
+    slowCallMs = slowCall;
+    tripCount = 0;
+    heldCount = 0;
+    reset();
+}
+
+void CircuitBreaker::reset() {
+    state = BREAKER_CLOSED;
+    outcomes = 0;
+    samples = 0;
+    reopenCount = 0;
+    openedAt = 0;
+    openDuration = 0;
+    probeInFlight = false;
+}
+
+bool CircuitBreaker::allowRequest() {
+    if (!wouldAllow()) {
+        heldCount++;
+        return false;
+    }
+    
+    if (state != BREAKER_CLOSED) {
+        state = BREAKER_HALF_OPEN;
+        probeInFlight = true;
+        Serial.println("Breaker: Half-open, sending a probe request");
+    }
+    return true;
+}
+
+bool CircuitBreaker::wouldAllow() const {
+    switch (state) {
+        case BREAKER_CLOSED:
+            return true;
+        case BREAKER_OPEN:
+            return millis() - openedAt >= openDuration;
+        case BREAKER_HALF_OPEN:
+            return !probeInFlight;
+    }
+    return false;
+}
+
+void CircuitBreaker::record(bool failed, unsigned long durationMs) {
+    bool bad = failed || durationMs > slowCallMs;
+    
+    if (state == BREAKER_HALF_OPEN) {
+        probeInFlight = false;
+        if (bad) {
+            reopenCount++;
+            open(jitteredOpenTime());
+            Serial.printf("Breaker: Probe failed, open for %lu s\n", openDuration / 1000);
+        } else {
+            close();
+        }
+        return;
+    }
+    if (state == BREAKER_OPEN) {
+        return; // Request admitted before a holdOff(); the probe decides
+    }
+    
+    outcomes = (outcomes << 1) | (bad ? 1 : 0);
+    if (samples < WINDOW_SIZE) {
+        samples++;
+    }
+    
+    if (samples >= MIN_SAMPLES && badCount() * 100 >= FAILURE_PERCENT * samples) {
+        tripCount++;
+        open(jitteredOpenTime());
+        Serial.printf("Breaker: %u%% of the last %u requests failed or were slow, open for %lu s\n",
+                      getFailurePercent(), samples, openDuration / 1000);
+    }
+}
+
+void CircuitBreaker::holdOff(unsigned long ms) {
+    // Spread the retry over an extra half of the requested pause; a server
+    // sending everyone the same Retry-After would otherwise get them back at once
+    unsigned long pause = min(ms + (unsigned long)random(ms / 2 + 1), MAX_OPEN_TIME);
+    if (state == BREAKER_OPEN && millis() - openedAt + pause <= openDuration) {
+        return; // Already holding at least that long
+    }
+    if (state == BREAKER_CLOSED) {
+        tripCount++;
+    }
+    probeInFlight = false;
+    open(pause);
+    Serial.printf("Breaker: Server asked for a pause, open for %lu s\n", openDuration / 1000);
+}
+
+void CircuitBreaker::open(unsigned long duration) {
+    state = BREAKER_OPEN;
+    openedAt = millis();
+    openDuration = duration;
+}
+
+void CircuitBreaker::close() {
+    Serial.println("Breaker: Probe succeeded, closed");
+    state = BREAKER_CLOSED;
+    outcomes = 0;
+    samples = 0;
+    reopenCount = 0;
+}
+
+unsigned long CircuitBreaker::jitteredOpenTime() const {
+    unsigned long base = BASE_OPEN_TIME << min(reopenCount, (uint8_t)5);
+    base = min(base, MAX_OPEN_TIME);
+    return base / 2 + random(base / 2 + 1);
+}
+
+uint8_t CircuitBreaker::badCount() const {
+    uint32_t window = samples < 32 ? outcomes & ((1UL << samples) - 1) : outcomes;
+    return __builtin_popcount(window);
+}
+
+const char* CircuitBreaker::getStateName() const {
+    switch (state) {
+        case BREAKER_CLOSED: return "closed";
+        case BREAKER_OPEN: return "open";
+        case BREAKER_HALF_OPEN: return "half-open";
+    }
+    return "unknown";
+}
+
+uint8_t CircuitBreaker::getFailurePercent() const {
+    return samples ? badCount() * 100 / samples : 0;
+}
+
+unsigned long CircuitBreaker::getRetryIn() const {
+    if (state != BREAKER_OPEN) return 0;
+    unsigned long elapsed = millis() - openedAt;
+    return elapsed < openDuration ? openDuration - elapsed : 0;
+}
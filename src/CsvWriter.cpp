@@ -0,0 +1,121 @@
+#include "CsvWriter.h"
+#include "JsonWriter.h"
+
+CsvWriter::CsvWriter(char* buf, size_t size, bool headerLine) {
+    buffer = buf;
+    capacity = size;
+    header = headerLine;
+    reset();
+}
+
+void CsvWriter::reset() {
+    length = 0;
+    overflow = false;
+    hasItems = false;
+    if (capacity > 0) {
+        buffer[0] = '\0';
+    }
+}
+
+void CsvWriter::key(const char* name) {
+    if (header) {
+        cell(name, true);
+    }
+}
+
+void CsvWriter::value(const char* str) {
+    if (!header) {
+        cell(str ? str : "", true);
+    }
+}
+
+// Numbers are formatted as JsonWriter does them
+template <typename T>
+static const char* formatNumber(char* out, size_t size, T number) {
+    JsonWriter writer(out, size);
+    writer.value(number);
+    return out;
+}
+
+static const char* formatNumber(char* out, size_t size, double number, uint8_t decimals) {
+    JsonWriter writer(out, size);
+    writer.value(number, decimals);
+    return out;
+}
+
+void CsvWriter::value(float number, uint8_t decimals) {
+    value((double)number, decimals);
+}
+
+void CsvWriter::value(double number, uint8_t decimals) {
+    char text[32];
+    numberCell(formatNumber(text, sizeof(text), number, decimals));
+}
+
+void CsvWriter::value(int number) {
+    char text[32];
+    numberCell(formatNumber(text, sizeof(text), number));
+}
+
+void CsvWriter::value(unsigned int number) {
+    char text[32];
+    numberCell(formatNumber(text, sizeof(text), number));
+}
+
+void CsvWriter::value(long number) {
+    char text[32];
+    numberCell(formatNumber(text, sizeof(text), number));
+}
+
+void CsvWriter::value(unsigned long number) {
+    char text[32];
+    numberCell(formatNumber(text, sizeof(text), number));
+}
+
+void CsvWriter::value(unsigned long long number) {
+    char text[32];
+    numberCell(formatNumber(text, sizeof(text), number));
+}
+
+void CsvWriter::value(bool flag) {
+    numberCell(flag ? "true" : "false");
+}
+
+void CsvWriter::numberCell(const char* text) {
+    // JSON's null (NaN, infinity) is an empty cell
+    if (!header) {
+        cell(strcmp(text, "null") == 0 ? "" : text, false);
+    }
+}
+
+void CsvWriter::nullValue() {
+    if (!header) {
+        cell("", false);
+    }
+}
+
+void CsvWriter::cell(const char* text, bool quoteIfNeeded) {
+    if (hasItems) {
+        put(',');
+    }
+    hasItems = true;
+    
+    // RFC 4180: quote cells holding a separator, quote or line break and
+    // double the quotes inside
+    bool quote = quoteIfNeeded && strpbrk(text, ",\"\r\n") != nullptr;
+    if (quote) put('"');
+    for (const char* p = text; *p; p++) {
+        if (quote && *p == '"') put('"');
+        put(*p);
+    }
+    if (quote) put('"');
+}
+
+void CsvWriter::put(char c) {
+    if (length + 1 >= capacity) {
+        overflow = true;
+        return;
+    }
+    buffer[length++] = c;
+    buffer[length] = '\0';
+}
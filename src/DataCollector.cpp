@@ -21,6 +21,9 @@ DataCollector::DataCollector(SensorManager* sensorMgr) {
     currentThreshold1 = 0.5;
     currentThreshold2 = 0.5;
     
+    sampleSubscriberCount = 0;
+    memset(sampleSubscribers, 0, sizeof(sampleSubscribers));
+    
     memset(&currentData, 0, sizeof(currentData));
     memset(&lastAggregated, 0, sizeof(lastAggregated));
 }
@@ -151,14 +154,22 @@ bool DataCollector::getAggregatedData(AggregatedData& data) {
     return false;
 }
 
-void DataCollector::clearAggregatedData() {
-    if (!running) return;
+bool DataCollector::takeAggregatedData(AggregatedData& data) {
+    if (!running) return false;
     
+    // Under one lock: an aggregate published between a separate read and
+    // clear would otherwise be wiped without ever being sent
     if (xSemaphoreTake(dataMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        memset(&lastAggregated, 0, sizeof(lastAggregated));
+        data = lastAggregated;
+        bool hasValidData = (data.sampleCount > 0);
+        if (hasValidData) {
+            memset(&lastAggregated, 0, sizeof(lastAggregated));
+        }
         xSemaphoreGive(dataMutex);
-        Serial.println("DataCollector: Aggregated data cleared after successful send");
+        return hasValidData;
     }
+    
+    return false;
 }
 
 void DataCollector::setCurrentThresholds(float threshold1, float threshold2) {
@@ -166,6 +177,17 @@ void DataCollector::setCurrentThresholds(float threshold1, float threshold2) {
     currentThreshold2 = threshold2;
 }
 
+bool DataCollector::addSampleSubscriber(SampleCallback callback, void* context) {
+    if (callback == nullptr || sampleSubscriberCount >= MAX_SAMPLE_SUBSCRIBERS) {
+        return false;
+    }
+    
+    sampleSubscribers[sampleSubscriberCount].callback = callback;
+    sampleSubscribers[sampleSubscriberCount].context = context;
+    sampleSubscriberCount++;
+    return true;
+}
+
 uint16_t DataCollector::getQueueSize() const {
     if (dataQueue == NULL) return 0;
     return uxQueueMessagesWaiting(dataQueue);
@@ -289,6 +311,8 @@ void DataCollector::collectSensorData() {
     // Allow sample to be valid even if temp/humidity fail occasionally
     // The main issue is that we need current sensors working for aggregation
     data.valid = pressOk && current1Ok && current2Ok;
+    data.sampleTime = millis();
+    data.sampleMicros = micros();
     
     if (xSemaphoreTake(dataMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
         currentData = data;
@@ -301,6 +325,14 @@ void DataCollector::collectSensorData() {
             Serial.println("Data queue full, dropping sample");
         }
     }
+    
+    publishSample(data);
+}
+
+void DataCollector::publishSample(const SensorData& data) {
+    for (uint8_t i = 0; i < sampleSubscriberCount; i++) {
+        sampleSubscribers[i].callback(data, sampleSubscribers[i].context);
+    }
 }
 
 void DataCollector::processQueueData() {
@@ -0,0 +1,231 @@
+#include "Deflater.h"
+#include <rom/crc.h>
+
+// RFC 1951 3.2.5: length codes 257-285 and distance codes 0-29
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+Deflater::Deflater() {
+    head = new uint16_t[HASH_SIZE];
+    prev = new uint16_t[WINDOW_SIZE];
+    output = nullptr;
+    capacity = 0;
+    length = 0;
+    overflow = false;
+    bitBuffer = 0;
+    bitCount = 0;
+}
+
+Deflater::~Deflater() {
+    if (head) {
+        delete[] head;
+        head = nullptr;
+    }
+    if (prev) {
+        delete[] prev;
+        prev = nullptr;
+    }
+}
+
+size_t Deflater::gzip(const uint8_t* input, size_t inputLength, uint8_t* out, size_t outSize) {
+    if (!head || !prev || inputLength > MAX_INPUT) {
+        return 0;
+    }
+    
+    output = out;
+    capacity = outSize;
+    length = 0;
+    overflow = false;
+    bitBuffer = 0;
+    bitCount = 0;
+    
+    // Header: magic, CM=deflate, no flags, no mtime, XFL=0, OS=unknown
+    static const uint8_t GZIP_HEADER[10] = { 0x1F, 0x8B, 0x08, 0x00, 0, 0, 0, 0, 0x00, 0xFF };
+    for (uint8_t i = 0; i < sizeof(GZIP_HEADER); i++) {
+        putByte(GZIP_HEADER[i]);
+    }
+    
+    deflate(input, inputLength);
+    
+    putLE32(crc32_le(0, input, inputLength));
+    putLE32(inputLength);
+    
+    return overflow ? 0 : length;
+}
+
+void Deflater::deflate(const uint8_t* input, size_t inputLength) {
+    for (uint16_t i = 0; i < HASH_SIZE; i++) {
+        head[i] = NO_POSITION;
+    }
+    
+    // One final block with the fixed Huffman tables (BFINAL=1, BTYPE=01):
+    // no code tables to send, which suits bodies of a few kilobytes
+    putBits(1, 1);
+    putBits(1, 2);
+    
+    size_t position = 0;
+    while (position < inputLength && !overflow) {
+        uint16_t distance = 0;
+        uint16_t matchLength = longestMatch(input, inputLength, position, distance);
+        insertPosition(input, inputLength, position);
+        
+        // Lazy evaluation: prefer a longer match starting one byte later
+        while (matchLength >= MIN_MATCH && matchLength < MAX_MATCH && position + 1 < inputLength) {
+            uint16_t nextDistance = 0;
+            uint16_t nextLength = longestMatch(input, inputLength, position + 1, nextDistance);
+            if (nextLength <= matchLength) break;
+            putLiteral(input[position]);
+            position++;
+            insertPosition(input, inputLength, position);
+            matchLength = nextLength;
+            distance = nextDistance;
+        }
+        
+        if (matchLength >= MIN_MATCH) {
+            putMatch(matchLength, distance);
+            for (uint16_t i = 1; i < matchLength; i++) {
+                insertPosition(input, inputLength, position + i);
+            }
+            position += matchLength;
+        } else {
+            putLiteral(input[position]);
+            position++;
+        }
+    }
+    
+    putCode(0, 7); // End of block (256)
+    flushBits();
+}
+
+static inline uint16_t hashBytes(const uint8_t* p, uint8_t bits) {
+    uint32_t key = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (uint32_t)(key * 2654435761U) >> (32 - bits);
+}
+
+void Deflater::insertPosition(const uint8_t* input, size_t inputLength, size_t position) {
+    if (position + MIN_MATCH > inputLength) return;
+    uint16_t hash = hashBytes(input + position, HASH_BITS);
+    prev[position & WINDOW_MASK] = head[hash];
+    head[hash] = position;
+}
+
+uint16_t Deflater::longestMatch(const uint8_t* input, size_t inputLength, size_t position, uint16_t& distance) {
+    if (position + MIN_MATCH > inputLength) {
+        return 0;
+    }
+    
+    size_t available = inputLength - position;
+    uint16_t limit = available < MAX_MATCH ? available : MAX_MATCH;
+    uint16_t best = 0;
+    
+    uint16_t candidate = head[hashBytes(input + position, HASH_BITS)];
+    for (uint8_t chain = 0; chain < MAX_CHAIN && candidate != NO_POSITION; chain++) {
+        if (candidate >= position || position - candidate > WINDOW_SIZE) break;
+        
+        const uint8_t* a = input + candidate;
+        const uint8_t* b = input + position;
+        // Cheap reject: a longer match must also agree at the current best length
+        if (a[best] == b[best] && a[0] == b[0]) {
+            uint16_t matched = 0;
+            while (matched < limit && a[matched] == b[matched]) {
+                matched++;
+            }
+            if (matched > best) {
+                best = matched;
+                distance = position - candidate;
+                if (best == limit) break;
+            }
+        }
+        
+        uint16_t next = prev[candidate & WINDOW_MASK];
+        if (next == NO_POSITION || next >= candidate) break;
+        candidate = next;
+    }
+    
+    return best >= MIN_MATCH ? best : 0;
+}
+
+void Deflater::putLiteral(uint8_t byte) {
+    if (byte < 144) {
+        putCode(0x30 + byte, 8);
+    } else {
+        putCode(0x190 + (byte - 144), 9);
+    }
+}
+
+void Deflater::putMatch(uint16_t matchLength, uint16_t distance) {
+    uint8_t lengthIndex = 28;
+    while (LENGTH_BASE[lengthIndex] > matchLength) {
+        lengthIndex--;
+    }
+    uint16_t symbol = 257 + lengthIndex;
+    if (symbol < 280) {
+        putCode(symbol - 256, 7);
+    } else {
+        putCode(0xC0 + (symbol - 280), 8);
+    }
+    putBits(matchLength - LENGTH_BASE[lengthIndex], LENGTH_EXTRA[lengthIndex]);
+    
+    uint8_t distanceIndex = 29;
+    while (DISTANCE_BASE[distanceIndex] > distance) {
+        distanceIndex--;
+    }
+    putCode(distanceIndex, 5);
+    putBits(distance - DISTANCE_BASE[distanceIndex], DISTANCE_EXTRA[distanceIndex]);
+}
+
+void Deflater::putCode(uint16_t code, uint8_t bits) {
+    // Huffman codes are packed most significant bit first
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < bits; i++) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    putBits(reversed, bits);
+}
+
+void Deflater::putBits(uint32_t value, uint8_t bits) {
+    bitBuffer |= value << bitCount;
+    bitCount += bits;
+    while (bitCount >= 8) {
+        putByte(bitBuffer & 0xFF);
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+void Deflater::flushBits() {
+    if (bitCount > 0) {
+        putByte(bitBuffer & 0xFF);
+    }
+    bitBuffer = 0;
+    bitCount = 0;
+}
+
+void Deflater::putByte(uint8_t byte) {
+    if (length >= capacity) {
+        overflow = true;
+        return;
+    }
+    output[length++] = byte;
+}
+
+void Deflater::putLE32(uint32_t value) {
+    for (uint8_t i = 0; i < 4; i++) {
+        putByte((value >> (8 * i)) & 0xFF);
+    }
+}
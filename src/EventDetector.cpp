@@ -1,4 +1,124 @@
 #include "EventDetector.h"
+#include <esp_system.h>
+#include <rom/crc.h>
+
+// Survives software, watchdog and brownout resets but not power loss;
+// the magic and CRC reject whatever the RAM held at power-on
+struct EventCheckpoint {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t nextSequence;
+    Event activeEvents[EVENT_TYPE_COUNT];
+    float loggedValue[EVENT_TYPE_COUNT];
+    
+    // Log entries no sink has taken yet, oldest first
+    uint8_t unsentCount;
+    Event unsent[EventDetector::EVENT_LOG_SIZE];
+    
+    // Debounce timers as ages, since millis() restarts at boot (0 = not running)
+    unsigned long currentEventAge;
+    unsigned long pressureEventAge;
+    unsigned long temperatureEventAge;
+    unsigned long pressureDecayEventAge;
+    unsigned long lockedRotorEventAge;
+    
+    uint32_t crc;
+};
+
+RTC_NOINIT_ATTR static EventCheckpoint rtcCheckpoint;
+
+static uint32_t checkpointCrc(const EventCheckpoint& checkpoint) {
+    return crc32_le(0, (const uint8_t*)&checkpoint, offsetof(EventCheckpoint, crc));
+}
+
+// Ages are stored off by one so that a running timer never reads as 0
+static unsigned long timerAge(unsigned long timer, unsigned long now) {
+    return timer == 0 ? 0 : (now - timer) + 1;
+}
+
+static unsigned long timerFromAge(unsigned long age, unsigned long now) {
+    if (age == 0) return 0;
+    unsigned long timer = now - (age - 1);
+    return timer == 0 ? 1 : timer;
+}
+
+static const char* const EVENT_DESCRIPTIONS[EVENT_TYPE_COUNT] = {
+    "No event",
+    "High current detected on pump motor",
+    "Low pressure detected in system",
+    "Low temperature detected in pump house",
+    "Sensor communication error detected",
+    "System error",
+    "Pressure decaying while pump idle (possible leak)",
+    "Pump cycle deviates from learned baseline",
+    "Dry run: pump running with no pressure rise",
+    "Locked rotor: high current with no pressure rise"
+};
+
+static const char* const EVENT_NAMES[EVENT_TYPE_COUNT] = {
+    "None",
+    "High Current",
+    "Low Pressure",
+    "Low Temperature",
+    "Sensor Error",
+    "System Error",
+    "Pressure Decay",
+    "Cycle Anomaly",
+    "Dry Run",
+    "Locked Rotor"
+};
+
+// Direction in which each event type gets worse, for escalation tracking
+static const bool EVENT_HIGHER_IS_WORSE[EVENT_TYPE_COUNT] = {
+    true,   // None
+    true,   // High Current
+    false,  // Low Pressure
+    false,  // Low Temperature
+    true,   // Sensor Error
+    true,   // System Error
+    true,   // Pressure Decay
+    true,   // Cycle Anomaly
+    false,  // Dry Run
+    true    // Locked Rotor
+};
+
+// Types that can damage the pump or mean loss of water if left for a minute
+static const bool EVENT_CRITICAL[EVENT_TYPE_COUNT] = {
+    false,  // None
+    true,   // High Current
+    true,   // Low Pressure
+    false,  // Low Temperature
+    false,  // Sensor Error
+    false,  // System Error
+    false,  // Pressure Decay
+    false,  // Cycle Anomaly
+    true,   // Dry Run
+    true    // Locked Rotor
+};
+
+const char* eventDescription(EventType type) {
+    if (type < 0 || type >= EVENT_TYPE_COUNT) return "Unknown event";
+    return EVENT_DESCRIPTIONS[type];
+}
+
+const char* eventTypeName(EventType type) {
+    if (type < 0 || type >= EVENT_TYPE_COUNT) return "Unknown";
+    return EVENT_NAMES[type];
+}
+
+bool isCriticalEvent(EventType type) {
+    if (type < 0 || type >= EVENT_TYPE_COUNT) return false;
+    return EVENT_CRITICAL[type];
+}
+
+const char* eventStateName(EventState state) {
+    switch (state) {
+        case EVENT_STATE_RAISED: return "raised";
+        case EVENT_STATE_UPDATED: return "updated";
+        case EVENT_STATE_CLEARED: return "cleared";
+        default: return "unknown";
+    }
+}
 
 EventDetector::EventDetector(DataCollector* collector) {
     dataCollector = collector;
@@ -11,44 +131,122 @@ EventDetector::EventDetector(DataCollector* collector) {
     currentHysteresis = 1.0;
     temperatureHysteresis = 2.0;
     
+    pressureDecayThreshold = 0.5;
+    pressureDecayHysteresis = 0.25;
+    pressureSlope = new SlopeEstimator(PRESSURE_SLOPE_SIZE, PRESSURE_SLOPE_WINDOW);
+    
+    pumpRunningCurrent = 0.5;
+    cycleAnalyzer = new PumpCycleAnalyzer(pumpRunningCurrent);
+    
+    dryRunCurrent = 0.0;
+    lockedRotorCurrent = 15.0;
+    minPressureRise = 2.0;
+    lockedRotorEventTime = 0;
+    
     currentEventTime = 0;
     pressureEventTime = 0;
     temperatureEventTime = 0;
+    pressureDecayEventTime = 0;
     
     currentEventDuration = 0;
     pressureEventDuration = 0;
     temperatureEventDuration = 0;
     
     eventCount = 0;
-    resolvedEventCount = 0;
-
+    eventLogHead = 0;
+    eventLogCount = 0;
+    nextSequence = 1;
+    firstSequence = 1;
+    deliveredSequence = 0;
+    
     highCurrentActive = false;
     lowPressureActive = false;
     lowTemperatureActive = false;
     sensorErrorActive = false;
-    
-    memset(currentEvents, 0, sizeof(currentEvents));
-    memset(resolvedEvents, 0, sizeof(resolvedEvents));
+    pressureDecayActive = false;
+    cycleAnomalyActive = false;
+    dryRunActive = false;
+    lockedRotorActive = false;
+    
+    eventMutex = NULL;
+    
+    samplesEvaluated = 0;
+    samplesSkipped = 0;
+    lastEvaluationLatencyUs = 0;
+    maxEvaluationLatencyUs = 0;
+    lastDetectionDelayMs = 0;
+    
+    memset(activeEvents, 0, sizeof(activeEvents));
+    memset(eventLog, 0, sizeof(eventLog));
+    memset(loggedValue, 0, sizeof(loggedValue));
 }
 
-void EventDetector::begin() {
-    Serial.println("EventDetector initialized");
+EventDetector::~EventDetector() {
+    delete pressureSlope;
+    delete cycleAnalyzer;
 }
 
-void EventDetector::update() {
-    if (!dataCollector || !dataCollector->isRunning()) {
+void EventDetector::begin() {
+    if (eventMutex == NULL) {
+        eventMutex = xSemaphoreCreateMutex();
+        if (eventMutex == NULL) {
+            Serial.println("EventDetector: Failed to create event mutex");
+            return;
+        }
+    }
+    
+    restoreCheckpoint();
+    
+    if (!dataCollector || !dataCollector->addSampleSubscriber(sampleCallback, this)) {
+        Serial.println("EventDetector: Failed to subscribe to sample stream");
         return;
     }
     
-    SensorData data;
-    if (!dataCollector->getCurrentData(data)) {
+    Serial.println("EventDetector initialized");
+}
+
+void EventDetector::sampleCallback(const SensorData& data, void* context) {
+    static_cast<EventDetector*>(context)->processSample(data);
+}
+
+void EventDetector::processSample(const SensorData& data) {
+    // Readers only copy under the lock, so this should never happen; if it
+    // does, the debounce timers just see a longer gap
+    if (!lock()) {
+        samplesSkipped++;
         return;
     }
     
-    checkHighCurrent(data);
-    checkLowPressure(data);
-    checkLowTemperature(data);
     checkSensorHealth(data);
+    
+    // Threshold checks only make sense on samples the sensors vouched for
+    if (data.valid) {
+        checkHighCurrent(data);
+        checkLowPressure(data);
+        checkLowTemperature(data);
+        checkPressureDecay(data);
+        checkPumpCycle(data);
+        checkRunResponse(data);
+    }
+    
+    samplesEvaluated++;
+    lastEvaluationLatencyUs = micros() - data.sampleMicros;
+    if (lastEvaluationLatencyUs > maxEvaluationLatencyUs) {
+        maxEvaluationLatencyUs = lastEvaluationLatencyUs;
+    }
+    
+    saveCheckpoint(data.sampleTime);
+    
+    unlock();
+}
+
+bool EventDetector::lock() const {
+    if (eventMutex == NULL) return false;
+    return xSemaphoreTake(eventMutex, pdMS_TO_TICKS(100)) == pdTRUE;
+}
+
+void EventDetector::unlock() const {
+    xSemaphoreGive(eventMutex);
 }
 
 void EventDetector::setThresholds(float highCurrent, float lowPressure, float lowTemp) {
@@ -63,22 +261,116 @@ void EventDetector::setHysteresis(float pressureHyst, float currentHyst, float t
     temperatureHysteresis = tempHyst;
 }
 
+void EventDetector::setLeakDetection(float decayRate, float decayHyst) {
+    pressureDecayThreshold = decayRate;
+    pressureDecayHysteresis = decayHyst;
+}
+
+void EventDetector::setPumpRunningCurrent(float current) {
+    pumpRunningCurrent = current;
+    cycleAnalyzer->setRunningCurrent(current);
+}
+
+void EventDetector::setCycleAnomalyThreshold(float score) {
+    cycleAnalyzer->setScoreThreshold(score);
+}
+
+void EventDetector::setRunResponse(float dryRunAmps, float lockedRotorAmps, float pressureRise) {
+    dryRunCurrent = dryRunAmps;
+    lockedRotorCurrent = lockedRotorAmps;
+    minPressureRise = pressureRise;
+}
+
+bool EventDetector::getCycleStats(CycleStats& stats) const {
+    if (!lock()) return false;
+    cycleAnalyzer->getStats(stats);
+    unlock();
+    return true;
+}
+
+float EventDetector::getPressureDecayRate() const {
+    if (!lock()) return 0.0;
+    // Only the rate the detector acts on; a short window is mostly noise
+    bool settled = pressureSlope->hasSlope() && pressureSlope->getSpan() >= PRESSURE_SLOPE_MIN_SPAN;
+    float rate = settled ? -pressureSlope->getSlopePerMinute() : 0.0;
+    unlock();
+    return rate;
+}
+
 bool EventDetector::hasActiveEvents() const {
-    for (uint8_t i = 0; i < eventCount; i++) {
-        if (currentEvents[i].active) {
-            return true;
+    return eventCount > 0;
+}
+
+uint8_t EventDetector::forEachActiveEvent(EventVisitor visitor, void* context) const {
+    if (!lock()) return 0;
+    
+    uint8_t visited = 0;
+    for (uint8_t type = 0; type < EVENT_TYPE_COUNT; type++) {
+        if (activeEvents[type].active) {
+            visitor(activeEvents[type], context);
+            visited++;
         }
     }
-    return false;
+    
+    unlock();
+    return visited;
+}
+
+uint32_t EventDetector::forEachEventSince(uint32_t afterSequence, EventVisitor visitor, void* context,
+                                          uint32_t* lost) const {
+    if (!lock()) return afterSequence;
+    
+    uint8_t available;
+    uint32_t overwritten;
+    uint8_t index = firstLogIndexAfter(afterSequence, available, overwritten);
+    if (lost) {
+        *lost = overwritten;
+    }
+    uint32_t lastSequence = afterSequence;
+    for (uint8_t i = 0; i < available; i++) {
+        const Event& event = eventLog[(index + i) % EVENT_LOG_SIZE];
+        visitor(event, context);
+        lastSequence = event.sequence;
+    }
+    
+    unlock();
+    return lastSequence;
+}
+
+void EventDetector::setDeliveredSequence(uint32_t sequence) {
+    if (!lock()) return;
+    deliveredSequence = sequence;
+    unlock();
+}
+
+uint8_t EventDetector::copyActiveEvents(Event* out, uint8_t maxEvents) const {
+    if (!lock()) return 0;
+    
+    uint8_t copied = 0;
+    for (uint8_t type = 0; type < EVENT_TYPE_COUNT && copied < maxEvents; type++) {
+        if (activeEvents[type].active) {
+            out[copied++] = activeEvents[type];
+        }
+    }
+    
+    unlock();
+    return copied;
 }
 
-Event EventDetector::getEvent(uint8_t index) const {
-    if (index < eventCount) {
-        return currentEvents[index];
+uint8_t EventDetector::copyEventsSince(uint32_t afterSequence, Event* out, uint8_t maxEvents) const {
+    if (!lock()) return 0;
+    
+    uint8_t available;
+    uint32_t overwritten;
+    uint8_t index = firstLogIndexAfter(afterSequence, available, overwritten);
+    uint8_t copied = 0;
+    while (copied < available && copied < maxEvents) {
+        out[copied] = eventLog[(index + copied) % EVENT_LOG_SIZE];
+        copied++;
     }
-    Event empty;
-    memset(&empty, 0, sizeof(empty));
-    return empty;
+    
+    unlock();
+    return copied;
 }
 
 String EventDetector::getStatusString() const {
@@ -113,19 +405,47 @@ String EventDetector::getStatusString() const {
         first = false;
     }
     
+    if (pressureDecayActive) {
+        if (!first) status += ", ";
+        status += "Pressure Decay";
+        first = false;
+    }
+    
+    if (cycleAnomalyActive) {
+        if (!first) status += ", ";
+        status += "Cycle Anomaly";
+        first = false;
+    }
+    
+    if (dryRunActive) {
+        if (!first) status += ", ";
+        status += "Dry Run";
+        first = false;
+    }
+    
+    if (lockedRotorActive) {
+        if (!first) status += ", ";
+        status += "Locked Rotor";
+        first = false;
+    }
+    
     return status;
 }
 
 String EventDetector::getEventSummary() const {
+    // Built from a copy, so the String work happens outside the lock
+    Event active[EVENT_TYPE_COUNT];
+    uint8_t count = copyActiveEvents(active, EVENT_TYPE_COUNT);
+    
     String summary = "Events: ";
-    summary += eventCount;
+    summary += count;
     summary += " active";
     
-    if (eventCount > 0) {
+    if (count > 0) {
         summary += " (";
-        for (uint8_t i = 0; i < eventCount; i++) {
+        for (uint8_t i = 0; i < count; i++) {
             if (i > 0) summary += ", ";
-            summary += eventTypeToString(currentEvents[i].type);
+            summary += eventTypeName(active[i].type);
         }
         summary += ")";
     }
@@ -134,7 +454,7 @@ String EventDetector::getEventSummary() const {
 }
 
 void EventDetector::checkHighCurrent(const SensorData& data) {
-    unsigned long now = millis();
+    unsigned long now = data.sampleTime;
     
     float maxCurrent = max(data.current1, data.current2);
     bool currentHigh = maxCurrent > highCurrentThreshold;
@@ -145,8 +465,8 @@ void EventDetector::checkHighCurrent(const SensorData& data) {
         } else if (now - currentEventTime >= CURRENT_EVENT_DELAY) {
             highCurrentActive = true;
             currentEventDuration = now - currentEventTime;
-            addEvent(EVENT_HIGH_CURRENT, maxCurrent, highCurrentThreshold, 
-                    "High current detected on pump motor");
+            lastDetectionDelayMs = currentEventDuration;
+            addEvent(EVENT_HIGH_CURRENT, maxCurrent, highCurrentThreshold, data.timestamp);
             Serial.printf("HIGH CURRENT EVENT: %.2fA (threshold: %.2fA)\n", 
                          maxCurrent, highCurrentThreshold);
         }
@@ -167,7 +487,7 @@ void EventDetector::checkHighCurrent(const SensorData& data) {
 }
 
 void EventDetector::checkLowPressure(const SensorData& data) {
-    unsigned long now = millis();
+    unsigned long now = data.sampleTime;
     
     bool pressureLow = data.pressure < lowPressureThreshold;
     
@@ -177,8 +497,8 @@ void EventDetector::checkLowPressure(const SensorData& data) {
         } else if (now - pressureEventTime >= PRESSURE_EVENT_DELAY) {
             lowPressureActive = true;
             pressureEventDuration = now - pressureEventTime;
-            addEvent(EVENT_LOW_PRESSURE, data.pressure, lowPressureThreshold, 
-                    "Low pressure detected in system");
+            lastDetectionDelayMs = pressureEventDuration;
+            addEvent(EVENT_LOW_PRESSURE, data.pressure, lowPressureThreshold, data.timestamp);
             Serial.printf("LOW PRESSURE EVENT: %.1f PSI (threshold: %.1f PSI)\n", 
                          data.pressure, lowPressureThreshold);
         }
@@ -199,7 +519,7 @@ void EventDetector::checkLowPressure(const SensorData& data) {
 }
 
 void EventDetector::checkLowTemperature(const SensorData& data) {
-    unsigned long now = millis();
+    unsigned long now = data.sampleTime;
     
     bool temperatureLow = data.temperature < lowTemperatureThreshold;
     
@@ -209,8 +529,8 @@ void EventDetector::checkLowTemperature(const SensorData& data) {
         } else if (now - temperatureEventTime >= TEMPERATURE_EVENT_DELAY) {
             lowTemperatureActive = true;
             temperatureEventDuration = now - temperatureEventTime;
-            addEvent(EVENT_LOW_TEMPERATURE, data.temperature, lowTemperatureThreshold, 
-                    "Low temperature detected in pump house");
+            lastDetectionDelayMs = temperatureEventDuration;
+            addEvent(EVENT_LOW_TEMPERATURE, data.temperature, lowTemperatureThreshold, data.timestamp);
             Serial.printf("LOW TEMPERATURE EVENT: %.1f°F (threshold: %.1f°F)\n", 
                          data.temperature, lowTemperatureThreshold);
         }
@@ -235,7 +555,7 @@ void EventDetector::checkSensorHealth(const SensorData& data) {
     
     if (sensorError && !sensorErrorActive) {
         sensorErrorActive = true;
-        addEvent(EVENT_SENSOR_ERROR, 0, 0, "Sensor communication error detected");
+        addEvent(EVENT_SENSOR_ERROR, 0, 0, data.timestamp);
         Serial.println("SENSOR ERROR EVENT");
     } else if (!sensorError && sensorErrorActive) {
         sensorErrorActive = false;
@@ -244,95 +564,305 @@ void EventDetector::checkSensorHealth(const SensorData& data) {
     }
 }
 
-extern unsigned long getCurrentTimestamp();
-
-void EventDetector::addEvent(EventType type, float value, float threshold, const String& description) {
-    if (eventCount >= 10) {
-        removeEvent(0);
-    }
+void EventDetector::checkPressureDecay(const SensorData& data) {
+    unsigned long now = data.sampleTime;
     
-    Event& event = currentEvents[eventCount];
-    event.type = type;
-    event.value = value;
-    event.threshold = threshold;
+    float maxCurrent = max(data.current1, data.current2);
+    if (maxCurrent >= pumpRunningCurrent) {
+        // A running pump masks any leak; start a fresh window once it stops.
+        // An active decay event stays up until an idle window shows recovery.
+        pressureSlope->reset();
+        if (!pressureDecayActive) {
+            pressureDecayEventTime = 0;
+        }
+        return;
+    }
     
-    // Use real timestamp if available, otherwise fall back to millis()
-    unsigned long timestamp = getCurrentTimestamp();
-    event.startTime = (timestamp > 0) ? timestamp : millis();
+    pressureSlope->addSample(now, data.pressure);
+    if (!pressureSlope->hasSlope() || pressureSlope->getSpan() < PRESSURE_SLOPE_MIN_SPAN) {
+        return;
+    }
     
-    // Debug timestamp usage
-    Serial.printf("Event timestamp: NTP=%lu, Final=%lu, Type=%d\n", 
-                  timestamp, event.startTime, (int)type);
+    float decayRate = -pressureSlope->getSlopePerMinute();
+    bool decaying = decayRate > pressureDecayThreshold;
+    
+    if (decaying && !pressureDecayActive) {
+        if (pressureDecayEventTime == 0) {
+            pressureDecayEventTime = now;
+        } else if (now - pressureDecayEventTime >= PRESSURE_DECAY_EVENT_DELAY) {
+            pressureDecayActive = true;
+            lastDetectionDelayMs = now - pressureDecayEventTime;
+            addEvent(EVENT_PRESSURE_DECAY, decayRate, pressureDecayThreshold, data.timestamp);
+            Serial.printf("PRESSURE DECAY EVENT: %.2f PSI/min (threshold: %.2f PSI/min)\n",
+                         decayRate, pressureDecayThreshold);
+        }
+    } else if (!decaying && pressureDecayActive) {
+        if (decayRate < (pressureDecayThreshold - pressureDecayHysteresis)) {
+            pressureDecayActive = false;
+            pressureDecayEventTime = 0;
+            clearEvent(EVENT_PRESSURE_DECAY);
+            Serial.println("Pressure decay event cleared");
+        }
+    } else if (!decaying) {
+        pressureDecayEventTime = 0;
+    }
     
-    event.duration = 0;
-    event.active = true;
-    event.description = description;
+    if (pressureDecayActive) {
+        updateEvent(EVENT_PRESSURE_DECAY, decayRate, now - pressureDecayEventTime);
+    }
+}
+
+void EventDetector::checkPumpCycle(const SensorData& data) {
+    if (!cycleAnalyzer->processSample(data)) {
+        return;
+    }
     
-    eventCount++;
+    // Evaluated once per completed cycle; the next normal cycle clears it
+    float score = cycleAnalyzer->getLastScore();
+    bool anomalous = cycleAnalyzer->isLastCycleAnomalous();
+    
+    if (anomalous && !cycleAnomalyActive) {
+        cycleAnomalyActive = true;
+        addEvent(EVENT_CYCLE_ANOMALY, score, cycleAnalyzer->getScoreThreshold(), data.timestamp);
+        Serial.printf("CYCLE ANOMALY EVENT: score %.2f (threshold: %.2f)\n",
+                     score, cycleAnalyzer->getScoreThreshold());
+    } else if (!anomalous && cycleAnomalyActive) {
+        cycleAnomalyActive = false;
+        clearEvent(EVENT_CYCLE_ANOMALY);
+        Serial.println("Cycle anomaly event cleared");
+    } else if (anomalous) {
+        updateEvent(EVENT_CYCLE_ANOMALY, score, 0);
+    }
 }
 
-void EventDetector::clearEvent(EventType type) {
-    int index = findEventIndex(type);
-    if (index >= 0) {
-        // Queue for sending as resolved before removing
-        if (resolvedEventCount < 10) {
-            resolvedEvents[resolvedEventCount] = currentEvents[index];
-            resolvedEvents[resolvedEventCount].active = false;
-            resolvedEventCount++;
+void EventDetector::checkRunResponse(const SensorData& data) {
+    unsigned long now = data.sampleTime;
+    
+    if (!cycleAnalyzer->isRunning()) {
+        // Both faults end when the motor stops drawing current
+        if (dryRunActive) {
+            dryRunActive = false;
+            clearEvent(EVENT_DRY_RUN);
+            Serial.println("Dry run event cleared");
+        }
+        if (lockedRotorActive) {
+            lockedRotorActive = false;
+            clearEvent(EVENT_LOCKED_ROTOR);
+            Serial.println("Locked rotor event cleared");
         }
-        removeEvent(index);
+        lockedRotorEventTime = 0;
+        return;
+    }
+    
+    unsigned long runTime = now - cycleAnalyzer->getRunStartTime();
+    float current = max(data.current1, data.current2);
+    float pressureRise = data.pressure - cycleAnalyzer->getRunStartPressure();
+    bool noPressureRise = pressureRise < minPressureRise;
+    
+    float dryRunLimit = dryRunCurrent;
+    float lockedRotorLimit = lockedRotorCurrent;
+    if (cycleAnalyzer->isBaselineReady()) {
+        float steady = cycleAnalyzer->getBaselineSteadyCurrent();
+        dryRunLimit = steady * DRY_RUN_BASELINE_RATIO;
+        lockedRotorLimit = steady * LOCKED_ROTOR_BASELINE_RATIO;
+    }
+    
+    // Locked rotor: inrush-level current that doesn't decay and moves no water
+    if (runTime > PumpCycleAnalyzer::INRUSH_WINDOW && current >= lockedRotorLimit && noPressureRise) {
+        if (lockedRotorEventTime == 0) {
+            lockedRotorEventTime = now;
+        } else if (!lockedRotorActive && now - lockedRotorEventTime >= LOCKED_ROTOR_DELAY) {
+            lockedRotorActive = true;
+            lastDetectionDelayMs = runTime;
+            addEvent(EVENT_LOCKED_ROTOR, current, lockedRotorLimit, data.timestamp);
+            Serial.printf("LOCKED ROTOR EVENT: %.2fA, pressure rise %.1f PSI after %lums\n",
+                         current, pressureRise, runTime);
+        }
+    } else if (!lockedRotorActive) {
+        lockedRotorEventTime = 0;
+    }
+    
+    // Dry run: motor turning freely (low current) without building pressure.
+    // Both halves are needed: heavy demand holds pressure flat at normal
+    // current, so with no current bound yet (no configured limit, baseline
+    // still learning) it isn't checked. Nor is a run that was already going
+    // at boot, whose "start" pressure may be near cut-out.
+    if (!dryRunActive && !lockedRotorActive && runTime >= DRY_RUN_WINDOW && dryRunLimit > 0.0 &&
+        cycleAnalyzer->isRunStartObserved() && noPressureRise && current < dryRunLimit) {
+        dryRunActive = true;
+        lastDetectionDelayMs = runTime;
+        addEvent(EVENT_DRY_RUN, current, dryRunLimit, data.timestamp);
+        Serial.printf("DRY RUN EVENT: %.2fA, pressure rise %.1f PSI after %lums\n",
+                     current, pressureRise, runTime);
+    }
+    
+    if (lockedRotorActive) {
+        updateEvent(EVENT_LOCKED_ROTOR, current, now - lockedRotorEventTime);
+    }
+    if (dryRunActive) {
+        updateEvent(EVENT_DRY_RUN, current, runTime);
     }
 }
 
-Event EventDetector::getResolvedEvent(uint8_t index) const {
-    if (index < resolvedEventCount) {
-        return resolvedEvents[index];
+void EventDetector::addEvent(EventType type, float value, float threshold, unsigned long startTime) {
+    Event& event = activeEvents[type];
+    if (!event.active) {
+        eventCount++;
     }
-    Event empty;
-    memset(&empty, 0, sizeof(empty));
-    return empty;
+    
+    event.type = type;
+    event.value = value;
+    event.threshold = threshold;
+    event.startTime = startTime;
+    event.duration = 0;
+    event.active = true;
+    
+    logTransition(event, EVENT_STATE_RAISED);
 }
 
-void EventDetector::clearResolvedEvents() {
-    resolvedEventCount = 0;
-    memset(resolvedEvents, 0, sizeof(resolvedEvents));
+void EventDetector::clearEvent(EventType type) {
+    Event& event = activeEvents[type];
+    if (!event.active) return;
+    
+    event.active = false;
+    eventCount--;
+    
+    // The cleared record stays in the log for the uplink to pick up
+    logTransition(event, EVENT_STATE_CLEARED);
 }
 
 void EventDetector::updateEvent(EventType type, float value, unsigned long duration) {
-    int index = findEventIndex(type);
-    if (index >= 0) {
-        currentEvents[index].value = value;
-        currentEvents[index].duration = duration;
+    Event& event = activeEvents[type];
+    if (!event.active) return;
+    
+    event.value = value;
+    event.duration = duration;
+    
+    float step = fabs(event.threshold) * ESCALATION_STEP_RATIO;
+    if (step <= 0.0) return;
+    
+    float worsening = EVENT_HIGHER_IS_WORSE[type] ? (value - loggedValue[type])
+                                                  : (loggedValue[type] - value);
+    if (worsening >= step) {
+        logTransition(event, EVENT_STATE_UPDATED);
     }
 }
 
-int EventDetector::findEventIndex(EventType type) const {
-    for (uint8_t i = 0; i < eventCount; i++) {
-        if (currentEvents[i].type == type) {
-            return i;
-        }
+void EventDetector::logTransition(Event& event, EventState state) {
+    event.state = state;
+    event.sequence = nextSequence++;
+    event.loggedMillis = millis();
+    loggedValue[event.type] = event.value;
+    
+    eventLog[eventLogHead] = event;
+    eventLogHead = (eventLogHead + 1) % EVENT_LOG_SIZE;
+    if (eventLogCount < EVENT_LOG_SIZE) {
+        eventLogCount++;
+    }
+}
+
+uint8_t EventDetector::firstLogIndexAfter(uint32_t afterSequence, uint8_t& available, uint32_t& lost) const {
+    // Log entries are contiguous in sequence, so the offset can be computed directly
+    uint8_t oldest = (eventLogHead + EVENT_LOG_SIZE - eventLogCount) % EVENT_LOG_SIZE;
+    available = 0;
+    lost = 0;
+    if (eventLogCount == 0) return oldest;
+    
+    uint32_t oldestSequence = eventLog[oldest].sequence;
+    uint32_t newestSequence = oldestSequence + eventLogCount - 1;
+    if (afterSequence >= newestSequence) return oldest;
+    
+    if (afterSequence < oldestSequence) {
+        // The reader fell behind and the ring overwrote what it hadn't seen;
+        // sequences from before this boot were never in the log
+        uint32_t from = max(afterSequence + 1, firstSequence);
+        lost = oldestSequence - from;
+        available = eventLogCount;
+        return oldest;
     }
-    return -1;
+    
+    uint8_t skip = afterSequence - oldestSequence + 1;
+    available = eventLogCount - skip;
+    return (oldest + skip) % EVENT_LOG_SIZE;
 }
 
-void EventDetector::removeEvent(uint8_t index) {
-    if (index >= eventCount) return;
+bool EventDetector::restoreCheckpoint() {
+    esp_reset_reason_t reason = esp_reset_reason();
     
-    for (uint8_t i = index; i < eventCount - 1; i++) {
-        currentEvents[i] = currentEvents[i + 1];
+    if (rtcCheckpoint.magic != CHECKPOINT_MAGIC || rtcCheckpoint.size != sizeof(EventCheckpoint) ||
+        rtcCheckpoint.crc != checkpointCrc(rtcCheckpoint)) {
+        Serial.printf("EventDetector: No event checkpoint (reset reason %d), starting fresh\n", (int)reason);
+        return false;
     }
     
-    eventCount--;
-    memset(&currentEvents[eventCount], 0, sizeof(Event));
+    unsigned long now = millis();
+    
+    nextSequence = rtcCheckpoint.nextSequence;
+    memcpy(activeEvents, rtcCheckpoint.activeEvents, sizeof(activeEvents));
+    memcpy(loggedValue, rtcCheckpoint.loggedValue, sizeof(loggedValue));
+    
+    // Undelivered transitions go back in the log for the outbox to collect;
+    // their loggedMillis belonged to the old boot, so latency counts from now
+    eventLogCount = rtcCheckpoint.unsentCount <= EVENT_LOG_SIZE ? rtcCheckpoint.unsentCount : 0;
+    for (uint8_t i = 0; i < eventLogCount; i++) {
+        eventLog[i] = rtcCheckpoint.unsent[i];
+        eventLog[i].loggedMillis = now;
+    }
+    eventLogHead = eventLogCount % EVENT_LOG_SIZE;
+    firstSequence = eventLogCount > 0 ? eventLog[0].sequence : nextSequence;
+    deliveredSequence = firstSequence - 1;
+    
+    eventCount = 0;
+    for (uint8_t type = 0; type < EVENT_TYPE_COUNT; type++) {
+        if (activeEvents[type].active) {
+            eventCount++;
+        }
+    }
+    
+    // Restored incidents are not re-logged, so the uplink won't raise them again;
+    // the first samples either keep them going or clear them through hysteresis
+    highCurrentActive = activeEvents[EVENT_HIGH_CURRENT].active;
+    lowPressureActive = activeEvents[EVENT_LOW_PRESSURE].active;
+    lowTemperatureActive = activeEvents[EVENT_LOW_TEMPERATURE].active;
+    sensorErrorActive = activeEvents[EVENT_SENSOR_ERROR].active;
+    pressureDecayActive = activeEvents[EVENT_PRESSURE_DECAY].active;
+    cycleAnomalyActive = activeEvents[EVENT_CYCLE_ANOMALY].active;
+    dryRunActive = activeEvents[EVENT_DRY_RUN].active;
+    lockedRotorActive = activeEvents[EVENT_LOCKED_ROTOR].active;
+    
+    currentEventTime = timerFromAge(rtcCheckpoint.currentEventAge, now);
+    pressureEventTime = timerFromAge(rtcCheckpoint.pressureEventAge, now);
+    temperatureEventTime = timerFromAge(rtcCheckpoint.temperatureEventAge, now);
+    pressureDecayEventTime = timerFromAge(rtcCheckpoint.pressureDecayEventAge, now);
+    lockedRotorEventTime = timerFromAge(rtcCheckpoint.lockedRotorEventAge, now);
+    
+    Serial.printf("EventDetector: Restored %d active events, %d unsent transitions, next sequence %lu (reset reason %d)\n",
+                  eventCount, eventLogCount, (unsigned long)nextSequence, (int)reason);
+    return true;
 }
 
-String EventDetector::eventTypeToString(EventType type) const {
-    switch (type) {
-        case EVENT_HIGH_CURRENT: return "High Current";
-        case EVENT_LOW_PRESSURE: return "Low Pressure";
-        case EVENT_LOW_TEMPERATURE: return "Low Temperature";
-        case EVENT_SENSOR_ERROR: return "Sensor Error";
-        case EVENT_SYSTEM_ERROR: return "System Error";
-        default: return "Unknown";
+void EventDetector::saveCheckpoint(unsigned long now) {
+    // A few hundred bytes and a ROM CRC per sample; cheap enough to keep current
+    rtcCheckpoint.magic = CHECKPOINT_MAGIC;
+    rtcCheckpoint.size = sizeof(EventCheckpoint);
+    rtcCheckpoint.nextSequence = nextSequence;
+    memcpy(rtcCheckpoint.activeEvents, activeEvents, sizeof(activeEvents));
+    memcpy(rtcCheckpoint.loggedValue, loggedValue, sizeof(loggedValue));
+    
+    // Empty while the uplink keeps up; up to the whole log while it's down
+    uint8_t available;
+    uint32_t lost;
+    uint8_t index = firstLogIndexAfter(deliveredSequence, available, lost);
+    rtcCheckpoint.unsentCount = available;
+    for (uint8_t i = 0; i < available; i++) {
+        rtcCheckpoint.unsent[i] = eventLog[(index + i) % EVENT_LOG_SIZE];
     }
-}
\ No newline at end of file
+    
+    rtcCheckpoint.currentEventAge = timerAge(currentEventTime, now);
+    rtcCheckpoint.pressureEventAge = timerAge(pressureEventTime, now);
+    rtcCheckpoint.temperatureEventAge = timerAge(temperatureEventTime, now);
+    rtcCheckpoint.pressureDecayEventAge = timerAge(pressureDecayEventTime, now);
+    rtcCheckpoint.lockedRotorEventAge = timerAge(lockedRotorEventTime, now);
+    
+    rtcCheckpoint.crc = checkpointCrc(rtcCheckpoint);
+}
@@ -0,0 +1,226 @@
+#include "EventOutbox.h"
+
+EventOutbox::EventOutbox(EventDetector* eventDetector, unsigned long heartbeatMs) {
+    detector = eventDetector;
+    
+    head = 0;
+    count = 0;
+    memset(entries, 0, sizeof(entries));
+    
+    cursor = 0;
+    lostPending = 0;
+    
+    heartbeatInterval = heartbeatMs;
+    lastHeartbeat = millis();
+    
+    sentCount = 0;
+    coalescedCount = 0;
+    droppedCount = 0;
+    heartbeatCount = 0;
+    lostCount = 0;
+    
+    lastPriorityLatency = 0;
+    maxPriorityLatency = 0;
+    priorityDelivered = 0;
+    priorityLate = 0;
+}
+
+void EventOutbox::collect() {
+    if (!detector) return;
+    
+    // Set before the visitor runs, so the first transition after an overrun carries it
+    uint32_t lostSoFar = lostCount;
+    cursor = detector->forEachEventSince(cursor, transitionVisitor, this, &lostPending);
+    if (lostCount > lostSoFar) {
+        Serial.printf("EventOutbox: %lu transitions overwritten in the event log before collection\n",
+                      (unsigned long)(lostCount - lostSoFar));
+    }
+    reportDelivered();
+    
+    unsigned long now = millis();
+    if (heartbeatInterval > 0 && now - lastHeartbeat >= heartbeatInterval) {
+        lastHeartbeat = now;
+        detector->forEachActiveEvent(heartbeatVisitor, this);
+    }
+}
+
+bool EventOutbox::peek(OutboxEntry& entry) const {
+    if (count == 0) return false;
+    entry = entryAt(0);
+    return true;
+}
+
+bool EventOutbox::peekCritical(OutboxEntry& entry) const {
+    // Critical entries are kept at the front, so only the head needs checking
+    if (count == 0 || !isPriority(entryAt(0))) return false;
+    entry = entryAt(0);
+    return true;
+}
+
+uint8_t EventOutbox::peekMany(OutboxEntry* out, uint8_t maxCount, bool criticalOnly, uint8_t offset) const {
+    uint8_t copied = 0;
+    while (copied < maxCount && offset + copied < count) {
+        const OutboxEntry& entry = entryAt(offset + copied);
+        if (criticalOnly && !isPriority(entry)) break;
+        out[copied++] = entry;
+    }
+    return copied;
+}
+
+void EventOutbox::pop() {
+    if (count == 0) return;
+    
+    const OutboxEntry& sent = entryAt(0);
+    if (isPriority(sent)) {
+        lastPriorityLatency = millis() - sent.event.loggedMillis;
+        if (lastPriorityLatency > maxPriorityLatency) {
+            maxPriorityLatency = lastPriorityLatency;
+        }
+        priorityDelivered++;
+        if (lastPriorityLatency > PRIORITY_TARGET_MS) {
+            priorityLate++;
+        }
+    }
+    
+    head = (head + 1) % OUTBOX_SIZE;
+    count--;
+    sentCount++;
+    reportDelivered();
+}
+
+void EventOutbox::markRelayed(uint8_t offset, uint8_t markCount) {
+    for (uint8_t i = offset; i < offset + markCount && i < count; i++) {
+        entryAt(i).relayed = true;
+    }
+}
+
+void EventOutbox::reportDelivered() {
+    if (!detector) return;
+    
+    // The detector checkpoints every transition after the oldest one still
+    // queued here, so a warm reset replays it; sinks drop the repeats by key
+    uint32_t delivered = cursor;
+    for (uint8_t i = 0; i < count; i++) {
+        const OutboxEntry& entry = entryAt(i);
+        if (!entry.heartbeat && entry.firstSequence <= delivered) {
+            delivered = entry.firstSequence - 1;
+        }
+    }
+    detector->setDeliveredSequence(delivered);
+}
+
+void EventOutbox::transitionVisitor(const Event& event, void* context) {
+    EventOutbox* outbox = static_cast<EventOutbox*>(context);
+    outbox->enqueue(event, false);
+    outbox->lostPending = 0;
+}
+
+void EventOutbox::heartbeatVisitor(const Event& event, void* context) {
+    EventOutbox* outbox = static_cast<EventOutbox*>(context);
+    
+    // A pending transition for the same incident already carries fresh state
+    if (outbox->findPending(event) >= 0) return;
+    
+    outbox->enqueue(event, true);
+    outbox->heartbeatCount++;
+}
+
+void EventOutbox::enqueue(const Event& event, bool heartbeat) {
+    int pending = heartbeat ? -1 : findPending(event);
+    
+    // A clear never replaces an unsent raise: the server would only see the
+    // incident end, and a short critical fault would vanish upstream
+    if (pending >= 0 && entryAt(pending).event.state == EVENT_STATE_RAISED && !entryAt(pending).heartbeat &&
+        event.state == EVENT_STATE_CLEARED) {
+        pending = -1;
+    }
+    
+    if (pending >= 0) {
+        OutboxEntry& entry = entryAt(pending);
+        EventState sentState = entry.event.state;
+        if (entry.heartbeat) {
+            entry.firstSequence = event.sequence;
+        }
+        entry.event = event;
+        entry.heartbeat = false;
+        entry.relayed = false;
+        
+        // The server hasn't seen the raise yet, so an escalation is still a raise
+        if (sentState == EVENT_STATE_RAISED && event.state == EVENT_STATE_UPDATED) {
+            entry.event.state = EVENT_STATE_RAISED;
+        }
+        entry.lostBefore += lostPending;
+        lostCount += lostPending;
+        coalescedCount++;
+        return;
+    }
+    
+    if (count >= OUTBOX_SIZE) {
+        makeRoom();
+    }
+    
+    OutboxEntry entry;
+    entry.event = event;
+    entry.heartbeat = heartbeat;
+    entry.lostBefore = heartbeat ? 0 : lostPending;
+    entry.firstSequence = event.sequence;
+    entry.relayed = false;
+    lostCount += entry.lostBefore;
+    
+    // Critical transitions go behind other critical ones but ahead of the rest;
+    // all transitions of one type share a lane, so their order is preserved
+    uint8_t position = count;
+    if (isPriority(entry)) {
+        position = 0;
+        while (position < count && isPriority(entryAt(position))) {
+            position++;
+        }
+    }
+    insertAt(position, entry);
+}
+
+int EventOutbox::findPending(const Event& event) const {
+    // Same type and start time identifies the same incident
+    for (int i = count - 1; i >= 0; i--) {
+        const Event& queued = entryAt(i).event;
+        if (queued.type == event.type && queued.startTime == event.startTime) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void EventOutbox::makeRoom() {
+    // Prefer dropping heartbeats and escalations; raises and clears carry the edges
+    for (uint8_t i = 0; i < count; i++) {
+        const OutboxEntry& entry = entryAt(i);
+        if (entry.heartbeat || entry.event.state == EVENT_STATE_UPDATED) {
+            removeAt(i);
+            droppedCount++;
+            return;
+        }
+    }
+    
+    // Otherwise the oldest routine entry, keeping critical edges if possible
+    uint8_t victim = 0;
+    while (victim < count - 1 && isPriority(entryAt(victim))) {
+        victim++;
+    }
+    removeAt(victim);
+    droppedCount++;
+}
+
+void EventOutbox::removeAt(uint8_t offset) {
+    for (uint8_t i = offset; i + 1 < count; i++) {
+        entryAt(i) = entryAt(i + 1);
+    }
+    count--;
+}
+
+void EventOutbox::insertAt(uint8_t offset, const OutboxEntry& entry) {
+    for (uint8_t i = count; i > offset; i--) {
+        entryAt(i) = entryAt(i - 1);
+    }
+    entryAt(offset) = entry;
+    count++;
+}
@@ -0,0 +1,89 @@
+#include "FlashLogSink.h"
+#include "JsonWriter.h"
+#include "SensorRecord.h"
+
+const char* FlashLogSink::LOG_PATH = "/telemetry.jsonl";
+const char* FlashLogSink::OLD_LOG_PATH = "/telemetry.old";
+
+FlashLogSink::FlashLogSink(const String& device, const String& loc) {
+    deviceName = device;
+    location = loc;
+    lineBuffer = new char[LINE_BUFFER_SIZE];
+    logSize = 0;
+    ready = false;
+    writeErrors = 0;
+    rotations = 0;
+}
+
+FlashLogSink::~FlashLogSink() {
+    if (lineBuffer) {
+        delete[] lineBuffer;
+        lineBuffer = nullptr;
+    }
+}
+
+bool FlashLogSink::begin() {
+    File file = SPIFFS.open(LOG_PATH, FILE_READ);
+    if (file) {
+        logSize = file.size();
+        file.close();
+    }
+    ready = true;
+    
+    Serial.printf("Flash log: %s holds %lu bytes\n", LOG_PATH, (unsigned long)logSize);
+    return true;
+}
+
+size_t FlashLogSink::encode(const AggregatedData& data, uint8_t* out, size_t size) {
+    JsonWriter writer((char*)out, size);
+    writeSensorRecord(writer, data, deviceName.c_str(), location.c_str());
+    return writer.overflowed() ? 0 : writer.size();
+}
+
+SinkResult FlashLogSink::deliver(const AggregatedData& data, const uint8_t* payload, size_t length) {
+    if (!ready) {
+        return SINK_RETRY;
+    }
+    if (!payload) {
+        length = encode(data, (uint8_t*)lineBuffer, LINE_BUFFER_SIZE);
+        if (length == 0) {
+            return SINK_FAILED;
+        }
+        payload = (const uint8_t*)lineBuffer;
+    }
+    
+    if (logSize + length + 1 > MAX_LOG_SIZE) {
+        rotate();
+    }
+    
+    File file = SPIFFS.open(LOG_PATH, FILE_APPEND);
+    if (!file) {
+        writeErrors++;
+        return SINK_RETRY;
+    }
+    
+    size_t written = file.write(payload, length);
+    written += file.write((const uint8_t*)"\n", 1);
+    file.close();
+    
+    if (written != length + 1) {
+        // A torn line is left behind; readers skip lines that don't parse
+        writeErrors++;
+        logSize += written;
+        return SINK_RETRY;
+    }
+    
+    logSize += written;
+    return SINK_DELIVERED;
+}
+
+void FlashLogSink::rotate() {
+    SPIFFS.remove(OLD_LOG_PATH);
+    if (!SPIFFS.rename(LOG_PATH, OLD_LOG_PATH)) {
+        // Can't keep the old half; start over rather than grow past the limit
+        SPIFFS.remove(LOG_PATH);
+    }
+    logSize = 0;
+    rotations++;
+    Serial.println("Flash log: Rotated");
+}
@@ -0,0 +1,352 @@
+#include "FlashOutbox.h"
+#include <rom/crc.h>
+
+FlashOutbox::FlashOutbox(const char* storeName) {
+    name = storeName;
+    ready = false;
+    firstSegment = 0;
+    writeSegment = 0;
+    writeCount = 0;
+    readSegment = 0;
+    readPosition = 0;
+    maxSegments = MIN_SEGMENTS;
+    memset(&stats, 0, sizeof(stats));
+}
+
+FlashOutbox::~FlashOutbox() {
+    if (ready) {
+        cursorStore.end();
+    }
+}
+
+bool FlashOutbox::begin() {
+    if (ready) {
+        return true;
+    }
+    
+    if (!cursorStore.begin(name, false)) {
+        Serial.println("Outbox: Failed to open cursor storage");
+        return false;
+    }
+    
+    stats.dropped = cursorStore.getUInt("dropped", 0);
+    
+    scanSegments();
+    
+    readSegment = cursorStore.getUInt("rseg", firstSegment);
+    readPosition = cursorStore.getUShort("rpos", 0);
+    if (readSegment < firstSegment) {
+        // The segment under the cursor was evicted before the cursor was saved
+        readSegment = firstSegment;
+        readPosition = 0;
+    } else if (readSegment > writeSegment) {
+        readSegment = writeSegment;
+        readPosition = segmentRecordCount(writeSegment);
+    }
+    
+    recoverWriteSegment();
+    
+    stats.pending = 0;
+    for (uint32_t segment = readSegment; segment <= writeSegment; segment++) {
+        stats.pending += segmentRecordCount(segment);
+    }
+    stats.pending = stats.pending > readPosition ? stats.pending - readPosition : 0;
+    
+    ready = true;
+    
+    while (writeSegment - firstSegment + 1 > maxSegments) {
+        evictOldest();
+    }
+    
+    stats.capacity = maxSegments * RECORDS_PER_SEGMENT;
+    Serial.printf("Outbox: %lu pending, capacity %lu records (%lu segments, ~%lu days at 1/min)\n",
+                  (unsigned long)stats.pending, (unsigned long)stats.capacity, (unsigned long)maxSegments,
+                  (unsigned long)(stats.capacity / 1440));
+    return true;
+}
+
+void FlashOutbox::scanSegments() {
+    bool found = false;
+    size_t outboxBytes = 0;
+    firstSegment = 0;
+    writeSegment = 0;
+    
+    char dirPath[12];
+    snprintf(dirPath, sizeof(dirPath), "/%s", name);
+    File dir = SPIFFS.open(dirPath);
+    if (dir) {
+        File entry = dir.openNextFile();
+        while (entry) {
+            // Depending on the core version name() may or may not include the directory
+            const char* name = entry.name();
+            const char* base = strrchr(name, '/');
+            base = base ? base + 1 : name;
+            
+            char* end;
+            uint32_t segment = strtoul(base, &end, 10);
+            if (end != base && strcmp(end, ".q") == 0) {
+                if (!found || segment < firstSegment) firstSegment = segment;
+                if (!found || segment > writeSegment) writeSegment = segment;
+                outboxBytes += entry.size();
+                stats.segments++;
+                found = true;
+            }
+            entry = dir.openNextFile();
+        }
+    }
+    
+    if (!found) {
+        // Keep numbering monotonic across a wiped filesystem
+        firstSegment = cursorStore.getUInt("rseg", 0);
+        writeSegment = firstSegment;
+    }
+    
+    // Budget: a share of whatever the web files leave free, counting what
+    // the outbox already holds
+    size_t otherBytes = SPIFFS.usedBytes() > outboxBytes ? SPIFFS.usedBytes() - outboxBytes : 0;
+    size_t available = SPIFFS.totalBytes() > otherBytes ? SPIFFS.totalBytes() - otherBytes : 0;
+    size_t segmentBytes = (size_t)RECORDS_PER_SEGMENT * sizeof(OutboxRecord);
+    maxSegments = (available * FLASH_BUDGET_PERCENT / 100) / segmentBytes;
+    if (maxSegments < MIN_SEGMENTS) {
+        maxSegments = MIN_SEGMENTS;
+    }
+}
+
+void FlashOutbox::recoverWriteSegment() {
+    char path[24];
+    segmentPath(writeSegment, path, sizeof(path));
+    
+    writeCount = 0;
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) {
+        return;
+    }
+    
+    size_t size = file.size();
+    uint16_t count = size / sizeof(OutboxRecord);
+    uint16_t valid = 0;
+    OutboxRecord record;
+    while (valid < count && readRecord(file, valid, record)) {
+        valid++;
+    }
+    file.close();
+    
+    if (valid < count || size % sizeof(OutboxRecord) != 0) {
+        // A reset tore the last append; never write after a damaged tail
+        Serial.printf("Outbox: Segment %lu damaged after %u records, starting a new segment\n",
+                      (unsigned long)writeSegment, valid);
+        writeSegment++;
+        return;
+    }
+    writeCount = count;
+}
+
+bool FlashOutbox::append(const AggregatedData& data) {
+    if (!ready) {
+        return false;
+    }
+    
+    if (writeCount >= RECORDS_PER_SEGMENT) {
+        writeSegment++;
+        writeCount = 0;
+    }
+    while (writeSegment - firstSegment + 1 > maxSegments) {
+        evictOldest();
+    }
+    
+    OutboxRecord record;
+    record.magic = RECORD_MAGIC;
+    record.data = data;
+    record.crc = recordCRC(record);
+    record.commit = COMMIT_MARKER;
+    
+    char path[24];
+    segmentPath(writeSegment, path, sizeof(path));
+    File file = SPIFFS.open(path, FILE_APPEND);
+    if (!file) {
+        Serial.printf("Outbox: Failed to open %s\n", path);
+        return false;
+    }
+    
+    // Body first, commit marker only once the body is on flash
+    size_t bodySize = offsetof(OutboxRecord, commit);
+    bool written = file.write((const uint8_t*)&record, bodySize) == bodySize;
+    file.flush();
+    written = written && file.write((const uint8_t*)&record.commit, sizeof(record.commit)) == sizeof(record.commit);
+    file.close();
+    
+    if (!written) {
+        // Most likely out of space: free the oldest segment and leave the
+        // partial record behind in a closed segment
+        Serial.println("Outbox: Write failed, rolling to a new segment");
+        evictOldest();
+        writeSegment++;
+        writeCount = 0;
+        return false;
+    }
+    
+    if (writeCount == 0) {
+        stats.segments++;
+    }
+    writeCount++;
+    stats.pending++;
+    stats.appended++;
+    return true;
+}
+
+uint8_t FlashOutbox::peek(AggregatedData* out, uint8_t maxCount) {
+    if (!ready) {
+        return 0;
+    }
+    
+    uint8_t found = 0;
+    uint32_t segment = readSegment;
+    uint16_t position = readPosition;
+    
+    while (found < maxCount && segment <= writeSegment) {
+        char path[24];
+        segmentPath(segment, path, sizeof(path));
+        File file = SPIFFS.open(path, FILE_READ);
+        uint16_t count = file ? file.size() / sizeof(OutboxRecord) : 0;
+        
+        bool stop = false;
+        bool skipped = false;
+        while (found < maxCount && position < count) {
+            OutboxRecord record;
+            if (readRecord(file, position, record)) {
+                out[found++] = record.data;
+                position++;
+            } else if (found == 0) {
+                // Unreadable record at the cursor: it can never be sent, skip it
+                Serial.printf("Outbox: Skipping corrupt record %u in segment %lu\n", position, (unsigned long)segment);
+                stats.corrupt++;
+                advanceCursor(1);
+                saveCursor();
+                segment = readSegment;
+                position = readPosition;
+                skipped = true;
+                break;
+            } else {
+                // Leave it at the head for the next peek; acknowledge() only
+                // ever advances over what was returned
+                stop = true;
+                break;
+            }
+        }
+        file.close();
+        
+        if (stop) break;
+        if (skipped) continue;
+        if (position < count || segment >= writeSegment) break;
+        segment++;
+        position = 0;
+    }
+    
+    return found;
+}
+
+void FlashOutbox::acknowledge(uint8_t count) {
+    if (!ready || count == 0) {
+        return;
+    }
+    
+    advanceCursor(count);
+    stats.acknowledged += count;
+    saveCursor();
+}
+
+void FlashOutbox::advanceCursor(uint16_t count) {
+    stats.pending = stats.pending > count ? stats.pending - count : 0;
+    
+    while (true) {
+        uint16_t available = segmentRecordCount(readSegment);
+        if (readPosition >= available && readSegment < writeSegment) {
+            // Fully consumed; the write segment stays so appends continue in it
+            removeSegment(readSegment);
+            readSegment++;
+            readPosition = 0;
+            if (firstSegment < readSegment) {
+                firstSegment = readSegment;
+            }
+            continue;
+        }
+        if (count == 0 || readPosition >= available) {
+            break;
+        }
+        uint16_t step = available - readPosition;
+        if (step > count) step = count;
+        readPosition += step;
+        count -= step;
+    }
+}
+
+void FlashOutbox::evictOldest() {
+    if (firstSegment >= writeSegment) {
+        return;
+    }
+    
+    uint32_t lost = 0;
+    if (readSegment <= firstSegment) {
+        uint16_t count = segmentRecordCount(firstSegment);
+        lost = count > readPosition ? count - readPosition : 0;
+        readSegment = firstSegment + 1;
+        readPosition = 0;
+    }
+    
+    removeSegment(firstSegment);
+    firstSegment++;
+    
+    if (lost > 0) {
+        stats.dropped += lost;
+        stats.pending = stats.pending > lost ? stats.pending - lost : 0;
+        Serial.printf("Outbox: Full, dropped %lu oldest records (%lu total)\n",
+                      (unsigned long)lost, (unsigned long)stats.dropped);
+    }
+    saveCursor();
+}
+
+void FlashOutbox::saveCursor() {
+    cursorStore.putUInt("rseg", readSegment);
+    cursorStore.putUShort("rpos", readPosition);
+    cursorStore.putUInt("dropped", stats.dropped);
+}
+
+uint16_t FlashOutbox::segmentRecordCount(uint32_t segment) {
+    char path[24];
+    segmentPath(segment, path, sizeof(path));
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) {
+        return 0;
+    }
+    uint16_t count = file.size() / sizeof(OutboxRecord);
+    file.close();
+    return count;
+}
+
+bool FlashOutbox::readRecord(File& file, uint16_t position, OutboxRecord& record) {
+    if (!file.seek((size_t)position * sizeof(OutboxRecord))) {
+        return false;
+    }
+    if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+        return false;
+    }
+    return record.magic == RECORD_MAGIC &&
+           record.commit == COMMIT_MARKER &&
+           record.crc == recordCRC(record);
+}
+
+void FlashOutbox::removeSegment(uint32_t segment) {
+    char path[24];
+    segmentPath(segment, path, sizeof(path));
+    if (SPIFFS.remove(path) && stats.segments > 0) {
+        stats.segments--;
+    }
+}
+
+void FlashOutbox::segmentPath(uint32_t segment, char* out, size_t size) const {
+    snprintf(out, size, "/%s/%08lu.q", name, (unsigned long)segment);
+}
+
+uint32_t FlashOutbox::recordCRC(const OutboxRecord& record) {
+    return crc32_le(0, (const uint8_t*)&record, offsetof(OutboxRecord, crc));
+}
@@ -0,0 +1,245 @@
+#include "JsonWriter.h"
+#include <math.h>
+
+JsonWriter::JsonWriter(char* buf, size_t size) {
+    buffer = buf;
+    capacity = size;
+    reset();
+}
+
+void JsonWriter::reset() {
+    length = 0;
+    overflow = false;
+    depth = 0;
+    afterKey = false;
+    hasItems[0] = false;
+    if (capacity > 0) {
+        buffer[0] = '\0';
+    }
+}
+
+JsonMark JsonWriter::mark() const {
+    JsonMark position;
+    position.length = length;
+    position.depth = depth;
+    position.hasItems = hasItems[depth];
+    return position;
+}
+
+void JsonWriter::rewind(const JsonMark& position) {
+    if (position.length > length) return;
+    length = position.length;
+    depth = position.depth;
+    hasItems[depth] = position.hasItems;
+    overflow = false;
+    afterKey = false;
+    if (capacity > 0) {
+        buffer[length] = '\0';
+    }
+}
+
+void JsonWriter::beginObject() {
+    separator();
+    put('{');
+    if (depth + 1 < MAX_DEPTH) {
+        depth++;
+        hasItems[depth] = false;
+    } else {
+        overflow = true;
+    }
+}
+    
+void JsonWriter::endObject() {
+    put('}');
+    if (depth > 0) depth--;
+}
+
+void JsonWriter::beginArray() {
+    separator();
+    put('[');
+    if (depth + 1 < MAX_DEPTH) {
+        depth++;
+        hasItems[depth] = false;
+    } else {
+        overflow = true;
+    }
+}
+
+void JsonWriter::endArray() {
+    put(']');
+    if (depth > 0) depth--;
+}
+
+void JsonWriter::key(const char* name) {
+    separator();
+    putString(name);
+    put(':');
+    afterKey = true;
+}
+
+void JsonWriter::value(const char* str) {
+    separator();
+    if (!str) {
+        put("null");
+        return;
+    }
+    putString(str);
+}
+
+void JsonWriter::putString(const char* str) {
+    put('"');
+    for (const char* p = str; *p; p++) {
+        char c = *p;
+        switch (c) {
+            case '"':  put("\\\""); break;
+            case '\\': put("\\\\"); break;
+            case '\n': put("\\n"); break;
+            case '\r': put("\\r"); break;
+            case '\t': put("\\t"); break;
+            default:
+                if ((uint8_t)c < 0x20) {
+                    static const char hex[] = "0123456789abcdef";
+                    put("\\u00");
+                    put(hex[(c >> 4) & 0x0F]);
+                    put(hex[c & 0x0F]);
+                } else {
+                    put(c);
+                }
+        }
+    }
+    put('"');
+}
+
+void JsonWriter::value(float number, uint8_t decimals) {
+    value((double)number, decimals);
+}
+
+void JsonWriter::value(double number, uint8_t decimals) {
+    separator();
+    
+    // Fixed-point by hand: printf's float path can allocate in newlib
+    if (isnan(number) || isinf(number) || fabs(number) >= 1e15) {
+        put("null");
+        return;
+    }
+    
+    if (decimals > 6) decimals = 6;
+    unsigned long long scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+    
+    bool negative = number < 0;
+    unsigned long long scaled = (unsigned long long)(fabs(number) * scale + 0.5);
+    unsigned long long whole = scaled / scale;
+    unsigned long long fraction = scaled % scale;
+    
+    if (negative && scaled > 0) put('-');
+    putUnsigned(whole);
+    
+    if (decimals > 0 && fraction > 0) {
+        // Trim trailing zeros so 40.500 prints as 40.5
+        uint8_t digits = decimals;
+        while (fraction % 10 == 0) {
+            fraction /= 10;
+            digits--;
+        }
+        char frac[7];
+        for (int8_t i = digits - 1; i >= 0; i--) {
+            frac[i] = '0' + (fraction % 10);
+            fraction /= 10;
+        }
+        frac[digits] = '\0';
+        put('.');
+        put(frac);
+    }
+}
+
+void JsonWriter::value(int number) {
+    value((long)number);
+}
+
+void JsonWriter::value(unsigned int number) {
+    separator();
+    putUnsigned(number);
+}
+
+void JsonWriter::value(long number) {
+    separator();
+    if (number < 0) {
+        put('-');
+        putUnsigned((unsigned long long)(-(long long)number));
+    } else {
+        putUnsigned((unsigned long long)number);
+    }
+}
+
+void JsonWriter::value(unsigned long number) {
+    separator();
+    putUnsigned(number);
+}
+
+void JsonWriter::value(unsigned long long number) {
+    separator();
+    putUnsigned(number);
+}
+
+void JsonWriter::value(bool flag) {
+    separator();
+    put(flag ? "true" : "false");
+}
+
+void JsonWriter::nullValue() {
+    separator();
+    put("null");
+}
+
+void JsonWriter::raw(const char* json, size_t size) {
+    separator();
+    if (length + size >= capacity) {
+        overflow = true;
+        return;
+    }
+    memcpy(buffer + length, json, size);
+    length += size;
+    buffer[length] = '\0';
+}
+
+void JsonWriter::separator() {
+    if (afterKey) {
+        // The key already placed the comma; its value follows the colon
+        afterKey = false;
+        return;
+    }
+    if (hasItems[depth]) {
+        put(',');
+    }
+    hasItems[depth] = true;
+}
+
+void JsonWriter::put(char c) {
+    // Keep one byte for the terminator
+    if (length + 1 >= capacity) {
+        overflow = true;
+        return;
+    }
+    buffer[length++] = c;
+    buffer[length] = '\0';
+}
+
+void JsonWriter::put(const char* str) {
+    while (*str) {
+        put(*str++);
+    }
+}
+
+void JsonWriter::putUnsigned(unsigned long long number) {
+    char digits[21];
+    uint8_t count = 0;
+    do {
+        digits[count++] = '0' + (number % 10);
+        number /= 10;
+    } while (number > 0);
+    
+    while (count > 0) {
+        put(digits[--count]);
+    }
+}
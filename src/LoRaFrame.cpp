@@ -0,0 +1,169 @@
+#include "LoRaFrame.h"
+
+static const uint8_t FRAME_HEADER_AGGREGATE = (LORA_FRAME_VERSION << 4) | LORA_FRAME_AGGREGATE;
+static const uint8_t FRAME_HEADER_EVENT = (LORA_FRAME_VERSION << 4) | LORA_FRAME_EVENT;
+static const uint8_t FRAME_HEADER_ACK = (LORA_FRAME_VERSION << 4) | LORA_FRAME_ACK;
+
+uint16_t loraFrameCRC(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    while (length--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static size_t appendCRC(uint8_t* frame, size_t length) {
+    uint16_t crc = loraFrameCRC(frame, length);
+    frame[length++] = crc & 0xFF;
+    frame[length++] = crc >> 8;
+    return length;
+}
+
+static void putUint32(uint8_t*& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        *out++ = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+static uint32_t getUint32(const uint8_t*& in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)*in++ << (8 * i);
+    }
+    return value;
+}
+
+// Hundredths, clamped, as packAggregate() does its metrics
+static void putFixed16(uint8_t*& out, float value) {
+    int16_t fixed;
+    float scaled = value * 100;
+    if (isnan(scaled)) {
+        fixed = INT16_MIN;
+    } else if (scaled >= INT16_MAX) {
+        fixed = INT16_MAX;
+    } else if (scaled <= -INT16_MAX) {
+        fixed = -INT16_MAX;
+    } else {
+        fixed = (int16_t)lroundf(scaled);
+    }
+    *out++ = (uint16_t)fixed & 0xFF;
+    *out++ = (uint16_t)fixed >> 8;
+}
+
+static float getFixed16(const uint8_t*& in) {
+    int16_t fixed = (int16_t)(in[0] | (in[1] << 8));
+    in += 2;
+    return fixed == INT16_MIN ? NAN : fixed / 100.0f;
+}
+
+size_t encodeLoRaAggregate(const AggregatedData& data, uint8_t nodeId, uint8_t* out, size_t size) {
+    if (size < LORA_AGGREGATE_FRAME_SIZE) {
+        return 0;
+    }
+    
+    out[0] = FRAME_HEADER_AGGREGATE;
+    out[1] = nodeId;
+    size_t length = LORA_FRAME_HEADER_SIZE;
+    length += packAggregate(data, out + length, size - length);
+    return appendCRC(out, length);
+}
+
+bool decodeLoRaAggregate(const uint8_t* in, size_t length, uint8_t& nodeId, AggregatedData& data) {
+    if (loraFrameType(in, length) != LORA_FRAME_AGGREGATE) {
+        return false;
+    }
+    
+    nodeId = in[1];
+    return unpackAggregate(in + LORA_FRAME_HEADER_SIZE, length - LORA_FRAME_HEADER_SIZE - LORA_FRAME_CRC_SIZE, data);
+}
+
+size_t encodeLoRaEvent(const Event& event, uint8_t nodeId, uint8_t* out, size_t size) {
+    if (size < LORA_EVENT_FRAME_SIZE) {
+        return 0;
+    }
+    
+    uint8_t* at = out;
+    *at++ = FRAME_HEADER_EVENT;
+    *at++ = nodeId;
+    putUint32(at, event.sequence);
+    *at++ = (uint8_t)event.type;
+    *at++ = (uint8_t)event.state;
+    putUint32(at, event.startTime);
+    putFixed16(at, event.value);
+    putFixed16(at, event.threshold);
+    return appendCRC(out, at - out);
+}
+
+bool decodeLoRaEvent(const uint8_t* in, size_t length, uint8_t& nodeId, Event& event) {
+    if (loraFrameType(in, length) != LORA_FRAME_EVENT) {
+        return false;
+    }
+    
+    memset(&event, 0, sizeof(event));
+    nodeId = in[1];
+    const uint8_t* at = in + LORA_FRAME_HEADER_SIZE;
+    event.sequence = getUint32(at);
+    event.type = (EventType)*at++;
+    event.state = (EventState)*at++;
+    event.startTime = getUint32(at);
+    event.value = getFixed16(at);
+    event.threshold = getFixed16(at);
+    return true;
+}
+
+size_t encodeLoRaAck(uint8_t nodeId, uint16_t ackedCRC, float snr, int16_t rssi, uint8_t* out, size_t size) {
+    if (size < LORA_ACK_FRAME_SIZE) {
+        return 0;
+    }
+    
+    out[0] = FRAME_HEADER_ACK;
+    out[1] = nodeId;
+    out[2] = ackedCRC & 0xFF;
+    out[3] = ackedCRC >> 8;
+    out[4] = (uint8_t)(int8_t)constrain(lroundf(snr * 4), -128L, 127L);
+    out[5] = (uint8_t)(int8_t)constrain(rssi, -128, 127);
+    return appendCRC(out, 6);
+}
+
+bool decodeLoRaAck(const uint8_t* in, size_t length, uint8_t& nodeId, uint16_t& ackedCRC, float& snr, int16_t& rssi) {
+    if (loraFrameType(in, length) != LORA_FRAME_ACK) {
+        return false;
+    }
+    
+    nodeId = in[1];
+    ackedCRC = in[2] | (in[3] << 8);
+    snr = (int8_t)in[4] / 4.0f;
+    rssi = (int8_t)in[5];
+    return true;
+}
+
+uint8_t loraFrameType(const uint8_t* in, size_t length) {
+    if (length < LORA_FRAME_HEADER_SIZE + LORA_FRAME_CRC_SIZE) {
+        return 0;
+    }
+    
+    size_t expected;
+    switch (in[0]) {
+        case FRAME_HEADER_AGGREGATE:
+            expected = LORA_AGGREGATE_FRAME_SIZE;
+            break;
+        case FRAME_HEADER_EVENT:
+            expected = LORA_EVENT_FRAME_SIZE;
+            break;
+        case FRAME_HEADER_ACK:
+            expected = LORA_ACK_FRAME_SIZE;
+            break;
+        default:
+            return 0;
+    }
+    if (length != expected) {
+        return 0;
+    }
+    
+    size_t body = length - LORA_FRAME_CRC_SIZE;
+    uint16_t crc = in[body] | (in[body + 1] << 8);
+    return crc == loraFrameCRC(in, body) ? in[0] & 0x0F : 0;
+}
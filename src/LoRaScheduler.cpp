@@ -0,0 +1,216 @@
+#include "LoRaScheduler.h"
+
+LoRaScheduler::LoRaScheduler(const LoRaSchedulerConfig& schedulerConfig) {
+    config = schedulerConfig;
+    
+    // The slowest spreading factor whose largest frame still fits the dwell limit
+    maxSpreadingFactor = MAX_SPREADING_FACTOR;
+    while (config.maxFrameAirtime > 0 && maxSpreadingFactor > MIN_SPREADING_FACTOR &&
+           frameAirtime(LARGEST_FRAME, maxSpreadingFactor) > config.maxFrameAirtime) {
+        maxSpreadingFactor--;
+    }
+    
+    spreadingFactor = constrain(config.spreadingFactor, MIN_SPREADING_FACTOR, maxSpreadingFactor);
+    txPower = constrain(config.txPower, MIN_TX_POWER, MAX_TX_POWER);
+    settingsChanged = spreadingFactor != config.spreadingFactor || txPower != config.txPower;
+    
+    memset(eventBuckets, 0, sizeof(eventBuckets));
+    memset(telemetryBuckets, 0, sizeof(telemetryBuckets));
+    currentBucket = 0;
+    bucketStart = millis();
+    nextTelemetry = bucketStart;
+    
+    snrCount = 0;
+    missedAcks = 0;
+    
+    eventAirtime = 0;
+    telemetryAirtime = 0;
+    eventsDeferred = 0;
+    telemetryDeferred = 0;
+    acksReceived = 0;
+    acksMissed = 0;
+    adaptations = 0;
+    lastSnr = NAN;
+    lastRssi = 0;
+}
+
+unsigned long LoRaScheduler::frameAirtime(size_t length, uint8_t spreadingFactor) {
+    // Explicit header, payload CRC on; low data rate optimization is on
+    // whenever a symbol is longer than 16 ms (SF11 and SF12 at 125 kHz)
+    uint32_t symbolUs = ((1UL << spreadingFactor) * 1000000UL) / BANDWIDTH;
+    int lowDataRate = symbolUs > 16000 ? 1 : 0;
+    
+    int numerator = 8 * (int)length - 4 * spreadingFactor + 28 + 16;
+    int denominator = 4 * (spreadingFactor - 2 * lowDataRate);
+    int payloadSymbols = 8;
+    if (numerator > 0) {
+        payloadSymbols += ((numerator + denominator - 1) / denominator) * CODING_RATE;
+    }
+    
+    // Preamble is PREAMBLE_LENGTH + 4.25 symbols; kept in quarter symbols
+    uint32_t quarterSymbols = (PREAMBLE_LENGTH + payloadSymbols) * 4 + 17;
+    uint32_t airtimeUs = quarterSymbols * symbolUs / 4;
+    return (airtimeUs + 999) / 1000;
+}
+
+bool LoRaScheduler::allow(LoRaTraffic traffic, size_t length) {
+    uint32_t budget = getBudget();
+    if (budget == 0) {
+        return true;
+    }
+    
+    advanceBuckets();
+    bool due = true;
+    if (traffic == LORA_TRAFFIC_TELEMETRY) {
+        budget = budget * TELEMETRY_SHARE / 100;
+        due = (long)(millis() - nextTelemetry) >= 0;
+    }
+    if (due && getBudgetUsed() + frameAirtime(length) <= budget) {
+        return true;
+    }
+    
+    if (traffic == LORA_TRAFFIC_EVENT) {
+        eventsDeferred++;
+    } else {
+        telemetryDeferred++;
+    }
+    return false;
+}
+
+void LoRaScheduler::recordTransmit(LoRaTraffic traffic, size_t length) {
+    advanceBuckets();
+    uint32_t airtime = frameAirtime(length);
+    if (traffic == LORA_TRAFFIC_EVENT) {
+        eventBuckets[currentBucket] += airtime;
+        eventAirtime += airtime;
+    } else {
+        telemetryBuckets[currentBucket] += airtime;
+        telemetryAirtime += airtime;
+        if (config.dutyCyclePermille > 0) {
+            nextTelemetry = millis() + airtime * 100000UL / ((uint32_t)config.dutyCyclePermille * TELEMETRY_SHARE);
+        }
+    }
+}
+
+void LoRaScheduler::recordAck(float snr, int16_t rssi) {
+    acksReceived++;
+    missedAcks = 0;
+    lastSnr = snr;
+    lastRssi = rssi;
+    if (!config.adaptive) {
+        return;
+    }
+    
+    snrHistory[snrCount++] = snr;
+    if (snrCount < SNR_HISTORY) {
+        return;
+    }
+    
+    // Best of the last few frames, as ADR does, so one fade doesn't count
+    float best = snrHistory[0];
+    for (uint8_t i = 1; i < SNR_HISTORY; i++) {
+        best = max(best, snrHistory[i]);
+    }
+    snrCount = 0;
+    
+    float margin = best - requiredSnr(spreadingFactor) - MARGIN_DB;
+    adapt((int)floorf(margin / 3));
+}
+
+void LoRaScheduler::recordMissedAck() {
+    acksMissed++;
+    if (!config.adaptive || ++missedAcks < MISSED_ACK_LIMIT) {
+        return;
+    }
+    
+    missedAcks = 0;
+    snrCount = 0;
+    if (txPower < MAX_TX_POWER) {
+        txPower = MAX_TX_POWER;
+    } else if (spreadingFactor < maxSpreadingFactor) {
+        spreadingFactor++;
+    } else {
+        return;
+    }
+    settingsChanged = true;
+    adaptations++;
+}
+
+bool LoRaScheduler::takeSettingsChange() {
+    bool changed = settingsChanged;
+    settingsChanged = false;
+    return changed;
+}
+
+uint32_t LoRaScheduler::getBudget() const {
+    // Per mille of an hour, 3 600 000 ms
+    return (uint32_t)config.dutyCyclePermille * 3600;
+}
+
+uint32_t LoRaScheduler::getBudgetUsed() const {
+    return sumBuckets(eventBuckets) + sumBuckets(telemetryBuckets);
+}
+
+void LoRaScheduler::advanceBuckets() {
+    unsigned long now = millis();
+    if (now - bucketStart >= BUCKET_COUNT * BUCKET_LENGTH) {
+        memset(eventBuckets, 0, sizeof(eventBuckets));
+        memset(telemetryBuckets, 0, sizeof(telemetryBuckets));
+        bucketStart = now;
+        return;
+    }
+    while (now - bucketStart >= BUCKET_LENGTH) {
+        currentBucket = (currentBucket + 1) % BUCKET_COUNT;
+        eventBuckets[currentBucket] = 0;
+        telemetryBuckets[currentBucket] = 0;
+        bucketStart += BUCKET_LENGTH;
+    }
+}
+
+uint32_t LoRaScheduler::sumBuckets(const uint32_t* buckets) const {
+    // Buckets advanceBuckets() would clear by now don't count
+    unsigned long stale = (millis() - bucketStart) / BUCKET_LENGTH;
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < BUCKET_COUNT; i++) {
+        uint8_t age = (currentBucket + BUCKET_COUNT - i) % BUCKET_COUNT;
+        if (age + stale < BUCKET_COUNT) {
+            total += buckets[i];
+        }
+    }
+    return total;
+}
+
+void LoRaScheduler::adapt(int steps) {
+    uint8_t oldSpreadingFactor = spreadingFactor;
+    int8_t oldTxPower = txPower;
+    
+    // Margin to spare: faster first, it saves airtime; then quieter
+    while (steps > 0 && spreadingFactor > MIN_SPREADING_FACTOR) {
+        spreadingFactor--;
+        steps--;
+    }
+    while (steps > 0 && txPower > MIN_TX_POWER) {
+        txPower = max(txPower - 3, (int)MIN_TX_POWER);
+        steps--;
+    }
+    
+    // Short of margin: louder first, then slower
+    while (steps < 0 && txPower < MAX_TX_POWER) {
+        txPower = min(txPower + 3, (int)MAX_TX_POWER);
+        steps++;
+    }
+    while (steps < 0 && spreadingFactor < maxSpreadingFactor) {
+        spreadingFactor++;
+        steps++;
+    }
+    
+    if (spreadingFactor != oldSpreadingFactor || txPower != oldTxPower) {
+        settingsChanged = true;
+        adaptations++;
+    }
+}
+
+float LoRaScheduler::requiredSnr(uint8_t spreadingFactor) {
+    // Demodulation floor of the SX127x: -7.5 dB at SF7, 2.5 dB lower per step
+    return -7.5f - 2.5f * (spreadingFactor - MIN_SPREADING_FACTOR);
+}
@@ -0,0 +1,174 @@
+#include "LoRaSink.h"
+#include <LoRa.h>
+
+LoRaSink::LoRaSink(uint8_t node, bool failoverOnly, const LoRaSchedulerConfig& schedule) {
+    nodeId = node;
+    failover = failoverOnly;
+    wifiOnline = true;
+    
+    memset(&window, 0, sizeof(window));
+    windowCount = 0;
+    
+    scheduler = new LoRaScheduler(schedule);
+    
+    framesSent = 0;
+    eventsRelayed = 0;
+    airtimeTotal = 0;
+    lastAirtime = 0;
+}
+
+LoRaSink::~LoRaSink() {
+    if (scheduler) {
+        delete scheduler;
+        scheduler = nullptr;
+    }
+}
+
+size_t LoRaSink::encode(const AggregatedData& data, uint8_t* out, size_t size) {
+    return encodeLoRaAggregate(data, nodeId, out, size);
+}
+
+SinkResult LoRaSink::deliver(const AggregatedData& data, const uint8_t* payload, size_t length) {
+    if (failover && wifiOnline) {
+        return SINK_SKIPPED;
+    }
+    
+    if (windowCount == 0) {
+        window = data;
+    } else {
+        mergeAggregate(window, data);
+        payload = nullptr;
+    }
+    windowCount++;
+    if (failover && windowCount < FAILOVER_MERGE) {
+        return SINK_SKIPPED;
+    }
+    
+    // Out of budget: keep merging until there's room. The frame carries
+    // the newest sequence of the window.
+    if (!scheduler->allow(LORA_TRAFFIC_TELEMETRY, LORA_AGGREGATE_FRAME_SIZE)) {
+        return SINK_SKIPPED;
+    }
+    
+    if (!payload) {
+        length = encode(window, frameBuffer, sizeof(frameBuffer));
+        if (length == 0) {
+            windowCount = 0;
+            return SINK_FAILED;
+        }
+        payload = frameBuffer;
+    }
+    windowCount = 0;
+    return transmit(payload, length, LORA_TRAFFIC_TELEMETRY) ? SINK_DELIVERED : SINK_FAILED;
+}
+
+uint8_t LoRaSink::relayEvents(const OutboxEntry* entries, uint8_t count) {
+    uint8_t handled = 0;
+    for (; handled < count; handled++) {
+        // The outbox flags what went out, per entry: a coalesced update
+        // clears the flag without moving the entry, so sequence order says
+        // nothing about what's been sent
+        if (entries[handled].relayed) {
+            continue;
+        }
+        
+        // A heartbeat repeats a transition the receiver already has; not
+        // worth the airtime
+        if (entries[handled].heartbeat) {
+            continue;
+        }
+        
+        // Left in the outbox; the next pass tries again
+        if (!scheduler->allow(LORA_TRAFFIC_EVENT, LORA_EVENT_FRAME_SIZE)) {
+            break;
+        }
+        
+        const Event& event = entries[handled].event;
+        size_t length = encodeLoRaEvent(event, nodeId, frameBuffer, sizeof(frameBuffer));
+        if (length == 0 || !transmit(frameBuffer, length, LORA_TRAFFIC_EVENT)) {
+            break;
+        }
+        eventsRelayed++;
+        Serial.printf("LoRa: Relayed event: type=%d state=%s seq=%lu\n", (int)event.type,
+                      eventStateName(event.state), (unsigned long)event.sequence);
+    }
+    return handled;
+}
+
+void LoRaSink::update(bool online) {
+    if (online != wifiOnline && failover) {
+        Serial.println(online ? "LoRa: WiFi back, failover off" : "LoRa: WiFi down, failing over to LoRa");
+        // What's still in the window gets backfilled over WiFi
+        windowCount = 0;
+    }
+    wifiOnline = online;
+}
+
+bool LoRaSink::transmit(const uint8_t* frame, size_t length, LoRaTraffic traffic) {
+    applySettings();
+    
+    // Blocking send: an aggregate frame is about 70 ms on air at SF7, 1.8 s at SF12
+    unsigned long start = millis();
+    if (!LoRa.beginPacket()) {
+        Serial.println("LoRa: Radio busy, frame dropped");
+        return false;
+    }
+    LoRa.write(frame, length);
+    if (!LoRa.endPacket()) {
+        Serial.println("LoRa: Transmit failed");
+        return false;
+    }
+    
+    lastAirtime = millis() - start;
+    airtimeTotal += lastAirtime;
+    framesSent++;
+    scheduler->recordTransmit(traffic, length);
+    
+    if (scheduler->isAdaptive()) {
+        awaitAck(frame, length);
+    }
+    return true;
+}
+
+void LoRaSink::awaitAck(const uint8_t* frame, size_t length) {
+    uint16_t crc = frame[length - 2] | (frame[length - 1] << 8);
+    unsigned long window = LoRaScheduler::frameAirtime(LORA_ACK_FRAME_SIZE, scheduler->getSpreadingFactor()) +
+                           ACK_TURNAROUND;
+    
+    unsigned long start = millis();
+    while (millis() - start < window) {
+        if (LoRa.parsePacket() != (int)LORA_ACK_FRAME_SIZE) {
+            delay(1);
+            continue;
+        }
+        
+        uint8_t ack[LORA_ACK_FRAME_SIZE];
+        for (size_t i = 0; i < sizeof(ack); i++) {
+            ack[i] = LoRa.read();
+        }
+        
+        uint8_t ackedNode;
+        uint16_t ackedCRC;
+        float snr;
+        int16_t rssi;
+        if (decodeLoRaAck(ack, sizeof(ack), ackedNode, ackedCRC, snr, rssi) && ackedNode == nodeId &&
+            ackedCRC == crc) {
+            LoRa.idle();
+            scheduler->recordAck(snr, rssi);
+            return;
+        }
+    }
+    
+    LoRa.idle();
+    scheduler->recordMissedAck();
+}
+
+void LoRaSink::applySettings() {
+    if (!scheduler->takeSettingsChange()) {
+        return;
+    }
+    
+    LoRa.setSpreadingFactor(scheduler->getSpreadingFactor());
+    LoRa.setTxPower(scheduler->getTxPower());
+    Serial.printf("LoRa: Now SF%u at %d dBm\n", scheduler->getSpreadingFactor(), scheduler->getTxPower());
+}
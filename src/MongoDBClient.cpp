@@ -1,8 +1,8 @@
 #include "MongoDBClient.h"
 
-WellPumpMongoClient::WellPumpMongoClient(const String& url, const String& key, 
+WellPumpMongoClient::WellPumpMongoClient(const String& url, const String& key,
                                         const String& dataSource, const String& db,
-                                        const String& device, const String& loc)
+                                        const String& device, const String& loc, SequenceCounter* sequences)
 {
     mongoURL = url;
     apiKey = key;
@@ -15,28 +15,67 @@ WellPumpMongoClient::WellPumpMongoClient(const String& url, const String& key,
     eventCollection = "events";
     
     httpClient = nullptr;
+    secureClient = nullptr;
+    plainClient = nullptr;
     connected = false;
     initialized = false;
     lastConnectionTest = 0;
     lastRetryTime = 0;
+    retryDelay = RETRY_DELAY;
+    lastRequestTime = 0;
+    lastDrainFailure = 0;
     retryCount = 0;
     maxRetries = 3;
-    
-    bufferSize = BUFFER_SIZE;
-    buffer = new DataBuffer[bufferSize];
-    bufferIndex = 0;
-    bufferedCount = 0;
-    
-    for (uint8_t i = 0; i < bufferSize; i++) {
-        buffer[i].valid = false;
-    }
+    lastHttpStatusCode = -1;
+    
+    requestCount = 0;
+    connectionCount = 0;
+    reusedCount = 0;
+    insertManyCount = 0;
+    documentsWritten = 0;
+    duplicateCount = 0;
+    lastRequestDuration = 0;
+    
+    breaker = new CircuitBreaker(SLOW_REQUEST_TIME);
+    rateLimiter = new TokenBucket(RATE_LIMIT_BURST, RATE_LIMIT_PER_MINUTE);
+    deferredCount = 0;
+    lastRequestDeferred = false;
+    yieldCallback = nullptr;
+    yieldContext = nullptr;
+    
+    payloadBuffer = new char[PAYLOAD_BUFFER_SIZE];
+    payloadBuffer[0] = '\0';
+    buildRequestStrings();
+    
+    // Own outbox, as the HTTP API sink may be running too; numbering is
+    // the pipeline's, shared with every other sink
+    outbox = new FlashOutbox("mongoq");
+    sequenceCounter = sequences;
+    batchRecords = new AggregatedData[MAX_BATCH_SIZE];
+    lastAckedSequence = 0;
 }
 
 WellPumpMongoClient::~WellPumpMongoClient() {
     disconnect();
-    if (buffer) {
-        delete[] buffer;
-        buffer = nullptr;
+    if (outbox) {
+        delete outbox;
+        outbox = nullptr;
+    }
+    if (batchRecords) {
+        delete[] batchRecords;
+        batchRecords = nullptr;
+    }
+    if (payloadBuffer) {
+        delete[] payloadBuffer;
+        payloadBuffer = nullptr;
+    }
+    if (breaker) {
+        delete breaker;
+        breaker = nullptr;
+    }
+    if (rateLimiter) {
+        delete rateLimiter;
+        rateLimiter = nullptr;
     }
 }
 
@@ -45,33 +84,37 @@ bool WellPumpMongoClient::begin() {
         return true;
     }
     
+    if (!outbox->isReady() && !outbox->begin()) {
+        Serial.println("MongoDB: Flash outbox unavailable, unsent data will be lost");
+    }
+    
     if (!validateConfiguration()) {
         return false;
     }
     
-    if (httpClient) {
-        delete httpClient;
+    if (!setupHTTPClient()) {
+        return false;
     }
-    httpClient = new HTTPClient();
     
     initialized = true;
     return testConnection();
 }
 
 bool WellPumpMongoClient::validateConfiguration() const {
-    return mongoURL.length() > 0 && 
-           apiKey.length() > 0 && 
-           dataSource.length() > 0 && 
+    return mongoURL.length() > 0 &&
+           apiKey.length() > 0 &&
+           dataSource.length() > 0 &&
            database.length() > 0 &&
            deviceName.length() > 0;
 }
 
-void WellPumpMongoClient::setCredentials(const String& url, const String& key, 
+void WellPumpMongoClient::setCredentials(const String& url, const String& key,
                                         const String& dataSource, const String& db) {
     mongoURL = url;
     apiKey = key;
     this->dataSource = dataSource;
     database = db;
+    buildRequestStrings();
     
     if (initialized) {
         disconnect();
@@ -79,40 +122,93 @@ void WellPumpMongoClient::setCredentials(const String& url, const String& key,
     }
 }
 
+void WellPumpMongoClient::buildRequestStrings() {
+    insertOneURL = mongoURL + "/action/insertOne";
+    insertManyURL = mongoURL + "/action/insertMany";
+    findOneURL = mongoURL + "/action/findOne";
+    findURL = mongoURL + "/action/find";
+    authHeader = "Bearer " + apiKey;
+}
+
+bool WellPumpMongoClient::setupHTTPClient() {
+    cleanupHTTPClient();
+    
+    // Atlas only serves HTTPS; plain HTTP is for a local stand-in. The
+    // certificate isn't checked, as with the previous per-request client.
+    if (mongoURL.startsWith("https://")) {
+        secureClient = new SecureTransport();
+        secureClient->setVerification(TLS_VERIFY_NONE, "");
+    } else {
+        plainClient = new WiFiClient();
+    }
+
+    httpClient = new HTTPClient();
+    httpClient->setReuse(true);
+    
+    static const char* responseHeaders[] = { "Retry-After" };
+    httpClient->collectHeaders(responseHeaders, 1);
+    return true;
+}
+
+void WellPumpMongoClient::cleanupHTTPClient() {
+    if (httpClient) {
+        httpClient->end();
+        delete httpClient;
+        httpClient = nullptr;
+    }
+    if (secureClient) {
+        secureClient->stop();
+        delete secureClient;
+        secureClient = nullptr;
+    }
+    if (plainClient) {
+        plainClient->stop();
+        delete plainClient;
+        plainClient = nullptr;
+    }
+}
+
+WiFiClient* WellPumpMongoClient::transport() const {
+    if (secureClient) return secureClient;
+    return plainClient;
+}
+
+void WellPumpMongoClient::closeIdleConnection() {
+    WiFiClient* client = transport();
+    if (client && client->connected() && millis() - lastRequestTime > KEEPALIVE_IDLE_TIMEOUT) {
+        client->stop();
+    }
+}
+
 bool WellPumpMongoClient::testConnection() {
     if (!httpClient) return false;
-    
+
+    // Only a good result is cached; while disconnected, update()'s backoff
+    // decides how often to test
     unsigned long now = millis();
-    if (now - lastConnectionTest < CONNECTION_TEST_INTERVAL) {
+    if (connected && now - lastConnectionTest < CONNECTION_TEST_INTERVAL) {
+        return true;
+    }
+    if (!uplinkReady()) {
+        deferredCount++;
         return connected;
     }
-    
+
     // Test connection by trying to find one document (should return 200 even if empty)
-    JsonDocument testDoc;
-    testDoc["dataSource"] = dataSource;
-    testDoc["database"] = database;
-    testDoc["collection"] = sensorCollection;
-    testDoc["filter"] = JsonObject();
-    testDoc["limit"] = 1;
-    
-    String testPayload;
-    serializeJson(testDoc, testPayload);
-    
-    httpClient->begin(mongoURL + "/action/findOne");
-    httpClient->addHeader("Content-Type", "application/json");
-    httpClient->addHeader("Authorization", "Bearer " + apiKey);
-    
-    int httpResponseCode = httpClient->POST(testPayload);
-    
-    connected = (httpResponseCode == 200);
+    JsonWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+    beginCommand(writer, sensorCollection);
+    writer.key("filter");
+    writer.beginObject();
+    writer.endObject();
+    writer.endObject();
+
+    connected = postAction(findOneURL, writer.c_str(), writer.size());
     lastConnectionTest = now;
-    
-    httpClient->end();
-    
+
     if (connected) {
         resetRetryCount();
     }
-    
+
     return connected;
 }
 
@@ -122,195 +218,458 @@ bool WellPumpMongoClient::connect() {
 }
 
 void WellPumpMongoClient::disconnect() {
-    if (httpClient) {
-        httpClient->end();
-        delete httpClient;
-        httpClient = nullptr;
-    }
+    cleanupHTTPClient();
     connected = false;
 }
 
-bool WellPumpMongoClient::writeAggregatedData(const AggregatedData& data) {
+bool WellPumpMongoClient::writeAggregatedData(const AggregatedData& aggregate) {
+    // Numbered once, before the first attempt; buffered copies keep it
+    AggregatedData data = aggregate;
+    if (data.sequence == 0 && sequenceCounter) {
+        data.sequence = sequenceCounter->allocate();
+    }
+    return sendRecord(data, nullptr, 0) == SINK_DELIVERED;
+}
+
+SinkResult WellPumpMongoClient::deliver(const AggregatedData& data, const uint8_t* payload, size_t length) {
+    return sendRecord(data, payload, length);
+}
+
+size_t WellPumpMongoClient::encode(const AggregatedData& data, uint8_t* out, size_t size) {
+    JsonWriter writer((char*)out, size);
+    writeSensorDocument(writer, data);
+    return writer.overflowed() ? 0 : writer.size();
+}
+
+SinkResult WellPumpMongoClient::sendRecord(const AggregatedData& data, const uint8_t* payload, size_t length) {
     if (!initialized || !connected) {
-        addToBuffer(data);
-        return false;
+        return addToBuffer(data) ? SINK_BUFFERED : SINK_RETRY;
     }
-    
-    if (writeDataDocument(data)) {
-        resetRetryCount();
-        return true;
+    if (!uplinkReady()) {
+        deferredCount++;
+        return addToBuffer(data) ? SINK_BUFFERED : SINK_RETRY;
+    }
+
+    if (outbox->pendingCount() > 0) {
+        // Queue behind the backlog so documents arrive in order
+        if (!addToBuffer(data)) return SINK_RETRY;
+        processBuffer();
+        return outbox->pendingCount() == 0 ? SINK_DELIVERED : SINK_BUFFERED;
+    }
+
+    JsonWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+    beginCommand(writer, sensorCollection);
+    writer.key("document");
+    if (payload) {
+        writer.raw((const char*)payload, length);
     } else {
-        addToBuffer(data);
-        return false;
+        writeSensorDocument(writer, data);
     }
-}
+    writer.endObject();
 
-bool WellPumpMongoClient::writeEvent(const Event& event) {
-    if (!initialized || !connected) {
-        return false;
+    String response;
+    if (!writer.overflowed() && (postAction(insertOneURL, writer.c_str(), writer.size(), &response) ||
+                                 isDuplicateKey(response))) {
+        documentsWritten++;
+        lastAckedSequence = data.sequence;
+        resetRetryCount();
+        return SINK_DELIVERED;
     }
-    
-    return writeEventDocument(event);
+
+    lastDrainFailure = millis();
+    return addToBuffer(data) ? SINK_BUFFERED : SINK_RETRY;
 }
 
-bool WellPumpMongoClient::writeDataDocument(const AggregatedData& data) {
-    String document = createSensorDocument(data);
-    return insertDocument(sensorCollection, document);
+bool WellPumpMongoClient::writeEvent(const Event& event, bool heartbeat) {
+    OutboxEntry entry;
+    entry.event = event;
+    entry.heartbeat = heartbeat;
+    entry.lostBefore = 0;
+    entry.firstSequence = event.sequence;
+    entry.relayed = false;
+    return writeEvents(&entry, 1) == 1;
 }
 
-bool WellPumpMongoClient::writeEventDocument(const Event& event) {
-    String document = createEventDocument(event);
-    return insertDocument(eventCollection, document);
+uint8_t WellPumpMongoClient::writeEvents(const OutboxEntry* entries, uint8_t count) {
+    if (!initialized || !connected || count == 0) {
+        return 0;
+    }
+    // One insertMany for the lot, so it only takes the critical lane when
+    // every event in it would
+    bool critical = true;
+    for (uint8_t i = 0; i < count; i++) {
+        critical = critical && !entries[i].heartbeat && isCriticalEvent(entries[i].event.type);
+    }
+    if (!uplinkReady(critical)) {
+        deferredCount++;
+        return 0; // Stays in the event outbox until the uplink is let through again
+    }
+
+    JsonWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+    beginCommand(writer, eventCollection);
+    writer.key("documents");
+    writer.beginArray();
+    uint8_t written = 0;
+    for (; written < count; written++) {
+        JsonMark before = writer.mark();
+        writeEventDocument(writer, entries[written]);
+        if (writer.overflowed()) {
+            writer.rewind(before);
+            break;
+        }
+    }
+    writer.endArray();
+    writer.endObject();
+    if (written == 0 || writer.overflowed()) {
+        return 0;
+    }
+
+    String response;
+    if (postAction(insertManyURL, writer.c_str(), writer.size(), &response, critical)) {
+        insertManyCount++;
+        documentsWritten += written;
+        return written;
+    }
+    if (!isDuplicateKey(response)) {
+        return 0;
+    }
+
+    // Part of the batch was stored by an attempt whose response was lost
+    for (uint8_t i = 0; i < written; i++) {
+        writer.reset();
+        beginCommand(writer, eventCollection);
+        writer.key("document");
+        writeEventDocument(writer, entries[i]);
+        writer.endObject();
+        if (postAction(insertOneURL, writer.c_str(), writer.size(), &response, critical)) {
+            documentsWritten++;
+        } else if (isDuplicateKey(response)) {
+            duplicateCount++;
+        } else {
+            return i;
+        }
+    }
+    return written;
 }
 
-bool WellPumpMongoClient::insertDocument(const String& collection, const String& document) {
+bool WellPumpMongoClient::postAction(const String& url, const char* body, size_t length, String* response,
+                                     bool critical) {
     if (!httpClient) return false;
-    
-    JsonDocument insertDoc;
-    insertDoc["dataSource"] = dataSource;
-    insertDoc["database"] = database;
-    insertDoc["collection"] = collection;
-    
-    JsonDocument docObj;
-    deserializeJson(docObj, document);
-    insertDoc["document"] = docObj;
-    
-    String payload;
-    serializeJson(insertDoc, payload);
-    
-    httpClient->begin(mongoURL + "/action/insertOne");
-    httpClient->addHeader("Content-Type", "application/json");
-    httpClient->addHeader("Authorization", "Bearer " + apiKey);
-    
-    int httpResponseCode = httpClient->POST(payload);
-    
+
+    lastRequestDeferred = !admitRequest(critical);
+    if (lastRequestDeferred) {
+        return false;
+    }
+
+    closeIdleConnection();
+    WiFiClient* client = transport();
+    bool reused = client->connected();
+
+    unsigned long started = millis();
+    int httpResponseCode = 0;
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+        if (client->connected()) {
+            reusedCount++;
+        } else {
+            connectionCount++;
+        }
+        httpClient->begin(*client, url);
+        httpClient->addHeader("Content-Type", "application/json");
+        httpClient->addHeader("Authorization", authHeader);
+        httpClient->setTimeout(REQUEST_TIMEOUT);
+        httpResponseCode = httpClient->POST((uint8_t*)body, length);
+    
+        // A kept-alive socket the server has since closed fails before
+        // anything is sent; reconnect and try once more
+        bool stale = httpResponseCode == HTTPC_ERROR_SEND_HEADER_FAILED ||
+                     httpResponseCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+                     httpResponseCode == HTTPC_ERROR_NOT_CONNECTED ||
+                     httpResponseCode == HTTPC_ERROR_CONNECTION_LOST;
+        if (!reused || !stale || attempt > 0) {
+            break;
+        }
+        httpClient->end();
+        client->stop();
+    }
+
+    lastRequestTime = millis();
+    lastRequestDuration = lastRequestTime - started;
+    requestCount++;
+    lastHttpStatusCode = httpResponseCode;
+    recordOutcome(httpResponseCode, lastRequestDuration);
+
     bool success = (httpResponseCode == 201 || httpResponseCode == 200);
-    
+    String reply = httpResponseCode > 0 ? httpClient->getString() : String("");
     if (!success) {
-        Serial.print("MongoDB insert failed. HTTP code: ");
+        Serial.print("MongoDB request failed. HTTP code: ");
         Serial.println(httpResponseCode);
-        String response = httpClient->getString();
-        if (response.length() > 0) {
-            Serial.println("Response: " + response);
+        if (reply.length() > 0 && reply.length() < 500) {
+            Serial.println("Response: " + reply);
         }
     }
-    
+    if (response) {
+        *response = reply;
+    }
+
+    // With reuse enabled this leaves the socket open for the next request
     httpClient->end();
     return success;
 }
 
-String WellPumpMongoClient::createSensorDocument(const AggregatedData& data) {
-    JsonDocument doc;
-    
-    doc["device"] = deviceName;
-    doc["location"] = location;
-    doc["timestamp"] = formatTimestamp(data.endTime);
-    doc["startTime"] = formatTimestamp(data.startTime);
-    doc["endTime"] = formatTimestamp(data.endTime);
-    doc["sampleCount"] = data.sampleCount;
-    
-    // Temperature data
-    JsonObject temp = doc["temperature"].to<JsonObject>();
-    temp["min"] = data.tempMin;
-    temp["max"] = data.tempMax;
-    temp["avg"] = data.tempAvg;
-    
-    // Humidity data
-    JsonObject hum = doc["humidity"].to<JsonObject>();
-    hum["min"] = data.humMin;
-    hum["max"] = data.humMax;
-    hum["avg"] = data.humAvg;
-    
-    // Pressure data
-    JsonObject press = doc["pressure"].to<JsonObject>();
-    press["min"] = data.pressMin;
-    press["max"] = data.pressMax;
-    press["avg"] = data.pressAvg;
-    
-    // Current 1 data
-    JsonObject curr1 = doc["current1"].to<JsonObject>();
-    curr1["min"] = data.current1Min;
-    curr1["max"] = data.current1Max;
-    curr1["avg"] = data.current1Avg;
-    curr1["rms"] = data.current1RMS;
-    curr1["dutyCycle"] = data.dutyCycle1;
-    
-    // Current 2 data
-    JsonObject curr2 = doc["current2"].to<JsonObject>();
-    curr2["min"] = data.current2Min;
-    curr2["max"] = data.current2Max;
-    curr2["avg"] = data.current2Avg;
-    curr2["rms"] = data.current2RMS;
-    curr2["dutyCycle"] = data.dutyCycle2;
-    
-    String result;
-    serializeJson(doc, result);
-    return result;
+bool WellPumpMongoClient::uplinkReady(bool critical) {
+    if (critical) {
+        return rateLimiter->available();
+    }
+    return rateLimiter->available(CRITICAL_TOKEN_RESERVE) && breaker->wouldAllow();
 }
 
-String WellPumpMongoClient::createEventDocument(const Event& event) {
-    JsonDocument doc;
-    
-    doc["device"] = deviceName;
-    doc["location"] = location;
-    doc["timestamp"] = formatTimestamp(event.startTime);
-    doc["type"] = (int)event.type;
-    doc["value"] = event.value;
-    doc["threshold"] = event.threshold;
-    doc["startTime"] = formatTimestamp(event.startTime);
-    doc["duration"] = event.duration;
-    doc["active"] = event.active;
-    doc["description"] = event.description;
-    
-    String result;
-    serializeJson(doc, result);
-    return result;
+bool WellPumpMongoClient::admitRequest(bool critical) {
+    // As in the API client: critical events aren't held by the breaker or
+    // Retry-After, only by the bucket
+    if (critical) {
+        if (!rateLimiter->take()) {
+            deferredCount++;
+            return false;
+        }
+        return true;
+    }
+
+    // Tokens first, so the breaker's half-open probe is only claimed by a
+    // request that is actually sent
+    if (!rateLimiter->available(CRITICAL_TOKEN_RESERVE) || !breaker->allowRequest()) {
+        deferredCount++;
+        return false;
+    }
+    rateLimiter->take(CRITICAL_TOKEN_RESERVE);
+    return true;
 }
 
-String WellPumpMongoClient::formatTimestamp(unsigned long timestamp) {
-    // Convert milliseconds to ISO 8601 format
-    // For simplicity, we'll use the timestamp as-is, but in production
-    // you might want to convert to proper ISO format
-    return String(timestamp);
+void WellPumpMongoClient::recordOutcome(int httpCode, unsigned long duration) {
+    // Other 4xx are about the request, not the server's health
+    bool failed = httpCode <= 0 || httpCode >= 500 || httpCode == 429 || httpCode == 408;
+    breaker->record(failed, duration);
+
+    if (httpCode == 429 || httpCode == 503) {
+        long seconds = httpClient->header("Retry-After").toInt();
+        if (seconds > 0) {
+            breaker->holdOff(min(seconds, MAX_RETRY_AFTER) * 1000UL);
+        }
+    }
 }
 
-void WellPumpMongoClient::addToBuffer(const AggregatedData& data) {
-    buffer[bufferIndex].data = data;
-    buffer[bufferIndex].timestamp = millis();
-    buffer[bufferIndex].valid = true;
-    
-    bufferIndex = (bufferIndex + 1) % bufferSize;
-    if (bufferedCount < bufferSize) {
-        bufferedCount++;
+bool WellPumpMongoClient::isDuplicateKey(const String& response) {
+    return response.indexOf("E11000") >= 0 || response.indexOf("duplicate key") >= 0;
+}
+
+void WellPumpMongoClient::beginCommand(JsonWriter& writer, const String& collection) {
+    writer.beginObject();
+    writer.field("dataSource", dataSource.c_str());
+    writer.field("database", database.c_str());
+    writer.field("collection", collection.c_str());
+}
+
+void WellPumpMongoClient::writeSensorDocument(JsonWriter& writer, const AggregatedData& data) {
+    char id[ID_SIZE];
+    char endTime[12];
+    formatSensorId(data, id, sizeof(id));
+    formatTimestamp(data.endTime, endTime, sizeof(endTime));
+
+    writer.beginObject();
+    writer.field("_id", id);
+    writer.field("device", deviceName.c_str());
+    writer.field("location", location.c_str());
+    writer.field("timestamp", endTime);
+    writeAggregateFields(writer, data, LAYOUT_GROUPED, TIME_SECONDS_STRING, true);
+    writer.endObject();
+}
+
+void WellPumpMongoClient::writeEventDocument(JsonWriter& writer, const OutboxEntry& entry) {
+    const Event& event = entry.event;
+    char startTime[12];
+    formatTimestamp(event.startTime, startTime, sizeof(startTime));
+
+    writer.beginObject();
+    if (!entry.heartbeat) {
+        // Heartbeats are deliberate repeats and get a generated _id
+        char id[ID_SIZE];
+        snprintf(id, sizeof(id), "%s-e%lu-%lu", deviceName.c_str(), (unsigned long)event.startTime,
+                 (unsigned long)event.sequence);
+        writer.field("_id", id);
+    }
+    writer.field("device", deviceName.c_str());
+    writer.field("location", location.c_str());
+    writer.field("timestamp", startTime);
+    writer.field("type", (int)event.type);
+    writer.field("value", event.value);
+    writer.field("threshold", event.threshold);
+    writer.field("startTime", startTime);
+    writer.field("duration", event.duration);
+    writer.field("active", event.active);
+    writer.field("description", eventDescription(event.type));
+    writer.field("sequence", event.sequence);
+    writer.field("state", eventStateName(event.state));
+    writer.field("heartbeat", entry.heartbeat);
+    if (entry.lostBefore > 0) {
+        writer.field("lostBefore", entry.lostBefore);
+    }
+    writer.endObject();
+}
+
+void WellPumpMongoClient::formatSensorId(const AggregatedData& data, char* out, size_t size) {
+    snprintf(out, size, "%s-s%lu", deviceName.c_str(), (unsigned long)data.sequence);
+}
+
+void WellPumpMongoClient::formatTimestamp(unsigned long timestamp, char* out, size_t size) {
+    // Stored as the decimal string of the timestamp, as before
+    snprintf(out, size, "%lu", timestamp);
+}
+
+bool WellPumpMongoClient::addToBuffer(const AggregatedData& data) {
+    if (!outbox->append(data)) {
+        Serial.println("MongoDB: Failed to buffer data");
+        return false;
     }
+    return true;
 }
 
 bool WellPumpMongoClient::processBuffer() {
-    if (bufferedCount == 0 || !connected) {
+    // Held by the rate limit or breaker isn't a failure; the drain resumes
+    // on a later update()
+    if (outbox->pendingCount() == 0 || !connected || !uplinkReady()) {
         return true;
     }
-    
+
+    uint32_t processed = 0;
     bool allSuccess = true;
-    uint8_t processed = 0;
-    
-    for (uint8_t i = 0; i < bufferSize && processed < bufferedCount; i++) {
-        if (buffer[i].valid) {
-            if (writeDataDocument(buffer[i].data)) {
-                buffer[i].valid = false;
-                processed++;
-            } else {
-                allSuccess = false;
-                break; // Stop on first failure to avoid overwhelming the server
-            }
+
+    while (outbox->pendingCount() > 0 && uplinkReady()) {
+        // Let critical events out between inserts; payloadBuffer is free here
+        if (processed > 0 && yieldCallback) {
+            yieldCallback(yieldContext);
+            if (!uplinkReady()) break;
+        }
+
+        uint8_t count = outbox->peek(batchRecords, MAX_BATCH_SIZE);
+        if (count == 0) break;
+    
+        uint8_t written = 0;
+        bool success = insertSensorBatch(batchRecords, count, written);
+        if (written > 0) {
+            lastAckedSequence = batchRecords[written - 1].sequence;
+            outbox->acknowledge(written);
+            processed += written;
+        }
+        if (!success && lastRequestDeferred) {
+            break;
+        }
+        if (!success) {
+            allSuccess = false;
+            break; // Stop on first failure to avoid overwhelming the server
         }
     }
-    
-    // Update buffered count
-    bufferedCount -= processed;
-    
+
+    if (!allSuccess) {
+        lastDrainFailure = millis();
+    }
+    if (processed > 0) {
+        Serial.printf("MongoDB: Wrote %lu buffered documents, %lu remaining\n", (unsigned long)processed,
+                      (unsigned long)outbox->pendingCount());
+    }
+
     return allSuccess;
 }
 
+bool WellPumpMongoClient::insertSensorBatch(const AggregatedData* records, uint8_t count, uint8_t& written) {
+    JsonWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+    beginCommand(writer, sensorCollection);
+    writer.key("documents");
+    writer.beginArray();
+    uint8_t fitted = 0;
+    for (; fitted < count; fitted++) {
+        // Send what fits; the rest stay in the outbox for the next batch
+        JsonMark before = writer.mark();
+        writeSensorDocument(writer, records[fitted]);
+        if (writer.overflowed()) {
+            writer.rewind(before);
+            break;
+        }
+    }
+    writer.endArray();
+    writer.endObject();
+    written = 0;
+    if (fitted == 0 || writer.overflowed()) {
+        Serial.println("MongoDB: Sensor document exceeds buffer");
+        return false;
+    }
+
+    String response;
+    if (postAction(insertManyURL, writer.c_str(), writer.size(), &response)) {
+        insertManyCount++;
+        documentsWritten += fitted;
+        written = fitted;
+        return true;
+    }
+    if (!isDuplicateKey(response)) {
+        return false;
+    }
+
+    // A batch whose response was lost was stored anyway. insertMany is
+    // ordered and the outbox is FIFO, so what exists is a prefix of this
+    // batch; look it up, settle it, and send the rest in the next batch.
+    uint8_t stored = 0;
+    if (!countStoredPrefix(records, fitted, stored) || stored == 0) {
+        return false;
+    }
+    duplicateCount += stored;
+    written = stored;
+    return true;
+}
+
+bool WellPumpMongoClient::countStoredPrefix(const AggregatedData* records, uint8_t count, uint8_t& stored) {
+    char id[ID_SIZE];
+    JsonWriter writer(payloadBuffer, PAYLOAD_BUFFER_SIZE);
+    beginCommand(writer, sensorCollection);
+    writer.key("filter");
+    writer.beginObject();
+    writer.key("_id");
+    writer.beginObject();
+    writer.key("$in");
+    writer.beginArray();
+    for (uint8_t i = 0; i < count; i++) {
+        formatSensorId(records[i], id, sizeof(id));
+        writer.value(id);
+    }
+    writer.endArray();
+    writer.endObject();
+    writer.endObject();
+    writer.key("projection");
+    writer.beginObject();
+    writer.field("_id", 1);
+    writer.endObject();
+    writer.endObject();
+
+    String response;
+    if (writer.overflowed() || !postAction(findURL, writer.c_str(), writer.size(), &response)) {
+        return false;
+    }
+
+    // Ids are matched with their closing quote so "-s12" doesn't match "-s120"
+    stored = 0;
+    while (stored < count) {
+        char quoted[ID_SIZE + 2];
+        formatSensorId(records[stored], id, sizeof(id));
+        snprintf(quoted, sizeof(quoted), "\"%s\"", id);
+        if (response.indexOf(quoted) < 0) break;
+        stored++;
+    }
+    return true;
+}
+
+void WellPumpMongoClient::setYieldCallback(SinkYieldCallback callback, void* context) {
+    yieldCallback = callback;
+    yieldContext = context;
+}
+
 bool WellPumpMongoClient::flushBuffer() {
     return processBuffer();
 }
@@ -319,28 +678,33 @@ void WellPumpMongoClient::update() {
     if (!initialized) {
         return;
     }
-    
+
     unsigned long now = millis();
-    
+
     // Handle retry logic
-    if (!connected && (now - lastRetryTime > getRetryDelay())) {
+    if (!connected && now - lastRetryTime > retryDelay && uplinkReady()) {
         if (testConnection()) {
             processBuffer(); // Try to flush buffer when reconnected
         } else {
             retryCount++;
             lastRetryTime = now;
+            retryDelay = getRetryDelay();
         }
     }
-    
-    // Process buffer periodically even when connected
-    if (connected && bufferedCount > 0) {
+
+    // Drain the outbox while connected, holding off after a failed drain
+    if (connected && outbox->pendingCount() > 0 && now - lastDrainFailure > RETRY_DELAY) {
         processBuffer();
     }
+
+    closeIdleConnection();
 }
 
 unsigned long WellPumpMongoClient::getRetryDelay() const {
     unsigned long delay = RETRY_DELAY * (1UL << min(retryCount, (uint16_t)4)); // Exponential backoff
-    return min(delay, MAX_RETRY_DELAY);
+    delay = min(delay, MAX_RETRY_DELAY);
+    // Random point in the upper half, so devices don't retry in lockstep
+    return delay / 2 + random(delay / 2 + 1);
 }
 
 String WellPumpMongoClient::getConnectionStatus() const {
@@ -348,8 +712,8 @@ String WellPumpMongoClient::getConnectionStatus() const {
         return "Not initialized";
     }
     if (connected) {
-        if (bufferedCount > 0) {
-            return "Connected (buffer: " + String(bufferedCount) + ")";
+        if (outbox->pendingCount() > 0) {
+            return "Connected (buffer: " + String(outbox->pendingCount()) + ")";
         }
         return "Connected";
     }
@@ -362,4 +726,4 @@ String WellPumpMongoClient::getConnectionStatus() const {
 String WellPumpMongoClient::getLastError() const {
     if (!httpClient) return "No HTTP client";
     return "HTTP error";
-}
\ No newline at end of file
+}
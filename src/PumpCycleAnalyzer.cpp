@@ -0,0 +1,135 @@
+#include "PumpCycleAnalyzer.h"
+
+PumpCycleAnalyzer::PumpCycleAnalyzer(float runCurrent, float ewmaAlpha, float anomalyScore) {
+    runningCurrent = runCurrent;
+    alpha = ewmaAlpha;
+    scoreThreshold = anomalyScore;
+    reset();
+}
+
+void PumpCycleAnalyzer::reset() {
+    running = false;
+    idleSeen = false;
+    runStartObserved = false;
+    runStartTime = 0;
+    lastRunSampleTime = 0;
+    runStartPressure = 0.0;
+    lastRunPressure = 0.0;
+    peakCurrent = 0.0;
+    steadySum = 0.0;
+    steadyCount = 0;
+    
+    memset(&baseline, 0, sizeof(baseline));
+    memset(&lastCycle, 0, sizeof(lastCycle));
+    lastScore = 0.0;
+    totalCycles = 0;
+}
+
+bool PumpCycleAnalyzer::processSample(const SensorData& data) {
+    unsigned long now = data.sampleTime;
+    float current = max(data.current1, data.current2);
+    bool pumpOn = current >= runningCurrent;
+    
+    if (pumpOn && !running) {
+        running = true;
+        runStartObserved = idleSeen;
+        runStartTime = now;
+        runStartPressure = data.pressure;
+        peakCurrent = current;
+        steadySum = 0.0;
+        steadyCount = 0;
+    } else if (pumpOn && running) {
+        if (now - runStartTime <= INRUSH_WINDOW) {
+            if (current > peakCurrent) peakCurrent = current;
+        } else {
+            steadySum += current;
+            steadyCount++;
+        }
+    } else if (!pumpOn && running) {
+        running = false;
+        idleSeen = true;
+        // A run joined part way through would teach the baseline a short,
+        // flat cycle
+        if (runStartObserved && lastRunSampleTime - runStartTime >= MIN_RUN_TIME && steadyCount > 0) {
+            completeCycle(lastRunSampleTime);
+            return true;
+        }
+        return false;
+    }
+    
+    if (running) {
+        lastRunSampleTime = now;
+        lastRunPressure = data.pressure;
+    } else {
+        idleSeen = true;
+    }
+    
+    return false;
+}
+
+void PumpCycleAnalyzer::getStats(CycleStats& stats) const {
+    stats.baseline = baseline;
+    stats.lastCycle = lastCycle;
+    stats.lastScore = lastScore;
+    stats.totalCycles = totalCycles;
+    stats.running = running;
+}
+
+void PumpCycleAnalyzer::completeCycle(unsigned long endTime) {
+    CycleSignature cycle;
+    cycle.inrushPeak = peakCurrent;
+    cycle.steadyCurrent = steadySum / steadyCount;
+    cycle.runTime = (endTime - runStartTime) / 1000.0;
+    cycle.pressureRiseRate = (lastRunPressure - runStartPressure) / (cycle.runTime / 60.0);
+    
+    lastCycle = cycle;
+    totalCycles++;
+    
+    lastScore = isBaselineReady() ? scoreCycle(cycle) : 0.0;
+    
+    // Let anomalous cycles nudge the baseline only slightly so faults don't become normal
+    float weight = isLastCycleAnomalous() ? alpha / 4.0 : alpha;
+    updateBaseline(cycle, weight);
+    
+    Serial.printf("Pump cycle: peak=%.2fA steady=%.2fA run=%.0fs rise=%.1fPSI/min score=%.2f\n",
+                  cycle.inrushPeak, cycle.steadyCurrent, cycle.runTime,
+                  cycle.pressureRiseRate, lastScore);
+}
+
+float PumpCycleAnalyzer::scoreCycle(const CycleSignature& cycle) const {
+    // Worst per-feature deviation in units of baseline sigma
+    float score = featureScore(cycle.inrushPeak, baseline.mean.inrushPeak, baseline.variance.inrushPeak);
+    score = max(score, featureScore(cycle.steadyCurrent, baseline.mean.steadyCurrent, baseline.variance.steadyCurrent));
+    score = max(score, featureScore(cycle.runTime, baseline.mean.runTime, baseline.variance.runTime));
+    score = max(score, featureScore(cycle.pressureRiseRate, baseline.mean.pressureRiseRate, baseline.variance.pressureRiseRate));
+    return score;
+}
+
+void PumpCycleAnalyzer::updateBaseline(const CycleSignature& cycle, float weight) {
+    if (baseline.cycleCount == 0) {
+        baseline.mean = cycle;
+        memset(&baseline.variance, 0, sizeof(baseline.variance));
+    } else {
+        updateFeature(cycle.inrushPeak, baseline.mean.inrushPeak, baseline.variance.inrushPeak, weight);
+        updateFeature(cycle.steadyCurrent, baseline.mean.steadyCurrent, baseline.variance.steadyCurrent, weight);
+        updateFeature(cycle.runTime, baseline.mean.runTime, baseline.variance.runTime, weight);
+        updateFeature(cycle.pressureRiseRate, baseline.mean.pressureRiseRate, baseline.variance.pressureRiseRate, weight);
+    }
+    
+    if (baseline.cycleCount < 0xFFFF) {
+        baseline.cycleCount++;
+    }
+}
+
+float PumpCycleAnalyzer::featureScore(float value, float mean, float variance) {
+    float sigma = sqrt(variance);
+    float floorSigma = max(SIGMA_FLOOR_ABS, SIGMA_FLOOR_RATIO * fabs(mean));
+    if (sigma < floorSigma) sigma = floorSigma;
+    return fabs(value - mean) / sigma;
+}
+
+void PumpCycleAnalyzer::updateFeature(float value, float& mean, float& variance, float weight) {
+    float diff = value - mean;
+    mean += weight * diff;
+    variance = (1.0 - weight) * (variance + weight * diff * diff);
+}
@@ -0,0 +1,301 @@
+#include "SecureTransport.h"
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/error.h>
+#include <mbedtls/md.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/version.h>
+#include <esp_arduino_version.h>
+
+// connect() fills the base class's sslclient_context and reads
+// mbedtls_ssl_context members directly. Both changed in arduino-esp32 3.x
+// (mbedTLS 3 makes the fields private), so platformio.ini pins a 2.0.x
+// platform; fail here rather than at some other struct layout.
+#if !defined(ESP_ARDUINO_VERSION_MAJOR) || ESP_ARDUINO_VERSION_MAJOR != 2
+#error "SecureTransport is written against arduino-esp32 2.0.x; check platform in platformio.ini"
+#endif
+#if MBEDTLS_VERSION_MAJOR != 2
+#error "SecureTransport reads mbedTLS 2.x ssl_context fields"
+#endif
+
+static const char DRBG_PERSONALIZATION[] = "wellpump-tls";
+
+SecureTransport::SecureTransport() {
+    verifyMode = TLS_VERIFY_NONE;
+    mbedtls_x509_crt_init(&pinnedCA);
+    pinReady = true;
+    memset(fingerprint, 0, sizeof(fingerprint));
+    
+    mbedtls_ssl_session_init(&session);
+    sessionValid = false;
+    sessionPort = 0;
+    
+    memset(&stats, 0, sizeof(stats));
+}
+
+SecureTransport::~SecureTransport() {
+    // Close first: the connection's config still points at pinnedCA
+    stop();
+    mbedtls_ssl_session_free(&session);
+    mbedtls_x509_crt_free(&pinnedCA);
+}
+
+bool SecureTransport::setVerification(TLSVerifyMode mode, const String& pin) {
+    clearSession();
+    mbedtls_x509_crt_free(&pinnedCA);
+    mbedtls_x509_crt_init(&pinnedCA);
+    verifyMode = mode;
+    pinReady = false;
+    
+    if (mode == TLS_VERIFY_CA) {
+        // PEM input length must include the terminator
+        int ret = mbedtls_x509_crt_parse(&pinnedCA, (const unsigned char*)pin.c_str(), pin.length() + 1);
+        if (ret != 0) {
+            Serial.printf("TLS: Could not parse the CA certificate (-0x%04X)\n", -ret);
+            return false;
+        }
+    } else if (mode == TLS_VERIFY_FINGERPRINT) {
+        if (!parseFingerprint(pin, fingerprint)) {
+            Serial.println("TLS: Fingerprint must be 64 hex digits (SHA-256)");
+            return false;
+        }
+    }
+    
+    pinReady = true;
+    return true;
+}
+
+int SecureTransport::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port, CONNECT_TIMEOUT);
+}
+
+int SecureTransport::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    return connect(ip.toString().c_str(), port, timeout);
+}
+
+int SecureTransport::connect(const char* host, uint16_t port) {
+    return connect(host, port, CONNECT_TIMEOUT);
+}
+
+int SecureTransport::connect(const char* host, uint16_t port, int32_t timeout) {
+    stop();
+    
+    if (!pinReady) {
+        Serial.println("TLS: No valid certificate pin configured, refusing to connect");
+        return fail(MBEDTLS_ERR_X509_CERT_VERIFY_FAILED);
+    }
+    
+    IPAddress address;
+    if (!WiFi.hostByName(host, address)) {
+        return fail(MBEDTLS_ERR_NET_UNKNOWN_HOST);
+    }
+    
+    sslclient->socket = openSocket(address, port, timeout);
+    if (sslclient->socket < 0) {
+        return fail(MBEDTLS_ERR_NET_CONNECT_FAILED);
+    }
+    
+    uint32_t heapBefore = ESP.getFreeHeap();
+    unsigned long started = millis();
+    
+    bool offered = sessionValid && sessionPort == port && sessionHost == host;
+    int ret = handshake(host, offered);
+    
+    // Resumption reuses the master secret; a full handshake negotiates a new one
+    bool resumed = ret == 0 && offered &&
+                   memcmp(sslclient->ssl_ctx.session->master, session.master, sizeof(session.master)) == 0;
+    
+    // A resumed session was already checked when it was first established
+    if (ret == 0 && !resumed && verifyMode == TLS_VERIFY_FINGERPRINT && !checkFingerprint()) {
+        ret = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+    }
+    
+    if (ret != 0) {
+        // Don't offer a session that led to a failure again
+        clearSession();
+        stop();
+        return fail(ret);
+    }
+    
+    unsigned long elapsed = millis() - started;
+    stats.lastHandshakeMs = elapsed;
+    if (resumed) {
+        stats.resumedHandshakes++;
+        stats.totalResumedMs += elapsed;
+    } else {
+        stats.fullHandshakes++;
+        stats.totalFullMs += elapsed;
+    }
+    uint32_t heapAfter = ESP.getFreeHeap();
+    stats.connectionHeap = heapBefore > heapAfter ? heapBefore - heapAfter : 0;
+    stats.minFreeHeap = ESP.getMinFreeHeap();
+    stats.lastError = 0;
+    
+    // Keep the session, including any renewed ticket, for the next connect
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    sessionValid = mbedtls_ssl_get_session(&sslclient->ssl_ctx, &session) == 0;
+    sessionHost = host;
+    sessionPort = port;
+    
+    _lastError = 0;
+    _connected = true;
+    return 1;
+}
+
+void SecureTransport::clearSession() {
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    sessionValid = false;
+}
+
+int SecureTransport::openSocket(IPAddress address, uint16_t port, int32_t timeout) {
+    int fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = (uint32_t)address;
+    server.sin_port = htons(port);
+    
+    // Non-blocking from here on, as the base client expects; connect is
+    // bounded by select() and the handshake by HANDSHAKE_TIMEOUT
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    
+    int ret = lwip_connect(fd, (struct sockaddr*)&server, sizeof(server));
+    if (ret < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(fd, &writable);
+    struct timeval wait;
+    wait.tv_sec = timeout / 1000;
+    wait.tv_usec = (timeout % 1000) * 1000;
+    if (select(fd + 1, nullptr, &writable, nullptr, &wait) <= 0) {
+        close(fd);
+        return -1;
+    }
+    
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+    return fd;
+}
+
+int SecureTransport::handshake(const char* host, bool offerSession) {
+    mbedtls_ssl_init(&sslclient->ssl_ctx);
+    mbedtls_ssl_config_init(&sslclient->ssl_conf);
+    mbedtls_ctr_drbg_init(&sslclient->drbg_ctx);
+    mbedtls_entropy_init(&sslclient->entropy_ctx);
+    
+    int ret = mbedtls_ctr_drbg_seed(&sslclient->drbg_ctx, mbedtls_entropy_func, &sslclient->entropy_ctx,
+                                    (const unsigned char*)DRBG_PERSONALIZATION, sizeof(DRBG_PERSONALIZATION) - 1);
+    if (ret != 0) return ret;
+    
+    ret = mbedtls_ssl_config_defaults(&sslclient->ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0) return ret;
+    
+    if (verifyMode == TLS_VERIFY_CA) {
+        mbedtls_ssl_conf_authmode(&sslclient->ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_ca_chain(&sslclient->ssl_conf, &pinnedCA, nullptr);
+    } else {
+        // Fingerprint mode checks the certificate after the handshake
+        mbedtls_ssl_conf_authmode(&sslclient->ssl_conf, MBEDTLS_SSL_VERIFY_NONE);
+    }
+    mbedtls_ssl_conf_rng(&sslclient->ssl_conf, mbedtls_ctr_drbg_random, &sslclient->drbg_ctx);
+    
+    ret = mbedtls_ssl_setup(&sslclient->ssl_ctx, &sslclient->ssl_conf);
+    if (ret != 0) return ret;
+    
+    ret = mbedtls_ssl_set_hostname(&sslclient->ssl_ctx, host);
+    if (ret != 0) return ret;
+    
+    if (offerSession && mbedtls_ssl_set_session(&sslclient->ssl_ctx, &session) != 0) {
+        // Not fatal; the server just gets a full handshake
+        clearSession();
+    }
+    
+    mbedtls_ssl_set_bio(&sslclient->ssl_ctx, &sslclient->socket, mbedtls_net_send, mbedtls_net_recv, nullptr);
+    
+    unsigned long started = millis();
+    while ((ret = mbedtls_ssl_handshake(&sslclient->ssl_ctx)) != 0) {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return ret;
+        }
+        if (millis() - started > HANDSHAKE_TIMEOUT) {
+            return MBEDTLS_ERR_SSL_TIMEOUT;
+        }
+        delay(2);
+    }
+    
+    return 0;
+}
+
+bool SecureTransport::checkFingerprint() {
+    const mbedtls_x509_crt* peer = mbedtls_ssl_get_peer_cert(&sslclient->ssl_ctx);
+    if (!peer) {
+        return false;
+    }
+    
+    uint8_t digest[32];
+    const mbedtls_md_info_t* sha256 = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    if (mbedtls_md(sha256, peer->raw.p, peer->raw.len, digest) != 0) {
+        return false;
+    }
+    
+    if (memcmp(digest, fingerprint, sizeof(digest)) != 0) {
+        Serial.println("TLS: Server certificate does not match the pinned fingerprint");
+        return false;
+    }
+    return true;
+}
+
+int SecureTransport::fail(int error) {
+    char message[96];
+    mbedtls_strerror(error, message, sizeof(message));
+    Serial.printf("TLS: Connect failed (-0x%04X): %s\n", -error, message);
+    
+    _lastError = error;
+    stats.lastError = error;
+    stats.failures++;
+    return 0;
+}
+
+bool SecureTransport::parseFingerprint(const String& text, uint8_t* out) {
+    uint8_t digits = 0;
+    for (size_t i = 0; i < text.length(); i++) {
+        char c = text[i];
+        if (c == ':' || c == ' ') continue;
+        
+        uint8_t nibble;
+        if (c >= '0' && c <= '9') nibble = c - '0';
+        else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+        else return false;
+        
+        if (digits >= 64) return false;
+        if (digits % 2 == 0) {
+            out[digits / 2] = nibble << 4;
+        } else {
+            out[digits / 2] |= nibble;
+        }
+        digits++;
+    }
+    return digits == 64;
+}
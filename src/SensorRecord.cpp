@@ -0,0 +1,128 @@
+#include "SensorRecord.h"
+
+const char* formatRecordTimestamp(unsigned long timestamp, char* out, size_t size) {
+    // Check if this looks like a unix timestamp or millis()
+    uint64_t timestampMs = 0;
+    if (timestamp > 1600000000) {
+        // Looks like a unix timestamp (seconds since epoch) - convert to milliseconds
+        // Use proper 64-bit arithmetic to avoid overflow
+        timestampMs = (uint64_t)timestamp * 1000ULL;
+    } else {
+        // Looks like millis() - this indicates NTP sync failed; 0 marks it invalid
+#ifdef API_DEBUG_PAYLOADS
+        Serial.printf("API: Warning - received millis timestamp %lu, NTP not synced!\n", timestamp);
+#endif
+    }
+    
+    // Sent as a string to keep the existing API contract
+    char digits[21];
+    uint8_t count = 0;
+    do {
+        digits[count++] = '0' + (timestampMs % 10);
+        timestampMs /= 10;
+    } while (timestampMs > 0);
+    
+    size_t length = 0;
+    while (count > 0 && length + 1 < size) {
+        out[length++] = digits[--count];
+    }
+    out[length] = '\0';
+    return out;
+}
+
+template <typename T>
+static void packField(uint8_t*& out, T value, uint16_t scale) {
+    if (std::is_floating_point<T>::value) {
+        int16_t fixed;
+        float scaled = (float)value * scale;
+        if (isnan(scaled)) {
+            fixed = INT16_MIN;
+        } else if (scaled >= INT16_MAX) {
+            fixed = INT16_MAX;
+        } else if (scaled <= -INT16_MAX) {
+            fixed = -INT16_MAX;
+        } else {
+            fixed = (int16_t)lroundf(scaled);
+        }
+        *out++ = (uint16_t)fixed & 0xFF;
+        *out++ = (uint16_t)fixed >> 8;
+        return;
+    }
+    
+    uint32_t bits = (uint32_t)value;
+    for (size_t i = 0; i < packedWidth<T>(); i++) {
+        *out++ = (bits >> (8 * i)) & 0xFF;
+    }
+}
+
+template <typename T>
+static void unpackField(const uint8_t*& in, T& value, uint16_t scale) {
+    if (std::is_floating_point<T>::value) {
+        int16_t fixed = (int16_t)(in[0] | (in[1] << 8));
+        in += 2;
+        value = fixed == INT16_MIN ? NAN : (float)fixed / scale;
+        return;
+    }
+    
+    uint32_t bits = 0;
+    for (size_t i = 0; i < packedWidth<T>(); i++) {
+        bits |= (uint32_t)*in++ << (8 * i);
+    }
+    value = (T)bits;
+}
+
+size_t packAggregate(const AggregatedData& data, uint8_t* out, size_t size) {
+    if (size < AGGREGATE_PACKED_SIZE) {
+        return 0;
+    }
+    
+#define AGGREGATE_PACK(type, member, kind, group, key, pack, record) \
+    if (pack) packField<type>(out, data.member, pack);
+    AGGREGATE_FIELDS(AGGREGATE_PACK)
+#undef AGGREGATE_PACK
+    return AGGREGATE_PACKED_SIZE;
+}
+
+bool unpackAggregate(const uint8_t* in, size_t length, AggregatedData& data) {
+    if (length < AGGREGATE_PACKED_SIZE) {
+        return false;
+    }
+    
+    memset(&data, 0, sizeof(data));
+#define AGGREGATE_UNPACK(type, member, kind, group, key, pack, record) \
+    if (pack) unpackField<type>(in, data.member, pack);
+    AGGREGATE_FIELDS(AGGREGATE_UNPACK)
+#undef AGGREGATE_UNPACK
+    return true;
+}
+
+static float mergeMetric(const char* key, float older, float newer, float olderWeight, float newerWeight) {
+    if (isnan(older)) return newer;
+    if (isnan(newer)) return older;
+    
+    if (strcmp(key, "min") == 0) return min(older, newer);
+    if (strcmp(key, "max") == 0) return max(older, newer);
+    
+    float total = olderWeight + newerWeight;
+    if (strcmp(key, "rms") == 0) {
+        return sqrtf((older * older * olderWeight + newer * newer * newerWeight) / total);
+    }
+    return (older * olderWeight + newer * newerWeight) / total;
+}
+
+void mergeAggregate(AggregatedData& into, const AggregatedData& next) {
+    // Weighted by samples; windows without a count weigh the same
+    float olderWeight = into.sampleCount > 0 || next.sampleCount > 0 ? into.sampleCount : 1;
+    float newerWeight = into.sampleCount > 0 || next.sampleCount > 0 ? next.sampleCount : 1;
+    
+#define AGGREGATE_MERGE(type, member, kind, group, key, pack, record) \
+    if (FIELD_##kind == FIELD_METRIC) { \
+        into.member = mergeMetric(key, into.member, next.member, olderWeight, newerWeight); \
+    } else if (FIELD_##kind == FIELD_COUNT) { \
+        into.member += next.member; \
+    } else if (FIELD_##kind == FIELD_ID || strcmp(key, "end") == 0) { \
+        into.member = next.member; \
+    }
+    AGGREGATE_FIELDS(AGGREGATE_MERGE)
+#undef AGGREGATE_MERGE
+}
@@ -0,0 +1,47 @@
+#include "SequenceCounter.h"
+
+SequenceCounter::SequenceCounter(const char* storeName) {
+    name = storeName;
+    ready = false;
+    nextValue = 1;
+    reservedUntil = 1;
+}
+
+SequenceCounter::~SequenceCounter() {
+    if (ready) {
+        store.end();
+    }
+}
+
+bool SequenceCounter::begin() {
+    if (ready) {
+        return true;
+    }
+    
+    if (!store.begin(name, false)) {
+        Serial.printf("SequenceCounter: Failed to open %s\n", name);
+        return false;
+    }
+    
+    // Resume after the last reserved block; anything handed out from it
+    // before the reset is lower than this
+    nextValue = store.getUInt("next", 1);
+    if (nextValue == 0) {
+        nextValue = 1;
+    }
+    reservedUntil = nextValue;
+    ready = true;
+    
+    Serial.printf("SequenceCounter: %s resumes at %lu\n", name, (unsigned long)nextValue);
+    return true;
+}
+
+uint32_t SequenceCounter::allocate() {
+    if (nextValue >= reservedUntil) {
+        reservedUntil = nextValue + RESERVE_BLOCK;
+        if (ready) {
+            store.putUInt("next", reservedUntil);
+        }
+    }
+    return nextValue++;
+}
@@ -0,0 +1,37 @@
+#include "SerialSink.h"
+#include "JsonWriter.h"
+#include "SensorRecord.h"
+
+SerialSink::SerialSink(const String& device, const String& loc) {
+    deviceName = device;
+    location = loc;
+    lineBuffer = new char[LINE_BUFFER_SIZE];
+}
+
+SerialSink::~SerialSink() {
+    if (lineBuffer) {
+        delete[] lineBuffer;
+        lineBuffer = nullptr;
+    }
+}
+
+size_t SerialSink::encode(const AggregatedData& data, uint8_t* out, size_t size) {
+    JsonWriter writer((char*)out, size);
+    writeSensorRecord(writer, data, deviceName.c_str(), location.c_str());
+    return writer.overflowed() ? 0 : writer.size();
+}
+
+SinkResult SerialSink::deliver(const AggregatedData& data, const uint8_t* payload, size_t length) {
+    if (!payload) {
+        length = encode(data, (uint8_t*)lineBuffer, LINE_BUFFER_SIZE);
+        if (length == 0) {
+            return SINK_FAILED;
+        }
+        payload = (const uint8_t*)lineBuffer;
+    }
+    
+    Serial.print("TELEMETRY ");
+    Serial.write(payload, length);
+    Serial.println();
+    return SINK_DELIVERED;
+}
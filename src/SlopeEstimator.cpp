@@ -0,0 +1,98 @@
+#include "SlopeEstimator.h"
+
+SlopeEstimator::SlopeEstimator(uint16_t size, unsigned long window) {
+    capacity = size;
+    windowMs = window;
+    times = new unsigned long[capacity];
+    values = new float[capacity];
+    reset();
+}
+
+SlopeEstimator::~SlopeEstimator() {
+    delete[] times;
+    delete[] values;
+}
+
+void SlopeEstimator::reset() {
+    head = 0;
+    count = 0;
+    originMs = 0;
+    sumT = sumV = sumTT = sumTV = 0.0;
+}
+
+void SlopeEstimator::addSample(unsigned long timeMs, float value) {
+    if (count == 0) {
+        originMs = timeMs;
+    } else if (timeMs - originMs >= REBASE_INTERVAL) {
+        rebase(times[head]);
+    }
+    
+    // Drop samples that have aged out of the window, or the oldest one if full
+    while (count > 0 && timeMs - times[head] > windowMs) {
+        evictOldest();
+    }
+    if (count >= capacity) {
+        evictOldest();
+    }
+    
+    uint16_t tail = (head + count) % capacity;
+    times[tail] = timeMs;
+    values[tail] = value;
+    count++;
+    
+    accumulate(timeMs, value, 1.0);
+}
+
+bool SlopeEstimator::hasSlope() const {
+    return count >= 3 && getSpan() > 0;
+}
+
+float SlopeEstimator::getSlope() const {
+    if (!hasSlope()) return 0.0;
+    
+    double n = count;
+    double denominator = n * sumTT - sumT * sumT;
+    if (denominator <= 0.0) return 0.0;
+    
+    return (float)((n * sumTV - sumT * sumV) / denominator);
+}
+
+float SlopeEstimator::getSlopePerMinute() const {
+    return getSlope() * 60.0;
+}
+
+unsigned long SlopeEstimator::getSpan() const {
+    if (count < 2) return 0;
+    uint16_t newest = (head + count - 1) % capacity;
+    return times[newest] - times[head];
+}
+
+void SlopeEstimator::accumulate(unsigned long timeMs, float value, double sign) {
+    double t = (timeMs - originMs) / 1000.0;
+    sumT += sign * t;
+    sumV += sign * value;
+    sumTT += sign * t * t;
+    sumTV += sign * t * value;
+}
+
+void SlopeEstimator::evictOldest() {
+    if (count == 0) return;
+    
+    accumulate(times[head], values[head], -1.0);
+    head = (head + 1) % capacity;
+    count--;
+    
+    if (count == 0) {
+        sumT = sumV = sumTT = sumTV = 0.0;
+    }
+}
+
+void SlopeEstimator::rebase(unsigned long newOriginMs) {
+    // O(n), but only once per REBASE_INTERVAL
+    originMs = newOriginMs;
+    sumT = sumV = sumTT = sumTV = 0.0;
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t index = (head + i) % capacity;
+        accumulate(times[index], values[index], 1.0);
+    }
+}
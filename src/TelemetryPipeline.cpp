@@ -0,0 +1,307 @@
+#include "TelemetryPipeline.h"
+
+TelemetryPipeline::TelemetryPipeline() {
+    payloadArea = new uint8_t[QUEUE_SIZE * SLOT_PAYLOAD_SIZE];
+    head = 0;
+    count = 0;
+    
+    memset(sinks, 0, sizeof(sinks));
+    sinkCount = 0;
+    eventSink = -1;
+    relaySink = -1;
+    
+    // Numbering moves here from the clients, so every sink sees the same
+    // sequence for the same record
+    sequenceCounter = new SequenceCounter("uplink");
+    statsMutex = NULL;
+    
+    yieldCallback = nullptr;
+    yieldContext = nullptr;
+    
+    publishedCount = 0;
+    encodeCount = 0;
+    encodeShared = 0;
+    encodeOverflow = 0;
+}
+
+TelemetryPipeline::~TelemetryPipeline() {
+    if (statsMutex != NULL) {
+        vSemaphoreDelete(statsMutex);
+        statsMutex = NULL;
+    }
+    if (sequenceCounter) {
+        delete sequenceCounter;
+        sequenceCounter = nullptr;
+    }
+    if (payloadArea) {
+        delete[] payloadArea;
+        payloadArea = nullptr;
+    }
+}
+
+bool TelemetryPipeline::addSink(TelemetrySink* sink) {
+    if (!sink || sinkCount >= MAX_SINKS) {
+        Serial.println("Pipeline: No room for another sink");
+        return false;
+    }
+    
+    SinkState& state = sinks[sinkCount];
+    state.sink = sink;
+    state.policy = sink->getPolicy();
+    state.attempts = 0;
+    state.retryDelay = state.policy.retryDelay;
+    state.nextAttempt = 0;
+    memset(&state.stats, 0, sizeof(state.stats));
+    state.stats.lastStatusCode = -1;
+    
+    if (eventSink < 0 && sink->acceptsEvents()) {
+        eventSink = sinkCount;
+    }
+    if (relaySink < 0 && sink->relaysEvents()) {
+        relaySink = sinkCount;
+    }
+    if (yieldCallback) {
+        sink->setYieldCallback(yieldCallback, yieldContext);
+    }
+    
+    Serial.printf("Pipeline: Added sink %s\n", sink->getName());
+    sinkCount++;
+    return true;
+}
+
+void TelemetryPipeline::setYieldCallback(SinkYieldCallback callback, void* context) {
+    yieldCallback = callback;
+    yieldContext = context;
+    for (uint8_t i = 0; i < sinkCount; i++) {
+        sinks[i].sink->setYieldCallback(callback, context);
+    }
+}
+
+bool TelemetryPipeline::begin() {
+    if (!sequenceCounter->begin()) {
+        Serial.println("Pipeline: Sequence storage unavailable, numbering restarts each boot");
+    }
+    
+    statsMutex = xSemaphoreCreateMutex();
+    if (statsMutex == NULL) {
+        Serial.println("Pipeline: Failed to create stats mutex");
+        return false;
+    }
+    return true;
+}
+
+void TelemetryPipeline::publish(const AggregatedData& data, unsigned long enqueuedAt) {
+    if (sinkCount == 0) {
+        return;
+    }
+    
+    if (count == QUEUE_SIZE) {
+        dropOldest();
+    }
+    
+    Slot& slot = slotAt(count);
+    slot.data = data;
+    if (slot.data.sequence == 0) {
+        slot.data.sequence = sequenceCounter->allocate();
+    }
+    slot.enqueuedAt = enqueuedAt;
+    slot.pending = (1 << sinkCount) - 1;
+    encodeSlot(slot);
+    
+    count++;
+    publishedCount++;
+    updateQueueDepths();
+}
+
+void TelemetryPipeline::encodeSlot(Slot& slot) {
+    uint8_t* area = slotPayload(slot);
+    size_t used = 0;
+    bool tried[ENCODING_COUNT] = {};
+    memset(slot.length, 0, sizeof(slot.length));
+    
+    for (uint8_t i = 0; i < sinkCount; i++) {
+        SinkEncoding encoding = sinks[i].sink->getEncoding();
+        if (tried[encoding]) {
+            if (slot.length[encoding] > 0) {
+                encodeShared++;
+            }
+            continue;
+        }
+        tried[encoding] = true;
+        
+        size_t size = sinks[i].sink->encode(slot.data, area + used, SLOT_PAYLOAD_SIZE - used);
+        if (size == 0) {
+            // The sink encodes into its own buffer at delivery instead
+            encodeOverflow++;
+            continue;
+        }
+        slot.offset[encoding] = used;
+        slot.length[encoding] = size;
+        used += size;
+        encodeCount++;
+    }
+}
+
+bool TelemetryPipeline::service() {
+    for (uint8_t i = 0; i < sinkCount; i++) {
+        deliverNext(i);
+    }
+    reclaim();
+    updateQueueDepths();
+    return count > 0;
+}
+
+void TelemetryPipeline::deliverNext(uint8_t index) {
+    SinkState& state = sinks[index];
+    uint8_t bit = 1 << index;
+    
+    // Each sink's queue is the slots still carrying its bit, oldest first
+    Slot* slot = nullptr;
+    for (uint8_t offset = 0; offset < count; offset++) {
+        if (slotAt(offset).pending & bit) {
+            slot = &slotAt(offset);
+            break;
+        }
+    }
+    if (!slot) {
+        return;
+    }
+    if (state.attempts > 0 && (long)(millis() - state.nextAttempt) < 0) {
+        return;
+    }
+    
+    SinkEncoding encoding = state.sink->getEncoding();
+    size_t length = slot->length[encoding];
+    const uint8_t* payload = length > 0 ? slotPayload(*slot) + slot->offset[encoding] : nullptr;
+    
+    state.stats.lastAttemptTime = millis();
+    SinkResult result = state.sink->deliver(slot->data, payload, length);
+    settle(index, *slot, result);
+}
+
+void TelemetryPipeline::settle(uint8_t index, Slot& slot, SinkResult result) {
+    SinkState& state = sinks[index];
+    uint8_t bit = 1 << index;
+    unsigned long now = millis();
+    bool done = true;
+    
+    bool locked = lockStats();
+    
+    switch (result) {
+        case SINK_DELIVERED:
+        case SINK_BUFFERED:
+            state.stats.bytes += slot.length[state.sink->getEncoding()];
+            if (result == SINK_BUFFERED) {
+                state.stats.buffered++;
+                break;
+            }
+            state.stats.delivered++;
+            state.stats.lastDeliveredTime = now;
+            state.stats.lastLatency = now - slot.enqueuedAt;
+            if (state.stats.lastLatency > state.stats.maxLatency) {
+                state.stats.maxLatency = state.stats.lastLatency;
+            }
+            break;
+        case SINK_RETRY:
+            state.attempts++;
+            state.stats.retries++;
+            if (state.policy.maxAttempts > 0 && state.attempts >= state.policy.maxAttempts) {
+                Serial.printf("Pipeline: %s gave up on record %lu after %u attempts\n", state.sink->getName(),
+                              (unsigned long)slot.data.sequence, state.attempts);
+                state.stats.failed++;
+            } else {
+                state.nextAttempt = now + state.retryDelay;
+                state.retryDelay = min(state.retryDelay * 2, state.policy.maxRetryDelay);
+                done = false;
+            }
+            break;
+        case SINK_FAILED:
+            state.stats.failed++;
+            break;
+        case SINK_SKIPPED:
+            state.stats.skipped++;
+            break;
+    }
+    state.stats.lastResult = result;
+    state.stats.lastStatusCode = state.sink->getLastStatusCode();
+    
+    if (locked) unlockStats();
+    
+    if (done) {
+        slot.pending &= ~bit;
+        state.attempts = 0;
+        state.retryDelay = state.policy.retryDelay;
+    }
+}
+
+void TelemetryPipeline::dropOldest() {
+    Slot& oldest = slotAt(0);
+    
+    bool locked = lockStats();
+    for (uint8_t i = 0; i < sinkCount; i++) {
+        if (oldest.pending & (1 << i)) {
+            // It was at the front of this sink's queue; start fresh on the next
+            sinks[i].stats.dropped++;
+            sinks[i].attempts = 0;
+            sinks[i].retryDelay = sinks[i].policy.retryDelay;
+        }
+    }
+    if (locked) unlockStats();
+    
+    Serial.printf("Pipeline: Queue full, record %lu dropped\n", (unsigned long)oldest.data.sequence);
+    head = (head + 1) % QUEUE_SIZE;
+    count--;
+}
+
+void TelemetryPipeline::reclaim() {
+    while (count > 0 && slotAt(0).pending == 0) {
+        head = (head + 1) % QUEUE_SIZE;
+        count--;
+    }
+}
+
+void TelemetryPipeline::updateQueueDepths() {
+    bool locked = lockStats();
+    for (uint8_t i = 0; i < sinkCount; i++) {
+        uint16_t depth = 0;
+        for (uint8_t offset = 0; offset < count; offset++) {
+            if (slotAt(offset).pending & (1 << i)) depth++;
+        }
+        sinks[i].stats.queueDepth = depth;
+        if (depth > sinks[i].stats.queueHighWater) {
+            sinks[i].stats.queueHighWater = depth;
+        }
+    }
+    if (locked) unlockStats();
+}
+
+bool TelemetryPipeline::lockStats() const {
+    if (statsMutex == NULL) return false;
+    return xSemaphoreTake(statsMutex, pdMS_TO_TICKS(100)) == pdTRUE;
+}
+
+void TelemetryPipeline::unlockStats() const {
+    xSemaphoreGive(statsMutex);
+}
+
+void TelemetryPipeline::update(bool online) {
+    for (uint8_t i = 0; i < sinkCount; i++) {
+        sinks[i].sink->update(online);
+    }
+}
+
+const char* TelemetryPipeline::getSinkName(uint8_t index) const {
+    return index < sinkCount ? sinks[index].sink->getName() : "";
+}
+
+bool TelemetryPipeline::getSinkStats(uint8_t index, SinkStats& out) const {
+    if (index >= sinkCount) {
+        return false;
+    }
+    if (lockStats()) {
+        out = sinks[index].stats;
+        unlockStats();
+        return true;
+    }
+    return false;
+}
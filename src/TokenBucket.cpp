@@ -0,0 +1,53 @@
+#include "TokenBucket.h"
+
+static const uint32_t TOKEN = 1000;
+
+TokenBucket::TokenBucket(uint16_t burst, uint16_t perMinute) {
+    capacity = burst * TOKEN;
+    tokens = capacity;
+    refillInterval = 60000UL / max(perMinute, (uint16_t)1);
+    lastRefill = millis();
+}
+
+uint32_t TokenBucket::refilledTokens(unsigned long now, unsigned long& converted) const {
+    // Thousandths of a token, so slow rates don't round down to nothing
+    uint64_t added = (uint64_t)(now - lastRefill) * TOKEN / refillInterval;
+    if (tokens + added >= capacity) {
+        converted = now - lastRefill;
+        return capacity;
+    }
+    // Only the time that was converted counts; frequent calls keep the remainder
+    converted = (unsigned long)(added * refillInterval / TOKEN);
+    return tokens + (uint32_t)added;
+}
+
+void TokenBucket::refill() {
+    unsigned long converted;
+    tokens = refilledTokens(millis(), converted);
+    lastRefill += converted;
+}
+
+bool TokenBucket::available(uint16_t reserve) {
+    refill();
+    return tokens >= (reserve + 1) * TOKEN;
+}
+
+bool TokenBucket::take(uint16_t reserve) {
+    if (!available(reserve)) {
+        return false;
+    }
+    tokens -= TOKEN;
+    return true;
+}
+
+uint16_t TokenBucket::getTokens() const {
+    unsigned long converted;
+    return refilledTokens(millis(), converted) / TOKEN;
+}
+
+unsigned long TokenBucket::getWaitTime() const {
+    unsigned long converted;
+    uint32_t level = refilledTokens(millis(), converted);
+    if (level >= TOKEN) return 0;
+    return (unsigned long)((uint64_t)(TOKEN - level) * refillInterval / TOKEN);
+}
@@ -0,0 +1,278 @@
+#include "UplinkTask.h"
+
+UplinkTask::UplinkTask(TelemetryPipeline* telemetry, EventOutbox* outbox) {
+    pipeline = telemetry;
+    eventOutbox = outbox;
+    
+    uplinkQueue = NULL;
+    uplinkTask = NULL;
+    statsMutex = NULL;
+    running = false;
+    
+    memset(&stats, 0, sizeof(stats));
+    stats.lastHttpStatusCode = -1;
+    
+    eventSendFailed = false;
+    lastEventFailure = 0;
+}
+
+UplinkTask::~UplinkTask() {
+    stop();
+}
+
+bool UplinkTask::begin() {
+    if (running) return true;
+    
+    if (!pipeline) {
+        Serial.println("ERROR: No telemetry pipeline in UplinkTask::begin()");
+        return false;
+    }
+    
+    uplinkQueue = xQueueCreate(QUEUE_SIZE, sizeof(UplinkItem));
+    if (uplinkQueue == NULL) {
+        Serial.println("Failed to create uplink queue");
+        return false;
+    }
+    
+    statsMutex = xSemaphoreCreateMutex();
+    if (statsMutex == NULL) {
+        Serial.println("Failed to create uplink stats mutex");
+        vQueueDelete(uplinkQueue);
+        uplinkQueue = NULL;
+        return false;
+    }
+    
+    pipeline->setYieldCallback(yieldToCriticalEvents, this);
+    
+    running = true;
+    BaseType_t result = xTaskCreatePinnedToCore(
+        uplinkTaskWrapper,
+        "Uplink",
+        TASK_STACK_SIZE,
+        this,
+        TASK_PRIORITY,
+        &uplinkTask,
+        TASK_CORE
+    );
+    
+    if (result != pdPASS) {
+        Serial.printf("Failed to create uplink task: result=%d\n", result);
+        running = false;
+        stop();
+        return false;
+    }
+    
+    Serial.println("Uplink task started");
+    return true;
+}
+
+void UplinkTask::stop() {
+    running = false;
+    
+    if (uplinkTask != NULL) {
+        vTaskDelete(uplinkTask);
+        uplinkTask = NULL;
+    }
+    
+    if (uplinkQueue != NULL) {
+        vQueueDelete(uplinkQueue);
+        uplinkQueue = NULL;
+    }
+    
+    if (statsMutex != NULL) {
+        vSemaphoreDelete(statsMutex);
+        statsMutex = NULL;
+    }
+    
+    if (pipeline) {
+        pipeline->setYieldCallback(nullptr, nullptr);
+    }
+}
+
+bool UplinkTask::enqueueAggregate(const AggregatedData& data) {
+    if (!running) return false;
+    
+    UplinkItem item;
+    item.data = data;
+    item.enqueuedAt = millis();
+    
+    bool dropped = false;
+    bool queued = xQueueSend(uplinkQueue, &item, 0) == pdTRUE;
+    if (!queued) {
+        // Full: the server is stalled, keep the newest minute
+        UplinkItem oldest;
+        dropped = xQueueReceive(uplinkQueue, &oldest, 0) == pdTRUE;
+        queued = xQueueSend(uplinkQueue, &item, 0) == pdTRUE;
+        if (!queued) {
+            Serial.println("Uplink queue full, aggregate dropped");
+            dropped = true;
+        }
+    }
+    
+    uint16_t depth = uxQueueMessagesWaiting(uplinkQueue);
+    if (xSemaphoreTake(statsMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+        stats.enqueuedCount++;
+        if (dropped) stats.droppedCount++;
+        stats.queueDepth = depth;
+        if (depth > stats.queueHighWater) stats.queueHighWater = depth;
+        xSemaphoreGive(statsMutex);
+    }
+    
+    return queued;
+}
+
+void UplinkTask::getStats(UplinkStats& out) const {
+    if (statsMutex && xSemaphoreTake(statsMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        out = stats;
+        xSemaphoreGive(statsMutex);
+    } else {
+        memset(&out, 0, sizeof(out));
+        out.lastHttpStatusCode = -1;
+    }
+    
+    if (uplinkQueue) {
+        out.queueDepth = uxQueueMessagesWaiting(uplinkQueue);
+    }
+    
+    SinkStats sink;
+    if (pipeline && pipeline->getSinkStats(0, sink)) {
+        out.lastSendTime = sink.lastDeliveredTime;
+        out.lastAttemptTime = sink.lastAttemptTime;
+        out.lastSendSuccess = sink.lastResult == SINK_DELIVERED;
+        out.sendErrorCount = sink.buffered + sink.retries + sink.failed;
+        out.lastHttpStatusCode = sink.lastStatusCode;
+        out.lastSendLatency = sink.lastLatency;
+        out.maxSendLatency = sink.maxLatency;
+    }
+}
+
+void UplinkTask::uplinkTaskWrapper(void* parameter) {
+    if (!parameter) {
+        Serial.println("ERROR: Null parameter in uplinkTaskWrapper!");
+        vTaskDelete(NULL);
+        return;
+    }
+    
+    UplinkTask* uplink = static_cast<UplinkTask*>(parameter);
+    uplink->uplinkTaskFunction();
+    vTaskDelete(NULL);
+}
+
+void UplinkTask::yieldToCriticalEvents(void* context) {
+    // Runs on this task, from inside a sink's drain
+    UplinkTask* uplink = static_cast<UplinkTask*>(context);
+    if (WiFi.status() == WL_CONNECTED && uplink->pipeline->getEventSink()) {
+        uplink->sendEvents(true);
+    }
+}
+
+void UplinkTask::uplinkTaskFunction() {
+    while (running) {
+        bool online = WiFi.status() == WL_CONNECTED;
+        
+        // Drain the detector's log every pass, sink or not: it holds only 32
+        // transitions, and the outbox coalesces while the uplink is down
+        if (eventOutbox) {
+            eventOutbox->collect();
+        }
+        
+        // Critical events first, then whatever telemetry is waiting
+        bool eventsSent = online && pipeline->getEventSink() && sendEvents(true);
+        if (!eventsSent) {
+            relayEvents();
+        }
+        
+        UplinkItem item;
+        if (xQueueReceive(uplinkQueue, &item, pdMS_TO_TICKS(POLL_INTERVAL)) == pdTRUE) {
+            if (online) {
+                sendEvents(false);
+            }
+            pipeline->publish(item.data, item.enqueuedAt);
+        }
+        
+        // One attempt per sink with a record due; sinks that can't send
+        // buffer or back off under their own policy
+        pipeline->service();
+        
+        // Reconnect, buffer drain and idle keep-alive close
+        pipeline->update(online);
+    }
+}
+
+bool UplinkTask::sendEvents(bool criticalOnly) {
+    TelemetrySink* sink = pipeline->getEventSink();
+    if (!eventOutbox || !sink) return true;
+    
+    // After a failure, hold off so a struggling server isn't polled every pass
+    if (eventSendFailed && millis() - lastEventFailure < EVENT_RETRY_INTERVAL) {
+        return false;
+    }
+    
+    eventOutbox->collect();
+    
+    OutboxEntry batch[EVENT_BATCH_SIZE];
+    uint8_t count;
+    while ((count = eventOutbox->peekMany(batch, EVENT_BATCH_SIZE, criticalOnly)) > 0) {
+        uint8_t written = sink->deliverEvents(batch, count);
+        for (uint8_t i = 0; i < written; i++) {
+            eventOutbox->pop();
+            logSentEvent(batch[i], criticalOnly);
+        }
+        if (written == 0) {
+            eventSendFailed = true;
+            lastEventFailure = millis();
+            return false;
+        }
+    }
+    
+    eventSendFailed = false;
+    return true;
+}
+
+void UplinkTask::relayEvents() {
+    TelemetrySink* relay = pipeline->getRelaySink();
+    if (!eventOutbox || !relay) return;
+    
+    OutboxEntry batch[EVENT_BATCH_SIZE];
+    uint8_t count;
+    
+    // No event sink: the relay is the only way out, so every event goes and
+    // leaves the outbox once sent
+    if (!pipeline->getEventSink()) {
+        while ((count = eventOutbox->peekMany(batch, EVENT_BATCH_SIZE, false)) > 0) {
+            uint8_t handled = relay->relayEvents(batch, count);
+            for (uint8_t i = 0; i < handled; i++) {
+                eventOutbox->pop();
+            }
+            if (handled < count) {
+                break;
+            }
+        }
+        return;
+    }
+    
+    // Failover: critical events only. The entries stay queued for the event
+    // sink, so walk past the ones already relayed to reach any behind them;
+    // the rest wait in the outbox for WiFi
+    uint8_t offset = 0;
+    while ((count = eventOutbox->peekMany(batch, EVENT_BATCH_SIZE, true, offset)) > 0) {
+        uint8_t handled = relay->relayEvents(batch, count);
+        eventOutbox->markRelayed(offset, handled);
+        offset += handled;
+        if (handled < count) {
+            break;
+        }
+    }
+}
+
+void UplinkTask::logSentEvent(const OutboxEntry& entry, bool critical) {
+    if (critical) {
+        Serial.printf("Sent critical event: type=%d state=%s seq=%lu latency=%lums\n", (int)entry.event.type,
+                      eventStateName(entry.event.state), (unsigned long)entry.event.sequence,
+                      eventOutbox->getLastPriorityLatency());
+    } else {
+        Serial.printf("Sent event: type=%d state=%s seq=%lu%s\n", (int)entry.event.type,
+                      eventStateName(entry.event.state), (unsigned long)entry.event.sequence,
+                      entry.heartbeat ? " (heartbeat)" : "");
+    }
+}
@@ -17,6 +17,15 @@
 #include "DataCollector.h"
 #include "EventDetector.h"
 #include "APIClient.h"
+#include "MongoDBClient.h"
+#include "SensorRecord.h"
+#include "CsvWriter.h"
+#include "SerialSink.h"
+#include "FlashLogSink.h"
+#include "LoRaSink.h"
+#include "TelemetryPipeline.h"
+#include "EventOutbox.h"
+#include "UplinkTask.h"
 
 AsyncWebServer server(80);
 Preferences preferences;
@@ -52,6 +61,13 @@ SensorManager* sensorManager;
 DataCollector* dataCollector;
 EventDetector* eventDetector;
 WellPumpAPIClient* apiClient;
+WellPumpMongoClient* mongoClient;
+SerialSink* serialSink;
+FlashLogSink* flashLogSink;
+LoRaSink* loraSink;
+TelemetryPipeline* telemetryPipeline;
+EventOutbox* eventOutbox;
+UplinkTask* uplinkTask;
 
 const char* AP_SSID = "WellPump-Config";
 const char* AP_PASSWORD = "pumphouse";
@@ -69,6 +85,21 @@ String api_base_url = "";
 String api_key = "";
 bool api_use_https = true;
 bool api_verify_cert = false;
+String api_ca_cert = "";
+String api_cert_fingerprint = "";
+bool api_use_cbor = false;
+bool api_compress = false;
+uint8_t uplink_sinks = 0;               // SINK_* bits
+String mongo_url = "";
+String mongo_key = "";
+String mongo_data_source = "";
+String mongo_database = "";
+uint32_t event_heartbeat_sec = 900;
+uint8_t lora_node_id = 0;
+uint8_t lora_spreading_factor = 7;
+int8_t lora_tx_power = 20;
+uint16_t lora_duty_permille = 10;       // Airtime budget, per mille of each hour
+bool lora_adaptive = false;             // The receiver acknowledges frames
 
 bool wifi_connected = false;
 bool system_healthy = false;
@@ -78,18 +109,24 @@ unsigned long led_timer = 0;
 unsigned long data_log_timer = 0;
 unsigned long display_update_timer = 0;
 unsigned long startup_time = 0;
-unsigned long last_data_send_time = 0;
-unsigned long last_send_attempt_time = 0;
-bool last_send_success = false;
-uint32_t send_error_count = 0;
-int last_http_status_code = -1;
-
 const unsigned long WIFI_RETRY_INTERVAL = 120000;  // 2 minutes
 const unsigned long LED_UPDATE_INTERVAL = 500;
 const unsigned long DATA_LOG_INTERVAL = 60000;
 const unsigned long DISPLAY_UPDATE_INTERVAL = 2000;
 const unsigned long PAGE_SWITCH_INTERVAL = 5000;  // Switch pages every 5 seconds
 
+// Telemetry sinks, stored as a bitmask in the "sinks" preference
+const uint8_t SINK_API = 0x01;
+const uint8_t SINK_MONGODB = 0x02;
+const uint8_t SINK_SERIAL = 0x04;
+const uint8_t SINK_FLASH = 0x08;
+const uint8_t SINK_LORA = 0x10;
+
+// LoRa channel (change for your region). The US 902-928 MHz band limits
+// each frame to 400 ms on air, which caps the spreading factor.
+const long LORA_FREQUENCY = 915E6;
+const unsigned long LORA_US_DWELL_LIMIT = 400;
+
 enum LEDState {
     LED_BOOT,
     LED_NORMAL,
@@ -108,13 +145,17 @@ void setupMDNS();
 void setupWebServer();
 void setupNTP();
 void setupSensors();
+void setupUplink();
 void setupAPI();
+void setupMongo();
 void setupDisplay();
 void setupLoRa();
 void loadConfiguration();
 unsigned long getCurrentTimestamp();
 void saveWiFiCredentials(const String& ssid, const String& password);
 void saveAPICredentials(const String& url, const String& apiKey, bool useHttps, bool verifyCert);
+void saveMongoCredentials(const String& url, const String& apiKey, const String& dataSource, const String& database);
+void saveSinks(uint8_t sinks);
 
 void updateLED();
 void updateSystem();
@@ -125,10 +166,13 @@ void handleAPI_Sensors(AsyncWebServerRequest *request);
 void handleAPI_Aggregated(AsyncWebServerRequest *request);
 void handleAPI_Events(AsyncWebServerRequest *request);
 void handleAPI_Status(AsyncWebServerRequest *request);
+void handleAPI_Cycles(AsyncWebServerRequest *request);
 void handleAPI_Calibrate(AsyncWebServerRequest *request);
 void handleAPI_ResetAlarms(AsyncWebServerRequest *request);
 void handleWiFiConfig(AsyncWebServerRequest *request);
 void handleAPIConfig(AsyncWebServerRequest *request);
+void handleMongoConfig(AsyncWebServerRequest *request);
+void handleSinkConfig(AsyncWebServerRequest *request);
 void handleRestart(AsyncWebServerRequest *request);
 
 void showBootProgress(const String& message);
@@ -175,11 +219,8 @@ void setup() {
     showBootProgress("Init Sensors...");
     setupSensors();
     
-    showBootProgress("Init API Client...");
-    setupAPI();
-    
-    // showBootProgress("Init LoRa...");
-    // setupLoRa();
+    showBootProgress("Init Uplink...");
+    setupUplink();
     
     current_led_state = LED_NORMAL;
     
@@ -199,10 +240,6 @@ void loop() {
     updateDisplay();
     logData();
     
-    if (apiClient) {
-        apiClient->update();
-    }
-    
     if (WiFi.status() != WL_CONNECTED && wifi_ssid.length() > 0) {
         if (millis() - wifi_retry_timer > WIFI_RETRY_INTERVAL) {
             Serial.println("WiFi disconnected, attempting reconnection...");
@@ -238,12 +275,45 @@ void loadConfiguration() {
     api_key = preferences.getString("api_key", "");
     api_use_https = preferences.getBool("api_https", true);
     api_verify_cert = preferences.getBool("api_verify", false);
+    api_ca_cert = preferences.getString("api_ca", "");
+    api_cert_fingerprint = preferences.getString("api_fp", "");
+    event_heartbeat_sec = preferences.getUInt("evt_heartbeat", 900);
+    api_use_cbor = preferences.getBool("api_cbor", false);
+    api_compress = preferences.getBool("api_gzip", false);
+    // Before "sinks" there was one sink, named in "uplink_sink"
+    uplink_sinks = preferences.getUChar("sinks", preferences.getString("uplink_sink", "api") == "mongodb" ?
+                                                 SINK_MONGODB : SINK_API);
+    mongo_url = preferences.getString("mongo_url", "");
+    mongo_key = preferences.getString("mongo_key", "");
+    mongo_data_source = preferences.getString("mongo_source", "");
+    mongo_database = preferences.getString("mongo_db", "");
+    // Tells the receiver's pump houses apart; the last MAC byte unless set
+    lora_node_id = preferences.getUChar("lora_node", (uint8_t)(ESP.getEfuseMac() >> 40));
+    lora_spreading_factor = preferences.getUChar("lora_sf", 7);
+    lora_tx_power = preferences.getChar("lora_power", 20);
+    lora_duty_permille = preferences.getUShort("lora_duty", 10);
+    lora_adaptive = preferences.getBool("lora_ack", false);
     
     Serial.println("Loaded configuration:");
     Serial.println("WiFi SSID: " + wifi_ssid);
     Serial.println("API URL: " + api_base_url);
     Serial.println("API HTTPS: " + String(api_use_https ? "Yes" : "No"));
-    Serial.println("API Verify Cert: " + String(api_verify_cert ? "Yes" : "No"));
+    Serial.println("API Verify Cert: " + String(api_verify_cert ? "Yes" : "No") +
+                   (api_cert_fingerprint.length() > 0 ? " (fingerprint)" : api_ca_cert.length() > 0 ? " (pinned CA)" : ""));
+    Serial.println("Event Heartbeat: " + String(event_heartbeat_sec) + "s");
+    Serial.println("API Payload: " + String(api_use_cbor ? "CBOR" : "JSON") + (api_compress ? ", gzip batches" : ""));
+    Serial.printf("Telemetry Sinks:%s%s%s%s%s\n", uplink_sinks & SINK_API ? " api" : "",
+                  uplink_sinks & SINK_MONGODB ? " mongodb" : "", uplink_sinks & SINK_SERIAL ? " serial" : "",
+                  uplink_sinks & SINK_FLASH ? " flash" : "", uplink_sinks & SINK_LORA ? " lora" : "");
+    if (uplink_sinks & SINK_MONGODB) {
+        Serial.println("MongoDB URL: " + mongo_url);
+        Serial.println("MongoDB Database: " + mongo_data_source + "/" + mongo_database);
+    }
+    if (uplink_sinks & SINK_LORA) {
+        Serial.printf("LoRa Node: %u\n", lora_node_id);
+        Serial.printf("LoRa Radio: SF%u at %d dBm, %u.%u%% duty cycle%s\n", lora_spreading_factor, lora_tx_power,
+                      lora_duty_permille / 10, lora_duty_permille % 10, lora_adaptive ? ", adaptive" : "");
+    }
 }
 
 void saveWiFiCredentials(const String& ssid, const String& password) {
@@ -263,9 +333,28 @@ void saveAPICredentials(const String& url, const String& apiKey, bool useHttps,
     api_key = apiKey;
     api_use_https = useHttps;
     api_verify_cert = verifyCert;
+    saveSinks(uplink_sinks | SINK_API);
     Serial.println("Saved API credentials");
 }
 
+void saveMongoCredentials(const String& url, const String& apiKey, const String& dataSource, const String& database) {
+    preferences.putString("mongo_url", url);
+    preferences.putString("mongo_key", apiKey);
+    preferences.putString("mongo_source", dataSource);
+    preferences.putString("mongo_db", database);
+    mongo_url = url;
+    mongo_key = apiKey;
+    mongo_data_source = dataSource;
+    mongo_database = database;
+    saveSinks(uplink_sinks | SINK_MONGODB);
+    Serial.println("Saved MongoDB credentials");
+}
+
+void saveSinks(uint8_t sinks) {
+    preferences.putUChar("sinks", sinks);
+    uplink_sinks = sinks;
+}
+
 void setupWiFi() {
     if (wifi_ssid.length() == 0) {
         Serial.println("No WiFi credentials, starting AP mode");
@@ -498,22 +587,83 @@ void setupSensors() {
     }
     
     dataCollector = new DataCollector(sensorManager);
-    if (!dataCollector->begin()) {
-        Serial.println("ERROR: Data collector initialization failed!");
-        current_led_state = LED_ERROR;
-        return;
-    }
     
+    // Subscribe the event detector before collection starts so it sees every sample
     eventDetector = new EventDetector(dataCollector);
     eventDetector->begin();
     // Increased current threshold to 20A to handle pump motor noise
     // Reduced pressure threshold to 35 PSI for low pressure detection
     eventDetector->setThresholds(20.0, 5.0, 35.0);
     eventDetector->setHysteresis(3.0, 1.0, 2.0);
+    // Locked rotor uses the same 20A ceiling until a cycle baseline is
+    // learned; dry run waits for the baseline, as normal current varies by site
+    eventDetector->setRunResponse(0.0, 20.0, 2.0);
+    
+    if (!dataCollector->begin()) {
+        Serial.println("ERROR: Data collector initialization failed!");
+        current_led_state = LED_ERROR;
+        return;
+    }
     
     Serial.println("Sensors initialized successfully");
 }
 
+void setupUplink() {
+    telemetryPipeline = new TelemetryPipeline();
+    
+    if (eventDetector) {
+        eventOutbox = new EventOutbox(eventDetector, event_heartbeat_sec * 1000UL);
+    }
+    
+    // Added in this order: the first sink is the one the display and the
+    // top-level status fields report, and the first that takes events
+    if (uplink_sinks & SINK_API) {
+        setupAPI();
+    }
+    if (uplink_sinks & SINK_MONGODB) {
+        setupMongo();
+    }
+    if (uplink_sinks & SINK_SERIAL) {
+        serialSink = new SerialSink(HOSTNAME, "Pump House");
+        telemetryPipeline->addSink(serialSink);
+    }
+    if (uplink_sinks & SINK_FLASH) {
+        flashLogSink = new FlashLogSink(HOSTNAME, "Pump House");
+        flashLogSink->begin();
+        telemetryPipeline->addSink(flashLogSink);
+    }
+    if (uplink_sinks & SINK_LORA) {
+        setupLoRa();
+        if (lora_enabled) {
+            LoRaSchedulerConfig schedule;
+            schedule.spreadingFactor = lora_spreading_factor;
+            schedule.txPower = lora_tx_power;
+            schedule.dutyCyclePermille = lora_duty_permille;
+            schedule.maxFrameAirtime = LORA_FREQUENCY >= 902E6 && LORA_FREQUENCY <= 928E6 ? LORA_US_DWELL_LIMIT : 0;
+            schedule.adaptive = lora_adaptive;
+            
+            // Next to a WiFi sink the radio only covers WiFi outages
+            loraSink = new LoRaSink(lora_node_id, (uplink_sinks & (SINK_API | SINK_MONGODB)) != 0, schedule);
+            telemetryPipeline->addSink(loraSink);
+        }
+    }
+    
+    if (telemetryPipeline->getSinkCount() == 0) {
+        Serial.println("No telemetry sinks configured, skipping uplink");
+        return;
+    }
+    
+    if (!telemetryPipeline->begin()) {
+        Serial.println("Failed to start telemetry pipeline");
+        return;
+    }
+    
+    uplinkTask = new UplinkTask(telemetryPipeline, eventOutbox);
+    if (!uplinkTask->begin()) {
+        Serial.println("Failed to start uplink task");
+    }
+}
+
 void setupAPI() {
     if (api_base_url.length() == 0) {
         Serial.println("No API URL configured, skipping initialization");
@@ -527,8 +677,12 @@ void setupAPI() {
     config.apiKey = api_key;
     config.useHttps = api_use_https;
     config.verifyCertificate = api_verify_cert;
+    config.caCert = api_ca_cert;
+    config.certFingerprint = api_cert_fingerprint;
+    config.useCbor = api_use_cbor;
+    config.compressBatches = api_compress;
     
-    apiClient = new WellPumpAPIClient(config, HOSTNAME, "Pump House");
+    apiClient = new WellPumpAPIClient(config, HOSTNAME, "Pump House", telemetryPipeline->getSequenceCounter());
     
     if (apiClient->begin()) {
         Serial.println("API client initialized successfully");
@@ -560,6 +714,32 @@ void setupAPI() {
         // Still keep the client for later retry attempts
         // Don't set apiClient = nullptr here so it can retry
     }
+    
+    telemetryPipeline->addSink(apiClient);
+}
+
+void setupMongo() {
+    if (mongo_url.length() == 0) {
+        Serial.println("No MongoDB URL configured, skipping initialization");
+        return;
+    }
+    
+    Serial.println("Initializing MongoDB client...");
+    
+    mongoClient = new WellPumpMongoClient(mongo_url, mongo_key, mongo_data_source, mongo_database,
+                                          HOSTNAME, "Pump House", telemetryPipeline->getSequenceCounter());
+    
+    if (mongoClient->begin()) {
+        Serial.println("MongoDB client initialized successfully");
+    } else {
+        Serial.println("MongoDB client initialization failed");
+        Serial.print("Connection test failed. HTTP status: ");
+        Serial.println(mongoClient->getLastHttpStatusCode());
+        Serial.println("Check Data API URL, key, data source and database");
+        // Still keep the client; the uplink task retries with backoff
+    }
+    
+    telemetryPipeline->addSink(mongoClient);
 }
 
 void setupWebServer() {
@@ -567,12 +747,15 @@ void setupWebServer() {
     server.on("/api/aggregated", HTTP_GET, handleAPI_Aggregated);
     server.on("/api/events", HTTP_GET, handleAPI_Events);
     server.on("/api/status", HTTP_GET, handleAPI_Status);
+    server.on("/api/cycles", HTTP_GET, handleAPI_Cycles);
     server.on("/api/calibrate", HTTP_GET, handleAPI_Calibrate);
     server.on("/api/calibrate", HTTP_POST, handleAPI_Calibrate);
     server.on("/api/reset-alarms", HTTP_POST, handleAPI_ResetAlarms);
     
     server.on("/config/wifi", HTTP_POST, handleWiFiConfig);
     server.on("/config/api", HTTP_POST, handleAPIConfig);
+    server.on("/config/mongodb", HTTP_POST, handleMongoConfig);
+    server.on("/config/sinks", HTTP_POST, handleSinkConfig);
     server.on("/restart", HTTP_POST, handleRestart);
     
     server.serveStatic("/", SPIFFS, "/").setDefaultFile("index.html");
@@ -586,13 +769,8 @@ void setupWebServer() {
 }
 
 void updateSystem() {
-    if (eventDetector) {
-        eventDetector->update();
-    }
-    
-    if (apiClient) {
-        apiClient->update();
-    }
+    // Event evaluation runs on the collection task, once per sample;
+    // network I/O runs on the uplink task
     
     system_healthy = sensorManager && sensorManager->isHealthy() && 
                     dataCollector && dataCollector->isRunning();
@@ -636,12 +814,12 @@ void logData() {
         return;
     }
     
-    if (!apiClient) {
+    if (!uplinkTask) {
         // Update tracking variables to show API not configured
         static unsigned long last_no_api_log = 0;
         unsigned long now = millis();
         if (now - last_no_api_log > 60000) { // Log once per minute
-            Serial.println("API client not configured - no data sending");
+            Serial.println("No telemetry sink configured - no data sending");
             last_no_api_log = now;
         }
         return;
@@ -654,47 +832,15 @@ void logData() {
     data_log_timer = now;
     
     AggregatedData aggregated;
-    Serial.println("=== ATTEMPTING DATA SEND ===");
-    if (dataCollector->getAggregatedData(aggregated)) {
-        Serial.println("Got aggregated data, attempting to send...");
-        last_send_attempt_time = millis();
-        if (apiClient->sendSensorData(aggregated)) {
-            last_data_send_time = millis();
-            last_send_success = true;
-            last_http_status_code = apiClient->getLastHttpStatusCode();
-            Serial.println("Data sent successfully!");
-            // Clear the aggregated data so it doesn't get sent again
-            dataCollector->clearAggregatedData();
-        } else {
-            last_send_success = false;
-            send_error_count++;
-            last_http_status_code = apiClient->getLastHttpStatusCode();
-            Serial.print("ERROR: Failed to send sensor data to server. HTTP code: ");
-            Serial.println(last_http_status_code);
+    if (dataCollector->takeAggregatedData(aggregated)) {
+        // Hand off to the uplink task; it sends queued events ahead of the
+        // aggregate and buffers it if the send fails
+        if (!uplinkTask->enqueueAggregate(aggregated)) {
+            Serial.println("WARNING: Aggregate could not be queued for upload");
         }
     } else {
         Serial.println("WARNING: No aggregated data available to send");
     }
-    
-    if (eventDetector) {
-        // Send active events
-        for (uint8_t i = 0; i < eventDetector->getEventCount(); i++) {
-            Event event = eventDetector->getEvent(i);
-            if (event.active) {
-                apiClient->sendEvent(event);
-            }
-        }
-
-        // Send resolved events (conditions that have cleared)
-        if (eventDetector->hasResolvedEvents()) {
-            for (uint8_t i = 0; i < eventDetector->getResolvedEventCount(); i++) {
-                Event event = eventDetector->getResolvedEvent(i);
-                apiClient->sendEvent(event);
-                Serial.printf("Sent resolved event: type=%d\n", (int)event.type);
-            }
-            eventDetector->clearResolvedEvents();
-        }
-    }
 }
 
 void handleAPI_Sensors(AsyncWebServerRequest *request) {
@@ -729,39 +875,31 @@ void handleAPI_Aggregated(AsyncWebServerRequest *request) {
         return;
     }
     
-    JsonDocument doc;
     AggregatedData data;
+    if (!dataCollector->getAggregatedData(data)) {
+        request->send(200, "application/json", "{\"error\":\"No aggregated data available\"}");
+        return;
+    }
     
-    if (dataCollector->getAggregatedData(data)) {
-        doc["tempMin"] = data.tempMin;
-        doc["tempMax"] = data.tempMax;
-        doc["tempAvg"] = data.tempAvg;
-        doc["humMin"] = data.humMin;
-        doc["humMax"] = data.humMax;
-        doc["humAvg"] = data.humAvg;
-        doc["pressMin"] = data.pressMin;
-        doc["pressMax"] = data.pressMax;
-        doc["pressAvg"] = data.pressAvg;
-        doc["current1Min"] = data.current1Min;
-        doc["current1Max"] = data.current1Max;
-        doc["current1Avg"] = data.current1Avg;
-        doc["current1RMS"] = data.current1RMS;
-        doc["current2Min"] = data.current2Min;
-        doc["current2Max"] = data.current2Max;
-        doc["current2Avg"] = data.current2Avg;
-        doc["current2RMS"] = data.current2RMS;
-        doc["dutyCycle1"] = data.dutyCycle1;
-        doc["dutyCycle2"] = data.dutyCycle2;
-        doc["sampleCount"] = data.sampleCount;
-        doc["startTime"] = data.startTime * 1000;  // Convert to milliseconds
-        doc["endTime"] = data.endTime * 1000;    // Convert to milliseconds
-    } else {
-        doc["error"] = "No aggregated data available";
+    // Every schema field, including the per-sensor sample counts uplink
+    // records leave out. ?format=csv gives a header line and a data line.
+    char buffer[1024];
+    if (request->hasParam("format") && request->getParam("format")->value() == "csv") {
+        CsvWriter header(buffer, sizeof(buffer), true);
+        writeAggregateFields(header, data, LAYOUT_FLAT, TIME_SECONDS, false);
+        String response = String(header.c_str()) + "\n";
+        CsvWriter row(buffer, sizeof(buffer), false);
+        writeAggregateFields(row, data, LAYOUT_FLAT, TIME_SECONDS, false);
+        response += String(row.c_str()) + "\n";
+        request->send(200, "text/csv", response);
+        return;
     }
     
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    JsonWriter writer(buffer, sizeof(buffer));
+    writer.beginObject();
+    writeAggregateFields(writer, data, LAYOUT_FLAT, TIME_MILLIS, false);
+    writer.endObject();
+    request->send(200, "application/json", writer.c_str());
 }
 
 void handleAPI_Events(AsyncWebServerRequest *request) {
@@ -770,11 +908,15 @@ void handleAPI_Events(AsyncWebServerRequest *request) {
         return;
     }
     
+    // Copied out first: the collection task evaluates every sample under the
+    // event mutex, so nothing slow may run while it's held
+    Event active[EVENT_TYPE_COUNT];
+    uint8_t count = eventDetector->copyActiveEvents(active, EVENT_TYPE_COUNT);
+    
     JsonDocument doc;
     JsonArray events = doc.to<JsonArray>();
-    
-    for (uint8_t i = 0; i < eventDetector->getEventCount(); i++) {
-        Event event = eventDetector->getEvent(i);
+    for (uint8_t i = 0; i < count; i++) {
+        const Event& event = active[i];
         JsonObject eventObj = events.add<JsonObject>();
         
         eventObj["type"] = String((int)event.type);
@@ -783,7 +925,8 @@ void handleAPI_Events(AsyncWebServerRequest *request) {
         eventObj["startTime"] = event.startTime * 1000;  // Convert to milliseconds
         eventObj["duration"] = event.duration;
         eventObj["active"] = event.active;
-        eventObj["description"] = event.description;
+        eventObj["description"] = eventDescription(event.type);
+        eventObj["sequence"] = event.sequence;
     }
     
     String response;
@@ -798,25 +941,136 @@ void handleAPI_Status(AsyncWebServerRequest *request) {
     doc["wifi"] = wifi_connected ? "Connected" : "Disconnected";
     doc["uptime"] = (millis() - startup_time) / 1000;
     doc["freeHeap"] = ESP.getFreeHeap();
+    doc["minFreeHeap"] = ESP.getMinFreeHeap();
     doc["time"] = timeClient.getFormattedTime();
     doc["timeSync"] = timeClient.isTimeSet();
     doc["epochTime"] = timeClient.getEpochTime() * 1000;  // Convert to milliseconds
     
-    // API Status and Send Info
+    UplinkStats uplink;
+    if (uplinkTask) {
+        uplinkTask->getStats(uplink);
+    } else {
+        memset(&uplink, 0, sizeof(uplink));
+        uplink.lastHttpStatusCode = -1;
+    }
+    
+    // API Status and Send Info. Connection and outbox fields describe the
+    // first network sink; with both, MongoDB's are under "mongodb".
     if (apiClient) {
         doc["api"] = apiClient->getConnectionStatus();
         doc["bufferedData"] = apiClient->getBufferedCount();
-        doc["lastHttpStatus"] = last_http_status_code;
-    } else {
+        doc["lastAckedSequence"] = apiClient->getLastAckedSequence();
+        OutboxStats outbox;
+        apiClient->getOutboxStats(outbox);
+        doc["outboxCapacity"] = outbox.capacity;
+        doc["outboxSegments"] = outbox.segments;
+        doc["outboxDropped"] = outbox.dropped;
+        doc["outboxCorrupt"] = outbox.corrupt;
+        doc["httpRequests"] = apiClient->getRequestCount();
+        doc["httpConnections"] = apiClient->getConnectionCount();
+        doc["httpReused"] = apiClient->getReusedCount();
+        doc["httpReconnectRetries"] = apiClient->getReconnectRetryCount();
+        doc["httpLastRequestMs"] = apiClient->getLastRequestDuration();
+        doc["httpAvgRequestMs"] = apiClient->getAverageRequestDuration();
+        doc["tlsMode"] = apiClient->getTLSMode();
+        TLSStats tls;
+        if (apiClient->getTLSStats(tls)) {
+            doc["tlsFullHandshakes"] = tls.fullHandshakes;
+            doc["tlsResumedHandshakes"] = tls.resumedHandshakes;
+            doc["tlsFailures"] = tls.failures;
+            doc["tlsLastHandshakeMs"] = tls.lastHandshakeMs;
+            doc["tlsAvgFullMs"] = tls.fullHandshakes ? tls.totalFullMs / tls.fullHandshakes : 0;
+            doc["tlsAvgResumedMs"] = tls.resumedHandshakes ? tls.totalResumedMs / tls.resumedHandshakes : 0;
+            doc["tlsConnectionHeap"] = tls.connectionHeap;
+            doc["tlsMinFreeHeap"] = tls.minFreeHeap;
+            doc["tlsLastError"] = tls.lastError;
+        }
+        doc["uplinkBreaker"] = apiClient->getBreakerState();
+        doc["breakerFailurePercent"] = apiClient->getBreakerFailurePercent();
+        doc["breakerRetryInMs"] = apiClient->getBreakerRetryIn();
+        doc["breakerTrips"] = apiClient->getBreakerTrips();
+        doc["rateLimitTokens"] = apiClient->getRateLimitTokens();
+        doc["deferredRequests"] = apiClient->getDeferredCount();
+        doc["lastDrainItems"] = apiClient->getLastDrainCount();
+        doc["lastDrainMs"] = apiClient->getLastDrainDuration();
+        doc["batchUpload"] = apiClient->isBatchSupported();
+        doc["batchSize"] = apiClient->getBatchSize();
+        doc["batchRequests"] = apiClient->getBatchRequestCount();
+        doc["rejectedRecords"] = apiClient->getRejectedCount();
+        doc["payloadEncoding"] = apiClient->getPayloadEncoding();
+        doc["batchCompression"] = apiClient->isCompressionEnabled();
+        doc["compressedBatches"] = apiClient->getCompressedBatchCount();
+        doc["compressionRatio"] = apiClient->getCompressionRatio();
+    }
+    if (mongoClient) {
+        JsonObject mongo = apiClient ? doc["mongodb"].to<JsonObject>() : doc.as<JsonObject>();
+        mongo["api"] = mongoClient->getConnectionStatus();
+        mongo["bufferedData"] = mongoClient->getBufferedCount();
+        mongo["lastAckedSequence"] = mongoClient->getLastAckedSequence();
+        OutboxStats outbox;
+        mongoClient->getOutboxStats(outbox);
+        mongo["outboxCapacity"] = outbox.capacity;
+        mongo["outboxSegments"] = outbox.segments;
+        mongo["outboxDropped"] = outbox.dropped;
+        mongo["outboxCorrupt"] = outbox.corrupt;
+        mongo["httpRequests"] = mongoClient->getRequestCount();
+        mongo["httpConnections"] = mongoClient->getConnectionCount();
+        mongo["httpReused"] = mongoClient->getReusedCount();
+        mongo["httpLastRequestMs"] = mongoClient->getLastRequestDuration();
+        mongo["mongoInsertMany"] = mongoClient->getInsertManyCount();
+        mongo["mongoDocuments"] = mongoClient->getDocumentsWritten();
+        mongo["mongoDuplicates"] = mongoClient->getDuplicateCount();
+        mongo["uplinkBreaker"] = mongoClient->getBreakerState();
+        mongo["breakerTrips"] = mongoClient->getBreakerTrips();
+        mongo["rateLimitTokens"] = mongoClient->getRateLimitTokens();
+        mongo["deferredRequests"] = mongoClient->getDeferredCount();
+    }
+    if (!apiClient && !mongoClient) {
         doc["api"] = "Not Configured";
-        doc["lastHttpStatus"] = -1;
+    }
+    doc["lastHttpStatus"] = uplink.lastHttpStatusCode;
+    
+    // Per-sink delivery; records are numbered and encoded once for all
+    if (telemetryPipeline) {
+        doc["nextSequence"] = telemetryPipeline->getNextSequence();
+        doc["telemetryPublished"] = telemetryPipeline->getPublishedCount();
+        doc["telemetryEncodes"] = telemetryPipeline->getEncodeCount();
+        doc["telemetryEncodesShared"] = telemetryPipeline->getEncodeShared();
+        doc["telemetryEncodeOverflow"] = telemetryPipeline->getEncodeOverflow();
+        JsonArray sinks = doc["sinks"].to<JsonArray>();
+        for (uint8_t i = 0; i < telemetryPipeline->getSinkCount(); i++) {
+            SinkStats stats;
+            if (!telemetryPipeline->getSinkStats(i, stats)) {
+                continue;
+            }
+            JsonObject sink = sinks.add<JsonObject>();
+            sink["name"] = telemetryPipeline->getSinkName(i);
+            sink["delivered"] = stats.delivered;
+            sink["buffered"] = stats.buffered;
+            sink["retries"] = stats.retries;
+            sink["failed"] = stats.failed;
+            sink["dropped"] = stats.dropped;
+            sink["skipped"] = stats.skipped;
+            sink["queueDepth"] = stats.queueDepth;
+            sink["queueHighWater"] = stats.queueHighWater;
+            sink["bytes"] = stats.bytes;
+            sink["lastDeliveredTime"] = stats.lastDeliveredTime;
+            sink["lastLatencyMs"] = stats.lastLatency;
+            sink["maxLatencyMs"] = stats.maxLatency;
+            sink["lastStatus"] = stats.lastStatusCode;
+        }
     }
     
     // Data Send Status
-    doc["lastDataSendTime"] = last_data_send_time > 0 ? last_data_send_time : 0;
-    doc["lastSendAttemptTime"] = last_send_attempt_time > 0 ? last_send_attempt_time : 0;
-    doc["lastSendSuccess"] = last_send_success;
-    doc["sendErrorCount"] = send_error_count;
+    doc["lastDataSendTime"] = uplink.lastSendTime;
+    doc["lastSendAttemptTime"] = uplink.lastAttemptTime;
+    doc["lastSendSuccess"] = uplink.lastSendSuccess;
+    doc["sendErrorCount"] = uplink.sendErrorCount;
+    doc["uplinkQueueDepth"] = uplink.queueDepth;
+    doc["uplinkQueueHighWater"] = uplink.queueHighWater;
+    doc["uplinkDropped"] = uplink.droppedCount;
+    doc["uplinkLatencyMs"] = uplink.lastSendLatency;
+    doc["uplinkLatencyMaxMs"] = uplink.maxSendLatency;
     
     // Aggregator Status
     if (dataCollector) {
@@ -829,10 +1083,58 @@ void handleAPI_Status(AsyncWebServerRequest *request) {
     }
     
     doc["lora"] = lora_enabled ? "Ready" : "Disabled";
+    if (loraSink) {
+        doc["loraNode"] = loraSink->getNodeId();
+        doc["loraMode"] = loraSink->isFailover() ? "failover" : "always";
+        doc["loraTransmitting"] = loraSink->isTransmitting();
+        doc["loraFramesSent"] = loraSink->getFramesSent();
+        doc["loraEventsRelayed"] = loraSink->getEventsRelayed();
+        doc["loraAirtimeMs"] = loraSink->getAirtimeTotal();
+        doc["loraLastAirtimeMs"] = loraSink->getLastAirtime();
+        doc["loraPendingAggregates"] = loraSink->getWindowCount();
+        
+        const LoRaScheduler* scheduler = loraSink->getScheduler();
+        doc["loraSpreadingFactor"] = scheduler->getSpreadingFactor();
+        doc["loraTxPower"] = scheduler->getTxPower();
+        doc["loraAdaptive"] = scheduler->isAdaptive();
+        doc["loraBudgetMs"] = scheduler->getBudget();
+        doc["loraBudgetUsedMs"] = scheduler->getBudgetUsed();
+        doc["loraEventAirtimeMs"] = scheduler->getEventAirtime();
+        doc["loraTelemetryAirtimeMs"] = scheduler->getTelemetryAirtime();
+        doc["loraEventsDeferred"] = scheduler->getEventsDeferred();
+        doc["loraTelemetryDeferred"] = scheduler->getTelemetryDeferred();
+        if (scheduler->isAdaptive()) {
+            doc["loraAcks"] = scheduler->getAcksReceived();
+            doc["loraAcksMissed"] = scheduler->getAcksMissed();
+            doc["loraAdaptations"] = scheduler->getAdaptations();
+            if (!isnan(scheduler->getLastSnr())) {
+                doc["loraLastSnr"] = scheduler->getLastSnr();
+                doc["loraLastRssi"] = scheduler->getLastRssi();
+            }
+        }
+    }
     
     if (eventDetector) {
         doc["activeEvents"] = eventDetector->getEventCount();
         doc["eventStatus"] = eventDetector->getStatusString();
+        doc["samplesEvaluated"] = eventDetector->getSamplesEvaluated();
+        doc["samplesSkipped"] = eventDetector->getSamplesSkipped();
+        doc["eventLatencyUs"] = eventDetector->getLastEvaluationLatencyUs();
+        doc["eventLatencyMaxUs"] = eventDetector->getMaxEvaluationLatencyUs();
+        doc["lastDetectionDelayMs"] = eventDetector->getLastDetectionDelayMs();
+    }
+    
+    if (eventOutbox) {
+        doc["eventsPending"] = eventOutbox->getPendingCount();
+        doc["eventsSent"] = eventOutbox->getSentCount();
+        doc["eventsCoalesced"] = eventOutbox->getCoalescedCount();
+        doc["eventsDropped"] = eventOutbox->getDroppedCount();
+        doc["eventsLost"] = eventOutbox->getLostCount();
+        doc["eventHeartbeats"] = eventOutbox->getHeartbeatCount();
+        doc["priorityLatencyMs"] = eventOutbox->getLastPriorityLatency();
+        doc["priorityLatencyMaxMs"] = eventOutbox->getMaxPriorityLatency();
+        doc["priorityDelivered"] = eventOutbox->getPriorityDeliveredCount();
+        doc["priorityLate"] = eventOutbox->getPriorityLateCount();
     }
     
     String response;
@@ -840,6 +1142,46 @@ void handleAPI_Status(AsyncWebServerRequest *request) {
     request->send(200, "application/json", response);
 }
 
+void handleAPI_Cycles(AsyncWebServerRequest *request) {
+    if (!eventDetector) {
+        request->send(500, "application/json", "{\"error\":\"Event detector not initialized\"}");
+        return;
+    }
+    
+    CycleStats stats;
+    if (!eventDetector->getCycleStats(stats)) {
+        request->send(503, "application/json", "{\"error\":\"Cycle stats busy\"}");
+        return;
+    }
+    
+    JsonDocument doc;
+    doc["running"] = stats.running;
+    doc["totalCycles"] = stats.totalCycles;
+    doc["baselineCycles"] = stats.baseline.cycleCount;
+    doc["lastScore"] = stats.lastScore;
+    doc["anomalyActive"] = eventDetector->isCycleAnomalyActive();
+    
+    JsonObject baseline = doc["baseline"].to<JsonObject>();
+    baseline["inrushPeak"] = stats.baseline.mean.inrushPeak;
+    baseline["inrushPeakStd"] = sqrt(stats.baseline.variance.inrushPeak);
+    baseline["steadyCurrent"] = stats.baseline.mean.steadyCurrent;
+    baseline["steadyCurrentStd"] = sqrt(stats.baseline.variance.steadyCurrent);
+    baseline["runTime"] = stats.baseline.mean.runTime;
+    baseline["runTimeStd"] = sqrt(stats.baseline.variance.runTime);
+    baseline["pressureRiseRate"] = stats.baseline.mean.pressureRiseRate;
+    baseline["pressureRiseRateStd"] = sqrt(stats.baseline.variance.pressureRiseRate);
+    
+    JsonObject last = doc["lastCycle"].to<JsonObject>();
+    last["inrushPeak"] = stats.lastCycle.inrushPeak;
+    last["steadyCurrent"] = stats.lastCycle.steadyCurrent;
+    last["runTime"] = stats.lastCycle.runTime;
+    last["pressureRiseRate"] = stats.lastCycle.pressureRiseRate;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
 void handleAPI_Calibrate(AsyncWebServerRequest *request) {
     if (!sensorManager) {
         request->send(500, "application/json", "{\"error\":\"Sensor manager not initialized\"}");
@@ -927,12 +1269,116 @@ void handleAPIConfig(AsyncWebServerRequest *request) {
     
     saveAPICredentials(url, apiKey, useHttps, verifyCert);
     
+    // Optional: seconds between re-sends of still-active events (0 disables)
+    if (request->hasParam("eventHeartbeat", true)) {
+        event_heartbeat_sec = request->getParam("eventHeartbeat", true)->value().toInt();
+        preferences.putUInt("evt_heartbeat", event_heartbeat_sec);
+    }
+    
+    // Optional: certificate pin used when verifyCert is on. A fingerprint
+    // (SHA-256 of the server certificate) takes precedence over a CA; an
+    // empty value clears the pin
+    if (request->hasParam("caCert", true)) {
+        api_ca_cert = request->getParam("caCert", true)->value();
+        preferences.putString("api_ca", api_ca_cert);
+    }
+    if (request->hasParam("certFingerprint", true)) {
+        api_cert_fingerprint = request->getParam("certFingerprint", true)->value();
+        preferences.putString("api_fp", api_cert_fingerprint);
+    }
+    
+    // Optional: send CBOR instead of JSON (the client falls back on HTTP 415)
+    if (request->hasParam("useCbor", true)) {
+        api_use_cbor = request->getParam("useCbor", true)->value() == "true";
+        preferences.putBool("api_cbor", api_use_cbor);
+    }
+    
+    // Optional: gzip batch uploads (the client falls back on HTTP 415)
+    if (request->hasParam("compressBatches", true)) {
+        api_compress = request->getParam("compressBatches", true)->value() == "true";
+        preferences.putBool("api_gzip", api_compress);
+    }
+    
     request->send(200, "application/json", "{\"status\":\"API credentials saved. Restarting...\"}");
     
     delay(2000);
     ESP.restart();
 }
 
+void handleMongoConfig(AsyncWebServerRequest *request) {
+    if (!request->hasParam("url", true) || !request->hasParam("apiKey", true) ||
+        !request->hasParam("dataSource", true) || !request->hasParam("database", true)) {
+        request->send(400, "application/json", "{\"error\":\"url, apiKey, dataSource and database are required\"}");
+        return;
+    }
+    
+    // Enables the MongoDB sink alongside any others; /config/sinks turns it off
+    saveMongoCredentials(request->getParam("url", true)->value(),
+                         request->getParam("apiKey", true)->value(),
+                         request->getParam("dataSource", true)->value(),
+                         request->getParam("database", true)->value());
+    
+    // Optional: seconds between re-sends of still-active events (0 disables)
+    if (request->hasParam("eventHeartbeat", true)) {
+        event_heartbeat_sec = request->getParam("eventHeartbeat", true)->value().toInt();
+        preferences.putUInt("evt_heartbeat", event_heartbeat_sec);
+    }
+    
+    request->send(200, "application/json", "{\"status\":\"MongoDB credentials saved. Restarting...\"}");
+    
+    delay(2000);
+    ESP.restart();
+}
+
+void handleSinkConfig(AsyncWebServerRequest *request) {
+    // Each of api, mongodb, serial, flash and lora is optional; omitted ones
+    // keep their current setting
+    static const struct { const char* name; uint8_t bit; } params[] = {
+        { "api", SINK_API }, { "mongodb", SINK_MONGODB }, { "serial", SINK_SERIAL }, { "flash", SINK_FLASH },
+        { "lora", SINK_LORA }
+    };
+    
+    uint8_t sinks = uplink_sinks;
+    for (const auto& param : params) {
+        if (request->hasParam(param.name, true)) {
+            if (request->getParam(param.name, true)->value() == "true") {
+                sinks |= param.bit;
+            } else {
+                sinks &= ~param.bit;
+            }
+        }
+    }
+    saveSinks(sinks);
+    
+    if (request->hasParam("loraNode", true)) {
+        lora_node_id = request->getParam("loraNode", true)->value().toInt();
+        preferences.putUChar("lora_node", lora_node_id);
+    }
+    if (request->hasParam("loraSF", true)) {
+        lora_spreading_factor = constrain(request->getParam("loraSF", true)->value().toInt(),
+                                          LoRaScheduler::MIN_SPREADING_FACTOR, LoRaScheduler::MAX_SPREADING_FACTOR);
+        preferences.putUChar("lora_sf", lora_spreading_factor);
+    }
+    if (request->hasParam("loraPower", true)) {
+        lora_tx_power = constrain(request->getParam("loraPower", true)->value().toInt(),
+                                  LoRaScheduler::MIN_TX_POWER, LoRaScheduler::MAX_TX_POWER);
+        preferences.putChar("lora_power", lora_tx_power);
+    }
+    if (request->hasParam("loraDutyPermille", true)) {
+        lora_duty_permille = constrain(request->getParam("loraDutyPermille", true)->value().toInt(), 0, 1000);
+        preferences.putUShort("lora_duty", lora_duty_permille);
+    }
+    if (request->hasParam("loraAdaptive", true)) {
+        lora_adaptive = request->getParam("loraAdaptive", true)->value() == "true";
+        preferences.putBool("lora_ack", lora_adaptive);
+    }
+    
+    request->send(200, "application/json", "{\"status\":\"Telemetry sinks saved. Restarting...\"}");
+    
+    delay(2000);
+    ESP.restart();
+}
+
 void handleRestart(AsyncWebServerRequest *request) {
     request->send(200, "text/plain", "Restarting...");
     delay(1000);
@@ -1090,12 +1536,28 @@ void updateDisplay() {
         }
         
         // Last data send status
-        if (!apiClient) {
+        UplinkStats uplink;
+        if (uplinkTask) {
+            uplinkTask->getStats(uplink);
+        } else {
+            memset(&uplink, 0, sizeof(uplink));
+        }
+        unsigned long last_send_attempt_time = uplink.lastAttemptTime;
+        unsigned long last_data_send_time = uplink.lastSendTime;
+        bool last_send_success = uplink.lastSendSuccess;
+        int last_http_status_code = uplink.lastHttpStatusCode;
+        uint32_t send_error_count = uplink.sendErrorCount;
+        
+        if (!uplinkTask) {
             display.println("Send: No API config");
-        } else if (!apiClient->isInitialized() || !apiClient->isConnected()) {
+        } else if (apiClient && (!apiClient->isInitialized() || !apiClient->isConnected())) {
             display.print("Send: API error (");
             display.print(apiClient->getLastHttpStatusCode());
             display.println(")");
+        } else if (mongoClient && (!mongoClient->isInitialized() || !mongoClient->isConnected())) {
+            display.print("Send: DB error (");
+            display.print(mongoClient->getLastHttpStatusCode());
+            display.println(")");
         } else if (last_send_attempt_time > 0) {
             if (last_send_success && last_data_send_time > 0) {
                 unsigned long time_since_send = (now - last_data_send_time) / 1000;
@@ -1168,22 +1630,22 @@ void setupLoRa() {
     // Set LoRa pins
     LoRa.setPins(LORA_CS, LORA_RST, LORA_IRQ);
     
-    // Initialize LoRa at 915 MHz (change for your region)
-    if (!LoRa.begin(915E6)) {
+    if (!LoRa.begin(LORA_FREQUENCY)) {
         Serial.println("LoRa initialization failed!");
         lora_enabled = false;
         return;
     }
     
-    // Set LoRa parameters
-    LoRa.setTxPower(20);           // Max power
-    LoRa.setSpreadingFactor(7);    // SF7 (faster, shorter range)
-    LoRa.setSignalBandwidth(125E3); // 125 kHz
-    LoRa.setCodingRate4(5);        // 4/5 coding rate
+    // Set LoRa parameters; the scheduler's airtime figures assume these.
+    // Spreading factor and power are where the scheduler starts; with
+    // acknowledgements it moves them from there.
+    LoRa.setTxPower(lora_tx_power);
+    LoRa.setSpreadingFactor(lora_spreading_factor);
+    LoRa.setSignalBandwidth(LoRaScheduler::BANDWIDTH);
+    LoRa.setCodingRate4(LoRaScheduler::CODING_RATE);
+    LoRa.setPreambleLength(LoRaScheduler::PREAMBLE_LENGTH);
     LoRa.enableCrc();              // Enable CRC
     
     lora_enabled = true;
     Serial.println("LoRa initialized successfully");
-    Serial.println("Note: LoRa transmit functions not yet implemented");
-    Serial.println("Available for future remote monitoring features");
 }
\ No newline at end of file
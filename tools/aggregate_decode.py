@@ -0,0 +1,280 @@
+#!/usr/bin/env python3
+"""Decode packed aggregates (packAggregate() in src/SensorRecord.cpp).
+
+The field list, widths and scales are read from include/AggregateSchema.h,
+the same list the firmware encoders are generated from, so a field added
+there decodes here without changes. With --frame the input is LoRa frames
+(include/LoRaFrame.h), aggregates, relayed events and acknowledgements,
+and the header and CRC are checked. Prints JSON, or CSV with one row per record. Python
+standard library only.
+
+    python3 tools/aggregate_decode.py --hex 4c0a...
+    python3 tools/aggregate_decode.py --csv records.bin
+    python3 tools/aggregate_decode.py --frame --hex 11a4...
+    python3 tools/aggregate_decode.py --fields
+"""
+
+import argparse
+import binascii
+import csv
+import json
+import math
+import os
+import re
+import struct
+import sys
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+SCHEMA_HEADER = os.path.join(os.path.dirname(TOOLS), "include", "AggregateSchema.h")
+
+FIELD_PATTERN = re.compile(
+    r'X\(\s*([\w ]+?)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*"(\w*)"\s*,\s*(\d+)\s*,\s*([01])\s*\)')
+
+# Packed widths by C type; floats are always int16 fixed point
+INTEGER_WIDTHS = {
+    "uint8_t": 1,
+    "uint16_t": 2,
+    "uint32_t": 4,
+    "unsigned long": 4,
+}
+
+INT16_MIN = -32768
+
+# LoRa frame layout, see include/LoRaFrame.h
+FRAME_VERSION = 1
+FRAME_AGGREGATE = 1
+FRAME_EVENT = 2
+FRAME_ACK = 3
+FRAME_HEADER_SIZE = 2
+FRAME_CRC_SIZE = 2
+EVENT_FRAME_SIZE = 18
+ACK_FRAME_SIZE = 8
+EVENT_STATES = ["raised", "updated", "cleared"]
+
+
+class Field:
+    def __init__(self, ctype, member, kind, group, key, pack, record):
+        self.ctype = ctype
+        self.member = member
+        self.kind = kind
+        self.group = group
+        self.key = key
+        self.pack = pack
+        self.record = record
+
+    @property
+    def is_float(self):
+        return self.ctype in ("float", "double")
+
+    @property
+    def width(self):
+        if self.is_float:
+            return 2
+        if self.ctype not in INTEGER_WIDTHS:
+            raise ValueError("no packed width for type %r (%s)" % (self.ctype, self.member))
+        return INTEGER_WIDTHS[self.ctype]
+
+
+def load_schema(path=SCHEMA_HEADER):
+    """All AGGREGATE_FIELDS entries, in schema order."""
+    with open(path) as handle:
+        text = handle.read()
+    start = text.index("#define AGGREGATE_FIELDS(X)")
+    end = text.index("#define", start + 1)
+    fields = []
+    for match in FIELD_PATTERN.finditer(text[start:end]):
+        ctype, member, kind, group, key, pack, record = match.groups()
+        fields.append(Field(ctype, member, kind, group, key, int(pack), record == "1"))
+    if not fields:
+        raise ValueError("no fields found in %s" % path)
+    return fields
+
+
+def packed_fields(fields):
+    return [field for field in fields if field.pack]
+
+
+def packed_size(fields):
+    return sum(field.width for field in packed_fields(fields))
+
+
+def unpack(data, fields):
+    """One packed aggregate as a dict keyed by member name."""
+    size = packed_size(fields)
+    if len(data) < size:
+        raise ValueError("need %d bytes, got %d" % (size, len(data)))
+    record = {}
+    pos = 0
+    for field in packed_fields(fields):
+        if field.is_float:
+            fixed = struct.unpack_from("<h", data, pos)[0]
+            record[field.member] = None if fixed == INT16_MIN else fixed / field.pack
+        else:
+            record[field.member] = int.from_bytes(data[pos:pos + field.width], "little")
+        pos += field.width
+    return record
+
+
+def pack(record, fields):
+    """Inverse of unpack(), mirroring packAggregate() for tests."""
+    out = bytearray()
+    for field in packed_fields(fields):
+        value = record.get(field.member, 0)
+        if field.is_float:
+            if value is None or value != value:
+                fixed = INT16_MIN
+            else:
+                fixed = max(-32767, min(32767, int(round(value * field.pack))))
+            out += struct.pack("<h", fixed)
+        else:
+            out += int(value).to_bytes(field.width, "little")
+    return bytes(out)
+
+
+def frame_size(fields):
+    return FRAME_HEADER_SIZE + packed_size(fields) + FRAME_CRC_SIZE
+
+
+def frame_crc(data):
+    """CRC-16/CCITT-FALSE, as loraFrameCRC()."""
+    return binascii.crc_hqx(data, 0xFFFF)
+
+
+def frame_type(data, fields):
+    """FRAME_AGGREGATE, FRAME_EVENT or FRAME_ACK by the header byte, and that frame's size."""
+    if not data:
+        raise ValueError("empty frame")
+    sizes = {FRAME_AGGREGATE: frame_size(fields), FRAME_EVENT: EVENT_FRAME_SIZE, FRAME_ACK: ACK_FRAME_SIZE}
+    kind = data[0] & 0x0F
+    if data[0] >> 4 != FRAME_VERSION or kind not in sizes:
+        raise ValueError("unknown frame header 0x%02x" % data[0])
+    return kind, sizes[kind]
+
+
+def check_frame(data, fields, expected):
+    kind, size = frame_type(data, fields)
+    if kind != expected:
+        raise ValueError("frame type %d, expected %d" % (kind, expected))
+    if len(data) != size:
+        raise ValueError("frame is %d bytes, expected %d" % (len(data), size))
+    body = len(data) - FRAME_CRC_SIZE
+    if struct.unpack_from("<H", data, body)[0] != frame_crc(data[:body]):
+        raise ValueError("CRC mismatch")
+    return data[FRAME_HEADER_SIZE:body]
+
+
+def decode_frame(data, fields):
+    """One LoRa aggregate frame as (node id, record); ValueError if invalid."""
+    body = check_frame(data, fields, FRAME_AGGREGATE)
+    return data[1], unpack(body, fields)
+
+
+def decode_event_frame(data, fields):
+    """One relayed event frame as (node id, event); ValueError if invalid."""
+    body = check_frame(data, fields, FRAME_EVENT)
+    sequence, event_type, state, start_time, value, threshold = struct.unpack("<IBBIhh", body)
+    return data[1], {
+        "sequence": sequence,
+        "type": event_type,
+        "state": EVENT_STATES[state] if state < len(EVENT_STATES) else "unknown",
+        "startTime": start_time,
+        "value": None if value == INT16_MIN else value / 100,
+        "threshold": None if threshold == INT16_MIN else threshold / 100,
+    }
+
+
+def decode_ack_frame(data, fields):
+    """One acknowledgement as (node id, ack); ValueError if invalid."""
+    body = check_frame(data, fields, FRAME_ACK)
+    acked_crc, snr, rssi = struct.unpack("<Hbb", body)
+    return data[1], {"ackedCrc": acked_crc, "snr": snr / 4, "rssi": rssi}
+
+
+def encode_frame(record, node, fields):
+    """Inverse of decode_frame(), mirroring encodeLoRaAggregate()."""
+    frame = bytes([FRAME_VERSION << 4 | FRAME_AGGREGATE, node]) + pack(record, fields)
+    return frame + struct.pack("<H", frame_crc(frame))
+
+
+def encode_ack_frame(acked, snr, rssi):
+    """The acknowledgement a receiver sends back for frame acked, with the
+    SNR (dB) and RSSI (dBm) it received it at; mirrors encodeLoRaAck()."""
+    quarters = math.floor(abs(snr) * 4 + 0.5) * (1 if snr >= 0 else -1)
+    frame = bytes([FRAME_VERSION << 4 | FRAME_ACK, acked[1]]) + struct.pack(
+        "<Hbb", struct.unpack_from("<H", acked, len(acked) - FRAME_CRC_SIZE)[0],
+        max(-128, min(127, quarters)), max(-128, min(127, int(rssi))))
+    return frame + struct.pack("<H", frame_crc(frame))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", nargs="?", default="-", help="file of back-to-back records, or - for stdin")
+    parser.add_argument("--hex", action="store_true", help="input is hex text")
+    parser.add_argument("--frame", action="store_true", help="input is LoRa frames; adds the node id")
+    parser.add_argument("--csv", action="store_true", help="print CSV instead of JSON")
+    parser.add_argument("--fields", action="store_true", help="list the packed layout and exit")
+    parser.add_argument("--schema", default=SCHEMA_HEADER, help="path to AggregateSchema.h")
+    args = parser.parse_args()
+
+    try:
+        fields = load_schema(args.schema)
+    except (OSError, ValueError) as error:
+        sys.exit("aggregate_decode: %s" % error)
+    size = frame_size(fields) if args.frame else packed_size(fields)
+
+    if args.fields:
+        offset = 0
+        for field in packed_fields(fields):
+            scale = "x%d" % field.pack if field.is_float else ""
+            print("%3d  %-14s %d  %s %s" % (offset, field.member, field.width, field.ctype, scale))
+            offset += field.width
+        print("%d bytes, %d as a LoRa frame" % (packed_size(fields), frame_size(fields)))
+        return
+
+    if args.source == "-":
+        raw = sys.stdin.buffer.read()
+    else:
+        with open(args.source, "rb") as handle:
+            raw = handle.read()
+    if args.hex:
+        raw = bytes.fromhex("".join(raw.decode("ascii").split()))
+    if not args.frame and (not raw or len(raw) % size):
+        sys.exit("aggregate_decode: %d bytes is not a whole number of %d-byte records" % (len(raw), size))
+
+    records = []
+    pos = 0
+    while pos < len(raw):
+        if not args.frame:
+            records.append(unpack(raw[pos:pos + size], fields))
+            pos += size
+            continue
+        try:
+            kind, size = frame_type(raw[pos:], fields)
+            if kind == FRAME_EVENT:
+                node, record = decode_event_frame(raw[pos:pos + size], fields)
+                records.append(dict(node=node, frame="event", **record))
+            elif kind == FRAME_ACK:
+                node, record = decode_ack_frame(raw[pos:pos + size], fields)
+                records.append(dict(node=node, frame="ack", **record))
+            else:
+                node, record = decode_frame(raw[pos:pos + size], fields)
+                records.append(dict(node=node, frame="aggregate", **record))
+        except ValueError as error:
+            sys.exit("aggregate_decode: frame at offset %d: %s" % (pos, error))
+        pos += size
+
+    if args.csv:
+        columns = [field.member for field in packed_fields(fields)]
+        if args.frame:
+            columns = ["node", "frame"] + columns + ["type", "state", "startTime", "value", "threshold",
+                                                     "ackedCrc", "snr", "rssi"]
+        writer = csv.DictWriter(sys.stdout, fieldnames=columns, restval="")
+        writer.writeheader()
+        writer.writerows(records)
+    else:
+        json.dump(records[0] if len(records) == 1 else records, sys.stdout, indent=2)
+        sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Decode the monitor's CBOR uploads to JSON.
+
+Covers the subset the firmware's CborWriter emits (integers, text, float32,
+true/false/null, definite and indefinite arrays and maps) plus definite
+byte strings and half/double floats, so payloads from other encoders decode
+too. Python standard library only.
+
+    python3 tools/cbor_decode.py payload.cbor
+    python3 tools/cbor_decode.py --hex bf6664657669...ff
+    curl ... | python3 tools/cbor_decode.py -
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+BREAK = object()
+
+
+class CborError(ValueError):
+    pass
+
+
+class Decoder:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, count):
+        if self.pos + count > len(self.data):
+            raise CborError("truncated input at offset %d" % self.pos)
+        chunk = self.data[self.pos:self.pos + count]
+        self.pos += count
+        return chunk
+
+    def argument(self, info):
+        if info < 24:
+            return info
+        if info == 24:
+            return self.take(1)[0]
+        if info == 25:
+            return struct.unpack(">H", self.take(2))[0]
+        if info == 26:
+            return struct.unpack(">I", self.take(4))[0]
+        if info == 27:
+            return struct.unpack(">Q", self.take(8))[0]
+        if info == 31:
+            return None  # Indefinite length
+        raise CborError("reserved additional info %d at offset %d" % (info, self.pos - 1))
+
+    def item(self):
+        initial = self.take(1)[0]
+        major = initial >> 5
+        info = initial & 0x1F
+
+        if major == 7:
+            return self.simple(info)
+
+        length = self.argument(info)
+        if major == 0:
+            return length
+        if major == 1:
+            return -1 - length
+        if major in (2, 3):
+            if length is None:
+                return self.chunked(major)
+            raw = self.take(length)
+            return raw.hex() if major == 2 else raw.decode("utf-8")
+        if major == 4:
+            return self.array(length)
+        if major == 5:
+            return self.map(length)
+        raise CborError("tags are not supported (offset %d)" % (self.pos - 1))
+
+    def simple(self, info):
+        if info == 20:
+            return False
+        if info == 21:
+            return True
+        if info in (22, 23):
+            return None
+        if info == 25:
+            return half_to_float(struct.unpack(">H", self.take(2))[0])
+        if info == 26:
+            return struct.unpack(">f", self.take(4))[0]
+        if info == 27:
+            return struct.unpack(">d", self.take(8))[0]
+        if info == 31:
+            return BREAK
+        raise CborError("unsupported simple value %d" % info)
+
+    def chunked(self, major):
+        parts = []
+        while True:
+            part = self.item()
+            if part is BREAK:
+                break
+            parts.append(part)
+        return "".join(parts)
+
+    def array(self, length):
+        items = []
+        while length is None or len(items) < length:
+            value = self.item()
+            if value is BREAK:
+                if length is not None:
+                    raise CborError("break inside definite array")
+                break
+            items.append(value)
+        return items
+
+    def map(self, length):
+        result = {}
+        while length is None or len(result) < length:
+            key = self.item()
+            if key is BREAK:
+                if length is not None:
+                    raise CborError("break inside definite map")
+                break
+            result[key] = self.item()
+        return result
+
+
+def half_to_float(bits):
+    return struct.unpack(">e", struct.pack(">H", bits))[0]
+
+
+def decode(data):
+    decoder = Decoder(data)
+    value = decoder.item()
+    if value is BREAK:
+        raise CborError("unexpected break")
+    if decoder.pos != len(data):
+        raise CborError("%d trailing bytes" % (len(data) - decoder.pos))
+    return value
+
+
+def round_floats(value, digits):
+    # float32 carries ~7 significant digits; trim the noise for display
+    if isinstance(value, float):
+        return round(value, digits)
+    if isinstance(value, list):
+        return [round_floats(v, digits) for v in value]
+    if isinstance(value, dict):
+        return {k: round_floats(v, digits) for k, v in value.items()}
+    return value
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", nargs="?", default="-", help="file to decode, or - for stdin")
+    parser.add_argument("--hex", action="store_true", help="input is hex text (e.g. from -DAPI_DEBUG_PAYLOADS logs)")
+    parser.add_argument("--digits", type=int, default=4, help="round floats to this many decimals")
+    args = parser.parse_args()
+
+    if args.source == "-":
+        raw = sys.stdin.buffer.read()
+    else:
+        with open(args.source, "rb") as handle:
+            raw = handle.read()
+    if args.hex:
+        raw = bytes.fromhex(raw.decode("ascii").strip())
+
+    try:
+        value = decode(raw)
+    except CborError as error:
+        sys.exit("cbor_decode: %s" % error)
+
+    json.dump(round_floats(value, args.digits), sys.stdout, indent=2)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+// Runs pressure traces through the firmware's SlopeEstimator.cpp and
+// EventDetector.cpp, for tools/test_pressure_decay.py and
+// tools/test_run_response.py. The trace comes on
+// stdin, one sample per line:
+//
+//   slope        "TIME_MS VALUE" into a bare SlopeEstimator with the
+//                detector's size and window; prints "TIME_MS SLOPE SPAN"
+//                per sample, SLOPE in units per minute ("-" before there
+//                is one)
+//   detect       "TIME_MS PRESSURE CURRENT" through EventDetector::
+//                processSample(); prints "TIME_MS RATE ACTIVE" per sample,
+//                RATE the decay in PSI/min, and "EVENT TIME_MS STATE TYPE"
+//                for every transition logged, TYPE the EventType number.
+//                An optional DRY_RUN_AMPS argument configures the dry run
+//                current that main.cpp leaves at 0
+
+#include <Arduino.h>
+#include "EventDetector.h"
+#include "SlopeEstimator.h"
+
+// The detector is fed directly, so nothing subscribes it to a collector
+bool DataCollector::addSampleSubscriber(SampleCallback callback, void* context) {
+    return false;
+}
+
+static const uint16_t SLOPE_SIZE = 160;             // As EventDetector's pressure slope
+static const unsigned long SLOPE_WINDOW = 300000;
+
+static int runSlope() {
+    SlopeEstimator estimator(SLOPE_SIZE, SLOPE_WINDOW);
+    unsigned long time;
+    float value;
+    while (scanf("%lu %f", &time, &value) == 2) {
+        estimator.addSample(time, value);
+        if (estimator.hasSlope()) {
+            printf("%lu %.6f %lu\n", time, estimator.getSlopePerMinute(), estimator.getSpan());
+        } else {
+            printf("%lu - %lu\n", time, estimator.getSpan());
+        }
+    }
+    return 0;
+}
+
+static int runDetector(float dryRunAmps) {
+    EventDetector detector(nullptr);
+    detector.begin();
+    detector.setRunResponse(dryRunAmps, 20.0, 2.0);     // As main.cpp
+    
+    SensorData data;
+    memset(&data, 0, sizeof(data));
+    data.temperature = 60.0;
+    data.humidity = 50.0;
+    data.valid = true;
+    
+    uint32_t lastSequence = 0;
+    unsigned long time;
+    float pressure;
+    float current;
+    while (scanf("%lu %f %f", &time, &pressure, &current) == 3) {
+        data.timestamp = time;          // No NTP on the host; the collector falls back to millis()
+        data.sampleTime = time;
+        data.sampleMicros = micros();
+        data.pressure = pressure;
+        data.current1 = current;
+        detector.processSample(data);
+        
+        Event logged[8];
+        uint8_t count = detector.copyEventsSince(lastSequence, logged, 8);
+        for (uint8_t i = 0; i < count; i++) {
+            printf("EVENT %lu %s %d\n", time, eventStateName(logged[i].state), (int)logged[i].type);
+            lastSequence = logged[i].sequence;
+        }
+        printf("%lu %.6f %d\n", time, detector.getPressureDecayRate(), detector.isPressureDecayActive() ? 1 : 0);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 2 && strcmp(argv[1], "slope") == 0) {
+        return runSlope();
+    }
+    if ((argc == 2 || argc == 3) && strcmp(argv[1], "detect") == 0) {
+        return runDetector(argc == 3 ? atof(argv[2]) : 0.0);
+    }
+    fprintf(stderr, "usage: %s slope|detect [DRY_RUN_AMPS] < trace\n", argv[0]);
+    return 2;
+}
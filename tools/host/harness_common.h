@@ -0,0 +1,44 @@
+#pragma once
+
+// Pieces shared by the host harnesses: wall clock, test aggregates and the
+// mock server's outage switch.
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <time.h>
+#include "DataCollector.h"
+
+static inline unsigned long long wallMicros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static inline AggregatedData makeAggregate(uint32_t index) {
+    // Plausible values with some movement so compression isn't flattered
+    AggregatedData data;
+    memset(&data, 0, sizeof(data));
+    float wobble = (index % 17) * 0.13f;
+    data.tempMin = 11.2f + wobble; data.tempMax = 12.9f + wobble; data.tempAvg = 12.1f + wobble;
+    data.humMin = 61.0f + wobble; data.humMax = 66.4f + wobble; data.humAvg = 63.8f + wobble;
+    data.pressMin = 38.4f - wobble; data.pressMax = 52.7f - wobble; data.pressAvg = 45.3f - wobble;
+    data.current1Min = 0.02f; data.current1Max = 9.81f + wobble; data.current1Avg = 2.47f + wobble;
+    data.current1RMS = 3.66f + wobble; data.dutyCycle1 = 0.27f;
+    data.current2Min = 0.01f; data.current2Max = 0.04f; data.current2Avg = 0.02f; data.current2RMS = 0.02f;
+    data.startTime = 1700000000UL + index * 60;
+    data.endTime = data.startTime + 60;
+    data.sampleCount = 60;
+    data.tempSampleCount = data.humSampleCount = data.pressSampleCount = 60;
+    data.current1SampleCount = data.current2SampleCount = 60;
+    return data;
+}
+
+static inline bool setOutage(const String& baseURL, bool outage) {
+    String body = outage ? "{\"outage\": true}" : "{\"outage\": false}";
+    int code = HTTPClient::request("POST", baseURL + "/debug/config", body, nullptr);
+    if (code != 200) {
+        fprintf(stderr, "harness: mock server did not accept /debug/config (HTTP %d)\n", code);
+        return false;
+    }
+    return true;
+}
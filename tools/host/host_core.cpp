@@ -0,0 +1,790 @@
+// Implementations behind the headers in shim/: clock, Serial, heap figures
+// and allocation counts, in-memory SPIFFS and NVS, POSIX sockets, HTTP/1.1,
+// a small JSON parser and a LoRa radio that only transmits.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FS.h>
+#include <HTTPClient.h>
+#include <LoRa.h>
+#include <Preferences.h>
+#include <SPIFFS.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+#include <Wire.h>
+#include "EventDetector.h"
+#include "SecureTransport.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <new>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+SPIFFSFS SPIFFS;
+TwoWire Wire;
+LoRaClass LoRa;
+
+// --- clock ---------------------------------------------------------------
+
+static unsigned long long skippedMs = 0;
+
+static unsigned long long monotonicMs() {
+    static struct timespec start = {0, 0};
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (start.tv_sec == 0 && start.tv_nsec == 0) {
+        start = now;
+    }
+    return (now.tv_sec - start.tv_sec) * 1000ULL + (now.tv_nsec - start.tv_nsec) / 1000000LL;
+}
+
+unsigned long millis() {
+    // Starts a minute after boot, past the client's first-test holdoffs, so
+    // "0 = never" timestamps behave as they do on a device that has joined WiFi
+    return (unsigned long)(60000 + monotonicMs() + skippedMs);
+}
+
+unsigned long micros() {
+    return millis() * 1000UL;
+}
+
+static bool realTime = false;
+
+void hostSetRealTime(bool enabled) {
+    realTime = enabled;
+}
+
+void delay(unsigned long ms) {
+    if (realTime) {
+        usleep(ms * 1000);
+    } else {
+        skippedMs += ms;
+    }
+}
+
+long random(long howBig) {
+    return howBig > 0 ? rand() % howBig : 0;
+}
+
+long random(long howSmall, long howBig) {
+    return howBig > howSmall ? howSmall + random(howBig - howSmall) : howSmall;
+}
+
+// --- Serial --------------------------------------------------------------
+
+static bool verboseOutput = false;
+
+void hostSetVerbose(bool verbose) {
+    verboseOutput = verbose;
+}
+
+size_t Print::write(const uint8_t* data, size_t size) {
+    if (verboseOutput) {
+        fwrite(data, 1, size, stderr);
+    }
+    return size;
+}
+
+size_t Print::print(const char* value) {
+    return write((const uint8_t*)value, strlen(value));
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) return 0;
+    return write((const uint8_t*)buffer, min((size_t)length, sizeof(buffer) - 1));
+}
+
+// --- String --------------------------------------------------------------
+
+void String::format(double value, unsigned int decimals) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+    text = buffer;
+}
+
+int String::indexOf(const char* needle) const {
+    size_t found = text.find(needle);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from >= text.size() || to <= from) return String("");
+    return String(text.substr(from, to - from));
+}
+
+// --- heap ----------------------------------------------------------------
+
+static const uint32_t DEVICE_HEAP_SIZE = 320 * 1024;
+static size_t heapBaseline = 0;
+static size_t heapPeak = 0;
+static uint64_t allocationCount = 0;
+
+// Every allocation in the process goes through these, firmware and shim
+// alike, so harnesses can count them around the code they measure
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+
+void* malloc(size_t size) {
+    allocationCount++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocationCount++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    allocationCount++;
+    return __libc_realloc(pointer, size);
+}
+}
+
+void* operator new(size_t size) {
+    void* pointer = malloc(size ? size : 1);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+uint64_t hostAllocationCount() {
+    return allocationCount;
+}
+
+size_t hostHeapInUse() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks;
+}
+
+void hostSampleHeap() {
+    size_t inUse = hostHeapInUse();
+    if (inUse > heapPeak) heapPeak = inUse;
+}
+
+size_t hostPeakHeapInUse() {
+    hostSampleHeap();
+    return heapPeak;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    if (heapBaseline == 0) heapBaseline = hostHeapInUse();
+    size_t used = hostHeapInUse() > heapBaseline ? hostHeapInUse() - heapBaseline : 0;
+    hostSampleHeap();
+    return used < DEVICE_HEAP_SIZE ? DEVICE_HEAP_SIZE - used : 0;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    if (heapBaseline == 0) heapBaseline = hostHeapInUse();
+    size_t used = heapPeak > heapBaseline ? heapPeak - heapBaseline : 0;
+    return used < DEVICE_HEAP_SIZE ? DEVICE_HEAP_SIZE - used : 0;
+}
+
+uint32_t EspClass::getHeapSize() {
+    return DEVICE_HEAP_SIZE;
+}
+
+void EspClass::restart() {
+    fprintf(stderr, "host: ESP.restart() called, exiting\n");
+    exit(2);
+}
+
+// --- filesystem ----------------------------------------------------------
+
+File::File(HostFileMap* fileMap, const std::string& filePath, size_t offset)
+    : files(fileMap), path(filePath), position(offset), open(true), nextEntry(0) {}
+
+File::File(HostFileMap* fileMap, const std::string& filePath, const std::vector<std::string>& listing)
+    : files(fileMap), path(filePath), position(0), open(true), entries(listing), nextEntry(0) {}
+
+size_t File::size() const {
+    if (!files) return 0;
+    HostFileMap::const_iterator found = files->find(path);
+    return found == files->end() ? 0 : found->second.size();
+}
+
+size_t File::read(uint8_t* data, size_t size) {
+    if (!open || !files) return 0;
+    std::vector<uint8_t>& contents = (*files)[path];
+    size_t count = position < contents.size() ? min(size, contents.size() - position) : 0;
+    memcpy(data, contents.data() + position, count);
+    position += count;
+    return count;
+}
+
+size_t File::write(const uint8_t* data, size_t size) {
+    if (!open || !files) return 0;
+    std::vector<uint8_t>& contents = (*files)[path];
+    if (position + size > contents.size()) {
+        contents.resize(position + size);
+    }
+    memcpy(contents.data() + position, data, size);
+    position += size;
+    return size;
+}
+
+bool File::seek(uint32_t offset, SeekMode mode) {
+    size_t base = mode == SeekSet ? 0 : mode == SeekCur ? position : size();
+    if (base + offset > size()) return false;
+    position = base + offset;
+    return true;
+}
+
+File File::openNextFile(const char* mode) {
+    if (nextEntry >= entries.size()) return File();
+    return File(files, entries[nextEntry++], 0);
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+    std::string name(path);
+    HostFileMap::iterator found = files.find(name);
+
+    if (strcmp(mode, FILE_READ) == 0) {
+        if (found != files.end()) {
+            return File(&files, name, 0);
+        }
+        // Directory: every file under the prefix
+        std::string prefix = name.back() == '/' ? name : name + "/";
+        std::vector<std::string> listing;
+        for (found = files.begin(); found != files.end(); ++found) {
+            if (found->first.compare(0, prefix.size(), prefix) == 0) {
+                listing.push_back(found->first);
+            }
+        }
+        return File(&files, name, listing);
+    }
+
+    if (strcmp(mode, FILE_WRITE) == 0) {
+        files[name].clear();
+        return File(&files, name, 0);
+    }
+    return File(&files, name, files[name].size());
+}
+
+size_t SPIFFSFS::usedBytes() const {
+    size_t used = 0;
+    for (HostFileMap::const_iterator it = files.begin(); it != files.end(); ++it) {
+        used += it->second.size();
+    }
+    return used;
+}
+
+// --- NVS -----------------------------------------------------------------
+
+std::map<std::string, uint32_t>& Preferences::store() {
+    static std::map<std::string, uint32_t> values;
+    return values;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    std::map<std::string, uint32_t>::iterator found = store().find(qualified(key));
+    return found == store().end() ? defaultValue : found->second;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    store()[qualified(key)] = value;
+    return sizeof(value);
+}
+
+// --- sockets -------------------------------------------------------------
+
+String IPAddress::toString() const {
+    struct in_addr in;
+    in.s_addr = address;
+    return String(inet_ntoa(in));
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    stop();
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+        return 0;
+    }
+    struct sockaddr_in address = *(struct sockaddr_in*)result->ai_addr;
+    freeaddrinfo(result);
+    address.sin_port = htons(port);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int ret = ::connect(fd, (struct sockaddr*)&address, sizeof(address));
+    if (ret < 0 && errno != EINPROGRESS) {
+        stop();
+        return 0;
+    }
+
+    struct pollfd waiting = { fd, POLLOUT, 0 };
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (poll(&waiting, 1, timeout) <= 0 ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+        stop();
+        return 0;
+    }
+
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return 1;
+}
+
+uint8_t WiFiClient::connected() {
+    if (fd < 0) return 0;
+
+    // A peer that closed shows as readable with nothing to read
+    char probe;
+    ssize_t ret = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiClient::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool WiFiClient::writeAll(const uint8_t* data, size_t size, uint32_t timeout) {
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t ret = send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if (ret > 0) {
+            sent += ret;
+            continue;
+        }
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd waiting = { fd, POLLOUT, 0 };
+            if (poll(&waiting, 1, timeout) > 0) continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+int WiFiClient::waitReadable(uint32_t timeout) {
+    struct pollfd waiting = { fd, POLLIN, 0 };
+    return poll(&waiting, 1, timeout);
+}
+
+bool WiFiClient::readLine(std::string& line, uint32_t timeout) {
+    line.clear();
+    while (true) {
+        char c;
+        ssize_t ret = recv(fd, &c, 1, 0);
+        if (ret == 1) {
+            if (c == '\n') {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                return true;
+            }
+            line += c;
+            continue;
+        }
+        if (ret == 0) return false;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+        if (waitReadable(timeout) <= 0) return false;
+    }
+}
+
+bool WiFiClient::readExactly(std::string& out, size_t size, uint32_t timeout) {
+    out.clear();
+    char buffer[1024];
+    while (out.size() < size) {
+        ssize_t ret = recv(fd, buffer, min(sizeof(buffer), size - out.size()), 0);
+        if (ret > 0) {
+            out.append(buffer, ret);
+            continue;
+        }
+        if (ret == 0) return false;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+        if (waitReadable(timeout) <= 0) return false;
+    }
+    return true;
+}
+
+void WiFiClient::readToClose(std::string& out, uint32_t timeout) {
+    out.clear();
+    char buffer[1024];
+    while (true) {
+        ssize_t ret = recv(fd, buffer, sizeof(buffer), 0);
+        if (ret > 0) {
+            out.append(buffer, ret);
+            continue;
+        }
+        if (ret == 0) return;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return;
+        if (waitReadable(timeout) <= 0) return;
+    }
+}
+
+int WiFiClientSecure::connect(const char* host, uint16_t port, int32_t timeout) {
+    Serial.println("host: HTTPS is not available in the host harness, use an http:// URL");
+    return 0;
+}
+
+// SecureTransport proper needs mbedTLS and the ESP32 ssl_client; on the host
+// it only has to exist so APIClient links
+SecureTransport::SecureTransport() {
+    verifyMode = TLS_VERIFY_NONE;
+    pinReady = true;
+    sessionValid = false;
+    sessionPort = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+SecureTransport::~SecureTransport() {}
+
+bool SecureTransport::setVerification(TLSVerifyMode mode, const String& pin) {
+    verifyMode = mode;
+    return true;
+}
+
+int SecureTransport::connect(const char* host, uint16_t port, int32_t timeout) {
+    return WiFiClientSecure::connect(host, port, timeout);
+}
+
+void SecureTransport::clearSession() {
+    sessionValid = false;
+}
+
+// The uplink harnesses send no events, so these only have to link. Weak,
+// so harnesses that build EventDetector.cpp get the real ones.
+__attribute__((weak)) const char* eventDescription(EventType type) {
+    return "host harness event";
+}
+
+__attribute__((weak)) const char* eventStateName(EventState state) {
+    return "raised";
+}
+
+__attribute__((weak)) bool isCriticalEvent(EventType type) {
+    return false;
+}
+
+// --- HTTP ----------------------------------------------------------------
+
+bool HTTPClient::begin(WiFiClient& transport, const String& url) {
+    client = &transport;
+    headers.clear();
+    body.clear();
+
+    std::string text(url.c_str());
+    size_t scheme = text.find("://");
+    if (scheme == std::string::npos) return false;
+    std::string rest = text.substr(scheme + 3);
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    path = slash == std::string::npos ? "/" : rest.substr(slash);
+
+    size_t colon = authority.find(':');
+    host = authority.substr(0, colon);
+    port = colon == std::string::npos ? (text.compare(0, 5, "https") == 0 ? 443 : 80)
+                                      : (uint16_t)atoi(authority.c_str() + colon + 1);
+    return true;
+}
+
+void HTTPClient::end() {
+    // Same rule as the ESP32 core: keep the socket only if both sides agreed
+    if (client && !(reuse && serverKeepAlive)) {
+        client->stop();
+    }
+}
+
+void HTTPClient::addHeader(const String& name, const String& value) {
+    headers.push_back(std::make_pair(std::string(name.c_str()), std::string(value.c_str())));
+}
+
+void HTTPClient::collectHeaders(const char* names[], size_t count) {
+    collected.clear();
+    for (size_t i = 0; i < count; i++) {
+        collected.push_back(std::make_pair(std::string(names[i]), std::string()));
+    }
+}
+
+String HTTPClient::header(const char* name) {
+    for (size_t i = 0; i < collected.size(); i++) {
+        if (strcasecmp(collected[i].first.c_str(), name) == 0) return String(collected[i].second);
+    }
+    return String("");
+}
+
+int HTTPClient::GET() {
+    return sendRequest("GET", nullptr, 0);
+}
+
+int HTTPClient::POST(uint8_t* payload, size_t size) {
+    return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::sendRequest(const char* method, const uint8_t* payload, size_t size) {
+    body.clear();
+    serverKeepAlive = false;
+
+    if (!client->connected() && !client->connect(host.c_str(), port, timeout)) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    std::string request = std::string(method) + " " + path + " HTTP/1.1\r\n";
+    request += "Host: " + host + "\r\n";
+    request += "User-Agent: ESP32HTTPClient\r\n";
+    request += reuse ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    for (size_t i = 0; i < headers.size(); i++) {
+        request += headers[i].first + ": " + headers[i].second + "\r\n";
+    }
+    if (payload) {
+        request += "Content-Length: " + std::to_string(size) + "\r\n";
+    }
+    request += "\r\n";
+
+    if (!client->writeAll((const uint8_t*)request.data(), request.size(), timeout)) {
+        client->stop();
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+    if (payload && size > 0 && !client->writeAll(payload, size, timeout)) {
+        client->stop();
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+
+    return readResponse();
+}
+
+int HTTPClient::readResponse() {
+    std::string line;
+    unsigned long started = millis();
+    if (!client->readLine(line, timeout)) {
+        bool timedOut = millis() - started >= timeout;
+        client->stop();
+        return timedOut ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+    }
+
+    int code = 0;
+    if (sscanf(line.c_str(), "HTTP/%*d.%*d %d", &code) != 1) {
+        client->stop();
+        return HTTPC_ERROR_CONNECTION_LOST;
+    }
+
+    long contentLength = -1;
+    for (size_t i = 0; i < collected.size(); i++) {
+        collected[i].second.clear();
+    }
+    serverKeepAlive = line.compare(0, 8, "HTTP/1.1") == 0;
+    while (client->readLine(line, timeout) && !line.empty()) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+            contentLength = atol(value.c_str());
+        } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+            serverKeepAlive = strcasecmp(value.c_str(), "close") != 0;
+        }
+        for (size_t i = 0; i < collected.size(); i++) {
+            if (strcasecmp(name.c_str(), collected[i].first.c_str()) == 0) collected[i].second = value;
+        }
+    }
+
+    if (contentLength >= 0) {
+        if (!client->readExactly(body, contentLength, timeout)) {
+            client->stop();
+            return HTTPC_ERROR_CONNECTION_LOST;
+        }
+    } else {
+        client->readToClose(body, timeout);
+        serverKeepAlive = false;
+    }
+    return code;
+}
+
+int HTTPClient::request(const char* method, const String& url, const String& payload, String* response) {
+    WiFiClient transport;
+    HTTPClient http;
+    http.setReuse(false);
+    http.begin(transport, url);
+    http.addHeader("Content-Type", "application/json");
+    int code = http.sendRequest(method, (const uint8_t*)payload.c_str(), payload.length());
+    if (response) *response = http.getString();
+    http.end();
+    return code;
+}
+
+// --- JSON ----------------------------------------------------------------
+
+namespace {
+
+class JsonParser {
+private:
+    const char* cursor;
+
+public:
+    explicit JsonParser(const char* text) : cursor(text) {}
+
+    std::shared_ptr<JsonNode> document() {
+        std::shared_ptr<JsonNode> root = value();
+        skipSpace();
+        return root && *cursor == '\0' ? root : nullptr;
+    }
+
+private:
+    void skipSpace() {
+        while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n') cursor++;
+    }
+
+    bool literal(const char* word) {
+        size_t length = strlen(word);
+        if (strncmp(cursor, word, length) != 0) return false;
+        cursor += length;
+        return true;
+    }
+
+    bool text(std::string& out) {
+        if (*cursor != '"') return false;
+        cursor++;
+        while (*cursor && *cursor != '"') {
+            if (*cursor == '\\') {
+                cursor++;
+                if (!*cursor) return false;
+                // Escapes other than these are kept verbatim; responses are ASCII
+                char c = *cursor;
+                out += c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : c;
+            } else {
+                out += *cursor;
+            }
+            cursor++;
+        }
+        if (*cursor != '"') return false;
+        cursor++;
+        return true;
+    }
+
+    std::shared_ptr<JsonNode> value() {
+        skipSpace();
+        std::shared_ptr<JsonNode> node = std::make_shared<JsonNode>();
+
+        if (*cursor == '{') {
+            cursor++;
+            node->type = JsonNode::Object;
+            skipSpace();
+            if (*cursor == '}') { cursor++; return node; }
+            while (true) {
+                skipSpace();
+                std::string key;
+                if (!text(key)) return nullptr;
+                skipSpace();
+                if (*cursor++ != ':') return nullptr;
+                std::shared_ptr<JsonNode> member = value();
+                if (!member) return nullptr;
+                node->members.push_back(std::make_pair(key, member));
+                skipSpace();
+                if (*cursor == ',') { cursor++; continue; }
+                if (*cursor == '}') { cursor++; return node; }
+                return nullptr;
+            }
+        }
+
+        if (*cursor == '[') {
+            cursor++;
+            node->type = JsonNode::Array;
+            skipSpace();
+            if (*cursor == ']') { cursor++; return node; }
+            while (true) {
+                std::shared_ptr<JsonNode> item = value();
+                if (!item) return nullptr;
+                node->items.push_back(item);
+                skipSpace();
+                if (*cursor == ',') { cursor++; continue; }
+                if (*cursor == ']') { cursor++; return node; }
+                return nullptr;
+            }
+        }
+
+        if (*cursor == '"') {
+            node->type = JsonNode::Text;
+            return text(node->text) ? node : nullptr;
+        }
+        if (literal("true")) { node->type = JsonNode::Boolean; node->number = 1; return node; }
+        if (literal("false")) { node->type = JsonNode::Boolean; return node; }
+        if (literal("null")) return node;
+
+        char* end;
+        node->number = strtod(cursor, &end);
+        if (end == cursor) return nullptr;
+        cursor = end;
+        node->type = JsonNode::Number;
+        return node;
+    }
+};
+
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const String& input) {
+    JsonParser parser(input.c_str());
+    std::shared_ptr<JsonNode> root = parser.document();
+    if (!root) return DeserializationError::InvalidInput;
+    doc.set(root);
+    return DeserializationError::Ok;
+}
+
+JsonVariant JsonVariant::operator[](const char* key) const {
+    if (!node || node->type != JsonNode::Object) return JsonVariant();
+    for (size_t i = 0; i < node->members.size(); i++) {
+        if (node->members[i].first == key) return JsonVariant(node->members[i].second);
+    }
+    return JsonVariant();
+}
+
+JsonVariant JsonVariant::operator[](size_t index) const {
+    if (!node || node->type != JsonNode::Array || index >= node->items.size()) return JsonVariant();
+    return JsonVariant(node->items[index]);
+}
+
+size_t JsonVariant::size() const {
+    if (!node) return 0;
+    return node->type == JsonNode::Array ? node->items.size() : node->members.size();
+}
+
+int operator|(const JsonVariant& value, int fallback) {
+    if (!value.node || value.node->type != JsonNode::Number) return fallback;
+    return (int)value.node->number;
+}
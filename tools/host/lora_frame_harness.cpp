@@ -0,0 +1,223 @@
+// Encodes and decodes LoRa frames with the firmware's own LoRaFrame.cpp
+// and SensorRecord.cpp, for tools/test_lora_frame.py.
+//
+//   encode COUNT SEED   COUNT pseudo-random aggregates, edge values
+//                       included; one "<frame hex> <input json>" line each
+//   events COUNT SEED   The same for event frames
+//   acks COUNT SEED     "<aggregate frame hex> <ack hex> <input json>" for
+//                       acknowledgements of COUNT aggregate frames
+//   merge COUNT SEED    COUNT aggregates, one JSON line each, then the
+//                       mergeAggregate() of them all
+//   decode              hex aggregate frames on stdin, one per line;
+//                       prints the decoded record as JSON, or "invalid"
+
+#include <Arduino.h>
+#include <math.h>
+#include "LoRaFrame.h"
+#include "JsonWriter.h"
+
+static uint32_t rngState;
+
+static uint32_t nextRandom() {
+    rngState = rngState * 1664525UL + 1013904223UL;
+    return rngState;
+}
+
+static float randomFloat(float low, float high) {
+    return low + (high - low) * (nextRandom() >> 8) / 16777216.0f;
+}
+
+static AggregatedData makeRecord(uint32_t index) {
+    AggregatedData data;
+    memset(&data, 0, sizeof(data));
+    
+    // Most fields within sensor range, the odd one far outside it or NaN
+#define HARNESS_FILL(type, member, kind, group, key, pack, record) \
+    if (FIELD_##kind == FIELD_METRIC) { \
+        uint32_t roll = nextRandom() % 20; \
+        data.member = roll == 0 ? NAN : roll == 1 ? randomFloat(-1000.0f, 1000.0f) : randomFloat(-40.0f, 150.0f); \
+    } else { \
+        data.member = (type)nextRandom(); \
+    }
+    AGGREGATE_FIELDS(HARNESS_FILL)
+#undef HARNESS_FILL
+    
+    if (index == 0) {
+        data.tempAvg = 327.67f;
+        data.humAvg = -327.67f;
+        data.pressMin = 0.005f;
+        data.endTime = 0xFFFFFFFFUL;
+        data.sequence = 0;
+    }
+    return data;
+}
+
+static void printRecord(const AggregatedData& data, int node) {
+    char buffer[1024];
+    JsonWriter writer(buffer, sizeof(buffer));
+    writer.beginObject();
+    if (node >= 0) {
+        writer.field("node", node);
+    }
+    writeAggregateFields(writer, data, LAYOUT_FLAT, TIME_SECONDS, false);
+    writer.endObject();
+    printf("%s", writer.c_str());
+}
+
+static int encodeRecords(uint32_t count, uint32_t seed) {
+    rngState = seed;
+    for (uint32_t i = 0; i < count; i++) {
+        AggregatedData data = makeRecord(i);
+        uint8_t frame[64];
+        size_t length = encodeLoRaAggregate(data, (uint8_t)(i * 37), frame, sizeof(frame));
+        if (length != LORA_AGGREGATE_FRAME_SIZE) {
+            fprintf(stderr, "harness: frame %u is %u bytes\n", i, (unsigned)length);
+            return 1;
+        }
+        for (size_t b = 0; b < length; b++) {
+            printf("%02x", frame[b]);
+        }
+        printf(" ");
+        printRecord(data, -1);
+        printf("\n");
+    }
+    return 0;
+}
+
+static int encodeEvents(uint32_t count, uint32_t seed) {
+    rngState = seed;
+    for (uint32_t i = 0; i < count; i++) {
+        Event event;
+        memset(&event, 0, sizeof(event));
+        event.sequence = nextRandom();
+        event.type = (EventType)(1 + nextRandom() % (EVENT_TYPE_COUNT - 1));
+        event.state = (EventState)(nextRandom() % 3);
+        event.startTime = nextRandom();
+        event.value = nextRandom() % 10 == 0 ? NAN : randomFloat(-400.0f, 400.0f);
+        event.threshold = randomFloat(0.0f, 100.0f);
+        
+        uint8_t frame[64];
+        size_t length = encodeLoRaEvent(event, (uint8_t)i, frame, sizeof(frame));
+        uint8_t node;
+        Event decoded;
+        if (length != LORA_EVENT_FRAME_SIZE || !decodeLoRaEvent(frame, length, node, decoded) ||
+            decoded.sequence != event.sequence || decoded.type != event.type || node != (uint8_t)i) {
+            fprintf(stderr, "harness: event %u did not round trip\n", i);
+            return 1;
+        }
+        for (size_t b = 0; b < length; b++) {
+            printf("%02x", frame[b]);
+        }
+        
+        char buffer[256];
+        JsonWriter writer(buffer, sizeof(buffer));
+        writer.beginObject();
+        writer.field("sequence", event.sequence);
+        writer.field("type", (int)event.type);
+        writer.field("state", (int)event.state);
+        writer.field("startTime", event.startTime);
+        writer.field("value", event.value);
+        writer.field("threshold", event.threshold);
+        writer.endObject();
+        printf(" %s\n", writer.c_str());
+    }
+    return 0;
+}
+
+static void printHex(const uint8_t* data, size_t length) {
+    for (size_t b = 0; b < length; b++) {
+        printf("%02x", data[b]);
+    }
+}
+
+static int encodeAcks(uint32_t count, uint32_t seed) {
+    rngState = seed;
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t frame[64];
+        size_t length = encodeLoRaAggregate(makeRecord(i), (uint8_t)(i * 37), frame, sizeof(frame));
+        
+        // Quarter-dB steps so the input prints exactly; some out of range
+        float snr = ((int)(nextRandom() % 400) - 200) / 4.0f;
+        int16_t rssi = (int16_t)(nextRandom() % 250) - 200;
+        uint8_t ack[16];
+        size_t ackLength = encodeLoRaAck(frame[1], frame[length - 2] | (frame[length - 1] << 8), snr, rssi,
+                                         ack, sizeof(ack));
+        uint8_t node;
+        uint16_t ackedCRC;
+        float decodedSnr;
+        int16_t decodedRssi;
+        if (ackLength != LORA_ACK_FRAME_SIZE ||
+            !decodeLoRaAck(ack, ackLength, node, ackedCRC, decodedSnr, decodedRssi) || node != frame[1] ||
+            ackedCRC != loraFrameCRC(frame, length - LORA_FRAME_CRC_SIZE)) {
+            fprintf(stderr, "harness: ack %u did not round trip\n", i);
+            return 1;
+        }
+        printHex(frame, length);
+        printf(" ");
+        printHex(ack, ackLength);
+        printf(" {\"snr\":%.2f,\"rssi\":%d}\n", snr, rssi);
+    }
+    return 0;
+}
+
+static int mergeRecords(uint32_t count, uint32_t seed) {
+    rngState = seed;
+    AggregatedData merged;
+    for (uint32_t i = 0; i < count; i++) {
+        AggregatedData data = makeRecord(i + 1);
+        data.sampleCount = 1 + nextRandom() % 60;
+        printRecord(data, -1);
+        printf("\n");
+        if (i == 0) {
+            merged = data;
+        } else {
+            mergeAggregate(merged, data);
+        }
+    }
+    printRecord(merged, -1);
+    printf("\n");
+    return 0;
+}
+
+static int decodeFrames() {
+    char line[256];
+    while (fgets(line, sizeof(line), stdin)) {
+        uint8_t frame[120];
+        size_t length = 0;
+        for (char* hex = line; isxdigit((unsigned char)hex[0]) && isxdigit((unsigned char)hex[1]) &&
+                               length < sizeof(frame); hex += 2) {
+            char byte[3] = { hex[0], hex[1], '\0' };
+            frame[length++] = (uint8_t)strtoul(byte, nullptr, 16);
+        }
+        
+        uint8_t node;
+        AggregatedData data;
+        if (decodeLoRaAggregate(frame, length, node, data)) {
+            printRecord(data, node);
+        } else {
+            printf("invalid");
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && strcmp(argv[1], "encode") == 0) {
+        return encodeRecords(strtoul(argv[2], nullptr, 10), strtoul(argv[3], nullptr, 10));
+    }
+    if (argc == 4 && strcmp(argv[1], "events") == 0) {
+        return encodeEvents(strtoul(argv[2], nullptr, 10), strtoul(argv[3], nullptr, 10));
+    }
+    if (argc == 4 && strcmp(argv[1], "acks") == 0) {
+        return encodeAcks(strtoul(argv[2], nullptr, 10), strtoul(argv[3], nullptr, 10));
+    }
+    if (argc == 4 && strcmp(argv[1], "merge") == 0) {
+        return mergeRecords(strtoul(argv[2], nullptr, 10), strtoul(argv[3], nullptr, 10));
+    }
+    if (argc == 2 && strcmp(argv[1], "decode") == 0) {
+        return decodeFrames();
+    }
+    fprintf(stderr, "usage: %s encode|events|acks|merge COUNT SEED | decode\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,152 @@
+// Runs the firmware's EventDetector, EventOutbox, LoRaSink and LoRaScheduler
+// together on the host clock, for tools/test_lora_relay.py: events go from
+// the detector through the outbox to the radio the way the uplink task
+// relays them while the event sink can't deliver, or without one. Commands
+// come one per line on stdin:
+//
+//   new MODE SF PERMILLE     A fresh detector, outbox and sink; no adaptive
+//                            data rate. MODE failover is a failover sink
+//                            beside a WiFi event sink that is down, only a
+//                            LoRa-only setup with no event sink
+//   sample PRESSURE CURRENT [TEMPERATURE]
+//                            processSample() at the current time; 60 °F
+//                            unless given
+//   wait MS                  Advances the clock
+//   aggregate                deliver() of the next aggregate
+//   relay                    One relay pass, as UplinkTask runs it
+//   pending                  Entries left in the outbox
+//
+// Every frame on the air prints "FRAME EVENT TYPE STATE SEQUENCE" or
+// "FRAME AGGREGATE SEQUENCE"; pending prints the count.
+
+#include <Arduino.h>
+#include <LoRa.h>
+#include "EventDetector.h"
+#include "EventOutbox.h"
+#include "LoRaSink.h"
+#include "harness_common.h"
+
+static const uint8_t NODE_ID = 1;
+static const uint8_t EVENT_BATCH_SIZE = 8;          // As UplinkTask
+
+// The detector is fed directly, so nothing subscribes it to a collector
+bool DataCollector::addSampleSubscriber(SampleCallback callback, void* context) {
+    return false;
+}
+
+static void printFrame(const uint8_t* frame, size_t length) {
+    uint8_t node;
+    Event event;
+    AggregatedData data;
+    if (decodeLoRaEvent(frame, length, node, event)) {
+        printf("FRAME EVENT %d %s %lu\n", (int)event.type, eventStateName(event.state),
+               (unsigned long)event.sequence);
+    } else if (decodeLoRaAggregate(frame, length, node, data)) {
+        printf("FRAME AGGREGATE %lu\n", (unsigned long)data.sequence);
+    } else {
+        printf("FRAME INVALID %lu\n", (unsigned long)length);
+    }
+}
+
+// UplinkTask::relayEvents()
+static void relayPass(EventOutbox& outbox, LoRaSink& sink, bool eventSink) {
+    outbox.collect();
+    OutboxEntry batch[EVENT_BATCH_SIZE];
+    uint8_t count;
+    if (!eventSink) {
+        while ((count = outbox.peekMany(batch, EVENT_BATCH_SIZE, false)) > 0) {
+            uint8_t handled = sink.relayEvents(batch, count);
+            for (uint8_t i = 0; i < handled; i++) {
+                outbox.pop();
+            }
+            if (handled < count) {
+                break;
+            }
+        }
+        return;
+    }
+
+    uint8_t offset = 0;
+    while ((count = outbox.peekMany(batch, EVENT_BATCH_SIZE, true, offset)) > 0) {
+        uint8_t handled = sink.relayEvents(batch, count);
+        outbox.markRelayed(offset, handled);
+        offset += handled;
+        if (handled < count) {
+            break;
+        }
+    }
+}
+
+int main() {
+    hostSetVerbose(getenv("HARNESS_VERBOSE") != nullptr);
+    LoRa.onTransmit = printFrame;
+
+    EventDetector* detector = nullptr;
+    EventOutbox* outbox = nullptr;
+    LoRaSink* sink = nullptr;
+    bool eventSink = false;
+    uint32_t aggregates = 0;
+
+    SensorData data;
+    memset(&data, 0, sizeof(data));
+    data.humidity = 50.0;
+    data.valid = true;
+
+    char line[128];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        lineNumber++;
+        char command[16];
+        if (sscanf(line, "%15s", command) != 1) {
+            continue;
+        }
+
+        char mode[16];
+        int a, b;
+        float pressure, current, temperature = 60.0;
+        if (strcmp(command, "new") == 0 && sscanf(line, "%*s %15s %d %d", mode, &a, &b) == 3 &&
+            (strcmp(mode, "failover") == 0 || strcmp(mode, "only") == 0)) {
+            delete sink;
+            delete outbox;
+            delete detector;
+            detector = new EventDetector(nullptr);
+            detector->begin();
+            outbox = new EventOutbox(detector);
+            LoRaSchedulerConfig schedule = { (uint8_t)a, 20, (uint16_t)b, 0, false };
+            eventSink = strcmp(mode, "failover") == 0;
+            sink = new LoRaSink(NODE_ID, eventSink, schedule);
+            sink->update(false);
+        } else if (!sink) {
+            fprintf(stderr, "harness: line %d before new\n", lineNumber);
+            return 2;
+        } else if (strcmp(command, "sample") == 0 &&
+                   sscanf(line, "%*s %f %f %f", &pressure, &current, &temperature) >= 2) {
+            data.timestamp = millis();
+            data.sampleTime = millis();
+            data.sampleMicros = micros();
+            data.pressure = pressure;
+            data.current1 = current;
+            data.temperature = temperature;
+            detector->processSample(data);
+        } else if (strcmp(command, "wait") == 0 && sscanf(line, "%*s %d", &a) == 1) {
+            delay(a);
+        } else if (strcmp(command, "aggregate") == 0) {
+            AggregatedData aggregate = makeAggregate(aggregates);
+            aggregate.sequence = ++aggregates;
+            sink->deliver(aggregate, nullptr, 0);
+        } else if (strcmp(command, "relay") == 0) {
+            relayPass(*outbox, *sink, eventSink);
+        } else if (strcmp(command, "pending") == 0) {
+            printf("PENDING %u\n", outbox->getPendingCount());
+        } else {
+            fprintf(stderr, "harness: bad command on line %d: %s", lineNumber, line);
+            return 2;
+        }
+        fflush(stdout);
+    }
+
+    delete sink;
+    delete outbox;
+    delete detector;
+    return 0;
+}
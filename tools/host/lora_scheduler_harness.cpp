@@ -0,0 +1,112 @@
+// Drives the firmware's LoRaScheduler.cpp on a simulated clock, for
+// tools/test_lora_scheduler.py. Commands come one per line on stdin:
+//
+//   new SF POWER PERMILLE DWELL ADAPTIVE   A fresh scheduler
+//   airtime LENGTH SF                      frameAirtime() in ms
+//   allow event|telemetry LENGTH           1 or 0
+//   send event|telemetry LENGTH            allow(), then recordTransmit() if allowed; 1 or 0
+//   ack SNR RSSI                           recordAck()
+//   miss                                   recordMissedAck()
+//   wait MS                                Advances the clock
+//   state                                  Everything the getters say, as JSON
+//
+// Each command that answers prints one line.
+
+#include <Arduino.h>
+#include "LoRaScheduler.h"
+#include "JsonWriter.h"
+
+// The scheduler only reads the clock, so the harness owns it
+static unsigned long clockMs = 1000;
+
+unsigned long millis() {
+    return clockMs;
+}
+
+void delay(unsigned long ms) {
+    clockMs += ms;
+}
+
+static bool parseTraffic(const char* name, LoRaTraffic& traffic) {
+    if (strcmp(name, "event") == 0) {
+        traffic = LORA_TRAFFIC_EVENT;
+        return true;
+    }
+    if (strcmp(name, "telemetry") == 0) {
+        traffic = LORA_TRAFFIC_TELEMETRY;
+        return true;
+    }
+    return false;
+}
+
+static void printState(LoRaScheduler& scheduler) {
+    char buffer[512];
+    JsonWriter writer(buffer, sizeof(buffer));
+    writer.beginObject();
+    writer.field("spreadingFactor", (int)scheduler.getSpreadingFactor());
+    writer.field("txPower", (int)scheduler.getTxPower());
+    writer.field("settingsChanged", scheduler.takeSettingsChange());
+    writer.field("budget", scheduler.getBudget());
+    writer.field("budgetUsed", scheduler.getBudgetUsed());
+    writer.field("eventAirtime", scheduler.getEventAirtime());
+    writer.field("telemetryAirtime", scheduler.getTelemetryAirtime());
+    writer.field("eventsDeferred", scheduler.getEventsDeferred());
+    writer.field("telemetryDeferred", scheduler.getTelemetryDeferred());
+    writer.field("acks", scheduler.getAcksReceived());
+    writer.field("acksMissed", scheduler.getAcksMissed());
+    writer.field("adaptations", scheduler.getAdaptations());
+    writer.endObject();
+    printf("%s\n", writer.c_str());
+}
+
+int main() {
+    LoRaSchedulerConfig config = { 7, 20, 10, 0, false };
+    LoRaScheduler* scheduler = new LoRaScheduler(config);
+    
+    char line[128];
+    char word[16];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        lineNumber++;
+        char command[16];
+        if (sscanf(line, "%15s", command) != 1) {
+            continue;
+        }
+        
+        int a, b, c, d, e;
+        float snr;
+        LoRaTraffic traffic;
+        if (strcmp(command, "new") == 0 && sscanf(line, "%*s %d %d %d %d %d", &a, &b, &c, &d, &e) == 5) {
+            delete scheduler;
+            config.spreadingFactor = a;
+            config.txPower = b;
+            config.dutyCyclePermille = c;
+            config.maxFrameAirtime = d;
+            config.adaptive = e != 0;
+            scheduler = new LoRaScheduler(config);
+        } else if (strcmp(command, "airtime") == 0 && sscanf(line, "%*s %d %d", &a, &b) == 2) {
+            printf("%lu\n", LoRaScheduler::frameAirtime(a, b));
+        } else if ((strcmp(command, "allow") == 0 || strcmp(command, "send") == 0) &&
+                   sscanf(line, "%*s %15s %d", word, &a) == 2 && parseTraffic(word, traffic)) {
+            bool allowed = scheduler->allow(traffic, a);
+            if (allowed && command[0] == 's') {
+                scheduler->recordTransmit(traffic, a);
+            }
+            printf("%d\n", allowed ? 1 : 0);
+        } else if (strcmp(command, "ack") == 0 && sscanf(line, "%*s %f %d", &snr, &a) == 2) {
+            scheduler->recordAck(snr, a);
+        } else if (strcmp(command, "miss") == 0) {
+            scheduler->recordMissedAck();
+        } else if (strcmp(command, "wait") == 0 && sscanf(line, "%*s %d", &a) == 1) {
+            delay(a);
+        } else if (strcmp(command, "state") == 0) {
+            printState(*scheduler);
+        } else {
+            fprintf(stderr, "harness: bad command on line %d: %s", lineNumber, line);
+            return 2;
+        }
+    }
+    
+    delete scheduler;
+    return 0;
+}
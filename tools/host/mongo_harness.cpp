@@ -0,0 +1,202 @@
+// Runs the firmware's WellPumpMongoClient on Linux against the Data API
+// stand-in in tools/mock_server.py, through the same scenario as
+// uplink_harness.cpp:
+//
+//   steady    one aggregate per interval, plus a burst of events every
+//             EVENT_EVERY aggregates, on a healthy link
+//   outage    the server answers 503; aggregates pile up in the outbox
+//   recovery  the server comes back; time and requests to drain the backlog
+//
+// Built and driven by tools/uplink_bench.py --sink mongodb; prints one JSON
+// object.
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <SPIFFS.h>
+#include <sys/resource.h>
+#include "MongoDBClient.h"
+#include "harness_common.h"
+
+static const uint32_t EVENT_EVERY = 10;
+static const uint8_t EVENT_BURST = 3;
+
+struct Options {
+    String baseURL = "http://127.0.0.1:8080";
+    uint32_t steadyRecords = 60;
+    uint32_t outageRecords = 240;
+    unsigned long intervalMs = 60000;
+    unsigned long drainLimitMs = 300000;
+    bool realTimeRecovery = false;
+    bool verbose = false;
+};
+
+struct Snapshot {
+    unsigned long long wallUs;
+    unsigned long simulatedMs;
+    uint32_t requests;
+    uint32_t connections;
+    uint32_t reused;
+    uint32_t insertMany;
+    uint64_t allocations;              // Whole process: client, shim transport and harness
+};
+
+static Snapshot snapshot(WellPumpMongoClient& client) {
+    Snapshot s;
+    s.wallUs = wallMicros();
+    s.simulatedMs = millis();
+    s.allocations = hostAllocationCount();
+    s.requests = client.getRequestCount();
+    s.connections = client.getConnectionCount();
+    s.reused = client.getReusedCount();
+    s.insertMany = client.getInsertManyCount();
+    return s;
+}
+
+static void printPhase(const char* name, const Snapshot& from, const Snapshot& to, uint32_t records, bool last) {
+    double wallMs = (to.wallUs - from.wallUs) / 1000.0;
+    uint32_t requests = to.requests - from.requests;
+    // Same shape as uplink_harness; insertMany requests stand in for batch requests
+    printf("  \"%s\": {\"records\": %lu, \"wallMs\": %.1f, \"simulatedMs\": %lu, \"recordsPerSecond\": %.1f, "
+           "\"requests\": %lu, \"connections\": %lu, \"reused\": %lu, \"reconnectRetries\": 0, "
+           "\"batchRequests\": %lu, \"avgRequestMs\": %.1f, \"allocationsPerRecord\": %.1f}%s\n",
+           name, (unsigned long)records, wallMs, to.simulatedMs - from.simulatedMs,
+           wallMs > 0 ? records * 1000.0 / wallMs : 0.0,
+           (unsigned long)requests, (unsigned long)(to.connections - from.connections),
+           (unsigned long)(to.reused - from.reused), (unsigned long)(to.insertMany - from.insertMany),
+           requests ? wallMs / requests : 0.0,
+           records ? (double)(to.allocations - from.allocations) / records : 0.0,
+           last ? "" : ",");
+}
+
+static uint8_t makeEvents(OutboxEntry* entries, uint32_t index) {
+    static uint32_t sequence = 0;
+    for (uint8_t i = 0; i < EVENT_BURST; i++) {
+        Event& event = entries[i].event;
+        memset(&event, 0, sizeof(event));
+        event.sequence = ++sequence;
+        event.type = (EventType)(EVENT_HIGH_CURRENT + i);
+        event.state = EVENT_STATE_RAISED;
+        event.value = 12.5f + i;
+        event.threshold = 10.0f;
+        event.startTime = 1700000000UL + index * 60;
+        event.active = true;
+        entries[i].heartbeat = false;
+        entries[i].relayed = false;
+    }
+    return EVENT_BURST;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--url") == 0 && value) { options.baseURL = value; i++; }
+        else if (strcmp(arg, "--steady") == 0 && value) { options.steadyRecords = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--outage") == 0 && value) { options.outageRecords = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--interval-ms") == 0 && value) { options.intervalMs = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--drain-limit-ms") == 0 && value) { options.drainLimitMs = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--real-time-recovery") == 0) options.realTimeRecovery = true;
+        else if (strcmp(arg, "--verbose") == 0) options.verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--url URL] [--steady N] [--outage N] [--interval-ms MS] "
+                            "[--drain-limit-ms MS] [--real-time-recovery] [--verbose]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+    hostSetVerbose(options.verbose);
+
+    size_t heapBefore = hostHeapInUse();
+
+    // Stands in for the pipeline's counter: the harness writes to the client directly
+    SequenceCounter* sequences = new SequenceCounter("uplink");
+    sequences->begin();
+    WellPumpMongoClient* client = new WellPumpMongoClient(options.baseURL, "harness-key", "Cluster0",
+                                                          "wellpump", "WellPump_HOST", "Harness", sequences);
+    if (!client->begin()) {
+        fprintf(stderr, "harness: client could not reach %s/action/findOne\n", options.baseURL.c_str());
+        return 1;
+    }
+    size_t heapAfterBegin = hostHeapInUse();
+    uint32_t record = 0;
+    uint32_t eventsSent = 0;
+    uint32_t eventsFailed = 0;
+    OutboxEntry events[EVENT_BURST];
+
+    Snapshot steadyStart = snapshot(*client);
+    for (uint32_t i = 0; i < options.steadyRecords; i++) {
+        if (i % EVENT_EVERY == 0) {
+            uint8_t count = makeEvents(events, record);
+            uint8_t written = client->writeEvents(events, count);
+            eventsSent += written;
+            eventsFailed += count - written;
+        }
+        client->writeAggregatedData(makeAggregate(record++));
+        client->update();
+        hostSampleHeap();
+        delay(options.intervalMs);
+    }
+    Snapshot steadyEnd = snapshot(*client);
+
+    if (!setOutage(options.baseURL, true)) return 1;
+    Snapshot outageStart = snapshot(*client);
+    for (uint32_t i = 0; i < options.outageRecords; i++) {
+        client->writeAggregatedData(makeAggregate(record++));
+        client->update();
+        hostSampleHeap();
+        delay(options.intervalMs);
+    }
+    Snapshot outageEnd = snapshot(*client);
+    uint32_t backlog = client->getBufferedCount();
+
+    if (!setOutage(options.baseURL, false)) return 1;
+    hostSetRealTime(options.realTimeRecovery);
+    Snapshot drainStart = snapshot(*client);
+    unsigned long simulatedStart = millis();
+    while (client->getBufferedCount() > 0 && millis() - simulatedStart < options.drainLimitMs) {
+        client->update();
+        hostSampleHeap();
+        delay(1000);
+    }
+    hostSetRealTime(false);
+    Snapshot drainEnd = snapshot(*client);
+    uint32_t remaining = client->getBufferedCount();
+
+    OutboxStats outbox;
+    client->getOutboxStats(outbox);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\n");
+    printf("  \"sink\": \"mongodb\", \"encoding\": \"json\", \"compression\": false, \"intervalMs\": %lu,\n",
+           options.intervalMs);
+    printPhase("steady", steadyStart, steadyEnd, options.steadyRecords, false);
+    printPhase("outage", outageStart, outageEnd, options.outageRecords, false);
+    printPhase("recovery", drainStart, drainEnd, backlog - remaining, false);
+    printf("  \"backlog\": %lu, \"undrained\": %lu, \"outboxDropped\": %lu, \"rejected\": 0,\n",
+           (unsigned long)backlog, (unsigned long)remaining, (unsigned long)outbox.dropped);
+    printf("  \"finalBatchSize\": 20, \"compressedBatches\": 0, \"compressionRatio\": 1.00,\n");
+    printf("  \"mongo\": {\"documents\": %lu, \"insertMany\": %lu, \"duplicates\": %lu, "
+           "\"eventsSent\": %lu, \"eventsFailed\": %lu},\n",
+           (unsigned long)client->getDocumentsWritten(), (unsigned long)client->getInsertManyCount(),
+           (unsigned long)client->getDuplicateCount(), (unsigned long)eventsSent, (unsigned long)eventsFailed);
+    printf("  \"breaker\": {\"state\": \"%s\", \"trips\": %lu, \"deferred\": %lu},\n",
+           client->getBreakerState(), (unsigned long)client->getBreakerTrips(),
+           (unsigned long)client->getDeferredCount());
+    printf("  \"memory\": {\"clientHeapBytes\": %lu, \"peakHeapBytes\": %lu, \"outboxFlashBytes\": %lu, "
+           "\"maxRssKb\": %ld}\n",
+           (unsigned long)(heapAfterBegin - heapBefore), (unsigned long)(hostPeakHeapInUse() - heapBefore),
+           (unsigned long)SPIFFS.usedBytes(), usage.ru_maxrss);
+    printf("}\n");
+
+    delete client;
+    delete sequences;
+    return remaining == 0 ? 0 : 3;
+}
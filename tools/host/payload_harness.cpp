@@ -0,0 +1,274 @@
+// Encodes aggregates with the firmware's own SensorRecord.cpp, JsonWriter.cpp
+// and CborWriter.cpp and reports what serialization costs on its own,
+// without the network path around it, for each encoding:
+//
+//   bytes per record, records and bytes per second, and heap allocations
+//   per record (counted by host_core across the whole encode loop)
+//
+// Record 0 is also printed in both encodings (CBOR as hex) so the bench can
+// check that they carry the same values.
+//
+// Then the records are cut into upload batches of the sizes the API client
+// uses, encoded in both encodings as its writeBatch() does, and gzipped with
+// the firmware's Deflater: compression ratio and CPU time per batch.
+//
+// --input reads the records instead of generating them, one per line, with
+// every AGGREGATE_FIELDS member in schema order as a number (payload_bench.py
+// converts recorded uploads to this).
+//
+// Built and driven by tools/payload_bench.py; prints one JSON object.
+
+#include <Arduino.h>
+#include "JsonWriter.h"
+#include "CborWriter.h"
+#include "Deflater.h"
+#include "SensorRecord.h"
+#include "harness_common.h"
+
+struct Options {
+    uint32_t records = 1000;               // Generated; with --input, however many it holds
+    uint32_t passes = 20;                  // Encode loops timed; more passes steady the rate
+    const char* input = nullptr;
+    const char* device = "WellPump_HOST";
+    const char* location = "Harness";
+};
+
+// WellPumpAPIClient's own limits, which are private to it
+static const size_t PAYLOAD_BUFFER_SIZE = 8192;
+static const size_t COMPRESS_MIN_BYTES = 1024;
+static const uint8_t BATCH_SIZES[] = { 2, 5, 10, 20 };    // MIN_BATCH_SIZE to MAX_BATCH_SIZE
+
+static unsigned long long cpuMicros() {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--records") == 0 && value) { options.records = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--passes") == 0 && value) { options.passes = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--input") == 0 && value) { options.input = value; i++; }
+        else if (strcmp(arg, "--device") == 0 && value) { options.device = value; i++; }
+        else if (strcmp(arg, "--location") == 0 && value) { options.location = value; i++; }
+        else {
+            fprintf(stderr, "usage: %s [--records N] [--passes N] [--input FILE] [--device NAME] "
+                            "[--location NAME]\n", argv[0]);
+            return false;
+        }
+    }
+    return options.records > 0 && options.passes > 0;
+}
+
+// Returns how many records were read, or 0 on a malformed line
+static uint32_t readRecords(const char* path, AggregatedData*& records) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "harness: cannot open %s\n", path);
+        return 0;
+    }
+    uint32_t capacity = 256;
+    uint32_t count = 0;
+    records = (AggregatedData*)malloc(capacity * sizeof(AggregatedData));
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        if (count == capacity) {
+            capacity *= 2;
+            records = (AggregatedData*)realloc(records, capacity * sizeof(AggregatedData));
+        }
+        AggregatedData& data = records[count];
+        memset(&data, 0, sizeof(data));
+        char* cursor = line;
+        char* end;
+        bool valid = true;
+#define HARNESS_READ(type, member, kind, group, key, pack, record) \
+        data.member = (type)strtod(cursor, &end); \
+        valid = valid && end != cursor; \
+        cursor = end;
+        AGGREGATE_FIELDS(HARNESS_READ)
+#undef HARNESS_READ
+        if (!valid) {
+            fprintf(stderr, "harness: %s line %lu is not a record\n", path, (unsigned long)count + 1);
+            count = 0;
+            break;
+        }
+        count++;
+    }
+    fclose(file);
+    return count;
+}
+
+struct EncodeResult {
+    unsigned long long bytes;
+    unsigned long long elapsedUs;
+    uint64_t allocations;
+    uint32_t overflowed;
+};
+
+// One record per encode, into a buffer reused across records, as the API
+// client encodes into its own payload buffer
+template <typename Writer>
+static EncodeResult encodeAll(Writer& writer, const AggregatedData* records, const Options& options) {
+    EncodeResult result = {0, 0, 0, 0};
+    uint64_t allocationsBefore = hostAllocationCount();
+    unsigned long long start = wallMicros();
+    for (uint32_t pass = 0; pass < options.passes; pass++) {
+        for (uint32_t i = 0; i < options.records; i++) {
+            writer.reset();
+            writeSensorRecord(writer, records[i], options.device, options.location);
+            if (writer.overflowed()) result.overflowed++;
+            result.bytes += writer.size();
+        }
+    }
+    result.elapsedUs = wallMicros() - start;
+    result.allocations = hostAllocationCount() - allocationsBefore;
+    return result;
+}
+
+static const uint8_t* bodyOf(const JsonWriter& writer) { return (const uint8_t*)writer.c_str(); }
+static const uint8_t* bodyOf(const CborWriter& writer) { return (const uint8_t*)writer.data(); }
+
+struct GzipResult {
+    uint32_t batches;
+    uint32_t records;
+    uint32_t belowThreshold;                // The client sends these uncompressed
+    uint32_t incompressible;                // Gzip didn't come out smaller
+    unsigned long long bytes;
+    unsigned long long gzipBytes;
+    unsigned long long cpuUs;
+    uint64_t allocations;
+};
+
+// Consecutive records in batches of up to batchSize, as an outbox drain
+// sends them: records that don't fit the payload buffer wait for the next
+// batch. Only gzip() is timed.
+template <typename Writer>
+static GzipResult gzipBatches(Writer& writer, Deflater& deflater, const AggregatedData* records,
+                              uint8_t batchSize, const Options& options) {
+    static uint8_t compressed[PAYLOAD_BUFFER_SIZE];
+    GzipResult result = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (uint32_t pass = 0; pass < options.passes; pass++) {
+        uint32_t first = 0;
+        while (first + batchSize <= options.records) {
+            writer.reset();
+            writer.beginArray();
+            uint8_t count = batchSize;
+            for (uint8_t i = 0; i < batchSize; i++) {
+                auto before = writer.mark();
+                writeSensorRecord(writer, records[first + i], options.device, options.location);
+                if (writer.overflowed()) {
+                    writer.rewind(before);
+                    count = i;
+                    break;
+                }
+            }
+            writer.endArray();
+            if (count == 0 || writer.overflowed()) break;
+            first += count;
+            
+            const uint8_t* body = bodyOf(writer);
+            uint64_t allocationsBefore = hostAllocationCount();
+            unsigned long long start = cpuMicros();
+            size_t length = deflater.gzip(body, writer.size(), compressed, writer.size());
+            result.cpuUs += cpuMicros() - start;
+            result.allocations += hostAllocationCount() - allocationsBefore;
+            
+            result.batches++;
+            result.records += count;
+            result.bytes += writer.size();
+            result.gzipBytes += length ? length : writer.size();
+            if (writer.size() < COMPRESS_MIN_BYTES) result.belowThreshold++;
+            if (length == 0) result.incompressible++;
+        }
+    }
+    return result;
+}
+
+static void printGzip(const char* encoding, uint8_t batchSize, const GzipResult& result, bool last) {
+    double batches = result.batches ? result.batches : 1;
+    printf("    {\"encoding\": \"%s\", \"batchSize\": %u, \"batches\": %lu, \"recordsPerBatch\": %.1f, "
+           "\"bytesPerBatch\": %.1f, "
+           "\"gzipBytesPerBatch\": %.1f, \"ratio\": %.3f, \"cpuUsPerBatch\": %.2f, \"allocationsPerBatch\": %.3f, "
+           "\"belowThreshold\": %lu, \"incompressible\": %lu}%s\n",
+           encoding, batchSize, (unsigned long)result.batches, result.records / batches, result.bytes / batches, result.gzipBytes / batches,
+           result.gzipBytes ? (double)result.bytes / result.gzipBytes : 0.0, result.cpuUs / batches,
+           result.allocations / batches, (unsigned long)result.belowThreshold,
+           (unsigned long)result.incompressible, last ? "" : ",");
+}
+
+static void printResult(const char* name, const EncodeResult& result, const Options& options) {
+    double encoded = (double)options.records * options.passes;
+    double seconds = result.elapsedUs / 1000000.0;
+    printf("  \"%s\": {\"bytesPerRecord\": %.1f, \"usPerRecord\": %.3f, \"recordsPerSecond\": %.0f, "
+           "\"bytesPerSecond\": %.0f, \"allocationsPerRecord\": %.3f},\n",
+           name, result.bytes / encoded, result.elapsedUs / encoded, seconds > 0 ? encoded / seconds : 0.0,
+           seconds > 0 ? result.bytes / seconds : 0.0, result.allocations / encoded);
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    // Built up front so the timed loops only serialize
+    AggregatedData* records = nullptr;
+    if (options.input) {
+        options.records = readRecords(options.input, records);
+        if (options.records == 0) {
+            fprintf(stderr, "harness: no records in %s\n", options.input);
+            return 1;
+        }
+    } else {
+        records = (AggregatedData*)malloc(options.records * sizeof(AggregatedData));
+        for (uint32_t i = 0; i < options.records; i++) {
+            records[i] = makeAggregate(i);
+        }
+    }
+
+    static char jsonBuffer[1024];
+    static char cborBuffer[1024];
+    JsonWriter json(jsonBuffer, sizeof(jsonBuffer));
+    CborWriter cbor(cborBuffer, sizeof(cborBuffer));
+    EncodeResult jsonResult = encodeAll(json, records, options);
+    EncodeResult cborResult = encodeAll(cbor, records, options);
+    uint32_t overflowed = jsonResult.overflowed + cborResult.overflowed;
+
+    printf("{\n");
+    printf("  \"records\": %lu, \"recorded\": %s, \"passes\": %lu, \"overflowed\": %lu,\n",
+           (unsigned long)options.records, options.input ? "true" : "false", (unsigned long)options.passes,
+           (unsigned long)overflowed);
+    printResult("json", jsonResult, options);
+    printResult("cbor", cborResult, options);
+
+    json.reset();
+    writeSensorRecord(json, records[0], options.device, options.location);
+    cbor.reset();
+    writeSensorRecord(cbor, records[0], options.device, options.location);
+    printf("  \"sample\": {\"json\": %.*s, \"cborHex\": \"", (int)json.size(), json.c_str());
+    for (size_t i = 0; i < cbor.size(); i++) {
+        printf("%02x", (uint8_t)cbor.data()[i]);
+    }
+    printf("\"},\n");
+
+    static char batchBuffer[PAYLOAD_BUFFER_SIZE];
+    JsonWriter jsonBatch(batchBuffer, sizeof(batchBuffer));
+    CborWriter cborBatch(batchBuffer, sizeof(batchBuffer));
+    Deflater deflater;
+    const uint8_t sizes = sizeof(BATCH_SIZES) / sizeof(BATCH_SIZES[0]);
+    printf("  \"gzip\": [\n");
+    for (uint8_t i = 0; i < sizes; i++) {
+        printGzip("json", BATCH_SIZES[i], gzipBatches(jsonBatch, deflater, records, BATCH_SIZES[i], options), false);
+    }
+    for (uint8_t i = 0; i < sizes; i++) {
+        printGzip("cbor", BATCH_SIZES[i], gzipBatches(cborBatch, deflater, records, BATCH_SIZES[i], options),
+                  i + 1 == sizes);
+    }
+    printf("  ]\n");
+    printf("}\n");
+
+    free(records);
+    return overflowed == 0 ? 0 : 3;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Declared only; sensors are not part of the host harness
+class Adafruit_ADS1115 {};
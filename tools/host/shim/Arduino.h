@@ -0,0 +1,130 @@
+#pragma once
+
+// Host (Linux) stand-in for the parts of the Arduino core the uplink code
+// uses, so APIClient and its dependencies build and run unmodified.
+//
+// Time is virtual: millis() is real elapsed time plus whatever delay() has
+// skipped, and delay() returns immediately. Simulated minutes between
+// uploads cost nothing while network I/O still takes real time.
+// hostSetRealTime(true) makes delay() sleep, for servers that pace by
+// wall-clock time (the mock's rate limit).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+using std::min;
+using std::max;
+
+template <typename T, typename L, typename H>
+T constrain(T value, L low, H high) { return value < low ? low : (value > high ? high : value); }
+
+class String {
+private:
+    std::string text;
+
+public:
+    String(const char* value = "") : text(value ? value : "") {}
+    String(const std::string& value) : text(value) {}
+    explicit String(char value) : text(1, value) {}
+    explicit String(int value) : text(std::to_string(value)) {}
+    explicit String(unsigned int value) : text(std::to_string(value)) {}
+    explicit String(long value) : text(std::to_string(value)) {}
+    explicit String(unsigned long value) : text(std::to_string(value)) {}
+    explicit String(float value, unsigned int decimals = 2) { format(value, decimals); }
+    explicit String(double value, unsigned int decimals = 2) { format(value, decimals); }
+
+    unsigned int length() const { return text.size(); }
+    const char* c_str() const { return text.c_str(); }
+    bool isEmpty() const { return text.empty(); }
+    char operator[](unsigned int index) const { return index < text.size() ? text[index] : 0; }
+    long toInt() const { return atol(text.c_str()); }
+    float toFloat() const { return atof(text.c_str()); }
+    bool reserve(unsigned int size) { text.reserve(size); return true; }
+    int indexOf(const char* needle) const;
+    bool startsWith(const char* prefix) const { return text.compare(0, strlen(prefix), prefix) == 0; }
+    String substring(unsigned int from, unsigned int to) const;
+    String substring(unsigned int from) const { return substring(from, length()); }
+
+    String& operator+=(const String& other) { text += other.text; return *this; }
+    String& operator+=(const char* other) { text += other; return *this; }
+    String& operator+=(char other) { text += other; return *this; }
+
+    bool operator==(const String& other) const { return text == other.text; }
+    bool operator==(const char* other) const { return text == other; }
+    bool operator!=(const String& other) const { return text != other.text; }
+    bool operator!=(const char* other) const { return text != other; }
+
+    friend String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+    friend String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+    friend String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+
+private:
+    void format(double value, unsigned int decimals);
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(const uint8_t* data, size_t size);
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const String& value) { return print(value.c_str()); }
+    size_t print(const char* value);
+    size_t print(char value) { return printf("%c", value); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(double value, int decimals = 2) { return printf("%.*f", decimals, value); }
+
+    size_t println() { return print("\n"); }
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long baud) {}
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// rand() with a fixed seed, so harness runs repeat
+long random(long howBig);
+long random(long howSmall, long howBig);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+// Heap figures come from the host allocator, offset so they read like an
+// ESP32's (free heap shrinks as the client allocates)
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getHeapSize();
+    void restart();
+};
+
+extern EspClass ESP;
+
+// Harness controls
+void hostSetVerbose(bool verbose);
+void hostSetRealTime(bool enabled);     // delay() sleeps instead of skipping ahead
+size_t hostHeapInUse();
+size_t hostPeakHeapInUse();
+void hostSampleHeap();
+uint64_t hostAllocationCount();         // malloc, calloc, realloc and new since start
@@ -0,0 +1,66 @@
+#pragma once
+
+// Read-only JSON for the host harness: parses a document and supports the
+// lookups the uplink does on responses (doc["key"], array[i], value | default).
+
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+
+struct JsonNode {
+    enum Type { Null, Boolean, Number, Text, Array, Object } type = Null;
+    double number = 0;
+    std::string text;
+    std::vector<std::shared_ptr<JsonNode>> items;
+    std::vector<std::pair<std::string, std::shared_ptr<JsonNode>>> members;
+};
+
+class JsonArray;
+
+class JsonVariant {
+protected:
+    std::shared_ptr<JsonNode> node;
+
+public:
+    JsonVariant() {}
+    explicit JsonVariant(const std::shared_ptr<JsonNode>& value) : node(value) {}
+
+    bool isNull() const { return !node || node->type == JsonNode::Null; }
+    JsonVariant operator[](const char* key) const;
+    JsonVariant operator[](size_t index) const;
+    JsonVariant operator[](int index) const { return (*this)[(size_t)index]; }
+    size_t size() const;
+
+    template <typename T> T as() const;
+
+    friend int operator|(const JsonVariant& value, int fallback);
+};
+
+class JsonArray : public JsonVariant {
+public:
+    JsonArray() {}
+    explicit JsonArray(const std::shared_ptr<JsonNode>& value) : JsonVariant(value) {}
+    bool isNull() const { return !node || node->type != JsonNode::Array; }
+};
+
+template <> inline JsonArray JsonVariant::as<JsonArray>() const { return JsonArray(node); }
+template <> inline int JsonVariant::as<int>() const { return (*this) | 0; }
+
+class JsonDocument : public JsonVariant {
+public:
+    void set(const std::shared_ptr<JsonNode>& root) { node = root; }
+};
+
+class DeserializationError {
+public:
+    enum Code { Ok, InvalidInput };
+
+    DeserializationError(Code value) : code(value) {}
+    bool operator==(Code other) const { return code == other; }
+    bool operator!=(Code other) const { return code != other; }
+
+private:
+    Code code;
+};
+
+DeserializationError deserializeJson(JsonDocument& doc, const String& input);
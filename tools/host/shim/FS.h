@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+enum SeekMode { SeekSet, SeekCur, SeekEnd };
+
+// In-memory filesystem: file path -> contents. SPIFFS has no real
+// directories, so a "directory" is any prefix ending in '/'.
+typedef std::map<std::string, std::vector<uint8_t>> HostFileMap;
+
+class File {
+private:
+    HostFileMap* files;
+    std::string path;
+    size_t position;
+    bool open;
+    std::vector<std::string> entries;   // Directory listing
+    size_t nextEntry;
+
+public:
+    File() : files(nullptr), position(0), open(false), nextEntry(0) {}
+    File(HostFileMap* files, const std::string& path, size_t position);
+    File(HostFileMap* files, const std::string& path, const std::vector<std::string>& entries);
+
+    operator bool() const { return open; }
+    const char* name() const { return path.c_str(); }
+    bool isDirectory() const { return open && files && files->find(path) == files->end(); }
+    size_t size() const;
+
+    size_t read(uint8_t* data, size_t size);
+    size_t write(const uint8_t* data, size_t size);
+    bool seek(uint32_t offset, SeekMode mode = SeekSet);
+    void flush() {}
+    void close() { open = false; }
+
+    File openNextFile(const char* mode = FILE_READ);
+};
+
+class FS {
+protected:
+    HostFileMap files;
+
+public:
+    File open(const char* path, const char* mode = FILE_READ, bool create = false);
+    bool exists(const char* path) const { return files.find(path) != files.end(); }
+    bool remove(const char* path) { return files.erase(path) > 0; }
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+enum followRedirects_t {
+    HTTPC_DISABLE_FOLLOW_REDIRECTS,
+    HTTPC_STRICT_FOLLOW_REDIRECTS,
+    HTTPC_FORCE_FOLLOW_REDIRECTS
+};
+
+// HTTP/1.1 client with the same keep-alive and error-code behavior as the
+// ESP32 core's HTTPClient, for the subset of calls the uplink makes. The
+// response body is read eagerly, so getString() never touches the socket.
+class HTTPClient {
+private:
+    WiFiClient* client;
+    std::string host;
+    uint16_t port;
+    std::string path;
+    std::vector<std::pair<std::string, std::string>> headers;
+    bool reuse;
+    bool serverKeepAlive;
+    uint16_t timeout;
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> collected;
+
+public:
+    HTTPClient() : client(nullptr), port(80), reuse(true), serverKeepAlive(false), timeout(5000) {}
+
+    bool begin(WiFiClient& transport, const String& url);
+    void end();
+    void setReuse(bool enable) { reuse = enable; }
+    void setTimeout(uint16_t ms) { timeout = ms; }
+    void setFollowRedirects(followRedirects_t mode) {}
+    void addHeader(const String& name, const String& value);
+
+    int GET();
+    int POST(uint8_t* payload, size_t size);
+    String getString() { return String(body); }
+    void collectHeaders(const char* names[], size_t count);
+    String header(const char* name);
+
+    // For the harness's own requests to the mock
+    static int request(const char* method, const String& url, const String& payload, String* response);
+
+private:
+    int sendRequest(const char* method, const uint8_t* payload, size_t size);
+    int readResponse();
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+
+// NVS stand-in; values live for the life of the process
+class Preferences {
+private:
+    std::string space;
+
+    std::map<std::string, uint32_t>& store();
+    std::string qualified(const char* key) const { return space + "/" + key; }
+
+public:
+    bool begin(const char* name, bool readOnly = false) { space = name; return true; }
+    void end() {}
+
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    size_t putUInt(const char* key, uint32_t value);
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return getUInt(key, defaultValue); }
+    size_t putUShort(const char* key, uint16_t value) { putUInt(key, value); return sizeof(value); }
+};
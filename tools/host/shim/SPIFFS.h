@@ -0,0 +1,19 @@
+#pragma once
+
+#include "FS.h"
+
+class SPIFFSFS : public FS {
+private:
+    size_t capacity;
+
+public:
+    // Same size as the SPIFFS partition in huge_app.csv
+    SPIFFSFS() : capacity(0xE0000) {}
+
+    bool begin(bool formatOnFail = false) { return true; }
+    void setTotalBytes(size_t bytes) { capacity = bytes; }
+    size_t totalBytes() const { return capacity; }
+    size_t usedBytes() const;
+};
+
+extern SPIFFSFS SPIFFS;
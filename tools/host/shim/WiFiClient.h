@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+class IPAddress {
+private:
+    uint32_t address;
+
+public:
+    IPAddress(uint32_t value = 0) : address(value) {}
+    operator uint32_t() const { return address; }
+    String toString() const;
+};
+
+// Blocking POSIX TCP socket with the WiFiClient calls the uplink uses
+class WiFiClient {
+protected:
+    int fd;
+
+public:
+    WiFiClient() : fd(-1) {}
+    virtual ~WiFiClient() { stop(); }
+
+    virtual int connect(const char* host, uint16_t port, int32_t timeout);
+    int connect(const char* host, uint16_t port) { return connect(host, port, 5000); }
+    virtual uint8_t connected();
+    virtual void stop();
+
+    // Whole buffer or false; timeout in milliseconds
+    bool writeAll(const uint8_t* data, size_t size, uint32_t timeout);
+    // One line without the CRLF, or false on timeout/close
+    bool readLine(std::string& line, uint32_t timeout);
+    bool readExactly(std::string& out, size_t size, uint32_t timeout);
+    void readToClose(std::string& out, uint32_t timeout);
+
+private:
+    int waitReadable(uint32_t timeout);
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "WiFiClient.h"
+
+// No TLS on the host: connecting always fails. Use http:// URLs with the
+// harness.
+class WiFiClientSecure : public WiFiClient {
+public:
+    int connect(const char* host, uint16_t port, int32_t timeout);
+};
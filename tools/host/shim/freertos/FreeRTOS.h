@@ -0,0 +1,15 @@
+#pragma once
+
+// Types, plus a single-threaded mutex in semphr.h: the host harnesses
+// compile headers that declare FreeRTOS handles, but no tasks or queues.
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
@@ -0,0 +1,5 @@
+#pragma once
+
+// Just enough for SecureTransport.h to declare its members; HTTPS is not
+// available on the host
+typedef struct { unsigned char master[48]; } mbedtls_ssl_session;
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// Same convention as the ESP32 ROM routine (zlib-compatible CRC-32)
+inline uint32_t crc32_le(uint32_t crc, const uint8_t* data, uint32_t length) {
+    crc = ~crc;
+    while (length--) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
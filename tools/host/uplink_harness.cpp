@@ -0,0 +1,185 @@
+// Runs the firmware's WellPumpAPIClient on Linux against a local server
+// (tools/mock_server.py) and reports what the network path costs:
+//
+//   steady    one aggregate per interval on a healthy link
+//   outage    the server answers 503; aggregates pile up in the outbox
+//   recovery  the server comes back; time and requests to drain the backlog
+//
+// Built and driven by tools/uplink_bench.py; prints one JSON object.
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <SPIFFS.h>
+#include <sys/resource.h>
+#include "APIClient.h"
+#include "harness_common.h"
+
+struct Options {
+    String baseURL = "http://127.0.0.1:8080";
+    uint32_t steadyRecords = 60;
+    uint32_t outageRecords = 240;
+    unsigned long intervalMs = 60000;
+    unsigned long drainLimitMs = 300000;    // Simulated time allowed for recovery
+    bool useCbor = false;
+    bool compressBatches = false;
+    bool realTimeRecovery = false;         // Needed when the server rate-limits per wall-clock second
+    bool verbose = false;
+};
+
+struct Snapshot {
+    unsigned long long wallUs;
+    unsigned long simulatedMs;
+    uint32_t requests;
+    uint32_t connections;
+    uint32_t reused;
+    uint32_t reconnectRetries;
+    uint32_t batchRequests;
+    unsigned long long requestMsTotal;
+    uint64_t allocations;              // Whole process: client, shim transport and harness
+};
+
+static Snapshot snapshot(WellPumpAPIClient& client) {
+    Snapshot s;
+    s.wallUs = wallMicros();
+    s.simulatedMs = millis();
+    s.allocations = hostAllocationCount();
+    s.requests = client.getRequestCount();
+    s.connections = client.getConnectionCount();
+    s.reused = client.getReusedCount();
+    s.reconnectRetries = client.getReconnectRetryCount();
+    s.batchRequests = client.getBatchRequestCount();
+    s.requestMsTotal = client.getTotalRequestDuration();
+    return s;
+}
+
+static void printPhase(const char* name, const Snapshot& from, const Snapshot& to, uint32_t records, bool last) {
+    double wallMs = (to.wallUs - from.wallUs) / 1000.0;
+    uint32_t requests = to.requests - from.requests;
+    printf("  \"%s\": {\"records\": %lu, \"wallMs\": %.1f, \"simulatedMs\": %lu, \"recordsPerSecond\": %.1f, "
+           "\"requests\": %lu, \"connections\": %lu, \"reused\": %lu, \"reconnectRetries\": %lu, "
+           "\"batchRequests\": %lu, \"avgRequestMs\": %.1f, \"allocationsPerRecord\": %.1f}%s\n",
+           name, (unsigned long)records, wallMs, to.simulatedMs - from.simulatedMs,
+           wallMs > 0 ? records * 1000.0 / wallMs : 0.0,
+           (unsigned long)requests, (unsigned long)(to.connections - from.connections),
+           (unsigned long)(to.reused - from.reused), (unsigned long)(to.reconnectRetries - from.reconnectRetries),
+           (unsigned long)(to.batchRequests - from.batchRequests),
+           requests ? (double)(to.requestMsTotal - from.requestMsTotal) / requests : 0.0,
+           records ? (double)(to.allocations - from.allocations) / records : 0.0,
+           last ? "" : ",");
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--url") == 0 && value) { options.baseURL = value; i++; }
+        else if (strcmp(arg, "--steady") == 0 && value) { options.steadyRecords = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--outage") == 0 && value) { options.outageRecords = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--interval-ms") == 0 && value) { options.intervalMs = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--drain-limit-ms") == 0 && value) { options.drainLimitMs = strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--cbor") == 0) options.useCbor = true;
+        else if (strcmp(arg, "--gzip") == 0) options.compressBatches = true;
+        else if (strcmp(arg, "--real-time-recovery") == 0) options.realTimeRecovery = true;
+        else if (strcmp(arg, "--verbose") == 0) options.verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--url URL] [--steady N] [--outage N] [--interval-ms MS] "
+                            "[--drain-limit-ms MS] [--cbor] [--gzip] [--real-time-recovery] [--verbose]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+    hostSetVerbose(options.verbose);
+
+    size_t heapBefore = hostHeapInUse();
+
+    APIConfig config;
+    config.baseURL = options.baseURL;
+    config.apiKey = "";
+    config.useHttps = false;
+    config.verifyCertificate = false;
+    config.useCbor = options.useCbor;
+    config.compressBatches = options.compressBatches;
+
+    // Stands in for the pipeline's counter: the harness sends to the client directly
+    SequenceCounter* sequences = new SequenceCounter("uplink");
+    sequences->begin();
+    WellPumpAPIClient* client = new WellPumpAPIClient(config, "WellPump_HOST", "Harness", sequences);
+    if (!client->begin()) {
+        fprintf(stderr, "harness: client could not reach %s/api/health\n", options.baseURL.c_str());
+        return 1;
+    }
+    size_t heapAfterBegin = hostHeapInUse();
+    uint32_t record = 0;
+
+    // Steady state: one aggregate per interval, as the uplink task does
+    Snapshot steadyStart = snapshot(*client);
+    for (uint32_t i = 0; i < options.steadyRecords; i++) {
+        client->sendSensorData(makeAggregate(record++));
+        client->update();
+        hostSampleHeap();
+        delay(options.intervalMs);
+    }
+    Snapshot steadyEnd = snapshot(*client);
+
+    // Outage: everything lands in the flash outbox
+    if (!setOutage(options.baseURL, true)) return 1;
+    Snapshot outageStart = snapshot(*client);
+    for (uint32_t i = 0; i < options.outageRecords; i++) {
+        client->sendSensorData(makeAggregate(record++));
+        client->update();
+        hostSampleHeap();
+        delay(options.intervalMs);
+    }
+    Snapshot outageEnd = snapshot(*client);
+    uint32_t backlog = client->getBufferedCount();
+
+    // Recovery: update() once per simulated second until the outbox is empty
+    if (!setOutage(options.baseURL, false)) return 1;
+    hostSetRealTime(options.realTimeRecovery);
+    Snapshot drainStart = snapshot(*client);
+    unsigned long simulatedStart = millis();
+    while (client->getBufferedCount() > 0 && millis() - simulatedStart < options.drainLimitMs) {
+        client->update();
+        hostSampleHeap();
+        delay(1000);
+    }
+    hostSetRealTime(false);
+    Snapshot drainEnd = snapshot(*client);
+    uint32_t remaining = client->getBufferedCount();
+
+    OutboxStats outbox;
+    client->getOutboxStats(outbox);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\n");
+    printf("  \"encoding\": \"%s\", \"compression\": %s, \"intervalMs\": %lu,\n",
+           client->getPayloadEncoding(), client->isCompressionEnabled() ? "true" : "false", options.intervalMs);
+    printPhase("steady", steadyStart, steadyEnd, options.steadyRecords, false);
+    printPhase("outage", outageStart, outageEnd, options.outageRecords, false);
+    printPhase("recovery", drainStart, drainEnd, backlog - remaining, false);
+    printf("  \"backlog\": %lu, \"undrained\": %lu, \"outboxDropped\": %lu, \"rejected\": %lu,\n",
+           (unsigned long)backlog, (unsigned long)remaining, (unsigned long)outbox.dropped,
+           (unsigned long)client->getRejectedCount());
+    printf("  \"finalBatchSize\": %u, \"compressedBatches\": %lu, \"compressionRatio\": %.2f,\n",
+           client->getBatchSize(), (unsigned long)client->getCompressedBatchCount(), client->getCompressionRatio());
+    printf("  \"breaker\": {\"state\": \"%s\", \"trips\": %lu, \"deferred\": %lu},\n",
+           client->getBreakerState(), (unsigned long)client->getBreakerTrips(),
+           (unsigned long)client->getDeferredCount());
+    printf("  \"memory\": {\"clientHeapBytes\": %lu, \"peakHeapBytes\": %lu, \"outboxFlashBytes\": %lu, "
+           "\"maxRssKb\": %ld}\n",
+           (unsigned long)(heapAfterBegin - heapBefore), (unsigned long)(hostPeakHeapInUse() - heapBefore),
+           (unsigned long)SPIFFS.usedBytes(), usage.ru_maxrss);
+    printf("}\n");
+
+    delete client;
+    delete sequences;
+    return remaining == 0 ? 0 : 3;
+}
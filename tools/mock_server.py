@@ -0,0 +1,489 @@
+#!/usr/bin/env python3
+"""Local mock of the ingestion API for exercising the device uplink.
+
+Implements /api/health, /api/sensors, /api/sensors/batch and /api/events as
+described in docs/API_INTEGRATION.md, including gzip bodies, CBOR bodies and
+exactly-once ingestion:
+
+- sensor records are deduplicated by (device, sequence); repeats get 409
+- records and events a LoRa gateway relays ("source": "lora") are
+  provisional: the device's own full-resolution copy, backfilled over WiFi
+  later, replaces them instead of being rejected as a repeat
+- requests carrying an Idempotency-Key that was already committed get the
+  original response replayed
+
+It also stands in for the MongoDB Atlas Data API (/action/findOne,
+/action/find, /action/insertOne, /action/insertMany) used by the MongoDB
+sink: documents are unique by (collection, _id), a repeat fails with the
+E11000 duplicate key error, and an insertMany stops at the first duplicate
+like an ordered insert.
+
+Faults can be injected to test the device's retry path, most importantly a
+commit followed by a lost response (--drop-after-commit), which is what turns
+a naive client's retry into a duplicate. Latency, per-record processing time
+(a server that drains a backlog slowly), rate limiting and full outages can
+be set at startup or changed while running through /debug/config. With
+--record every sensor record stored is also appended to a file, one JSON
+line each, as input for tools/payload_bench.py --recorded.
+
+    python3 tools/mock_server.py --port 8080 --drop-after-commit 0.2
+    python3 tools/mock_server.py --record sensors.jsonl
+    curl localhost:8080/debug/stats
+    curl -d '{"outage": true}' localhost:8080/debug/config
+
+Python standard library only.
+"""
+
+import argparse
+import gzip
+import json
+import random
+import socket
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+from cbor_decode import CborError, decode as cbor_decode
+
+
+def is_relayed(record):
+    return isinstance(record, dict) and record.get("source") == "lora"
+
+
+class IngestStore:
+    """Committed records plus the bookkeeping needed to judge exactly-once."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.recording = None      # File each stored sensor record is appended to
+        self.clear()
+
+    def clear(self):
+        self.sensors = {}          # (device, sequence) -> record
+        self.events = []
+        self.relayed_events = {}   # (device, sequence, startTime) -> index into events, LoRa copies only
+        self.documents = set()     # (collection, _id) stored through the Data API
+        self.responses = {}        # Idempotency-Key -> (status, body)
+        self.duplicates = 0
+        self.superseded = 0
+        self.replayed = 0
+        self.requests = 0
+        self.dropped_responses = 0
+        self.injected_errors = 0
+        self.rate_limited = 0
+        self.outage_rejections = 0
+        self.records_received = 0
+        self.window_start = 0.0
+        self.window_requests = 0
+
+    def reset(self):
+        with self.lock:
+            self.clear()
+
+    def commit_sensor(self, record):
+        """Returns the per-record status: 201 stored, 409 already present."""
+        device = record.get("device", "")
+        sequence = record.get("sequence")
+        if sequence is None:
+            # Firmware older than sequence numbering: accept, can't dedupe
+            self.sensors[(device, "unsequenced-%d" % len(self.sensors))] = record
+            self.record(record)
+            return 201
+        key = (device, sequence)
+        if key in self.sensors:
+            if is_relayed(self.sensors[key]) and not is_relayed(record):
+                self.superseded += 1
+                self.sensors[key] = record
+                self.record(record)
+                return 201
+            self.duplicates += 1
+            return 409
+        self.sensors[key] = record
+        self.record(record)
+        return 201
+
+    def record(self, record):
+        if self.recording:
+            self.recording.write(json.dumps(record) + "\n")
+            self.recording.flush()
+
+    def commit_event(self, event):
+        """Events are kept as sent, except that a LoRa copy is replaced by
+        the device's own and not stored twice."""
+        key = (event.get("device", ""), event.get("sequence"), event.get("startTime"))
+        if key in self.relayed_events:
+            if is_relayed(event):
+                self.duplicates += 1
+                return 409
+            self.superseded += 1
+            self.events[self.relayed_events.pop(key)] = event
+            return 201
+        if is_relayed(event) and event.get("sequence") is not None:
+            self.relayed_events[key] = len(self.events)
+        self.events.append(event)
+        return 201
+
+    def insert_document(self, collection, document):
+        """Data API insert; returns the _id, or None if it already exists."""
+        if "_id" not in document:
+            document["_id"] = "generated-%d" % len(self.documents)
+        key = (collection, document["_id"])
+        if key in self.documents:
+            self.duplicates += 1
+            return None
+        self.documents.add(key)
+        if collection == "events":
+            self.events.append(document)
+        elif document.get("sequence") is not None:
+            self.sensors[(document.get("device", ""), document["sequence"])] = document
+        else:
+            self.sensors[(document.get("device", ""), "unsequenced-%d" % len(self.sensors))] = document
+        return document["_id"]
+
+    def missing_sequences(self):
+        """Gaps per device. Gaps are expected after a reset (numbers are
+        reserved in blocks) or an outbox eviction; otherwise they are loss."""
+        by_device = {}
+        for device, sequence in self.sensors:
+            if isinstance(sequence, int):
+                by_device.setdefault(device, []).append(sequence)
+        gaps = {}
+        for device, numbers in by_device.items():
+            numbers.sort()
+            missing = []
+            for low, high in zip(numbers, numbers[1:]):
+                if high - low > 1:
+                    missing.append([low + 1, high - 1])
+            gaps[device] = {"first": numbers[0], "last": numbers[-1], "count": len(numbers), "missing": missing}
+        return gaps
+
+    def stats(self):
+        with self.lock:
+            return {
+                "requests": self.requests,
+                "sensorsStored": len(self.sensors),
+                "eventsStored": len(self.events),
+                "documentsStored": len(self.documents),
+                "duplicatesRejected": self.duplicates,
+                "relayedSuperseded": self.superseded,
+                "relayedPending": sum(1 for record in self.sensors.values() if is_relayed(record)),
+                "idempotentReplays": self.replayed,
+                "droppedResponses": self.dropped_responses,
+                "injectedErrors": self.injected_errors,
+                "rateLimited": self.rate_limited,
+                "outageRejections": self.outage_rejections,
+                "recordsReceived": self.records_received,
+                "sequences": self.missing_sequences(),
+            }
+
+
+class MockHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # Keep-alive, like the real server
+    server_version = "WellPumpMock/1.0"
+
+    def log_message(self, fmt, *args):
+        if self.server.options.verbose:
+            sys.stderr.write("mock: " + (fmt % args) + "\n")
+
+    # --- plumbing -------------------------------------------------------
+
+    def send_json(self, status, payload):
+        body = json.dumps(payload).encode("utf-8")
+        self.send_response(status)
+        if status in (429, 503) and self.server.options.retry_after > 0:
+            self.send_header("Retry-After", str(self.server.options.retry_after))
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def read_body(self):
+        raw = self.read_body_raw()
+        if self.headers.get("Content-Encoding", "").lower() == "gzip":
+            raw = gzip.decompress(raw)
+        if self.headers.get("Content-Type", "").startswith("application/cbor"):
+            return cbor_decode(raw)
+        return json.loads(raw.decode("utf-8")) if raw else None
+
+    def drop_connection(self):
+        """Commit happened; make the response disappear."""
+        options = self.server.options
+        if options.fault_mode == "stall":
+            # Hold the socket past the device's 10 s request timeout
+            time.sleep(options.stall_seconds)
+        try:
+            self.connection.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self.close_connection = True
+
+    def rejection(self):
+        """Status and body for a request turned away before processing."""
+        store = self.server.store
+        options = self.server.options
+        with store.lock:
+            if options.outage:
+                store.outage_rejections += 1
+                return 503, {"error": "outage"}
+            if options.rate_limit > 0:
+                now = time.monotonic()
+                if now - store.window_start >= 1.0:
+                    store.window_start = now
+                    store.window_requests = 0
+                store.window_requests += 1
+                if store.window_requests > options.rate_limit:
+                    store.rate_limited += 1
+                    return 429, {"error": "rate limited"}
+        return None
+
+    def simulate_latency(self, records):
+        options = self.server.options
+        delay = options.latency + options.record_latency * records
+        if options.latency_jitter > 0:
+            delay += self.server.rng.uniform(0, options.latency_jitter)
+        if delay > 0:
+            time.sleep(delay)
+
+    # --- endpoints ------------------------------------------------------
+
+    @staticmethod
+    def duplicate_key(collection, document_id):
+        # Status and wording of the Data API's write error
+        return 400, {"error": "Failed to insert documents: E11000 duplicate key error collection: %s "
+                              "dup key: { _id: \"%s\" }" % (collection, document_id),
+                     "error_code": "DuplicateKey"}
+
+    def do_GET(self):
+        if self.path == "/api/health":
+            rejected = self.rejection()
+            if rejected:
+                self.send_json(*rejected)
+                return
+            self.simulate_latency(0)
+            self.send_json(200, {"status": "ok"})
+        elif self.path == "/debug/stats":
+            self.send_json(200, self.server.store.stats())
+        else:
+            self.send_json(404, {"error": "not found"})
+
+    def do_POST(self):
+        store = self.server.store
+        options = self.server.options
+        rng = self.server.rng
+
+        if self.path == "/debug/reset":
+            store.reset()
+            self.send_json(200, {"status": "reset"})
+            return
+        if self.path == "/debug/config":
+            self.update_options()
+            return
+
+        routes = {
+            "/api/sensors": self.ingest_sensor,
+            "/api/sensors/batch": self.ingest_batch,
+            "/api/events": self.ingest_event,
+            "/action/findOne": self.find_one,
+            "/action/find": self.find,
+            "/action/insertOne": self.insert_one,
+            "/action/insertMany": self.insert_many,
+        }
+        route = routes.get(self.path)
+        if route is None:
+            self.send_json(404, {"error": "not found"})
+            return
+
+        try:
+            payload = self.read_body()
+        except (OSError, ValueError, CborError) as error:
+            self.send_json(400, {"error": "bad body: %s" % error})
+            return
+
+        rejected = self.rejection()
+        if rejected:
+            self.send_json(*rejected)
+            return
+
+        if self.path in ("/action/findOne", "/action/find"):
+            records = 0
+        elif isinstance(payload, list):
+            records = len(payload)
+        elif isinstance(payload, dict) and isinstance(payload.get("documents"), list):
+            records = len(payload["documents"])
+        else:
+            records = 1
+        self.simulate_latency(records)
+
+        with store.lock:
+            store.records_received += records
+            store.requests += 1
+
+            if rng.random() < options.error_before_commit:
+                store.injected_errors += 1
+                status, body = 503, {"error": "injected"}
+            else:
+                key = self.headers.get("Idempotency-Key")
+                if key and key in store.responses:
+                    # Same answer as the first time, without committing again
+                    store.replayed += 1
+                    status, body = store.responses[key]
+                else:
+                    status, body = route(payload)
+                    if key and status < 500:
+                        store.responses[key] = (status, body)
+
+                if rng.random() < options.drop_after_commit:
+                    store.dropped_responses += 1
+                    drop = True
+                else:
+                    drop = False
+
+        if status < 500 and drop:
+            self.drop_connection()
+            return
+        self.send_json(status, body)
+
+    def update_options(self):
+        try:
+            changes = json.loads(self.read_body_raw() or b"{}")
+        except ValueError as error:
+            self.send_json(400, {"error": "bad body: %s" % error})
+            return
+        options = self.server.options
+        for name, value in changes.items():
+            if name not in RUNTIME_OPTIONS:
+                self.send_json(400, {"error": "unknown option %s" % name})
+                return
+            setattr(options, name, RUNTIME_OPTIONS[name](value))
+        self.send_json(200, {name: getattr(options, name) for name in RUNTIME_OPTIONS})
+
+    def read_body_raw(self):
+        length = int(self.headers.get("Content-Length", "0"))
+        return self.rfile.read(length) if length > 0 else b""
+
+    def ingest_sensor(self, record):
+        if not isinstance(record, dict):
+            return 400, {"error": "expected an object"}
+        status = self.server.store.commit_sensor(record)
+        return status, {"status": status}
+
+    def ingest_batch(self, records):
+        if not isinstance(records, list):
+            return 400, {"error": "expected an array"}
+        results = [{"status": self.server.store.commit_sensor(record)} for record in records]
+        return 200, {"results": results}
+
+    def ingest_event(self, event):
+        if not isinstance(event, dict):
+            return 400, {"error": "expected an object"}
+        status = self.server.store.commit_event(event)
+        return status, {"status": status}
+
+    def find_one(self, command):
+        if not isinstance(command, dict) or "collection" not in command:
+            return 400, {"error": "expected a command with a collection"}
+        return 200, {"document": None}
+
+    def find(self, command):
+        """Only the {"_id": {"$in": [...]}} filter the client sends."""
+        if not isinstance(command, dict) or "collection" not in command:
+            return 400, {"error": "expected a command with a collection"}
+        collection = command["collection"]
+        wanted = command.get("filter", {}).get("_id", {}).get("$in", [])
+        found = [{"_id": document_id} for document_id in wanted
+                 if (collection, document_id) in self.server.store.documents]
+        return 200, {"documents": found}
+
+    def insert_one(self, command):
+        if not isinstance(command, dict) or not isinstance(command.get("document"), dict):
+            return 400, {"error": "expected a command with a document"}
+        collection = command.get("collection", "")
+        document = command["document"]
+        inserted = self.server.store.insert_document(collection, document)
+        if inserted is None:
+            return self.duplicate_key(collection, document["_id"])
+        return 201, {"insertedId": inserted}
+
+    def insert_many(self, command):
+        if not isinstance(command, dict) or not isinstance(command.get("documents"), list):
+            return 400, {"error": "expected a command with documents"}
+        collection = command.get("collection", "")
+        inserted = []
+        for document in command["documents"]:
+            # Ordered: everything before the duplicate stays stored
+            document_id = self.server.store.insert_document(collection, document)
+            if document_id is None:
+                return self.duplicate_key(collection, document["_id"])
+            inserted.append(document_id)
+        return 201, {"insertedIds": inserted}
+
+
+# Options /debug/config may change while running, with their types
+RUNTIME_OPTIONS = {
+    "latency": float,
+    "latency_jitter": float,
+    "record_latency": float,
+    "rate_limit": int,
+    "error_before_commit": float,
+    "drop_after_commit": float,
+    "outage": bool,
+    "retry_after": int,
+}
+
+
+class MockServer(ThreadingHTTPServer):
+    daemon_threads = True
+
+    def __init__(self, address, options):
+        super().__init__(address, MockHandler)
+        self.options = options
+        self.store = IngestStore()
+        self.rng = random.Random(options.seed)
+        if getattr(options, "record", None):
+            self.store.recording = open(options.record, "a")
+
+
+def build_parser():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--drop-after-commit", type=float, default=0.0,
+                        help="probability that a committed request gets no response")
+    parser.add_argument("--fault-mode", choices=("close", "stall"), default="close",
+                        help="how a dropped response fails: connection reset or a stall past the client timeout")
+    parser.add_argument("--stall-seconds", type=float, default=12.0)
+    parser.add_argument("--error-before-commit", type=float, default=0.0,
+                        help="probability of a 503 without committing")
+    parser.add_argument("--latency", type=float, default=0.0,
+                        help="seconds added to every request")
+    parser.add_argument("--latency-jitter", type=float, default=0.0,
+                        help="up to this many random seconds added on top")
+    parser.add_argument("--record-latency", type=float, default=0.0,
+                        help="seconds per record in the body, so large batches drain slowly")
+    parser.add_argument("--rate-limit", type=int, default=0,
+                        help="requests per second before answering 429 (0 = unlimited)")
+    parser.add_argument("--retry-after", type=int, default=0,
+                        help="Retry-After seconds sent with 429 and 503 (0 = no header)")
+    parser.add_argument("--outage", action="store_true",
+                        help="start with every /api and /action request answered 503")
+    parser.add_argument("--record", metavar="FILE",
+                        help="append every sensor record stored to FILE, one JSON line each")
+    parser.add_argument("--seed", type=int, default=None)
+    parser.add_argument("--verbose", action="store_true")
+    return parser
+
+
+def main():
+    options = build_parser().parse_args()
+    server = MockServer((options.host, options.port), options)
+    print("mock server on http://%s:%d (stats at /debug/stats)" % (options.host, server.server_port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print(json.dumps(server.store.stats(), indent=2))
+
+
+if __name__ == "__main__":
+    main()
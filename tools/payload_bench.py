@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Benchmark record serialization on the host.
+
+Compiles tools/host/payload_harness.cpp together with the firmware's own
+SensorRecord, JsonWriter and CborWriter and prints, for JSON and CBOR,
+bytes per record, encode rate in records and bytes per second, and heap
+allocations per record, plus CBOR's size and encode time relative to JSON.
+The writers encode into caller-owned buffers, so anything but 0
+allocations per record is a regression. One record is decoded from both
+encodings (tools/cbor_decode.py for CBOR) and must carry the same values.
+
+The records are then cut into upload batches of 2 to 20, as an outbox drain
+sends them, and gzipped with the firmware's Deflater: ratio and CPU time per
+batch for each encoding and batch size. --recorded runs all of it on real
+records instead of generated ones: a JSON line per record in the
+POST /api/sensors layout, as written by tools/mock_server.py --record or
+the device's flash log (/telemetry.jsonl). Needs g++.
+
+    python3 tools/payload_bench.py
+    python3 tools/payload_bench.py --records 5000 --passes 50 --json
+    python3 tools/payload_bench.py --recorded sensors.jsonl
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+from aggregate_decode import load_schema
+from cbor_decode import decode as decode_cbor
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+
+SOURCES = [
+    "src/SensorRecord.cpp",
+    "src/JsonWriter.cpp",
+    "src/CborWriter.cpp",
+    "src/Deflater.cpp",
+    "tools/host/host_core.cpp",
+    "tools/host/payload_harness.cpp",
+]
+
+
+def build_harness(output, compiler):
+    command = [compiler, "-std=gnu++17", "-O2", "-Wall", "-Wno-unused-variable",
+               "-I", os.path.join(TOOLS, "host", "shim"), "-I", os.path.join(ROOT, "include"),
+               "-o", output]
+    command += [os.path.join(ROOT, path) for path in SOURCES]
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr)
+        raise SystemExit("payload_bench: harness build failed")
+
+
+def convert_recorded(source, output):
+    """Writes the records in source as the harness reads them: every schema
+    field as a number, in schema order. Returns the device and location of
+    the first record."""
+    fields = load_schema()
+    identity = None
+    with open(source) as lines, open(output, "w") as out:
+        for number, line in enumerate(lines, 1):
+            if not line.strip():
+                continue
+            try:
+                record = json.loads(line)
+            except ValueError:
+                raise SystemExit("payload_bench: %s line %d is not JSON" % (source, number))
+            if identity is None:
+                identity = (record.get("device", "WellPump_HOST"), record.get("location", "Harness"))
+            values = []
+            for field in fields:
+                value = record.get(field.member)
+                if value is None:
+                    # Local-only fields aren't uploaded; null metrics were NaN
+                    values.append("nan" if field.is_float and field.member in record else "0")
+                elif field.kind == "TIME":
+                    # Uploaded as epoch milliseconds, stored as seconds
+                    values.append(str(int(value) // 1000))
+                else:
+                    values.append(repr(float(value)) if field.is_float else str(int(value)))
+            out.write(" ".join(values) + "\n")
+    if identity is None:
+        raise SystemExit("payload_bench: no records in %s" % source)
+    return identity
+
+
+def run_harness(binary, args, recorded=None):
+    command = [binary, "--records", str(args.records), "--passes", str(args.passes)]
+    if recorded:
+        path, (device, location) = recorded
+        command += ["--input", path, "--device", device, "--location", location]
+    result = subprocess.run(command, stdout=subprocess.PIPE, text=True)
+    if result.returncode not in (0, 3):
+        raise SystemExit("payload_bench: harness exited with %d" % result.returncode)
+    return json.loads(result.stdout)
+
+
+def same_values(json_value, cbor_value):
+    # JSON carries 3 decimals, CBOR a float32; both within rounding of the source
+    if isinstance(json_value, dict) and isinstance(cbor_value, dict):
+        return json_value.keys() == cbor_value.keys() and all(
+            same_values(json_value[key], cbor_value[key]) for key in json_value)
+    if isinstance(json_value, (int, float)) and isinstance(cbor_value, (int, float)):
+        return abs(json_value - cbor_value) <= 0.0006 + abs(json_value) * 1e-6
+    return json_value == cbor_value
+
+
+def check_sample(report):
+    sample = report["sample"]
+    decoded = decode_cbor(bytes.fromhex(sample["cborHex"]))
+    report["sampleMatches"] = same_values(sample["json"], decoded)
+
+
+def print_report(report):
+    print("%d %s records x %d passes, %d overflowed" % (
+        report["records"], "recorded" if report["recorded"] else "synthetic", report["passes"], report["overflowed"]))
+    print("%-9s %10s %10s %10s %12s %11s" % ("encoding", "B/rec", "us/rec", "rec/s", "MB/s", "allocs/rec"))
+    for encoding in ("json", "cbor"):
+        e = report[encoding]
+        print("%-9s %10.1f %10.3f %10.0f %12.2f %11.3f" % (
+            encoding, e["bytesPerRecord"], e["usPerRecord"], e["recordsPerSecond"],
+            e["bytesPerSecond"] / 1e6, e["allocationsPerRecord"]))
+    json_stats, cbor_stats = report["json"], report["cbor"]
+    print("cbor/json: size %.2f, encode time %.2f; sample record %s" % (
+        cbor_stats["bytesPerRecord"] / json_stats["bytesPerRecord"],
+        cbor_stats["usPerRecord"] / json_stats["usPerRecord"] if json_stats["usPerRecord"] else 0.0,
+        "decodes to the same values" if report["sampleMatches"] else "DIFFERS between encodings"))
+
+    print("gzip per upload batch (records that don't fit the 8 KB payload buffer go in the next batch):")
+    print("%-9s %6s %8s %8s %10s %10s %7s %11s %9s" % (
+        "encoding", "batch", "batches", "rec/bat", "B/batch", "gzip B", "ratio", "cpu us/bat", "<1024 B"))
+    for g in report["gzip"]:
+        print("%-9s %6d %8d %8.1f %10.1f %10.1f %7.2f %11.2f %9d" % (
+            g["encoding"], g["batchSize"], g["batches"], g["recordsPerBatch"], g["bytesPerBatch"],
+            g["gzipBytesPerBatch"], g["ratio"], g["cpuUsPerBatch"], g["belowThreshold"]))
+    print("batches under 1024 B are sent uncompressed by the client; %d batches did not shrink" % (
+        sum(g["incompressible"] for g in report["gzip"])))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--records", type=int, default=1000, help="distinct aggregates encoded per pass")
+    parser.add_argument("--passes", type=int, default=20, help="timed passes over the records")
+    parser.add_argument("--recorded", metavar="FILE",
+                        help="JSON lines in the /api/sensors layout to use instead of generated records")
+    parser.add_argument("--compiler", default=os.environ.get("CXX", "g++"))
+    parser.add_argument("--json", action="store_true", help="print the raw report")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory(prefix="payload_bench_") as build_dir:
+        binary = os.path.join(build_dir, "payload_harness")
+        build_harness(binary, args.compiler)
+        recorded = None
+        if args.recorded:
+            path = os.path.join(build_dir, "records.txt")
+            recorded = (path, convert_recorded(args.recorded, path))
+        report = run_harness(binary, args, recorded)
+    check_sample(report)
+
+    if args.json:
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+    return 0 if report["overflowed"] == 0 and report["sampleMatches"] else 3
+
+
+if __name__ == "__main__":
+    sys.exit(main())
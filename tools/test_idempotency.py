@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Exactly-once check of the uplink against tools/mock_server.py.
+
+Builds tools/host/uplink_harness.cpp with the firmware's own APIClient,
+FlashOutbox and payload writers (as tools/uplink_bench.py does) and runs its
+steady / outage / recovery scenario while the mock commits requests and then
+drops the response, or fails them before committing. Every sequence must end
+up stored exactly once: none missing, none stored twice under a new
+sequence, and every lost response settled later by a replay or a 409. Also
+when a LoRa gateway relayed reduced copies of some of them first. Needs g++.
+
+    cd tools && python3 -m unittest test_idempotency
+"""
+
+import http.client
+import json
+import os
+import shutil
+import subprocess
+import tempfile
+import threading
+import unittest
+
+from mock_server import MockServer, build_parser
+from uplink_bench import FIRMWARE_SOURCES, HOST_SOURCES
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+
+DEVICE = "WellPump_HOST"            # The harness's device name
+DRAIN_LIMIT_MS = 3600000            # Simulated; breaker trips stretch the recovery
+
+
+class IdempotencyTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        compiler = os.environ.get("CXX", "g++")
+        if shutil.which(compiler) is None:
+            raise unittest.SkipTest("%s not found" % compiler)
+        cls.build_dir = tempfile.mkdtemp(prefix="idempotency_")
+        cls.harness = os.path.join(cls.build_dir, "uplink_harness")
+        command = [compiler, "-std=gnu++17", "-O2", "-Wall", "-Wno-unused-variable",
+                   "-I", os.path.join(TOOLS, "host", "shim"), "-I", os.path.join(ROOT, "include"),
+                   "-o", cls.harness]
+        command += [os.path.join(ROOT, path) for path in FIRMWARE_SOURCES["api"] + HOST_SOURCES["api"]]
+        result = subprocess.run(command, capture_output=True, text=True)
+        if result.returncode != 0:
+            raise AssertionError("harness build failed:\n" + result.stderr)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.build_dir, ignore_errors=True)
+
+    def start_server(self, **overrides):
+        # A dropped response resets the connection instead of stalling, so
+        # the harness doesn't wait out the client's timeout in real time
+        options = build_parser().parse_args(["--seed", "41", "--stall-seconds", "0"])
+        vars(options).update(overrides)
+        server = MockServer(("127.0.0.1", 0), options)
+        thread = threading.Thread(target=server.serve_forever, daemon=True)
+        thread.start()
+        self.addCleanup(server.server_close)
+        self.addCleanup(server.shutdown)
+        return server
+
+    def run_uplink(self, server, steady, outage, *flags):
+        """Runs the firmware client through the scenario; returns the
+        server's stats once its outbox is empty."""
+        command = [self.harness, "--url", "http://127.0.0.1:%d" % server.server_port,
+                   "--steady", str(steady), "--outage", str(outage),
+                   "--drain-limit-ms", str(DRAIN_LIMIT_MS)] + list(flags)
+        result = subprocess.run(command, capture_output=True, text=True)
+        self.assertIn(result.returncode, (0, 3), result.stderr)
+        report = json.loads(result.stdout)
+        self.assertEqual(report["undrained"], 0)
+        self.assertEqual(report["outboxDropped"], 0)
+        self.assertEqual(report["rejected"], 0)
+        return server.store.stats()
+
+    def assert_exactly_once(self, stats, count):
+        # A retry stored under a new sequence would show up past count
+        self.assertEqual(stats["sensorsStored"], count)
+        sequences = stats["sequences"][DEVICE]
+        self.assertEqual((sequences["first"], sequences["last"], sequences["count"]), (1, count, count))
+        self.assertEqual(sequences["missing"], [])
+
+    @staticmethod
+    def post(server, path, payload, key):
+        """A one-off request, as the LoRa gateway would send it."""
+        connection = http.client.HTTPConnection("127.0.0.1", server.server_port, timeout=5)
+        try:
+            headers = {"Content-Type": "application/json", "Idempotency-Key": key}
+            connection.request("POST", path, json.dumps(payload).encode("utf-8"), headers)
+            return connection.getresponse().status
+        finally:
+            connection.close()
+
+    def test_clean_link(self):
+        stats = self.run_uplink(self.start_server(), 20, 40)
+        self.assert_exactly_once(stats, 60)
+        self.assertEqual(stats["duplicatesRejected"] + stats["idempotentReplays"], 0)
+
+    def test_lost_responses_after_commit(self):
+        stats = self.run_uplink(self.start_server(drop_after_commit=0.3), 40, 160)
+        self.assert_exactly_once(stats, 200)
+        self.assertGreater(stats["droppedResponses"], 0)
+        # Every lost response was answered later by a replay or a 409
+        self.assertGreater(stats["duplicatesRejected"] + stats["idempotentReplays"], 0)
+
+    def test_lost_responses_and_server_errors(self):
+        server = self.start_server(drop_after_commit=0.2, error_before_commit=0.2)
+        stats = self.run_uplink(server, 40, 160)
+        self.assert_exactly_once(stats, 200)
+        self.assertGreater(stats["droppedResponses"], 0)
+        self.assertGreater(stats["injectedErrors"], 0)
+
+    def test_lost_responses_with_cbor_and_gzip(self):
+        stats = self.run_uplink(self.start_server(drop_after_commit=0.3), 40, 160, "--cbor", "--gzip")
+        self.assert_exactly_once(stats, 200)
+        self.assertGreater(stats["droppedResponses"], 0)
+
+    def test_relayed_records_superseded_by_backfill(self):
+        server = self.start_server()
+        # WiFi down: the gateway posts every fifth record as received over LoRa
+        for sequence in (5, 10, 15):
+            relayed = {"device": DEVICE, "sequence": sequence, "source": "lora"}
+            self.assertEqual(self.post(server, "/api/sensors", relayed, "lora-%d" % sequence), 201)
+        self.assertEqual(self.post(server, "/api/sensors", relayed, "lora-15-again"), 409)
+        # WiFi back: the device backfills everything at full resolution
+        stats = self.run_uplink(server, 20, 0)
+        self.assert_exactly_once(stats, 20)
+        self.assertEqual(stats["relayedSuperseded"], 3)
+        self.assertEqual(stats["relayedPending"], 0)
+
+    def test_relayed_event_superseded(self):
+        # Server side only: the harness doesn't send events
+        server = self.start_server()
+        event = {"device": DEVICE, "sequence": 7, "startTime": "1700000000000", "type": 8, "state": "raised"}
+        self.assertEqual(self.post(server, "/api/events", dict(event, source="lora"), "lora-e7"), 201)
+        self.assertEqual(self.post(server, "/api/events", dict(event, source="lora"), "lora-e7-again"), 409)
+        self.assertEqual(self.post(server, "/api/events", dict(event, value=61.5), "%s-e7" % DEVICE), 201)
+
+        self.assertEqual(server.store.events, [dict(event, value=61.5)])
+
+
+if __name__ == "__main__":
+    unittest.main()
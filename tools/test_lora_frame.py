@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""Round trip of the LoRa frames between firmware and host.
+
+Builds tools/host/lora_frame_harness.cpp with the firmware's LoRaFrame.cpp
+and SensorRecord.cpp, then checks both directions against the decoder in
+tools/aggregate_decode.py: frames the firmware encodes decode to the input
+within the fixed-point step, frames the host encodes decode on the
+firmware to the same values, and damaged frames are rejected by both.
+Event and acknowledgement frames and the merge behind failover frames are
+checked too.
+Needs g++.
+
+    cd tools && python3 -m unittest test_lora_frame
+"""
+
+import json
+import math
+import os
+import random
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+import aggregate_decode
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+SOURCES = ["src/LoRaFrame.cpp", "src/SensorRecord.cpp", "src/JsonWriter.cpp", "tools/host/lora_frame_harness.cpp"]
+
+RECORDS = 500
+INT16_LIMIT = 32767
+
+
+def expected_value(field, value):
+    """What a packed field decodes to: clamped and rounded to the scale."""
+    if not field.is_float:
+        return value & (1 << 8 * field.width) - 1
+    if value is None:
+        return None
+    limit = INT16_LIMIT / field.pack
+    return max(-limit, min(limit, value))
+
+
+class LoRaFrameTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        compiler = os.environ.get("CXX", "g++")
+        if shutil.which(compiler) is None:
+            raise unittest.SkipTest("%s not found" % compiler)
+        cls.build_dir = tempfile.mkdtemp(prefix="lora_frame_")
+        cls.harness = os.path.join(cls.build_dir, "lora_frame_harness")
+        command = [compiler, "-std=gnu++17", "-O2", "-Wall", "-Wno-unused-variable",
+                   "-I", os.path.join(TOOLS, "host", "shim"), "-I", os.path.join(ROOT, "include"),
+                   "-o", cls.harness] + [os.path.join(ROOT, path) for path in SOURCES]
+        result = subprocess.run(command, capture_output=True, text=True)
+        if result.returncode != 0:
+            raise AssertionError("harness build failed:\n" + result.stderr)
+        cls.fields = aggregate_decode.load_schema()
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.build_dir, ignore_errors=True)
+
+    def run_harness(self, *args, stdin=None):
+        result = subprocess.run([self.harness] + list(args), input=stdin, capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        return result.stdout.splitlines()
+
+    def assert_close(self, field, actual, expected, context):
+        if expected is None:
+            self.assertIsNone(actual, "%s %s" % (context, field.member))
+        elif field.is_float:
+            # Half a fixed-point step, plus the harness printing 3 decimals
+            self.assertLessEqual(abs(actual - expected), 0.5 / field.pack + 0.0011,
+                                 "%s %s: %r vs %r" % (context, field.member, actual, expected))
+        else:
+            self.assertEqual(actual, expected, "%s %s" % (context, field.member))
+
+    def test_frame_fits_radio_budget(self):
+        size = aggregate_decode.frame_size(self.fields)
+        self.assertGreaterEqual(size, 24)
+        self.assertLessEqual(size, 32)
+
+    def test_firmware_frames_decode_on_host(self):
+        lines = self.run_harness("encode", str(RECORDS), "12345")
+        self.assertEqual(len(lines), RECORDS)
+        for index, line in enumerate(lines):
+            frame_hex, source = line.split(" ", 1)
+            frame = bytes.fromhex(frame_hex)
+            self.assertEqual(len(frame), aggregate_decode.frame_size(self.fields))
+            node, record = aggregate_decode.decode_frame(frame, self.fields)
+            self.assertEqual(node, index * 37 % 256)
+            source = json.loads(source)
+            for field in aggregate_decode.packed_fields(self.fields):
+                self.assert_close(field, record[field.member], expected_value(field, source[field.member]),
+                                  "record %d" % index)
+
+    def test_host_frames_decode_on_firmware(self):
+        rng = random.Random(7)
+        packed = aggregate_decode.packed_fields(self.fields)
+        records = []
+        for index in range(RECORDS):
+            record = {}
+            for field in packed:
+                if field.is_float:
+                    record[field.member] = None if rng.random() < 0.05 else round(rng.uniform(-400, 400), 3)
+                else:
+                    record[field.member] = rng.getrandbits(8 * field.width)
+            records.append((index % 256, record))
+
+        frames = "".join(aggregate_decode.encode_frame(record, node, self.fields).hex() + "\n"
+                         for node, record in records)
+        lines = self.run_harness("decode", stdin=frames)
+        self.assertEqual(len(lines), RECORDS)
+        for (node, record), line in zip(records, lines):
+            decoded = json.loads(line)
+            self.assertEqual(decoded["node"], node)
+            for field in packed:
+                self.assert_close(field, decoded[field.member], expected_value(field, record[field.member]),
+                                  "node %d" % node)
+            # Fields outside the packed form come back zeroed
+            self.assertEqual(decoded["startTime"], 0)
+            self.assertEqual(decoded["tempMin"], 0)
+
+    def test_event_frames_decode_on_host(self):
+        for index, line in enumerate(self.run_harness("events", "200", "321")):
+            frame_hex, source = line.split(" ", 1)
+            node, event = aggregate_decode.decode_event_frame(bytes.fromhex(frame_hex), self.fields)
+            source = json.loads(source)
+            self.assertEqual(node, index % 256)
+            for key in ("sequence", "type", "startTime"):
+                self.assertEqual(event[key], source[key])
+            self.assertEqual(event["state"], aggregate_decode.EVENT_STATES[source["state"]])
+            for key in ("value", "threshold"):
+                if source[key] is None:
+                    self.assertIsNone(event[key])
+                else:
+                    self.assertLessEqual(abs(event[key] - max(-327.67, min(327.67, source[key]))), 0.0061)
+
+    def test_ack_frames_match_host(self):
+        for line in self.run_harness("acks", "200", "55"):
+            frame_hex, ack_hex, source = line.split(" ", 2)
+            frame, ack, source = bytes.fromhex(frame_hex), bytes.fromhex(ack_hex), json.loads(source)
+            self.assertEqual(aggregate_decode.encode_ack_frame(frame, source["snr"], source["rssi"]), ack)
+            node, decoded = aggregate_decode.decode_ack_frame(ack, self.fields)
+            self.assertEqual(node, frame[1])
+            self.assertEqual(decoded["ackedCrc"], aggregate_decode.frame_crc(frame[:-2]))
+            self.assertEqual(decoded["snr"], max(-32.0, min(31.75, source["snr"])))
+            self.assertEqual(decoded["rssi"], max(-128, min(127, source["rssi"])))
+
+    def test_merge_follows_schema_keys(self):
+        lines = [json.loads(line) for line in self.run_harness("merge", "8", "99")]
+        windows, merged = lines[:-1], lines[-1]
+        weights = [window["sampleCount"] for window in windows]
+        for field in self.fields:
+            values = [window[field.member] for window in windows]
+            if field.kind == "COUNT":
+                expected = sum(values) % (1 << 16)
+            elif field.kind == "ID" or field.key == "end":
+                expected = values[-1]
+            elif field.key == "start":
+                expected = values[0]
+            else:
+                expected = self.merge_metric(field.key, values, weights)
+                if expected is None:
+                    self.assertIsNone(merged[field.member], field.member)
+                    continue
+            self.assertAlmostEqual(merged[field.member], expected, delta=0.002 + abs(expected) * 1e-5,
+                                   msg=field.member)
+
+    @staticmethod
+    def merge_metric(key, values, weights):
+        # Pairwise, oldest first, as mergeAggregate() is applied window by
+        # window; a missing value takes the other side's
+        value, weight = values[0], weights[0]
+        for newer, newer_weight in zip(values[1:], weights[1:]):
+            if value is None or newer is None:
+                value = newer if value is None else value
+            elif key == "min":
+                value = min(value, newer)
+            elif key == "max":
+                value = max(value, newer)
+            elif key == "rms":
+                value = math.sqrt((value * value * weight + newer * newer * newer_weight) / (weight + newer_weight))
+            else:
+                value = (value * weight + newer * newer_weight) / (weight + newer_weight)
+            weight += newer_weight
+        return value
+
+    def test_damaged_frames_rejected(self):
+        frame = bytes.fromhex(self.run_harness("encode", "1", "99")[0].split(" ", 1)[0])
+        damaged = [frame[:-1], frame + b"\x00", bytes([0x21]) + frame[1:]]
+        for position in range(len(frame)):
+            for bit in (0x01, 0x80):
+                flipped = bytearray(frame)
+                flipped[position] ^= bit
+                damaged.append(bytes(flipped))
+
+        for candidate in damaged:
+            with self.assertRaises(ValueError):
+                aggregate_decode.decode_frame(candidate, self.fields)
+        lines = self.run_harness("decode", stdin="".join(candidate.hex() + "\n" for candidate in damaged))
+        self.assertEqual(lines, ["invalid"] * len(damaged))
+        self.assertNotEqual(self.run_harness("decode", stdin=frame.hex() + "\n"), ["invalid"])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Critical events relayed over LoRa while the event sink is down.
+
+Builds tools/host/lora_relay_harness.cpp with the firmware's EventDetector,
+EventOutbox, LoRaSink and LoRaScheduler and drives them on the host clock:
+every transition goes on the air once, an update coalesced into an entry
+that was already relayed goes out again, and an event the airtime budget
+held back still goes out once there is room, whatever the sequence numbers
+of the entries around it. Without an event sink every event goes over LoRa
+and the outbox empties as they're sent. Needs g++.
+
+    cd tools && python3 -m unittest test_lora_relay
+"""
+
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+SOURCES = ["src/EventDetector.cpp", "src/SlopeEstimator.cpp", "src/PumpCycleAnalyzer.cpp",
+           "src/EventOutbox.cpp", "src/LoRaSink.cpp", "src/LoRaScheduler.cpp", "src/LoRaFrame.cpp",
+           "src/SensorRecord.cpp", "tools/host/host_core.cpp", "tools/host/lora_relay_harness.cpp"]
+
+SAMPLE_MS = 2000
+HOUR_AND_BUCKET_MS = 3700000    # The scheduler's window is 61 one-minute buckets
+FAILOVER_MERGE = 5              # Aggregates per failover frame
+HIGH_CURRENT = 1                # EventType numbers
+LOW_PRESSURE = 2
+LOW_TEMPERATURE = 3
+HEARTBEAT_MS = 900000           # EventOutbox's default interval
+
+
+class LoRaRelayTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        compiler = os.environ.get("CXX", "g++")
+        if shutil.which(compiler) is None:
+            raise unittest.SkipTest("%s not found" % compiler)
+        cls.build_dir = tempfile.mkdtemp(prefix="lora_relay_")
+        cls.harness = os.path.join(cls.build_dir, "lora_relay_harness")
+        command = [compiler, "-std=gnu++17", "-O2", "-Wall", "-Wno-unused-variable",
+                   "-I", os.path.join(TOOLS, "host", "shim"), "-I", os.path.join(ROOT, "include"),
+                   "-o", cls.harness] + [os.path.join(ROOT, path) for path in SOURCES]
+        result = subprocess.run(command, capture_output=True, text=True)
+        if result.returncode != 0:
+            raise AssertionError("harness build failed:\n" + result.stderr)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.build_dir, ignore_errors=True)
+
+    def run_harness(self, commands):
+        """Returns the event frames sent, one list of (type, state, sequence)
+        per relay pass, and the entries left in the outbox after each."""
+        result = subprocess.run([self.harness], input="".join(line + "\n" for line in commands),
+                                capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        passes = []
+        pending = []
+        frames = []
+        for line in result.stdout.splitlines():
+            fields = line.split()
+            if fields[:2] == ["FRAME", "EVENT"]:
+                frames.append((int(fields[2]), fields[3], int(fields[4])))
+            elif fields[0] == "PENDING":
+                passes.append(frames)
+                pending.append(int(fields[1]))
+                frames = []
+        return passes, pending
+
+    @staticmethod
+    def samples(pressure, current, count, temperature=60.0):
+        commands = []
+        for _ in range(count):
+            commands += ["sample %.1f %.1f %.1f" % (pressure, current, temperature), "wait %d" % SAMPLE_MS]
+        return commands
+
+    @staticmethod
+    def relay():
+        # pending ends the pass's frames
+        return ["relay", "pending"]
+
+    def test_update_coalesced_behind_budget_refusal(self):
+        # SF12 at 1 per mille: an hour holds 3600 ms of airtime. A merged
+        # aggregate frame (1811 ms) and one event frame (1319 ms) fit; a
+        # second event frame doesn't.
+        commands = ["new failover 12 1"] + ["aggregate"] * FAILOVER_MERGE
+        commands += self.samples(50.0, 8.0, 3) + self.relay()        # High current raised, relayed
+        commands += self.samples(3.0, 8.0, 7) + self.relay()         # Low pressure raised, no room
+        commands += self.samples(3.0, 9.0, 1) + self.relay()         # High current escalates into its entry
+        commands += ["wait %d" % HOUR_AND_BUCKET_MS] + self.relay() + self.relay()
+        passes, _ = self.run_harness(commands)
+
+        self.assertEqual(passes[0], [(HIGH_CURRENT, "raised", 1)])
+        self.assertEqual(passes[1], [])
+        self.assertEqual(passes[2], [])
+        # The queue is [high current seq 3, low pressure seq 2]: both go out,
+        # the older sequence behind the newer one included
+        self.assertEqual(passes[3], [(HIGH_CURRENT, "raised", 3), (LOW_PRESSURE, "raised", 2)])
+        self.assertEqual(passes[4], [])
+
+    def test_each_transition_relayed_once(self):
+        commands = ["new failover 7 0"] + self.samples(50.0, 8.0, 3)
+        commands += self.relay() * 3
+        commands += self.samples(50.0, 2.0, 1) + self.relay() * 3
+        passes, _ = self.run_harness(commands)
+        self.assertEqual(passes, [[(HIGH_CURRENT, "raised", 1)], [], [], [(HIGH_CURRENT, "cleared", 2)], [], []])
+
+    def test_new_event_behind_a_full_batch_of_relayed_ones(self):
+        # Nine raise/clear transitions stay queued for the event sink after
+        # they're relayed, more than one relay batch of 8
+        commands = ["new failover 7 0"]
+        for _ in range(5):
+            commands += self.samples(50.0, 8.0, 3) + self.samples(50.0, 2.0, 1) + self.relay()
+        passes, _ = self.run_harness(commands)
+        self.assertEqual(sum(len(frames) for frames in passes), 10)
+        self.assertEqual([frame[2] for frames in passes for frame in frames], list(range(1, 11)))
+
+    def test_lora_only_relays_every_event(self):
+        commands = ["new only 7 0"] + self.samples(50.0, 2.0, 6, temperature=30.0) + self.relay()
+        commands += self.samples(50.0, 8.0, 3, temperature=30.0) + self.relay()
+        commands += self.samples(50.0, 2.0, 1, temperature=45.0) + self.relay()
+        # Heartbeats for the active high current event are let go unsent
+        commands += ["wait %d" % HEARTBEAT_MS] + self.relay()
+        passes, pending = self.run_harness(commands)
+        self.assertEqual(passes, [[(LOW_TEMPERATURE, "raised", 1)], [(HIGH_CURRENT, "raised", 2)],
+                                  [(HIGH_CURRENT, "cleared", 3), (LOW_TEMPERATURE, "cleared", 4)], []])
+        self.assertEqual(pending, [0, 0, 0, 0])
+
+    def test_lora_only_budget_refusal_waits_in_outbox(self):
+        # Every aggregate is a frame of its own here; next to one there's
+        # room for a single event frame an hour
+        commands = ["new only 12 1", "aggregate"] + self.samples(50.0, 2.0, 6, temperature=30.0) + self.relay()
+        commands += self.samples(3.0, 2.0, 7, temperature=30.0) + self.relay()
+        commands += ["wait %d" % HOUR_AND_BUCKET_MS] + self.relay()
+        passes, pending = self.run_harness(commands)
+        self.assertEqual(passes, [[(LOW_TEMPERATURE, "raised", 1)], [], [(LOW_PRESSURE, "raised", 2)]])
+        self.assertEqual(pending, [0, 1, 0])
+
+
+if __name__ == "__main__":
+    unittest.main()
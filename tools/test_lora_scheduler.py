@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""Airtime, duty-cycle budget and adaptive data rate of the LoRa scheduler.
+
+Builds tools/host/lora_scheduler_harness.cpp with the firmware's
+LoRaScheduler.cpp and drives it on a simulated clock: frame airtime
+against the Semtech formula, the budget over every sliding hour of a
+busy day, events getting through while telemetry is held back, and the
+spreading factor and power following the acknowledged SNR. Needs g++.
+
+    cd tools && python3 -m unittest test_lora_scheduler
+"""
+
+import json
+import math
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+from fractions import Fraction
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+SOURCES = ["src/LoRaScheduler.cpp", "src/JsonWriter.cpp", "tools/host/lora_scheduler_harness.cpp"]
+
+BANDWIDTH = 125000
+PREAMBLE = 8
+CODING_RATE = 1                 # 4/5
+AGGREGATE_FRAME = 32
+EVENT_FRAME = 18
+HOUR = 3600000
+TELEMETRY_SHARE = Fraction(80, 100)
+
+
+def airtime_ms(length, sf):
+    """Semtech AN1200.13: explicit header, CRC on, LDRO above 16 ms symbols."""
+    symbol = Fraction(2 ** sf * 1000, BANDWIDTH)
+    ldro = 1 if symbol > 16 else 0
+    numerator = 8 * length - 4 * sf + 28 + 16
+    payload = 8 + max(math.ceil(Fraction(numerator, 4 * (sf - 2 * ldro))) * (CODING_RATE + 4), 0)
+    return math.ceil((PREAMBLE + Fraction(17, 4) + payload) * symbol)
+
+
+class LoRaSchedulerTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        compiler = os.environ.get("CXX", "g++")
+        if shutil.which(compiler) is None:
+            raise unittest.SkipTest("%s not found" % compiler)
+        cls.build_dir = tempfile.mkdtemp(prefix="lora_scheduler_")
+        cls.harness = os.path.join(cls.build_dir, "lora_scheduler_harness")
+        command = [compiler, "-std=gnu++17", "-O2", "-Wall", "-Wno-unused-variable",
+                   "-I", os.path.join(TOOLS, "host", "shim"), "-I", os.path.join(ROOT, "include"),
+                   "-o", cls.harness] + [os.path.join(ROOT, path) for path in SOURCES]
+        result = subprocess.run(command, capture_output=True, text=True)
+        if result.returncode != 0:
+            raise AssertionError("harness build failed:\n" + result.stderr)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.build_dir, ignore_errors=True)
+
+    def run_harness(self, commands):
+        result = subprocess.run([self.harness], input="".join(line + "\n" for line in commands),
+                                capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        return result.stdout.splitlines()
+
+    def state(self, commands):
+        return json.loads(self.run_harness(commands + ["state"])[-1])
+
+    def test_airtime_matches_semtech_formula(self):
+        cases = [(length, sf) for sf in range(7, 13) for length in range(1, 65)]
+        lines = self.run_harness(["airtime %d %d" % case for case in cases])
+        for (length, sf), line in zip(cases, lines):
+            self.assertEqual(int(line), airtime_ms(length, sf), "%d bytes at SF%d" % (length, sf))
+        # Figures from the Semtech calculator, rounded up
+        self.assertEqual(airtime_ms(AGGREGATE_FRAME, 7), 72)
+        self.assertEqual(airtime_ms(AGGREGATE_FRAME, 12), 1811)
+
+    def test_dwell_limit_caps_spreading_factor(self):
+        fitting = max(sf for sf in range(7, 13) if airtime_ms(AGGREGATE_FRAME, sf) <= 400)
+        self.assertEqual(fitting, 9)
+        state = self.state(["new 12 20 10 400 1"])
+        self.assertEqual(state["spreadingFactor"], fitting)
+        self.assertTrue(state["settingsChanged"])
+
+        # Missed acknowledgements never push past it either
+        state = self.state(["new 9 20 10 400 1"] + ["miss"] * 12)
+        self.assertEqual(state["spreadingFactor"], fitting)
+        self.assertEqual(self.state(["new 12 20 10 0 1"])["spreadingFactor"], 12)
+
+    def simulate(self, sf, permille, hours, telemetry_every, event_every):
+        """A frame attempt every telemetry_every ms and an event every
+        event_every ms; returns the (time, airtime, traffic) sent and the
+        final state."""
+        commands = ["new %d 20 %d 0 0" % (sf, permille)]
+        attempts = []
+        for now in range(0, hours * HOUR, telemetry_every):
+            if now % event_every == 0:
+                commands.append("send event %d" % EVENT_FRAME)
+                attempts.append((now, airtime_ms(EVENT_FRAME, sf), "event"))
+            commands.append("send telemetry %d" % AGGREGATE_FRAME)
+            attempts.append((now, airtime_ms(AGGREGATE_FRAME, sf), "telemetry"))
+            commands.append("wait %d" % telemetry_every)
+        lines = self.run_harness(commands + ["state"])
+        sent = [attempt for attempt, line in zip(attempts, lines) if line == "1"]
+        return sent, json.loads(lines[-1])
+
+    def test_budget_holds_over_every_sliding_hour(self):
+        # SF10 aggregates every 10 s would want 25% of the air
+        budget = 10 * 3600
+        sent, state = self.simulate(10, 10, 4, 10000, 300000)
+        self.assertEqual(state["budget"], budget)
+        self.assertGreater(state["telemetryDeferred"], 0)
+
+        start = 0
+        used = 0
+        for end in range(len(sent)):
+            used += sent[end][1]
+            while sent[start][0] <= sent[end][0] - HOUR:
+                used -= sent[start][1]
+                start += 1
+            self.assertLessEqual(used, budget, "hour ending at %d ms" % sent[end][0])
+
+        # The budget is spent, not left idle: telemetry fills its share
+        # around the events
+        last_hour = [frame for frame in sent if frame[0] > 3 * HOUR]
+        self.assertGreater(sum(frame[1] for frame in last_hour), budget * TELEMETRY_SHARE * 0.9)
+
+    def test_events_get_through_while_telemetry_waits(self):
+        # An event every 5 minutes fits the fifth held back for events
+        sent, state = self.simulate(10, 10, 3, 10000, 300000)
+        self.assertGreater(state["telemetryDeferred"], 0)
+        self.assertEqual(state["eventsDeferred"], 0)
+        self.assertEqual(sum(1 for frame in sent if frame[2] == "event"), 3 * 12)
+
+        # Telemetry alone never takes more than its share
+        sent, state = self.simulate(10, 10, 2, 10000, 10 ** 9)
+        used = sum(frame[1] for frame in sent if frame[0] >= HOUR)
+        self.assertLessEqual(used, state["budget"] * TELEMETRY_SHARE)
+
+    def test_telemetry_paced_across_the_hour(self):
+        # At 1%, 80% of it for telemetry, a frame buys 125 times its airtime off
+        frame = airtime_ms(AGGREGATE_FRAME, 12)
+        off = frame * 125
+        lines = self.run_harness(["new 12 20 10 0 0", "send telemetry 32", "allow telemetry 32", "allow event 18",
+                                  "wait %d" % (off - 1), "allow telemetry 32", "wait 1", "allow telemetry 32"])
+        self.assertEqual(lines, ["1", "0", "1", "0", "1"])
+
+    def test_budget_frees_up_after_an_hour(self):
+        frame = airtime_ms(EVENT_FRAME, 12)
+        commands = ["new 12 20 10 0 0"] + ["send event %d" % EVENT_FRAME] * 30
+        lines = self.run_harness(commands + ["allow event 18", "allow telemetry 32", "state"])
+        allowed = 10 * 3600 // frame
+        self.assertEqual(lines[:30], ["1"] * allowed + ["0"] * (30 - allowed))
+        self.assertEqual(lines[30:32], ["0", "0"])
+        state = json.loads(lines[-1])
+        self.assertEqual((state["budgetUsed"], state["eventsDeferred"]), (allowed * frame, 31 - allowed))
+
+        # Still counted 59 minutes on, gone once the whole minute is an hour old
+        self.assertEqual(self.state(commands + ["wait %d" % (HOUR - 60000)])["budgetUsed"], allowed * frame)
+        later = commands + ["wait %d" % (HOUR + 60000)]
+        self.assertEqual(self.state(later)["budgetUsed"], 0)
+        self.assertEqual(self.run_harness(later + ["allow telemetry 32", "allow event 18"])[-2:], ["1", "1"])
+
+    def test_no_budget_without_duty_cycle(self):
+        state = self.state(["new 12 20 0 0 0"] + ["send telemetry 32"] * 100)
+        self.assertEqual(state["budget"], 0)
+        self.assertEqual(state["telemetryDeferred"], 0)
+        self.assertEqual(state["telemetryAirtime"], 100 * airtime_ms(AGGREGATE_FRAME, 12))
+
+    def test_good_link_steps_down_spreading_factor_then_power(self):
+        # 5 dB at SF10 is 10 dB over the floor and the margin: 3 steps
+        state = self.state(["new 10 20 10 0 1"] + ["ack 5 -90"] * 5)
+        self.assertEqual((state["spreadingFactor"], state["txPower"]), (7, 20))
+        self.assertTrue(state["settingsChanged"])
+
+        # At SF7 the next steps come off the power, never below 2 dBm
+        state = self.state(["new 7 20 10 0 1"] + ["ack 10 -70"] * 5)
+        self.assertEqual((state["spreadingFactor"], state["txPower"]), (7, 14))
+        state = self.state(["new 7 5 10 0 1"] + ["ack 30 -40"] * 5)
+        self.assertEqual(state["txPower"], 2)
+
+    def test_best_snr_of_the_history_decides(self):
+        # One good frame among fades is enough, as with LoRaWAN ADR
+        state = self.state(["new 10 20 10 0 1", "ack -20 -120", "ack -20 -120", "ack 5 -90",
+                            "ack -20 -120", "ack -20 -120"])
+        self.assertEqual(state["spreadingFactor"], 7)
+        # Nothing moves before the history is full
+        state = self.state(["new 10 20 10 0 1"] + ["ack 5 -90"] * 4)
+        self.assertEqual((state["spreadingFactor"], state["adaptations"]), (10, 0))
+
+    def test_weak_link_raises_power_then_spreading_factor(self):
+        # -10 dB at SF7 is 12.5 dB short: 5 steps, 2 of them power
+        state = self.state(["new 7 14 10 0 1"] + ["ack -10 -125"] * 5)
+        self.assertEqual((state["spreadingFactor"], state["txPower"]), (10, 20))
+
+    def test_missed_acks_raise_power_then_spreading_factor(self):
+        state = self.state(["new 7 8 10 0 1"] + ["miss"] * 2)
+        self.assertEqual((state["spreadingFactor"], state["txPower"]), (7, 8))
+        state = self.state(["new 7 8 10 0 1"] + ["miss"] * 3)
+        self.assertEqual((state["spreadingFactor"], state["txPower"]), (7, 20))
+        state = self.state(["new 7 8 10 0 1"] + ["miss"] * 9)
+        self.assertEqual((state["spreadingFactor"], state["txPower"], state["acksMissed"]), (9, 20, 9))
+        # An ack in between starts the count over
+        state = self.state(["new 7 8 10 0 1", "miss", "miss", "ack -5 -120", "miss", "miss"])
+        self.assertEqual(state["txPower"], 8)
+
+    def test_fixed_settings_without_acks(self):
+        state = self.state(["new 9 17 10 0 0"] + ["ack 20 -40"] * 5 + ["miss"] * 6)
+        self.assertEqual((state["spreadingFactor"], state["txPower"]), (9, 17))
+        self.assertFalse(state["settingsChanged"])
+        self.assertEqual(state["adaptations"], 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""Leak detection on simulated pressure traces.
+
+Builds tools/host/event_detector_harness.cpp with the firmware's
+SlopeEstimator.cpp and EventDetector.cpp and runs pressure traces through
+them, one sample every 2 seconds as the collector takes them: a steady
+leak, a flat line with sensor noise, a leak interrupted by a pump run, and
+hours of idle samples across the estimator's hourly rebase. Each checks
+the slope against a least-squares fit done here and the time
+EVENT_PRESSURE_DECAY is raised or cleared. Needs g++.
+
+    cd tools && python3 -m unittest test_pressure_decay
+"""
+
+import os
+import random
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+SOURCES = ["src/EventDetector.cpp", "src/SlopeEstimator.cpp", "src/PumpCycleAnalyzer.cpp",
+           "tools/host/host_core.cpp", "tools/host/event_detector_harness.cpp"]
+
+SAMPLE_MS = 2000
+START_MS = 1000
+WINDOW_MS = 300000              # EventDetector's regression window
+MIN_SPAN_MS = 180000            # Idle data needed before the slope counts
+EVENT_DELAY_MS = 30000          # Decay sustained this long raises the event
+EVENT_PRESSURE_DECAY = 6
+DECAY_THRESHOLD = 0.5           # PSI/min, default leak threshold
+DECAY_HYSTERESIS = 0.25
+PUMP_CURRENT = 5.0              # Running, below the high-current threshold
+HOUR_MS = 3600000
+
+
+def fit_slope(samples):
+    """Least-squares slope of (ms, value) pairs, in units per minute."""
+    n = len(samples)
+    mean_t = sum(t for t, _ in samples) / n
+    mean_v = sum(v for _, v in samples) / n
+    covariance = sum((t - mean_t) * (v - mean_v) for t, v in samples)
+    variance = sum((t - mean_t) ** 2 for t, _ in samples)
+    return covariance / variance * 60000
+
+
+def idle_window(trace, index):
+    """The samples the detector's estimator holds after trace[index]: idle
+    ones since the last pump run, within the window."""
+    now = trace[index][0]
+    window = []
+    for t, pressure, current in reversed(trace[:index + 1]):
+        if current >= 0.5 or now - t > WINDOW_MS:
+            break
+        window.append((t, pressure))
+    return window[::-1]
+
+
+class PressureDecayTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        compiler = os.environ.get("CXX", "g++")
+        if shutil.which(compiler) is None:
+            raise unittest.SkipTest("%s not found" % compiler)
+        cls.build_dir = tempfile.mkdtemp(prefix="pressure_decay_")
+        cls.harness = os.path.join(cls.build_dir, "event_detector_harness")
+        command = [compiler, "-std=gnu++17", "-O2", "-Wall", "-Wno-unused-variable",
+                   "-I", os.path.join(TOOLS, "host", "shim"), "-I", os.path.join(ROOT, "include"),
+                   "-o", cls.harness] + [os.path.join(ROOT, path) for path in SOURCES]
+        result = subprocess.run(command, capture_output=True, text=True)
+        if result.returncode != 0:
+            raise AssertionError("harness build failed:\n" + result.stderr)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.build_dir, ignore_errors=True)
+
+    def detect(self, trace):
+        """Runs (ms, pressure, current) samples through the detector; returns
+        (ms, rate, active) per sample and the (ms, state) pressure decay
+        transitions."""
+        stdin = "".join("%d %.4f %.3f\n" % sample for sample in trace)
+        result = subprocess.run([self.harness, "detect"], input=stdin, capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        samples, events = [], []
+        for line in result.stdout.splitlines():
+            fields = line.split()
+            if fields[0] == "EVENT":
+                if int(fields[3]) == EVENT_PRESSURE_DECAY:
+                    events.append((int(fields[1]), fields[2]))
+            else:
+                samples.append((int(fields[0]), float(fields[1]), fields[2] == "1"))
+        self.assertEqual(len(samples), len(trace))
+        return samples, events
+
+    def check_rates(self, trace, samples, tolerance=0.002):
+        """The reported decay matches the fit wherever the detector has one."""
+        for index, (t, rate, _) in enumerate(samples):
+            window = idle_window(trace, index)
+            if len(window) < 3 or window[-1][0] - window[0][0] < MIN_SPAN_MS:
+                continue
+            expected = -fit_slope([(t, round(v, 4)) for t, v in window])
+            self.assertAlmostEqual(rate, expected, delta=tolerance, msg="rate at %d ms" % t)
+
+    @staticmethod
+    def trace(duration_ms, pressure, current=lambda t: 0.0, start=START_MS):
+        return [(t, pressure(t), current(t)) for t in range(start, start + duration_ms, SAMPLE_MS)]
+
+    def test_linear_leak_raises_after_span_and_delay(self):
+        # 1 PSI/min from 60 PSI with a little sensor noise
+        rng = random.Random(1)
+        trace = self.trace(600000, lambda t: 60 - (t - START_MS) / 60000 + rng.uniform(-0.05, 0.05))
+        samples, events = self.detect(trace)
+        self.check_rates(trace, samples)
+
+        # The window needs 3 minutes of data, then the decay has to hold for 30 s
+        self.assertEqual(events, [(START_MS + MIN_SPAN_MS + EVENT_DELAY_MS, "raised")])
+        self.assertAlmostEqual(samples[-1][1], 1.0, delta=0.02)
+        self.assertTrue(samples[-1][2])
+
+    def test_flat_trace_with_noise_stays_quiet(self):
+        rng = random.Random(2)
+        trace = self.trace(2 * HOUR_MS, lambda t: 48 + rng.gauss(0, 0.3))
+        samples, events = self.detect(trace)
+        self.check_rates(trace, samples)
+        self.assertEqual(events, [])
+        self.assertLess(max(abs(rate) for _, rate, _ in samples), DECAY_THRESHOLD / 2)
+
+    def test_pump_run_restarts_window(self):
+        # 2.5 minutes of leak, a 1-minute pump run back up to 60 PSI, then
+        # the same leak again
+        run_start = START_MS + 150000
+        run_end = run_start + 60000
+
+        def pressure(t):
+            if t < run_start:
+                return 55 - (t - START_MS) / 60000
+            if t < run_end:
+                return 52.5 + (t - run_start) / 8000
+            return 60 - (t - run_end) / 60000
+
+        def current(t):
+            return PUMP_CURRENT if run_start <= t < run_end else 0.0
+
+        trace = self.trace(900000, pressure, current)
+        samples, events = self.detect(trace)
+        self.check_rates(trace, samples)
+
+        # No rate while the pump runs or before the new window spans 3 minutes
+        for t, rate, _ in samples:
+            if run_start <= t < run_end + MIN_SPAN_MS:
+                self.assertEqual(rate, 0.0, "rate at %d ms" % t)
+        self.assertEqual(events, [(run_end + MIN_SPAN_MS + EVENT_DELAY_MS, "raised")])
+
+    def test_raised_leak_survives_pump_run_and_clears_on_recovery(self):
+        # Leak raised, pump runs, then pressure holds: the event stays up
+        # through the run and clears once a full idle span shows no decay
+        run_start = START_MS + 300000
+        run_end = run_start + 60000
+
+        def pressure(t):
+            if t < run_start:
+                return 60 - (t - START_MS) / 60000
+            if t < run_end:
+                return 55 + (t - run_start) / 12000
+            return 60.0
+
+        def current(t):
+            return PUMP_CURRENT if run_start <= t < run_end else 0.0
+
+        trace = self.trace(900000, pressure, current)
+        samples, events = self.detect(trace)
+        self.assertEqual(events, [(START_MS + MIN_SPAN_MS + EVENT_DELAY_MS, "raised"),
+                                  (run_end + MIN_SPAN_MS, "cleared")])
+        for t, _, active in samples:
+            if run_start <= t < run_end + MIN_SPAN_MS:
+                self.assertTrue(active, "active at %d ms" % t)
+
+    def test_slope_holds_across_hourly_rebase(self):
+        # Three hours of a slow leak: the estimator re-anchors its time
+        # origin every hour, and the slope must not jump when it does
+        rng = random.Random(3)
+        trace = self.trace(3 * HOUR_MS + 600000, lambda t: 80 - 0.8 * t / 60000 % 40 + rng.uniform(-0.02, 0.02))
+        stdin = "".join("%d %.4f\n" % (t, v) for t, v, _ in trace)
+        result = subprocess.run([self.harness, "slope"], input=stdin, capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        lines = [line.split() for line in result.stdout.splitlines()]
+        self.assertEqual(len(lines), len(trace))
+
+        points = [(t, round(v, 4)) for t, v, _ in trace]
+        checked = 0
+        for index, (t, slope, span) in enumerate(lines):
+            window = [point for point in points[:index + 1] if int(t) - point[0] <= WINDOW_MS][-160:]
+            self.assertEqual(int(span), window[-1][0] - window[0][0])
+            if slope == "-":
+                self.assertLess(len(window), 3)
+                continue
+            # Across the sawtooth's reset the fit is steep; compare relative there
+            expected = fit_slope(window)
+            self.assertAlmostEqual(float(slope), expected, delta=0.001 + abs(expected) * 1e-4,
+                                   msg="slope at %d ms" % int(t))
+            checked += 1
+        self.assertGreater(checked, len(trace) - 5)
+
+        # Through the detector: raised once, never cleared across the rebases
+        steady = self.trace(3 * HOUR_MS, lambda t: 90 - 0.8 * t / 60000 % 1000 + rng.uniform(-0.02, 0.02))
+        samples, events = self.detect(steady)
+        self.check_rates(steady, samples)
+        self.assertEqual(events, [(START_MS + MIN_SPAN_MS + EVENT_DELAY_MS, "raised")])
+
+
+if __name__ == "__main__":
+    unittest.main()
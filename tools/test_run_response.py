@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Dry run detection on simulated pump runs.
+
+Builds tools/host/event_detector_harness.cpp with the firmware's
+EventDetector.cpp and PumpCycleAnalyzer.cpp and runs current and pressure
+traces through them, one sample every 2 seconds. A dry run is low current
+*and* no pressure rise: runs at normal current that hold pressure flat
+(heavy demand, or a pump already running at boot) must stay quiet, while a
+real dry run is raised 10 s into the run. Needs g++.
+
+    cd tools && python3 -m unittest test_run_response
+"""
+
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+SOURCES = ["src/EventDetector.cpp", "src/SlopeEstimator.cpp", "src/PumpCycleAnalyzer.cpp",
+           "tools/host/host_core.cpp", "tools/host/event_detector_harness.cpp"]
+
+SAMPLE_MS = 2000
+START_MS = 1000
+DRY_RUN_WINDOW_MS = 10000       # Pressure must rise within this of the run start
+WARMUP_CYCLES = 5               # Cycles before the baseline sets the current bound
+NORMAL_CURRENT = 8.0
+INRUSH_CURRENT = 14.0
+DRY_CURRENT = 3.0               # Under 0.75 of the learned 8 A
+EVENT_DRY_RUN = 8
+
+
+class RunResponseTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        compiler = os.environ.get("CXX", "g++")
+        if shutil.which(compiler) is None:
+            raise unittest.SkipTest("%s not found" % compiler)
+        cls.build_dir = tempfile.mkdtemp(prefix="run_response_")
+        cls.harness = os.path.join(cls.build_dir, "event_detector_harness")
+        command = [compiler, "-std=gnu++17", "-O2", "-Wall", "-Wno-unused-variable",
+                   "-I", os.path.join(TOOLS, "host", "shim"), "-I", os.path.join(ROOT, "include"),
+                   "-o", cls.harness] + [os.path.join(ROOT, path) for path in SOURCES]
+        result = subprocess.run(command, capture_output=True, text=True)
+        if result.returncode != 0:
+            raise AssertionError("harness build failed:\n" + result.stderr)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.build_dir, ignore_errors=True)
+
+    def dry_run_events(self, trace, dry_run_amps=None):
+        """Runs (ms, pressure, current) samples through the detector; returns
+        the (ms, state) dry run transitions."""
+        stdin = "".join("%d %.4f %.3f\n" % sample for sample in trace)
+        command = [self.harness, "detect"]
+        if dry_run_amps is not None:
+            command.append("%.2f" % dry_run_amps)
+        result = subprocess.run(command, input=stdin, capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        events = []
+        for line in result.stdout.splitlines():
+            fields = line.split()
+            if fields[0] == "EVENT" and int(fields[3]) == EVENT_DRY_RUN:
+                events.append((int(fields[1]), fields[2]))
+        return events
+
+    @staticmethod
+    def idle(start, duration_ms, pressure):
+        return [(t, pressure, 0.0) for t in range(start, start + duration_ms, SAMPLE_MS)]
+
+    @staticmethod
+    def pump_run(start, duration_ms, current, pressure):
+        """A pump run; pressure is a function of ms since the run started."""
+        samples = []
+        for t in range(start, start + duration_ms, SAMPLE_MS):
+            amps = INRUSH_CURRENT if t == start and current >= NORMAL_CURRENT else current
+            samples.append((t, pressure(t - start), amps))
+        return samples
+
+    def normal_cycles(self, start, count):
+        """Runs from 40 to 60 PSI at normal current with idle time between;
+        returns the trace and the time it ends."""
+        trace = []
+        t = start
+        for _ in range(count):
+            trace += self.idle(t, 60000, 40.0)
+            t += 60000
+            trace += self.pump_run(t, 60000, NORMAL_CURRENT, lambda ms: 40.0 + ms / 3000)
+            t += 60000
+        trace += self.idle(t, 60000, 60.0)
+        return trace, t + 60000
+
+    def test_heavy_demand_before_baseline_stays_quiet(self):
+        # Demand matches the pump: normal current, pressure flat for 2 minutes
+        trace = self.idle(START_MS, 60000, 50.0)
+        trace += self.pump_run(START_MS + 60000, 120000, NORMAL_CURRENT, lambda ms: 50.0)
+        trace += self.idle(START_MS + 180000, 20000, 50.0)
+        self.assertEqual(self.dry_run_events(trace), [])
+
+    def test_boot_while_running_stays_quiet(self):
+        # The first sample is mid-run near cut-out, where pressure can't rise
+        # another 2 PSI. Even below a configured dry run current this run's
+        # start wasn't seen, so there is no pressure response to judge.
+        trace = self.pump_run(START_MS, 60000, 5.0, lambda ms: 59.0)
+        trace += self.idle(START_MS + 60000, 20000, 59.0)
+        self.assertEqual(self.dry_run_events(trace), [])
+        self.assertEqual(self.dry_run_events(trace, dry_run_amps=6.0), [])
+
+        # The next run is observed and judged as usual
+        restart = START_MS + 80000
+        trace += self.pump_run(restart, 30000, 5.0, lambda ms: 59.0)
+        self.assertEqual(self.dry_run_events(trace, dry_run_amps=6.0),
+                         [(restart + DRY_RUN_WINDOW_MS, "raised")])
+
+    def test_heavy_demand_after_baseline_stays_quiet(self):
+        trace, t = self.normal_cycles(START_MS, WARMUP_CYCLES + 1)
+        trace += self.pump_run(t, 120000, NORMAL_CURRENT, lambda ms: 45.0)
+        self.assertEqual(self.dry_run_events(trace), [])
+
+    def test_dry_run_raised_once_baseline_is_ready(self):
+        trace, t = self.normal_cycles(START_MS, WARMUP_CYCLES + 1)
+        trace += self.pump_run(t, 30000, DRY_CURRENT, lambda ms: 40.0)
+        trace += self.idle(t + 30000, 10000, 40.0)
+        self.assertEqual(self.dry_run_events(trace),
+                         [(t + DRY_RUN_WINDOW_MS, "raised"), (t + 30000, "cleared")])
+
+    def test_dry_run_before_baseline_needs_configured_current(self):
+        trace = self.idle(START_MS, 20000, 40.0)
+        trace += self.pump_run(START_MS + 20000, 30000, DRY_CURRENT, lambda ms: 40.0)
+        self.assertEqual(self.dry_run_events(trace), [])
+        self.assertEqual(self.dry_run_events(trace, dry_run_amps=4.0),
+                         [(START_MS + 20000 + DRY_RUN_WINDOW_MS, "raised")])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""Benchmark the uplink path on the host against tools/mock_server.py.
+
+Compiles tools/host/uplink_harness.cpp together with the firmware's own
+APIClient, FlashOutbox and payload writers, starts the mock in-process with
+the requested latency and fault settings, runs the steady / outage /
+recovery scenario and prints throughput, drain time, retries and memory.
+With --sink mongodb the same scenario runs WellPumpMongoClient
+(tools/host/mongo_harness.cpp) against the mock's Data API endpoints.
+Needs g++; results are reproducible for a given --seed.
+
+    python3 tools/uplink_bench.py
+    python3 tools/uplink_bench.py --latency 0.05 --record-latency 0.002 --gzip
+    python3 tools/uplink_bench.py --drop-after-commit 0.1 --rate-limit 5 --json
+    python3 tools/uplink_bench.py --sink mongodb --drop-after-commit 0.2
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import threading
+
+from mock_server import MockServer, build_parser as build_mock_parser
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+
+# Firmware sources each harness links; everything else comes from tools/host
+FIRMWARE_SOURCES = {
+    "api": [
+        "src/APIClient.cpp",
+        "src/FlashOutbox.cpp",
+        "src/SequenceCounter.cpp",
+        "src/JsonWriter.cpp",
+        "src/CborWriter.cpp",
+        "src/Deflater.cpp",
+        "src/CircuitBreaker.cpp",
+        "src/TokenBucket.cpp",
+        "src/SensorRecord.cpp",
+    ],
+    "mongodb": [
+        "src/MongoDBClient.cpp",
+        "src/FlashOutbox.cpp",
+        "src/SequenceCounter.cpp",
+        "src/JsonWriter.cpp",
+        "src/CircuitBreaker.cpp",
+        "src/TokenBucket.cpp",
+        "src/SensorRecord.cpp",
+    ],
+}
+HOST_SOURCES = {
+    "api": ["tools/host/host_core.cpp", "tools/host/uplink_harness.cpp"],
+    "mongodb": ["tools/host/host_core.cpp", "tools/host/mongo_harness.cpp"],
+}
+
+
+def build_harness(output, compiler, sink):
+    command = [compiler, "-std=gnu++17", "-O2", "-Wall", "-Wno-unused-variable",
+               "-I", os.path.join(TOOLS, "host", "shim"), "-I", os.path.join(ROOT, "include"),
+               "-o", output]
+    command += [os.path.join(ROOT, path) for path in FIRMWARE_SOURCES[sink] + HOST_SOURCES[sink]]
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr)
+        raise SystemExit("uplink_bench: harness build failed")
+
+
+def start_mock(args):
+    mock_args = ["--latency", str(args.latency), "--latency-jitter", str(args.latency_jitter),
+                 "--record-latency", str(args.record_latency), "--rate-limit", str(args.rate_limit),
+                 "--error-before-commit", str(args.error_rate), "--retry-after", str(args.retry_after),
+                 "--drop-after-commit", str(args.drop_after_commit),
+                 "--stall-seconds", "0", "--seed", str(args.seed)]
+    if args.record:
+        mock_args += ["--record", args.record]
+    options = build_mock_parser().parse_args(mock_args)
+    server = MockServer(("127.0.0.1", 0), options)
+    thread = threading.Thread(target=server.serve_forever, daemon=True)
+    thread.start()
+    return server
+
+
+def run_harness(binary, port, args):
+    command = [binary, "--url", "http://127.0.0.1:%d" % port,
+               "--steady", str(args.steady), "--outage", str(args.outage),
+               "--interval-ms", str(args.interval_ms), "--drain-limit-ms", str(args.drain_limit_ms)]
+    if args.cbor and args.sink == "api":
+        command.append("--cbor")
+    if args.gzip and args.sink == "api":
+        command.append("--gzip")
+    if args.real_time_recovery or args.rate_limit > 0:
+        command.append("--real-time-recovery")
+    if args.verbose:
+        command.append("--verbose")
+    result = subprocess.run(command, stdout=subprocess.PIPE, text=True)
+    if result.returncode not in (0, 3):
+        raise SystemExit("uplink_bench: harness exited with %d" % result.returncode)
+    return json.loads(result.stdout)
+
+
+def print_report(report):
+    print("sink %s, encoding %s, compression %s" % (
+        report.get("sink", "api"), report["encoding"], "on" if report["compression"] else "off"))
+    print("%-9s %8s %10s %9s %9s %8s %8s %8s %10s %10s" % (
+        "phase", "records", "wall ms", "rec/s", "requests", "conns", "reused", "retries", "avg req ms",
+        "allocs/rec"))
+    for phase in ("steady", "outage", "recovery"):
+        p = report[phase]
+        print("%-9s %8d %10.1f %9.1f %9d %8d %8d %8d %10.1f %10.1f" % (
+            phase, p["records"], p["wallMs"], p["recordsPerSecond"], p["requests"],
+            p["connections"], p["reused"], p["reconnectRetries"], p["avgRequestMs"],
+            p["allocationsPerRecord"]))
+
+    recovery = report["recovery"]
+    print("backlog %d records drained in %.1f s simulated (%d requests), %d left undrained" % (
+        report["backlog"], recovery["simulatedMs"] / 1000.0, recovery["requests"], report["undrained"]))
+    print("final batch size %d, outbox dropped %d, rejected %d" % (
+        report["finalBatchSize"], report["outboxDropped"], report["rejected"]))
+    if report["compression"]:
+        print("compressed batches %d, ratio %.2f" % (report["compressedBatches"], report["compressionRatio"]))
+
+    if "breaker" in report:
+        breaker = report["breaker"]
+        print("breaker %s at the end, %d trips, %d requests deferred by breaker or rate limit" % (
+            breaker["state"], breaker["trips"], breaker["deferred"]))
+    if "mongo" in report:
+        mongo = report["mongo"]
+        print("mongodb: %d documents in %d insertMany requests, %d duplicates settled, %d/%d events sent" % (
+            mongo["documents"], mongo["insertMany"], mongo["duplicates"], mongo["eventsSent"],
+            mongo["eventsSent"] + mongo["eventsFailed"]))
+
+    memory = report["memory"]
+    print("heap: client %d B, peak %d B; outbox flash %d B; max RSS %d KB" % (
+        memory["clientHeapBytes"], memory["peakHeapBytes"], memory["outboxFlashBytes"], memory["maxRssKb"]))
+
+    server = report["server"]
+    print("server: %d requests, %d stored, %d resent, %d 429s, %d 503s, %d dropped responses, %d sequence gaps" % (
+        server["requests"], server["sensorsStored"], server["resent"], server["rateLimited"],
+        server["outageRejections"] + server["injectedErrors"], server["droppedResponses"],
+        server["missingSequences"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--steady", type=int, default=60, help="aggregates sent on a healthy link")
+    parser.add_argument("--outage", type=int, default=240, help="aggregates sent while the server is down")
+    parser.add_argument("--interval-ms", type=int, default=60000, help="simulated time between aggregates")
+    parser.add_argument("--drain-limit-ms", type=int, default=600000, help="simulated time allowed for recovery")
+    parser.add_argument("--sink", choices=("api", "mongodb"), default="api",
+                        help="client to run: the HTTP API client or the MongoDB Data API client")
+    parser.add_argument("--cbor", action="store_true", help="API sink only")
+    parser.add_argument("--gzip", action="store_true", help="API sink only")
+    parser.add_argument("--real-time-recovery", action="store_true",
+                        help="let the recovery phase run on the wall clock instead of skipping ahead")
+    parser.add_argument("--latency", type=float, default=0.0)
+    parser.add_argument("--latency-jitter", type=float, default=0.0)
+    parser.add_argument("--record-latency", type=float, default=0.0)
+    parser.add_argument("--rate-limit", type=int, default=0,
+                        help="server requests per wall-clock second; implies --real-time-recovery")
+    parser.add_argument("--error-rate", type=float, default=0.0, help="probability of a 503 before commit")
+    parser.add_argument("--retry-after", type=int, default=0, help="Retry-After seconds on 429 and 503")
+    parser.add_argument("--drop-after-commit", type=float, default=0.0)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--record", metavar="FILE", help="append the records the server stores to FILE")
+    parser.add_argument("--compiler", default=os.environ.get("CXX", "g++"))
+    parser.add_argument("--json", action="store_true", help="print the raw report")
+    parser.add_argument("--verbose", action="store_true", help="pass the client's Serial log through")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory(prefix="uplink_bench_") as build_dir:
+        binary = os.path.join(build_dir, "uplink_harness")
+        build_harness(binary, args.compiler, args.sink)
+
+        server = start_mock(args)
+        try:
+            report = run_harness(binary, server.server_port, args)
+        finally:
+            server.shutdown()
+
+    stats = server.store.stats()
+    sequences = stats["sequences"].get("WellPump_HOST", {})
+    stats["resent"] = stats["recordsReceived"] - stats["sensorsStored"] - stats["eventsStored"]
+    stats["missingSequences"] = len(sequences.get("missing", []))
+    report["server"] = stats
+
+    if args.json:
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+    return 0 if report["undrained"] == 0 else 3
+
+
+if __name__ == "__main__":
+    sys.exit(main())